@@ -0,0 +1,26 @@
+/*
+ * Stand-in for the SDK log.h in the host build of NVKVS. Only on the include
+ * path of the host build.
+ */
+#ifndef NVKVS_HOST_LOG_H
+#define NVKVS_HOST_LOG_H
+
+#include <stdio.h>
+
+#ifndef DBG_TAG
+#define DBG_TAG "NVKVS"
+#endif
+
+#define LOG_E(fmt, ...) fprintf(stderr, "[E][" DBG_TAG "] " fmt, ##__VA_ARGS__)
+#define LOG_W(fmt, ...) fprintf(stderr, "[W][" DBG_TAG "] " fmt, ##__VA_ARGS__)
+#ifdef NVKVS_HOST_VERBOSE
+#define LOG_I(fmt, ...) fprintf(stderr, "[I][" DBG_TAG "] " fmt, ##__VA_ARGS__)
+#define LOG_D(fmt, ...) fprintf(stderr, "[D][" DBG_TAG "] " fmt, ##__VA_ARGS__)
+#else
+#define LOG_I(fmt, ...)
+#define LOG_D(fmt, ...)
+#endif
+#define LOG_T(fmt, ...)
+#define LOG_F(fmt, ...) fprintf(stderr, "[F][" DBG_TAG "] " fmt, ##__VA_ARGS__)
+
+#endif // NVKVS_HOST_LOG_H
@@ -0,0 +1,308 @@
+/*
+ * NVKVS access service benchmark on a host
+ *
+ * Runs batched requests through a loopback service (oblfr_nvkvs_service_request)
+ * on a NVKVS store in RAM, the processing of a request by the service without
+ * RPMsg, and reports the operations and requests per second:
+ *
+ *   set        SET of every key, u32 values
+ *   get        GET of every key, values checked
+ *   iter       ITER pages until the cursor is 0, per entry returned
+ *   delete     DELETE of every key
+ *
+ * for batches of 1, 8 and 32 operations per request. Requests and responses
+ * are at most -m bytes, the RPMsg payload (2032 bytes with the default
+ * CONFIG_RPMSG_BUFFER_SIZE), and operations that do not fit in a response are
+ * sent again, as tools/nvkvs_client.py does.
+ *
+ *     nvkvs_service_bench [-n rounds] [-k keys] [-s shards] [-m max message size]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "oblfr_nvkvs.h"
+#include "oblfr_nvkvs_service.h"
+
+#define MAX_MSG_SIZE 4096
+#define KEY_FORMAT   "k%05u"
+#define MAX_KEYS     100000
+
+typedef struct bench_op_s {
+    uint8_t op;
+    uint8_t type;
+    char key[KVED_MAX_KEY_SIZE + 1];
+    uint32_t value;
+} bench_op_t;
+
+static const uint32_t batch_sizes[] = { 1, 8, 32 };
+static uint32_t msg_size = 2032;
+static uint32_t requests;
+
+static uint64_t time_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t key_value(uint32_t key, uint32_t round)
+{
+    return key * 2654435761u + round;
+}
+
+/* one request with as many of ops as fit, returns how many of them were executed */
+static uint32_t bench_request(oblfr_nvkvs_service_t *svc, const bench_op_t *ops, uint32_t count,
+                              uint8_t *resp, size_t *resp_len)
+{
+    static uint16_t seq;
+    uint8_t req[MAX_MSG_SIZE];
+    oblfr_nvkvs_service_hdr_t hdr = {
+        .magic = OBLFR_NVKVS_SERVICE_MAGIC,
+        .version = OBLFR_NVKVS_SERVICE_VERSION,
+        .seq = ++seq,
+    };
+    size_t len = sizeof(hdr);
+
+    for (; hdr.count < count; hdr.count++) {
+        const bench_op_t *op = &ops[hdr.count];
+        oblfr_nvkvs_service_rec_t rec = {
+            .op = op->op,
+            .type = op->type,
+            .key_len = strlen(op->key),
+            .value_len = op->op == OBLFR_NVKVS_SERVICE_OP_GET || op->op == OBLFR_NVKVS_SERVICE_OP_DELETE ? 0 : sizeof(op->value),
+        };
+
+        if (len + sizeof(rec) + rec.key_len + rec.value_len > msg_size) {
+            break;
+        }
+        memcpy(req + len, &rec, sizeof(rec));
+        len += sizeof(rec);
+        memcpy(req + len, op->key, rec.key_len);
+        len += rec.key_len;
+        memcpy(req + len, &op->value, rec.value_len);
+        len += rec.value_len;
+    }
+    memcpy(req, &hdr, sizeof(hdr));
+
+    *resp_len = msg_size;
+    if (oblfr_nvkvs_service_request(svc, req, len, resp, resp_len) != OBLFR_OK) {
+        fprintf(stderr, "request rejected\n");
+        exit(1);
+    }
+    requests++;
+    memcpy(&hdr, resp, sizeof(hdr));
+    if (hdr.seq != seq || hdr.done == 0) {
+        fprintf(stderr, "unexpected response\n");
+        exit(1);
+    }
+    return hdr.done;
+}
+
+/* runs ops in batches of batch, checks the status and the values of GET */
+static void bench_batch(oblfr_nvkvs_service_t *svc, const bench_op_t *ops, uint32_t count, uint32_t batch)
+{
+    uint8_t resp[MAX_MSG_SIZE];
+    size_t resp_len;
+
+    while (count > 0) {
+        uint32_t done = bench_request(svc, ops, count < batch ? count : batch, resp, &resp_len);
+        size_t pos = sizeof(oblfr_nvkvs_service_hdr_t);
+
+        for (uint32_t i = 0; i < done; i++) {
+            oblfr_nvkvs_service_rec_t rec;
+            uint32_t value;
+
+            memcpy(&rec, resp + pos, sizeof(rec));
+            pos += sizeof(rec) + rec.key_len;
+            if (rec.op != OBLFR_NVKVS_SERVICE_OK) {
+                fprintf(stderr, "%s: status %u\n", ops[i].key, rec.op);
+                exit(1);
+            }
+            if (ops[i].op == OBLFR_NVKVS_SERVICE_OP_GET) {
+                memcpy(&value, resp + pos, sizeof(value));
+                if (rec.value_len != sizeof(value) || value != ops[i].value) {
+                    fprintf(stderr, "%s: wrong value\n", ops[i].key);
+                    exit(1);
+                }
+            }
+            pos += rec.value_len;
+        }
+        ops += done;
+        count -= done;
+    }
+}
+
+/* iterates over the store, pages limited by the message size, returns the number of entries */
+static uint32_t bench_iter(oblfr_nvkvs_service_t *svc)
+{
+    uint8_t resp[MAX_MSG_SIZE];
+    size_t resp_len;
+    bench_op_t op = { .op = OBLFR_NVKVS_SERVICE_OP_ITER };
+    uint32_t entries = 0;
+
+    do {
+        oblfr_nvkvs_service_hdr_t hdr;
+        oblfr_nvkvs_service_rec_t rec;
+        size_t pos = sizeof(hdr);
+
+        bench_request(svc, &op, 1, resp, &resp_len);
+        memcpy(&hdr, resp, sizeof(hdr));
+        /* the last record is the cursor */
+        for (uint16_t i = 0; i < hdr.count; i++) {
+            memcpy(&rec, resp + pos, sizeof(rec));
+            pos += sizeof(rec) + rec.key_len;
+            if (i + 1 == hdr.count) {
+                memcpy(&op.value, resp + pos, sizeof(op.value));
+            }
+            pos += rec.value_len;
+        }
+        entries += hdr.count - 1;
+    } while (op.value != 0);
+    return entries;
+}
+
+static void bench_report(const char *name, uint32_t batch, uint64_t ops, uint64_t ns)
+{
+    printf("  %-6s batch %2u: %9.0f ops/s %8.0f requests/s\n", name, batch, ops * 1e9 / ns,
+           requests * 1e9 / ns);
+}
+
+/* kved prints the tables of every shard at init */
+static oblfr_nvkvs_handle_t *bench_init(const oblfr_nvkvs_cfg_t *cfg)
+{
+    oblfr_nvkvs_handle_t *handle;
+    int out = dup(STDOUT_FILENO);
+    int null = open("/dev/null", O_WRONLY);
+
+    fflush(stdout);
+    dup2(null, STDOUT_FILENO);
+    handle = oblfr_nvkvs_init(cfg);
+    fflush(stdout);
+    dup2(out, STDOUT_FILENO);
+    close(null);
+    close(out);
+    return handle;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t rounds = 100;
+    uint32_t keys = 128;
+    uint32_t shards = 8;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:k:s:m:")) != -1) {
+        switch (opt) {
+            case 'n':
+                rounds = strtoul(optarg, NULL, 0);
+                break;
+            case 'k':
+                keys = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                shards = strtoul(optarg, NULL, 0);
+                break;
+            case 'm':
+                msg_size = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n rounds] [-k keys] [-s shards] [-m max message size]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (rounds == 0 || keys == 0 || keys > MAX_KEYS || shards == 0 || shards > 255 || msg_size < 64 || msg_size > MAX_MSG_SIZE) {
+        fprintf(stderr, "invalid arguments\n");
+        return 1;
+    }
+
+    oblfr_nvkvs_cfg_t cfg = {
+        .storage = OBLFR_NVKVS_STORAGE_RAM,
+        .shards = (uint8_t)shards,
+    };
+    oblfr_nvkvs_handle_t *handle = bench_init(&cfg);
+    oblfr_nvkvs_service_cfg_t svc_cfg = {
+        .loopback = true,
+    };
+    oblfr_nvkvs_service_t *svc = handle != NULL ? oblfr_nvkvs_service_start(handle, &svc_cfg) : NULL;
+    bench_op_t *set_ops = calloc(keys, sizeof(bench_op_t));
+    bench_op_t *get_ops = calloc(keys, sizeof(bench_op_t));
+    bench_op_t *del_ops = calloc(keys, sizeof(bench_op_t));
+    if (svc == NULL || set_ops == NULL || get_ops == NULL || del_ops == NULL) {
+        fprintf(stderr, "init failed\n");
+        return 1;
+    }
+    for (uint32_t i = 0; i < keys; i++) {
+        snprintf(set_ops[i].key, sizeof(set_ops[i].key), KEY_FORMAT, i % MAX_KEYS);
+        set_ops[i].op = OBLFR_NVKVS_SERVICE_OP_SET;
+        set_ops[i].type = OBLFR_NVKVS_DATA_TYPE_UINT32;
+        get_ops[i] = set_ops[i];
+        get_ops[i].op = OBLFR_NVKVS_SERVICE_OP_GET;
+        del_ops[i] = set_ops[i];
+        del_ops[i].op = OBLFR_NVKVS_SERVICE_OP_DELETE;
+    }
+
+    printf("NVKVS service: %u keys in %u shards (RAM), %u rounds, messages of %u B\n", keys, shards, rounds,
+           msg_size);
+    for (size_t b = 0; b < sizeof(batch_sizes) / sizeof(batch_sizes[0]); b++) {
+        uint32_t batch = batch_sizes[b];
+        uint64_t set_ns = 0, get_ns = 0, iter_ns = 0, del_ns = 0;
+        uint32_t set_req = 0, get_req = 0, iter_req = 0, del_req = 0;
+        uint64_t entries = 0;
+
+        for (uint32_t round = 0; round < rounds; round++) {
+            uint64_t start;
+
+            for (uint32_t i = 0; i < keys; i++) {
+                set_ops[i].value = get_ops[i].value = key_value(i, round);
+            }
+            requests = 0;
+            start = time_ns();
+            bench_batch(svc, set_ops, keys, batch);
+            set_ns += time_ns() - start;
+            set_req += requests;
+
+            requests = 0;
+            start = time_ns();
+            bench_batch(svc, get_ops, keys, batch);
+            get_ns += time_ns() - start;
+            get_req += requests;
+
+            requests = 0;
+            start = time_ns();
+            entries += bench_iter(svc);
+            iter_ns += time_ns() - start;
+            iter_req += requests;
+
+            requests = 0;
+            start = time_ns();
+            bench_batch(svc, del_ops, keys, batch);
+            del_ns += time_ns() - start;
+            del_req += requests;
+        }
+        if (entries != (uint64_t)keys * rounds) {
+            fprintf(stderr, "iter returned %lu entries, expected %lu\n", (unsigned long)entries,
+                    (unsigned long)keys * rounds);
+            return 1;
+        }
+        requests = set_req;
+        bench_report("set", batch, (uint64_t)keys * rounds, set_ns);
+        requests = get_req;
+        bench_report("get", batch, (uint64_t)keys * rounds, get_ns);
+        requests = del_req;
+        bench_report("delete", batch, (uint64_t)keys * rounds, del_ns);
+        /* iter pages are only limited by the message size */
+        if (b == 0) {
+            printf("  iter   pages   : %9.0f entries/s %8.0f requests/s\n", entries * 1e9 / iter_ns,
+                   iter_req * 1e9 / iter_ns);
+        }
+    }
+
+    oblfr_nvkvs_service_stop(svc);
+    oblfr_nvkvs_deinit(handle);
+    return 0;
+}
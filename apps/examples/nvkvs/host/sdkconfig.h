@@ -0,0 +1,18 @@
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+/*
+Configuration of the host build, oblfr_common.h and kved.h include it.
+The NVKVS component with the defaults of its Kconfig, on the memory backend,
+and the access service without RPMsg, only in loopback mode.
+*/
+#define CONFIG_COMPONENT_NVKVS                   1
+#define CONFIG_COMPONENT_NVKVS_MEM_BACKEND       1
+#define CONFIG_COMPONENT_NVKVS_MAX_STRING_SIZE   64
+#define CONFIG_COMPONENT_NVKVS_MAX_ARRAY_SIZE    64
+#define CONFIG_COMPONENT_NVKVS_LOOKUP_INDEX      1
+#define CONFIG_COMPONENT_NVKVS_BLOOM_FILTER_SIZE 64
+#define CONFIG_COMPONENT_NVKVS_FACTORY           1
+#define CONFIG_COMPONENT_NVKVS_SERVICE           1
+
+#endif // SDKCONFIG_H
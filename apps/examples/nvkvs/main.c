@@ -26,6 +26,7 @@
 void app_main(void *arg) {
     oblfr_kved_flash_driver_t kved_flash_drv = {
         .flash_addr = 0xF0000,
+        .xip_read = true,
     };
 
     oblfr_nvkvs_cfg_t nvkvs_cfg = {
@@ -151,6 +152,49 @@ void app_main(void *arg) {
         LOG_I("STRING: %s = %s\r\n", v, v2);
         KVED_RUN_DUMP(ctrl);
     }
+    // STRING (zero copy)
+    {
+        LOG_I("Test STRING REF\r\n");
+        const char *ref;
+        size_t len;
+        uint32_t gen;
+        CHECK_ERR(oblfr_nvkvs_get_string_ref(handle, "STRING", &ref, &len, &gen));
+        if (gen == oblfr_nvkvs_get_generation(handle)) {
+            LOG_I("STRING REF: %.*s (%d bytes at %p)\r\n", len, ref, len, ref);
+        }
+    }
+
+    // FLOAT ARRAY
+    {
+        LOG_I("Test FLOAT ARRAY\r\n");
+        float cal[8];
+        for (int i = 0; i < 8; i++) {
+            cal[i] = 1.0f + i * 0.125f;
+        }
+        CHECK_ERR(oblfr_nvkvs_set_float_array(handle, "CAL", cal, 8));
+        float v2[8];
+        size_t count = 8;
+        CHECK_ERR(oblfr_nvkvs_get_float_array(handle, "CAL", v2, &count));
+        LOG_I("FLOAT ARRAY: %d elements, [7] = %f\r\n", count, v2[7]);
+        float part[2];
+        CHECK_ERR(oblfr_nvkvs_get_float_array_range(handle, "CAL", 3, part, 2));
+        LOG_I("FLOAT ARRAY RANGE: [3] = %f [4] = %f\r\n", part[0], part[1]);
+        KVED_RUN_DUMP(ctrl);
+    }
+
+    // PACKED GROUP
+    {
+        LOG_I("Test PACKED GROUP\r\n");
+        CHECK_ERR(oblfr_nvkvs_set_packed_bool(handle, "FLAGS", 0, true));
+        CHECK_ERR(oblfr_nvkvs_set_packed_bool(handle, "FLAGS", 5, true));
+        CHECK_ERR(oblfr_nvkvs_set_packed_u8(handle, "BYTES", 2, 0x42));
+        bool f;
+        CHECK_ERR(oblfr_nvkvs_get_packed_bool(handle, "FLAGS", 5, &f));
+        uint8_t b;
+        CHECK_ERR(oblfr_nvkvs_get_packed_u8(handle, "BYTES", 2, &b));
+        LOG_I("PACKED: FLAGS[5] = %d BYTES[2] = 0x%02x\r\n", f, b);
+        KVED_RUN_DUMP(ctrl);
+    }
 
     /* force a Index Table Rollover */
     {
@@ -185,7 +229,7 @@ void app_main(void *arg) {
     // iterate over all keys 
     {
         LOG_I("Iterate over all keys\r\n");
-        uint16_t iter = oblfr_nvkvs_iter_init(handle);
+        int32_t iter = oblfr_nvkvs_iter_init(handle);
         while (iter != 0) {
             oblfr_nvkvs_data_t data;
             oblfr_nvkvs_get_item(handle, iter, &data);
@@ -224,6 +268,13 @@ void app_main(void *arg) {
                 case OBLFR_NVKVS_DATA_TYPE_STRING:
                     LOG_I("\tSTRING: %s\r\n", data.value.str);
                     break;
+                case OBLFR_NVKVS_DATA_TYPE_UINT8_ARRAY:
+                case OBLFR_NVKVS_DATA_TYPE_UINT16_ARRAY:
+                case OBLFR_NVKVS_DATA_TYPE_UINT32_ARRAY:
+                case OBLFR_NVKVS_DATA_TYPE_FLOAT_ARRAY:
+                case OBLFR_NVKVS_DATA_TYPE_DOUBLE_ARRAY:
+                    LOG_I("\tARRAY: %d bytes\r\n", data.size);
+                    break;
             }
             iter = oblfr_nvkvs_iter_next(handle, iter);
         }
@@ -232,10 +283,10 @@ void app_main(void *arg) {
     /* some statistics */
     {
         LOG_I("Statistics\r\n");
-        LOG_I("Total Size: %d\r\n", oblfr_nvkvs_get_size(handle));
-        LOG_I("Used Size: %d\r\n", oblfr_nvkvs_used_entries(handle));
-        LOG_I("Free Size: %d\r\n", oblfr_nvkvs_free_entries(handle));
-        LOG_I("Deleted Entries: %d\r\n", oblfr_nvkvs_deleted_entries(handle));
+        LOG_I("Total Size: %ld\r\n", oblfr_nvkvs_get_size(handle));
+        LOG_I("Used Size: %ld\r\n", oblfr_nvkvs_used_entries(handle));
+        LOG_I("Free Size: %ld\r\n", oblfr_nvkvs_free_entries(handle));
+        LOG_I("Deleted Entries: %ld\r\n", oblfr_nvkvs_deleted_entries(handle));
     }
     /* compact */
     {
@@ -249,10 +300,17 @@ void app_main(void *arg) {
     }
     {
         LOG_I("Final Statistics\r\n");
-        LOG_I("Total Size: %d\r\n", oblfr_nvkvs_get_size(handle));
-        LOG_I("Used Size: %d\r\n", oblfr_nvkvs_used_entries(handle));
-        LOG_I("Free Size: %d\r\n", oblfr_nvkvs_free_entries(handle));
-        LOG_I("Deleted Entries: %d\r\n", oblfr_nvkvs_deleted_entries(handle));
+        LOG_I("Total Size: %ld\r\n", oblfr_nvkvs_get_size(handle));
+        LOG_I("Used Size: %ld\r\n", oblfr_nvkvs_used_entries(handle));
+        LOG_I("Free Size: %ld\r\n", oblfr_nvkvs_free_entries(handle));
+        LOG_I("Deleted Entries: %ld\r\n", oblfr_nvkvs_deleted_entries(handle));
+        oblfr_nvkvs_stats_t stats;
+        CHECK_ERR(oblfr_nvkvs_get_stats(handle, &stats));
+        LOG_I("Compactions: %d (last %d us, max %d us, lifetime %d)\r\n", stats.compactions, stats.compaction_last_us, stats.compaction_max_us, stats.lifetime_compactions);
+        LOG_I("Erases: Index %d/%d String %d/%d\r\n", stats.sector_erases[0], stats.sector_erases[1], stats.sector_erases[2], stats.sector_erases[3]);
+        LOG_I("String Area: %d live / %d written / %d total bytes, fragmentation %f\r\n", stats.string_bytes_live, stats.string_bytes_allocated, stats.string_bytes_total, stats.string_fragmentation);
+        LOG_I("Bytes Written: %ld, write amplification %f\r\n", stats.bytes_written, stats.write_amplification);
+        LOG_I("Lookups: %d, %f probes per lookup\r\n", stats.lookups, stats.avg_lookup_probes);
     }
 
    while (true) {
@@ -0,0 +1,32 @@
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+/*
+Host stand-in of the FreeRTOS API used by oblfr_rpmsg.c, on pthreads, see
+sdk_host.c. A tick is a millisecond. Priorities are accepted but the threads
+keep the default one, so the priority classes only separate the queues.
+*/
+#include <stdint.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdPASS  1
+#define pdFAIL  0
+
+#define configTICK_RATE_HZ   1000
+#define configMAX_PRIORITIES 32
+#define portTICK_PERIOD_MS   (1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY        ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)    ((TickType_t)(ms) / portTICK_PERIOD_MS)
+
+/* masks the interrupt thread of the loopback platform and excludes the other tasks */
+void vHostEnterCritical(void);
+void vHostExitCritical(void);
+#define taskENTER_CRITICAL() vHostEnterCritical()
+#define taskEXIT_CRITICAL()  vHostExitCritical()
+
+#endif // FREERTOS_H
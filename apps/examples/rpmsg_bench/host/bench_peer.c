@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_peer.h"
+
+static int bench_peer_reply(bench_peer_t *peer, uint8_t type, uint32_t seq, uint32_t count)
+{
+    bench_msg_t msg = {
+        .magic = BENCH_MAGIC,
+        .type = type,
+        .seq = seq,
+        .count = count,
+    };
+    return peer->send(peer->ctx, &msg, sizeof(msg));
+}
+
+static void *bench_peer_source(void *arg)
+{
+    bench_peer_t *peer = arg;
+    uint8_t *buf = malloc(peer->source_size);
+    bench_msg_t msg = {
+        .magic = BENCH_MAGIC,
+        .type = BENCH_MSG_DATA,
+    };
+
+    if (buf == NULL) {
+        fprintf(stderr, "bench_peer: out of memory\n");
+        return NULL;
+    }
+    memset(buf, 0xA5, peer->source_size);
+    for (uint32_t i = 1; i <= peer->source_count; i++) {
+        msg.seq = i;
+        memcpy(buf, &msg, sizeof(msg));
+        if (peer->send(peer->ctx, buf, peer->source_size) != 0) {
+            fprintf(stderr, "bench_peer: send failed\n");
+            break;
+        }
+    }
+    free(buf);
+    return NULL;
+}
+
+int bench_peer_hello(bench_peer_t *peer)
+{
+    return bench_peer_reply(peer, BENCH_MSG_HELLO, 0, 0);
+}
+
+int bench_peer_handle(bench_peer_t *peer, const void *data, size_t len)
+{
+    bench_msg_t msg;
+
+    if (len < sizeof(msg)) {
+        return -1;
+    }
+    memcpy(&msg, data, sizeof(msg));
+    if (msg.magic != BENCH_MAGIC) {
+        return -1;
+    }
+    switch (msg.type) {
+        case BENCH_MSG_HELLO:
+            return 0;
+        case BENCH_MSG_ECHO:
+            return peer->send(peer->ctx, data, len);
+        case BENCH_MSG_SINK:
+            peer->sunk++;
+            return 0;
+        case BENCH_MSG_SYNC: {
+            uint32_t sunk = peer->sunk;
+            peer->sunk = 0;
+            return bench_peer_reply(peer, BENCH_MSG_SYNC, msg.seq, sunk);
+        }
+        case BENCH_MSG_SOURCE:
+            bench_peer_stop(peer);
+            if (msg.size < sizeof(bench_msg_t) || msg.size > peer->mtu) {
+                return -1;
+            }
+            peer->source_count = msg.count;
+            peer->source_size = msg.size;
+            if (pthread_create(&peer->source, NULL, bench_peer_source, peer) != 0) {
+                return -1;
+            }
+            peer->source_running = true;
+            return 0;
+        case BENCH_MSG_DONE:
+            peer->done = true;
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+void bench_peer_stop(bench_peer_t *peer)
+{
+    if (peer->source_running) {
+        pthread_join(peer->source, NULL);
+        peer->source_running = false;
+    }
+}
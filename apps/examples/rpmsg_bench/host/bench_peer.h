@@ -0,0 +1,52 @@
+#ifndef RPMSG_BENCH_PEER_H
+#define RPMSG_BENCH_PEER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "bench_msg.h"
+
+/*
+Peer side of the RPMsg benchmark (see src/bench_msg.h), for POSIX systems:
+Linux on D0 (rpmsg_bench_peer.c) and the host loopback build (main.c).
+*/
+
+/**
+ * @brief Send a message to the benchmark, blocking. Returns 0 on success
+ */
+typedef int (*bench_peer_send_t)(void *ctx, const void *data, size_t len);
+
+/**
+ * @brief Peer state
+ */
+typedef struct bench_peer_s {
+    bench_peer_send_t send;     /**< transport */
+    void *ctx;                  /**< passed to send */
+    uint32_t mtu;               /**< largest message */
+    uint32_t sunk;              /**< SINK messages since the last SYNC */
+    bool done;                  /**< DONE received */
+    pthread_t source;           /**< thread sending DATA for a SOURCE */
+    bool source_running;
+    uint32_t source_count;
+    uint32_t source_size;
+} bench_peer_t;
+
+/**
+ * @brief Tell the benchmark the peer is ready
+ * @return 0 on success
+ */
+int bench_peer_hello(bench_peer_t *peer);
+
+/**
+ * @brief Handle a message received from the benchmark
+ * @return 0 on success, -1 if the message is malformed
+ */
+int bench_peer_handle(bench_peer_t *peer, const void *data, size_t len);
+
+/**
+ * @brief Wait for a SOURCE in progress to finish
+ */
+void bench_peer_stop(bench_peer_t *peer);
+
+#endif // RPMSG_BENCH_PEER_H
@@ -0,0 +1,9 @@
+#ifndef BFLB_L1C_H
+#define BFLB_L1C_H
+
+/* host stand-in of the SDK cache driver, the loopback platform simulates the cache */
+static inline void bflb_l1c_dcache_disable(void)
+{
+}
+
+#endif // BFLB_L1C_H
@@ -0,0 +1,16 @@
+#ifndef BFLB_MTIMER_H
+#define BFLB_MTIMER_H
+
+/* host stand-in of the SDK timer, for the oblfr_rpmsg sources */
+#include <stdint.h>
+#include <time.h>
+
+static inline uint64_t bflb_mtimer_get_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+#endif // BFLB_MTIMER_H
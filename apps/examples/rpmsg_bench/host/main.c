@@ -0,0 +1,245 @@
+/*
+ * RPMsg benchmark on a host
+ *
+ * Runs the benchmark (src/bench.c) on the remote side of the loopback
+ * platform, with oblfr_rpmsg, and the peer on the master side,
+ * in a thread, or with -p in a second process:
+ *
+ *     rpmsg_bench_host [-p] [-d] [-e] [-b kick batch] [-B buffers] [-S buffer size]
+ *                      [-n ping-pongs] [-c stream messages]
+ *
+ * -d receives on a direct endpoint, -e negotiates VIRTIO_RING_F_EVENT_IDX
+ * on both sides, -b batches the notifications of the benchmark side.
+ * -B and -S set the buffer pool of both sides, buffers per direction and
+ * buffer size with the rpmsg header.
+ *
+ * Built with RL_USE_DCACHE (rpmsg_bench_dcache), the sides always run in
+ * two processes, each with its simulated cache.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "rpmsg_lite.h"
+#include "rpmsg_ns.h"
+#include "rpmsg_queue.h"
+#include "oblfr_rpmsg_host.h"
+#include "bench.h"
+#include "bench_peer.h"
+
+#define BENCH_ENDPOINT "rpmsg-raw"
+#define SHMEM_SIZE     platform_loopback_shmem_size(RL_PLATFORM_LOOPBACK_MASTER_LINK_ID)
+
+static sem_t bench_sem;
+static void *shmem;
+static uint32_t init_flags = RL_NO_FLAGS;
+
+uint64_t bench_port_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+void bench_port_signal(void)
+{
+    sem_post(&bench_sem);
+}
+
+bool bench_port_wait(uint32_t timeout_ms)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    while (sem_timedwait(&bench_sem, &ts) != 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* master side, what Linux does on the target */
+typedef struct peer_link_s {
+    struct rpmsg_lite_instance *rpmsg;
+    struct rpmsg_lite_endpoint *ept;
+    volatile uint32_t dst;
+} peer_link_t;
+
+static void peer_ns_cb(uint32_t new_ept, const char *new_ept_name, uint32_t flags, void *user_data)
+{
+    peer_link_t *link = user_data;
+
+    if (flags == RL_NS_CREATE && strcmp(new_ept_name, BENCH_ENDPOINT) == 0) {
+        link->dst = new_ept;
+    }
+}
+
+static int peer_send(void *ctx, const void *data, size_t len)
+{
+    peer_link_t *link = ctx;
+
+    return rpmsg_lite_send(link->rpmsg, link->ept, link->dst, (char *)data, len, RL_BLOCK) == RL_SUCCESS ? 0 : -1;
+}
+
+static void *peer_main(void *arg)
+{
+    peer_link_t link = { .dst = RL_ADDR_ANY };
+    bench_peer_t peer = { .send = peer_send, .ctx = &link, .mtu = RL_BUFFER_PAYLOAD_SIZE(RL_PLATFORM_LOOPBACK_MASTER_LINK_ID) };
+    rpmsg_queue_handle queue;
+    rpmsg_ns_handle ns;
+    uint32_t src, len;
+    char *msg;
+
+    link.rpmsg = rpmsg_lite_master_init(shmem, SHMEM_SIZE, RL_PLATFORM_LOOPBACK_MASTER_LINK_ID, init_flags);
+    if (link.rpmsg == NULL) {
+        fprintf(stderr, "peer: rpmsg_lite_master_init failed\n");
+        return (void *)1;
+    }
+    queue = rpmsg_queue_create(link.rpmsg);
+    link.ept = rpmsg_lite_create_ept(link.rpmsg, RL_ADDR_ANY, rpmsg_queue_rx_cb, queue);
+    ns = rpmsg_ns_bind(link.rpmsg, peer_ns_cb, &link);
+    while (link.dst == RL_ADDR_ANY) {
+        usleep(1000);
+    }
+
+    bench_peer_hello(&peer);
+    while (!peer.done) {
+        if (rpmsg_queue_recv_nocopy(link.rpmsg, queue, &src, &msg, &len, RL_BLOCK) != RL_SUCCESS) {
+            break;
+        }
+        if (bench_peer_handle(&peer, msg, len) != 0) {
+            fprintf(stderr, "peer: bad message of %u bytes\n", len);
+        }
+        rpmsg_queue_nocopy_free(link.rpmsg, msg);
+    }
+    bench_peer_stop(&peer);
+
+    rpmsg_ns_unbind(link.rpmsg, ns);
+    rpmsg_lite_destroy_ept(link.rpmsg, link.ept);
+    rpmsg_queue_destroy(link.rpmsg, queue);
+    rpmsg_lite_deinit(link.rpmsg);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    static oblfr_device_cfg_t endpoint = {
+        .name = BENCH_ENDPOINT,
+        .cb = bench_rx,
+        .credits = OBLFR_RPMSG_CREDITS_ALL,
+    };
+    bench_cfg_t cfg = { 0 };
+#if defined(RL_USE_DCACHE) && (RL_USE_DCACHE == 1)
+    bool processes = true;
+#else
+    bool processes = false;
+#endif
+    uint32_t kick_batch = 1;
+    rpmsg_platform_shmem_config_t layout;
+    pthread_t peer_thread;
+    pid_t peer_pid = 0;
+    oblfr_err_t ret;
+    int opt;
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    platform_get_custom_shmem_config(RL_PLATFORM_LOOPBACK_MASTER_LINK_ID, &layout);
+    while ((opt = getopt(argc, argv, "pdeb:B:S:n:c:")) != -1) {
+        switch (opt) {
+            case 'p':
+                processes = true;
+                break;
+            case 'd':
+                endpoint.direct = true;
+                break;
+            case 'e':
+                init_flags |= RL_EVENT_IDX;
+                break;
+            case 'b':
+                kick_batch = strtoul(optarg, NULL, 0);
+                break;
+            case 'B':
+                layout.buffer_count = strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                layout.buffer_payload_size = strtoul(optarg, NULL, 0) - 16;
+                break;
+            case 'n':
+                cfg.latency_iterations = strtoul(optarg, NULL, 0);
+                break;
+            case 'c':
+                cfg.stream_count = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-p] [-d] [-e] [-b kick batch] [-B buffers] [-S buffer size] "
+                        "[-n ping-pongs] [-c stream messages]\n", argv[0]);
+                return 1;
+        }
+    }
+    /* each vring holds up to 256 buffers */
+    platform_set_custom_shmem_config(RL_PLATFORM_LOOPBACK_MASTER_LINK_ID, &layout);
+    platform_set_custom_shmem_config(RL_PLATFORM_LOOPBACK_REMOTE_LINK_ID, &layout);
+    printf("Buffer pool: %u x %u B per direction\n", layout.buffer_count, layout.buffer_payload_size + 16);
+
+    /* anonymous and shared, so a forked peer shares it too */
+    shmem = platform_loopback_shmem_map(NULL, SHMEM_SIZE);
+    if (shmem == NULL) {
+        return 1;
+    }
+    if (processes) {
+        peer_pid = fork();
+        if (peer_pid < 0) {
+            perror("fork");
+            return 1;
+        }
+        if (peer_pid == 0) {
+            return peer_main(NULL) == NULL ? 0 : 1;
+        }
+    }
+
+    sem_init(&bench_sem, 0, 0);
+    oblfr_rpmsg_host_set_shmem(shmem);
+    oblfr_rpmsg_host_set_init_flags(init_flags);
+    if (init_rpmsg() != OBLFR_OK || oblfr_rpmsg_set_kick_batch(kick_batch) != OBLFR_OK) {
+        return 1;
+    }
+    cfg.device = oblfr_rpmsg_device_add(&endpoint);
+    if (cfg.device == NULL) {
+        return 1;
+    }
+    if (!processes && pthread_create(&peer_thread, NULL, peer_main, NULL) != 0) {
+        return 1;
+    }
+
+    ret = bench_run(&cfg);
+    if (ret != OBLFR_OK) {
+        /* the peer waits for a DONE that will not come */
+        if (processes) {
+            kill(peer_pid, SIGTERM);
+        }
+        return 1;
+    }
+
+    if (processes) {
+        waitpid(peer_pid, NULL, 0);
+    } else {
+        pthread_join(peer_thread, NULL);
+    }
+    oblfr_rpmsg_device_remove(cfg.device);
+    platform_loopback_shmem_unmap();
+    return 0;
+}
@@ -0,0 +1,23 @@
+#ifndef OBLFR_RPMSG_HOST_H
+#define OBLFR_RPMSG_HOST_H
+
+#include "oblfr_rpmsg.h"
+
+/*
+The host builds run components/rpmsg/src/oblfr_rpmsg.c as the remote side (M0)
+of the link, on rpmsg-lite with the POSIX environment and the loopback
+platform, whose interrupt thread stands in for the mailbox interrupt. The
+FreeRTOS calls run on pthreads (sdk_host.c), see sdkconfig.h for the layout.
+*/
+
+/**
+ * @brief Set the shared memory (from platform_loopback_shmem_map()), before init_rpmsg()
+ */
+void oblfr_rpmsg_host_set_shmem(void *shmem);
+
+/**
+ * @brief Set the rpmsg-lite init flags (RL_EVENT_IDX), before init_rpmsg()
+ */
+void oblfr_rpmsg_host_set_init_flags(uint32_t flags);
+
+#endif // OBLFR_RPMSG_HOST_H
@@ -0,0 +1,70 @@
+/*
+ * Peer of the RPMsg benchmark for Linux on D0
+ *
+ * Talks to the "rpmsg-raw" endpoint of the benchmark on M0 through the
+ * rpmsg char device bound to it:
+ *
+ *     rpmsg_bench_peer /dev/rpmsg0
+ *
+ * and answers until the benchmark is over. The results are printed on the
+ * console of M0.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "bench_peer.h"
+
+#define PEER_MTU 4096
+
+static int peer_send(void *ctx, const void *data, size_t len)
+{
+    int fd = *(int *)ctx;
+
+    /* a write blocks until a buffer is available */
+    return write(fd, data, len) == (ssize_t)len ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t buf[PEER_MTU];
+    bench_peer_t peer = { 0 };
+    ssize_t len;
+    int fd;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s /dev/rpmsgN\n", argv[0]);
+        return 1;
+    }
+    fd = open(argv[1], O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+    peer.send = peer_send;
+    peer.ctx = &fd;
+    peer.mtu = PEER_MTU;
+
+    if (bench_peer_hello(&peer) != 0) {
+        fprintf(stderr, "can't reach the benchmark: %s\n", strerror(errno));
+        return 1;
+    }
+    printf("benchmark running, see the console of M0\n");
+    while (!peer.done) {
+        len = read(fd, buf, sizeof(buf));
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "read: %s\n", strerror(errno));
+            break;
+        }
+        if (bench_peer_handle(&peer, buf, (size_t)len) != 0) {
+            fprintf(stderr, "bad message of %zd bytes\n", len);
+        }
+    }
+    bench_peer_stop(&peer);
+    close(fd);
+    return peer.done ? 0 : 1;
+}
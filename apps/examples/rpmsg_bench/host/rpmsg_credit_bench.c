@@ -0,0 +1,346 @@
+/*
+ * RPMsg credit benchmark on a host
+ *
+ * The remote side (oblfr_rpmsg) has a fast endpoint, which echoes
+ * every message, and slow endpoints, whose callback takes -s us per message,
+ * like a stalled consumer. The fast endpoint is in the highest priority class,
+ * so its callbacks never wait for the slow ones and only the buffer pool is
+ * shared (see rpmsg_prio_bench). The master pings the fast endpoint while it floods
+ * a slow one, and reports the round trip of the pings and the counters of the
+ * slow endpoint, in five phases:
+ *
+ *   idle       no flood
+ *   all        flood of an endpoint with OBLFR_RPMSG_CREDITS_ALL, which takes the whole pool
+ *   credits    flood of an endpoint with SLOW_CREDITS credits, following the credits
+ *              advertised on OBLFR_RPMSG_CREDIT_ENDPOINT
+ *   drop       the same flood, ignoring the credits, so the excess is dropped
+ *   kept       flood following the credits of an endpoint whose callback keeps the
+ *              buffer with oblfr_rpmsg_hold(), for one of -w worker threads to take
+ *              the -s us and oblfr_rpmsg_release() it
+ *
+ * The held and hold time counters of the slow endpoints count since they were added.
+ *
+ *     rpmsg_credit_bench [-n pings per phase] [-s slow callback us] [-w workers]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "rpmsg_lite.h"
+#include "rpmsg_ns.h"
+#include "rpmsg_queue.h"
+#include "oblfr_rpmsg_host.h"
+#include "bflb_mtimer.h"
+
+#define FAST_ENDPOINT     "rpmsg-fast"
+#define SLOW_ALL_ENDPOINT "rpmsg-slow-all"
+#define SLOW_ENDPOINT     "rpmsg-slow"
+#define KEPT_ENDPOINT     "rpmsg-slow-kept"
+
+/* credits of the slow endpoints, the default is the whole pool */
+#define SLOW_CREDITS 4
+#define SHMEM_SIZE        platform_loopback_shmem_size(RL_PLATFORM_LOOPBACK_MASTER_LINK_ID)
+#define PING_SIZE         64
+
+static uint32_t slow_us = 2000;
+static uint32_t workers = 2;
+static oblfr_queue_entry_t *fast_device;
+
+/* kept messages, from the callback of the kept endpoint to the workers */
+static pthread_mutex_t work_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static void *work[256];
+static uint32_t work_head, work_count;
+static uint32_t work_errors;
+
+/* remote side */
+static void fast_rx(void *data, size_t len, void *priv)
+{
+    if (oblfr_rpmsg_device_send(fast_device, data, len, (OBLFR_Timeout)1000) != OBLFR_OK) {
+        fprintf(stderr, "remote: echo failed\n");
+    }
+}
+
+static void slow_rx(void *data, size_t len, void *priv)
+{
+    usleep(slow_us);
+}
+
+static void kept_rx(void *data, size_t len, void *priv)
+{
+    if (oblfr_rpmsg_hold(data) != OBLFR_OK) {
+        work_errors++;
+        return;
+    }
+    pthread_mutex_lock(&work_lock);
+    /* at most the credits of the endpoint are kept */
+    work[(work_head + work_count++) % 256] = data;
+    pthread_cond_signal(&work_cond);
+    pthread_mutex_unlock(&work_lock);
+}
+
+static void *kept_worker(void *arg)
+{
+    void *data;
+
+    while (1) {
+        pthread_mutex_lock(&work_lock);
+        while (work_count == 0) {
+            pthread_cond_wait(&work_cond, &work_lock);
+        }
+        data = work[work_head];
+        work_head = (work_head + 1) % 256;
+        work_count--;
+        pthread_mutex_unlock(&work_lock);
+        usleep(slow_us);
+        if (oblfr_rpmsg_release(data) != OBLFR_OK) {
+            work_errors++;
+        }
+    }
+    return NULL;
+}
+
+/* master side */
+typedef struct peer_ept_s {
+    const char *name;
+    volatile uint32_t addr;
+    /* from the advertisements */
+    volatile uint32_t consumed;
+    volatile uint32_t credits;
+} peer_ept_t;
+
+enum { EPT_FAST, EPT_SLOW_ALL, EPT_SLOW, EPT_KEPT, EPT_CREDIT, EPT_COUNT };
+
+typedef struct peer_s {
+    struct rpmsg_lite_instance *rpmsg;
+    struct rpmsg_lite_endpoint *ept;
+    rpmsg_queue_handle queue;
+    peer_ept_t epts[EPT_COUNT];
+    /* flood */
+    peer_ept_t *volatile flood;
+    volatile bool flood_credits;
+    volatile bool flooding;
+    uint32_t flood_sent;
+} peer_t;
+
+static peer_t peer = {
+    .epts = {
+        [EPT_FAST] = { FAST_ENDPOINT, RL_ADDR_ANY },
+        [EPT_SLOW_ALL] = { SLOW_ALL_ENDPOINT, RL_ADDR_ANY },
+        [EPT_SLOW] = { SLOW_ENDPOINT, RL_ADDR_ANY },
+        [EPT_KEPT] = { KEPT_ENDPOINT, RL_ADDR_ANY },
+        [EPT_CREDIT] = { OBLFR_RPMSG_CREDIT_ENDPOINT, RL_ADDR_ANY },
+    },
+};
+
+static void peer_ns_cb(uint32_t new_ept, const char *new_ept_name, uint32_t flags, void *user_data)
+{
+    for (int i = 0; i < EPT_COUNT && flags == RL_NS_CREATE; i++) {
+        if (strcmp(new_ept_name, peer.epts[i].name) == 0) {
+            peer.epts[i].addr = new_ept;
+        }
+    }
+}
+
+/* in the interrupt thread of the master */
+static int32_t peer_credit_rx(void *payload, uint32_t payload_len, uint32_t src, void *priv)
+{
+    oblfr_rpmsg_credit_t *credit = payload;
+
+    for (int i = 0; i < EPT_COUNT && payload_len == sizeof(*credit); i++) {
+        peer_ept_t *ept = &peer.epts[i];
+
+        if (credit->addr == ept->addr) {
+            ept->credits = credit->credits;
+            /* advertisements of one endpoint may arrive out of order */
+            if ((int32_t)(credit->consumed - ept->consumed) > 0) {
+                ept->consumed = credit->consumed;
+            }
+        }
+    }
+    return RL_RELEASE;
+}
+
+static void *peer_flood(void *arg)
+{
+    char msg[PING_SIZE] = { 0 };
+
+    while (1) {
+        while (!peer.flooding) {
+            usleep(1000);
+        }
+        if (peer.flood_credits && peer.flood_sent - peer.flood->consumed >= peer.flood->credits) {
+            usleep(10);
+            continue;
+        }
+        if (rpmsg_lite_send(peer.rpmsg, peer.ept, peer.flood->addr, msg, sizeof(msg), 10) == RL_SUCCESS) {
+            peer.flood_sent++;
+        }
+    }
+    return NULL;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static int run_phase(const char *name, oblfr_queue_entry_t *slow, peer_ept_t *dst, bool credits, uint32_t pings)
+{
+    oblfr_rpmsg_device_stats_t before = { 0 }, after = { 0 };
+    uint32_t *rtt = malloc(pings * sizeof(uint32_t));
+    char ping[PING_SIZE], echo[PING_SIZE];
+    uint32_t src, len, flood_sent;
+    uint64_t phase_us;
+
+    if (rtt == NULL) {
+        return -1;
+    }
+    phase_us = bflb_mtimer_get_time_us();
+    if (slow != NULL) {
+        oblfr_rpmsg_get_device_stats(slow, &before);
+        peer.flood = dst;
+        peer.flood_credits = credits;
+        /* the credits count from the start of the endpoint */
+        peer.flood_sent = before.received + before.dropped;
+        flood_sent = peer.flood_sent;
+        peer.flooding = true;
+        usleep(20 * 1000);
+    }
+    for (uint32_t i = 0; i < pings; i++) {
+        uint64_t start = bflb_mtimer_get_time_us();
+
+        memset(ping, (int)i, sizeof(ping));
+        if (rpmsg_lite_send(peer.rpmsg, peer.ept, peer.epts[EPT_FAST].addr, ping, sizeof(ping), RL_BLOCK) != RL_SUCCESS ||
+            rpmsg_queue_recv(peer.rpmsg, peer.queue, &src, echo, sizeof(echo), &len, RL_BLOCK) != RL_SUCCESS ||
+            len != sizeof(ping) || memcmp(ping, echo, len) != 0) {
+            fprintf(stderr, "%s: ping %u failed\n", name, i);
+            free(rtt);
+            return -1;
+        }
+        rtt[i] = (uint32_t)(bflb_mtimer_get_time_us() - start);
+    }
+    if (slow != NULL) {
+        peer.flooding = false;
+        /* let the slow endpoint drain before the next phase */
+        do {
+            usleep(100);
+            oblfr_rpmsg_get_device_stats(slow, &after);
+        } while (after.held != 0);
+        flood_sent = peer.flood_sent - flood_sent;
+    }
+    phase_us = bflb_mtimer_get_time_us() - phase_us;
+
+    qsort(rtt, pings, sizeof(uint32_t), cmp_u32);
+    printf("  %-8s fast rtt p50 %6u us p99 %6u us max %6u us", name, rtt[pings / 2], rtt[pings * 99 / 100],
+           rtt[pings - 1]);
+    if (slow != NULL) {
+        printf(" | slow sent %6u received %6u (%5u/s) dropped %6u held max %u/%u hold avg %u us max %u us",
+               flood_sent, after.received - before.received,
+               (uint32_t)((after.received - before.received) * 1000000ull / phase_us),
+               after.dropped - before.dropped, after.held_max, after.credits, after.hold_us_avg, after.hold_us_max);
+    }
+    printf("\n");
+    free(rtt);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static oblfr_device_cfg_t fast_cfg = { .name = FAST_ENDPOINT, .cb = fast_rx, .priority = OBLFR_RPMSG_PRIO_HIGHEST };
+    static oblfr_device_cfg_t slow_all_cfg = { .name = SLOW_ALL_ENDPOINT, .cb = slow_rx, .credits = OBLFR_RPMSG_CREDITS_ALL };
+    static oblfr_device_cfg_t slow_cfg = { .name = SLOW_ENDPOINT, .cb = slow_rx, .credits = SLOW_CREDITS };
+    static oblfr_device_cfg_t kept_cfg = { .name = KEPT_ENDPOINT, .cb = kept_rx, .credits = SLOW_CREDITS };
+    oblfr_queue_entry_t *slow_all, *slow, *kept;
+    pthread_t worker_thread;
+    struct rpmsg_lite_endpoint *credit_ept;
+    oblfr_rpmsg_credit_t hello = { 0 };
+    pthread_t flood_thread;
+    uint32_t pings = 500;
+    void *shmem;
+    int opt;
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    while ((opt = getopt(argc, argv, "n:s:w:")) != -1) {
+        switch (opt) {
+            case 'n':
+                pings = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                slow_us = strtoul(optarg, NULL, 0);
+                break;
+            case 'w':
+                workers = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n pings per phase] [-s slow callback us] [-w workers]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (pings == 0) {
+        return 1;
+    }
+
+    shmem = platform_loopback_shmem_map(NULL, SHMEM_SIZE);
+    if (shmem == NULL) {
+        return 1;
+    }
+    oblfr_rpmsg_host_set_shmem(shmem);
+    if (init_rpmsg() != OBLFR_OK) {
+        return 1;
+    }
+    fast_device = oblfr_rpmsg_device_add(&fast_cfg);
+    slow_all = oblfr_rpmsg_device_add(&slow_all_cfg);
+    slow = oblfr_rpmsg_device_add(&slow_cfg);
+    kept = oblfr_rpmsg_device_add(&kept_cfg);
+    if (fast_device == NULL || slow_all == NULL || slow == NULL || kept == NULL) {
+        return 1;
+    }
+    for (uint32_t i = 0; i < workers; i++) {
+        if (pthread_create(&worker_thread, NULL, kept_worker, NULL) != 0) {
+            return 1;
+        }
+    }
+
+    peer.rpmsg = rpmsg_lite_master_init(shmem, SHMEM_SIZE, RL_PLATFORM_LOOPBACK_MASTER_LINK_ID, RL_NO_FLAGS);
+    if (peer.rpmsg == NULL) {
+        fprintf(stderr, "rpmsg_lite_master_init failed\n");
+        return 1;
+    }
+    peer.queue = rpmsg_queue_create(peer.rpmsg);
+    peer.ept = rpmsg_lite_create_ept(peer.rpmsg, RL_ADDR_ANY, rpmsg_queue_rx_cb, peer.queue);
+    credit_ept = rpmsg_lite_create_ept(peer.rpmsg, RL_ADDR_ANY, peer_credit_rx, NULL);
+    rpmsg_ns_bind(peer.rpmsg, peer_ns_cb, NULL);
+    for (int i = 0; i < EPT_COUNT; i++) {
+        while (peer.epts[i].addr == RL_ADDR_ANY) {
+            usleep(1000);
+        }
+    }
+    /* subscribe to the credits */
+    rpmsg_lite_send(peer.rpmsg, credit_ept, peer.epts[EPT_CREDIT].addr, (char *)&hello, sizeof(hello), RL_BLOCK);
+    while (peer.epts[EPT_SLOW].credits == 0 || peer.epts[EPT_KEPT].credits == 0) {
+        usleep(1000);
+    }
+    if (pthread_create(&flood_thread, NULL, peer_flood, NULL) != 0) {
+        return 1;
+    }
+
+    printf("RPMsg credits: %u pings of %u B per phase, slow callback %u us, %u workers, %u buffers\n", pings,
+           PING_SIZE, slow_us, workers, peer.rpmsg->rvq->vq_nentries);
+    if (run_phase("idle", NULL, NULL, false, pings) != 0 ||
+        run_phase("all", slow_all, &peer.epts[EPT_SLOW_ALL], false, pings) != 0 ||
+        run_phase("credits", slow, &peer.epts[EPT_SLOW], true, pings) != 0 ||
+        run_phase("drop", slow, &peer.epts[EPT_SLOW], false, pings) != 0 ||
+        run_phase("kept", kept, &peer.epts[EPT_KEPT], true, pings) != 0) {
+        return 1;
+    }
+    if (work_errors != 0) {
+        fprintf(stderr, "%u kept messages failed\n", work_errors);
+        return 1;
+    }
+    return 0;
+}
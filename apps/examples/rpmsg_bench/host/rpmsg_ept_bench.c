@@ -0,0 +1,220 @@
+/*
+ * RPMsg endpoint dispatch microbenchmark on a host
+ *
+ * Measures the receive path of rpmsg-lite per message, with 1, 8 and 64
+ * endpoints on the receiving side. The interrupt of the receiving side is
+ * disabled and its handler is run from here, so only the dispatch is timed,
+ * not the wake up of the interrupt thread. The messages go to the endpoint
+ * created first, the last one of the list of endpoints.
+ *
+ * With -o the endpoints are oblfr_rpmsg devices, and the whole receive path
+ * is timed, from the send to the callback in the rpmsg task, as the
+ * throughput of a stream of messages.
+ *
+ *     rpmsg_ept_bench [-o] [-n messages]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "rpmsg_lite.h"
+#include "rpmsg_ns.h"
+#include "oblfr_rpmsg_host.h"
+
+#define SHMEM_SIZE   platform_loopback_shmem_size(RL_PLATFORM_LOOPBACK_MASTER_LINK_ID)
+#define MAX_EPTS     64
+#define MSG_SIZE     16
+#define REMOTE_RX_VQ RL_GET_VQ_ID(RL_PLATFORM_LOOPBACK_REMOTE_LINK_ID, 1U)
+
+static const uint32_t ept_counts[] = { 1, 8, 64 };
+static uint32_t received;
+
+static uint64_t time_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static int32_t ept_rx_cb(void *payload, uint32_t payload_len, uint32_t src, void *priv)
+{
+    received++;
+    return RL_RELEASE;
+}
+
+static void device_rx(void *data, size_t len, void *priv)
+{
+    __atomic_fetch_add(&received, 1, __ATOMIC_RELEASE);
+}
+
+/* the address of the device added first */
+static void master_ns_cb(uint32_t new_ept, const char *new_ept_name, uint32_t flags, void *user_data)
+{
+    volatile uint32_t *dst = user_data;
+
+    if (flags == RL_NS_CREATE && strcmp(new_ept_name, "rpmsg-ept0") == 0) {
+        *dst = new_ept;
+    }
+}
+
+static int run_oblfr(void *shmem, uint32_t messages)
+{
+    static oblfr_device_cfg_t cfgs[MAX_EPTS];
+    struct rpmsg_lite_instance *master;
+    struct rpmsg_lite_endpoint *master_ept;
+    oblfr_queue_entry_t *devices[MAX_EPTS];
+    volatile uint32_t dst = RL_ADDR_ANY;
+    char msg[MSG_SIZE] = { 0 };
+    uint32_t n_devices = 0;
+
+    oblfr_rpmsg_host_set_shmem(shmem);
+    if (init_rpmsg() != OBLFR_OK) {
+        return 1;
+    }
+    master = rpmsg_lite_master_init(shmem, SHMEM_SIZE, RL_PLATFORM_LOOPBACK_MASTER_LINK_ID, RL_NO_FLAGS);
+    if (master == NULL) {
+        fprintf(stderr, "rpmsg_lite init failed\n");
+        return 1;
+    }
+    rpmsg_ns_bind(master, master_ns_cb, (void *)&dst);
+    master_ept = rpmsg_lite_create_ept(master, RL_ADDR_ANY, ept_rx_cb, NULL);
+
+    printf("oblfr_rpmsg rx path: %u messages of %u B\n", messages, MSG_SIZE);
+    for (size_t i = 0; i < sizeof(ept_counts) / sizeof(ept_counts[0]); i++) {
+        uint64_t start;
+
+        while (n_devices < ept_counts[i]) {
+            snprintf(cfgs[n_devices].name, sizeof(cfgs[n_devices].name), "rpmsg-ept%u", (uint8_t)n_devices);
+            cfgs[n_devices].cb = device_rx;
+            devices[n_devices] = oblfr_rpmsg_device_add(&cfgs[n_devices]);
+            if (devices[n_devices] == NULL) {
+                return 1;
+            }
+            n_devices++;
+        }
+        while (dst == RL_ADDR_ANY) {
+            usleep(1000);
+        }
+
+        __atomic_store_n(&received, 0, __ATOMIC_RELEASE);
+        start = time_ns();
+        for (uint32_t sent = 0; sent < messages; sent++) {
+            if (rpmsg_lite_send(master, master_ept, dst, msg, sizeof(msg), RL_BLOCK) != RL_SUCCESS) {
+                fprintf(stderr, "rpmsg_lite_send failed\n");
+                return 1;
+            }
+        }
+        while (__atomic_load_n(&received, __ATOMIC_ACQUIRE) != messages) {
+            usleep(100);
+        }
+        printf("%3u endpoints: %6.1f ns per message\n", n_devices, (double)(time_ns() - start) / messages);
+    }
+
+    for (uint32_t i = 0; i < n_devices; i++) {
+        oblfr_rpmsg_device_remove(devices[i]);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct rpmsg_lite_instance *master, *remote;
+    struct rpmsg_lite_endpoint *master_ept;
+    struct rpmsg_lite_endpoint *epts[MAX_EPTS];
+    uint32_t messages = 100000;
+    bool oblfr = false;
+    uint32_t n_epts = 0;
+    uint32_t dst = RL_ADDR_ANY;
+    char msg[MSG_SIZE] = { 0 };
+    void *shmem;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "on:")) != -1) {
+        switch (opt) {
+            case 'o':
+                oblfr = true;
+                break;
+            case 'n':
+                messages = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-o] [-n messages]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    shmem = platform_loopback_shmem_map(NULL, SHMEM_SIZE);
+    if (shmem == NULL) {
+        return 1;
+    }
+    if (oblfr) {
+        return run_oblfr(shmem, messages);
+    }
+    master = rpmsg_lite_master_init(shmem, SHMEM_SIZE, RL_PLATFORM_LOOPBACK_MASTER_LINK_ID, RL_NO_FLAGS);
+    remote = rpmsg_lite_remote_init(shmem, RL_PLATFORM_LOOPBACK_REMOTE_LINK_ID, RL_NO_FLAGS);
+    if (master == NULL || remote == NULL) {
+        fprintf(stderr, "rpmsg_lite init failed\n");
+        return 1;
+    }
+    rpmsg_lite_wait_for_link_up(remote);
+    master_ept = rpmsg_lite_create_ept(master, RL_ADDR_ANY, ept_rx_cb, NULL);
+
+    /* dispatch the messages from this thread */
+    env_disable_interrupt(REMOTE_RX_VQ);
+
+    printf("RPMsg rx dispatch: %u messages of %u B, RL_EPT_TABLE_SIZE %u\n", messages, MSG_SIZE,
+           (uint32_t)RL_EPT_TABLE_SIZE);
+    for (size_t i = 0; i < sizeof(ept_counts) / sizeof(ept_counts[0]); i++) {
+        uint64_t busy = 0;
+        uint32_t sent = 0;
+
+        while (n_epts < ept_counts[i]) {
+            epts[n_epts] = rpmsg_lite_create_ept(remote, RL_ADDR_ANY, ept_rx_cb, NULL);
+            if (epts[n_epts] == NULL) {
+                fprintf(stderr, "rpmsg_lite_create_ept failed\n");
+                return 1;
+            }
+            if (dst == RL_ADDR_ANY) {
+                dst = epts[n_epts]->addr;
+            }
+            n_epts++;
+        }
+
+        received = 0;
+        while (sent < messages) {
+            uint32_t batch = 0;
+            uint64_t start;
+
+            /* fill the ring, then dispatch it in one interrupt */
+            while (batch < RL_BUFFER_COUNT(RL_PLATFORM_LOOPBACK_MASTER_LINK_ID) && sent < messages) {
+                if (rpmsg_lite_send(master, master_ept, dst, msg, sizeof(msg), RL_BLOCK) != RL_SUCCESS) {
+                    fprintf(stderr, "rpmsg_lite_send failed\n");
+                    return 1;
+                }
+                batch++;
+                sent++;
+            }
+            start = time_ns();
+            env_isr(REMOTE_RX_VQ);
+            busy += time_ns() - start;
+        }
+        if (received != messages) {
+            fprintf(stderr, "received %u of %u messages\n", received, messages);
+            return 1;
+        }
+        printf("%3u endpoints: %6.1f ns per message\n", n_epts, (double)busy / messages);
+    }
+
+    env_enable_interrupt(REMOTE_RX_VQ);
+    for (uint32_t i = 0; i < n_epts; i++) {
+        rpmsg_lite_destroy_ept(remote, epts[i]);
+    }
+    rpmsg_lite_destroy_ept(master, master_ept);
+    rpmsg_lite_deinit(remote);
+    rpmsg_lite_deinit(master);
+    platform_loopback_shmem_unmap();
+    return 0;
+}
@@ -0,0 +1,268 @@
+/*
+ * RPMsg priority class benchmark on a host
+ *
+ * The remote side (oblfr_rpmsg) has a bulk endpoint, whose callback
+ * takes -s us per message, and two control endpoints, which echo every message:
+ * one in the priority class of the bulk endpoint, one in the highest class. The
+ * master pings a control endpoint while it floods the bulk endpoint, following
+ * its credits so no buffer is short, and reports the round trip of the pings
+ * and the rate of the bulk endpoint, in three phases:
+ *
+ *   idle       no flood, pings of the control endpoint of class 0
+ *   same       flood, pings of the control endpoint of class 0, whose callbacks
+ *              wait behind the bulk ones
+ *   high       flood, pings of the control endpoint of the highest class, run by
+ *              its own rpmsg task
+ *
+ *     rpmsg_prio_bench [-n pings per phase] [-s bulk callback us]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "rpmsg_lite.h"
+#include "rpmsg_ns.h"
+#include "rpmsg_queue.h"
+#include "oblfr_rpmsg_host.h"
+#include "bflb_mtimer.h"
+
+#define BULK_ENDPOINT    "rpmsg-bulk"
+#define CTRL_ENDPOINT    "rpmsg-ctrl"
+#define CTRL_HI_ENDPOINT "rpmsg-ctrl-hi"
+#define SHMEM_SIZE       platform_loopback_shmem_size(RL_PLATFORM_LOOPBACK_MASTER_LINK_ID)
+#define PING_SIZE        64
+/* the bulk endpoint leaves buffers to the control ones, the default is the whole pool */
+#define BULK_CREDITS     4
+
+static uint32_t bulk_us = 1000;
+static oblfr_queue_entry_t *ctrl_device;
+static oblfr_queue_entry_t *ctrl_hi_device;
+
+/* remote side */
+static void ctrl_rx(void *data, size_t len, void *priv)
+{
+    oblfr_queue_entry_t *device = *(oblfr_queue_entry_t **)priv;
+
+    if (oblfr_rpmsg_device_send(device, data, len, (OBLFR_Timeout)1000) != OBLFR_OK) {
+        fprintf(stderr, "remote: echo failed\n");
+    }
+}
+
+static void bulk_rx(void *data, size_t len, void *priv)
+{
+    usleep(bulk_us);
+}
+
+/* master side */
+typedef struct peer_ept_s {
+    const char *name;
+    volatile uint32_t addr;
+    /* from the advertisements */
+    volatile uint32_t consumed;
+    volatile uint32_t credits;
+} peer_ept_t;
+
+enum { EPT_BULK, EPT_CTRL, EPT_CTRL_HI, EPT_CREDIT, EPT_COUNT };
+
+typedef struct peer_s {
+    struct rpmsg_lite_instance *rpmsg;
+    struct rpmsg_lite_endpoint *ept;
+    rpmsg_queue_handle queue;
+    peer_ept_t epts[EPT_COUNT];
+    volatile bool flooding;
+    uint32_t flood_sent;
+} peer_t;
+
+static peer_t peer = {
+    .epts = {
+        [EPT_BULK] = { BULK_ENDPOINT, RL_ADDR_ANY },
+        [EPT_CTRL] = { CTRL_ENDPOINT, RL_ADDR_ANY },
+        [EPT_CTRL_HI] = { CTRL_HI_ENDPOINT, RL_ADDR_ANY },
+        [EPT_CREDIT] = { OBLFR_RPMSG_CREDIT_ENDPOINT, RL_ADDR_ANY },
+    },
+};
+
+static void peer_ns_cb(uint32_t new_ept, const char *new_ept_name, uint32_t flags, void *user_data)
+{
+    for (int i = 0; i < EPT_COUNT && flags == RL_NS_CREATE; i++) {
+        if (strcmp(new_ept_name, peer.epts[i].name) == 0) {
+            peer.epts[i].addr = new_ept;
+        }
+    }
+}
+
+/* in the interrupt thread of the master */
+static int32_t peer_credit_rx(void *payload, uint32_t payload_len, uint32_t src, void *priv)
+{
+    oblfr_rpmsg_credit_t *credit = payload;
+    peer_ept_t *ept = &peer.epts[EPT_BULK];
+
+    if (payload_len == sizeof(*credit) && credit->addr == ept->addr) {
+        ept->credits = credit->credits;
+        /* advertisements may arrive out of order */
+        if ((int32_t)(credit->consumed - ept->consumed) > 0) {
+            ept->consumed = credit->consumed;
+        }
+    }
+    return RL_RELEASE;
+}
+
+/* keeps the credits of the bulk endpoint in flight, its callbacks never wait for a message */
+static void *peer_flood(void *arg)
+{
+    peer_ept_t *bulk = &peer.epts[EPT_BULK];
+    char msg[PING_SIZE] = { 0 };
+
+    while (1) {
+        while (!peer.flooding) {
+            usleep(1000);
+        }
+        if (peer.flood_sent - bulk->consumed >= bulk->credits) {
+            usleep(10);
+            continue;
+        }
+        if (rpmsg_lite_send(peer.rpmsg, peer.ept, bulk->addr, msg, sizeof(msg), 10) == RL_SUCCESS) {
+            peer.flood_sent++;
+        }
+    }
+    return NULL;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static int run_phase(const char *name, oblfr_queue_entry_t *bulk, peer_ept_t *ctrl, bool flood, uint32_t pings)
+{
+    oblfr_rpmsg_device_stats_t before = { 0 }, after = { 0 };
+    uint32_t *rtt = malloc(pings * sizeof(uint32_t));
+    char ping[PING_SIZE], echo[PING_SIZE];
+    uint32_t src, len;
+    uint64_t phase_us;
+
+    if (rtt == NULL) {
+        return -1;
+    }
+    oblfr_rpmsg_get_device_stats(bulk, &before);
+    phase_us = bflb_mtimer_get_time_us();
+    if (flood) {
+        peer.flooding = true;
+        usleep(20 * 1000);
+    }
+    for (uint32_t i = 0; i < pings; i++) {
+        uint64_t start = bflb_mtimer_get_time_us();
+
+        memset(ping, (int)i, sizeof(ping));
+        if (rpmsg_lite_send(peer.rpmsg, peer.ept, ctrl->addr, ping, sizeof(ping), RL_BLOCK) != RL_SUCCESS ||
+            rpmsg_queue_recv(peer.rpmsg, peer.queue, &src, echo, sizeof(echo), &len, RL_BLOCK) != RL_SUCCESS ||
+            len != sizeof(ping) || memcmp(ping, echo, len) != 0) {
+            fprintf(stderr, "%s: ping %u failed\n", name, i);
+            free(rtt);
+            return -1;
+        }
+        rtt[i] = (uint32_t)(bflb_mtimer_get_time_us() - start);
+    }
+    if (flood) {
+        peer.flooding = false;
+        /* let the bulk endpoint drain before the next phase */
+        do {
+            usleep(100);
+            oblfr_rpmsg_get_device_stats(bulk, &after);
+        } while (after.held != 0);
+    }
+    phase_us = bflb_mtimer_get_time_us() - phase_us;
+    oblfr_rpmsg_get_device_stats(bulk, &after);
+
+    qsort(rtt, pings, sizeof(uint32_t), cmp_u32);
+    printf("  %-6s ctrl rtt p50 %6u us p99 %6u us max %6u us | bulk received %6u (%5u/s) dropped %u\n", name,
+           rtt[pings / 2], rtt[pings * 99 / 100], rtt[pings - 1], after.received - before.received,
+           (uint32_t)((after.received - before.received) * 1000000ull / phase_us), after.dropped - before.dropped);
+    free(rtt);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static oblfr_device_cfg_t bulk_cfg = { .name = BULK_ENDPOINT, .cb = bulk_rx, .credits = BULK_CREDITS };
+    static oblfr_device_cfg_t ctrl_cfg = { .name = CTRL_ENDPOINT, .cb = ctrl_rx, .priv = &ctrl_device };
+    static oblfr_device_cfg_t ctrl_hi_cfg = {
+        .name = CTRL_HI_ENDPOINT, .cb = ctrl_rx, .priv = &ctrl_hi_device, .priority = OBLFR_RPMSG_PRIO_HIGHEST
+    };
+    oblfr_queue_entry_t *bulk;
+    struct rpmsg_lite_endpoint *credit_ept;
+    oblfr_rpmsg_credit_t hello = { 0 };
+    pthread_t flood_thread;
+    uint32_t pings = 500;
+    void *shmem;
+    int opt;
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+            case 'n':
+                pings = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                bulk_us = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n pings per phase] [-s bulk callback us]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (pings == 0) {
+        return 1;
+    }
+
+    shmem = platform_loopback_shmem_map(NULL, SHMEM_SIZE);
+    if (shmem == NULL) {
+        return 1;
+    }
+    oblfr_rpmsg_host_set_shmem(shmem);
+    if (init_rpmsg() != OBLFR_OK) {
+        return 1;
+    }
+    bulk = oblfr_rpmsg_device_add(&bulk_cfg);
+    ctrl_device = oblfr_rpmsg_device_add(&ctrl_cfg);
+    ctrl_hi_device = oblfr_rpmsg_device_add(&ctrl_hi_cfg);
+    if (bulk == NULL || ctrl_device == NULL || ctrl_hi_device == NULL) {
+        return 1;
+    }
+
+    peer.rpmsg = rpmsg_lite_master_init(shmem, SHMEM_SIZE, RL_PLATFORM_LOOPBACK_MASTER_LINK_ID, RL_NO_FLAGS);
+    if (peer.rpmsg == NULL) {
+        fprintf(stderr, "rpmsg_lite_master_init failed\n");
+        return 1;
+    }
+    peer.queue = rpmsg_queue_create(peer.rpmsg);
+    peer.ept = rpmsg_lite_create_ept(peer.rpmsg, RL_ADDR_ANY, rpmsg_queue_rx_cb, peer.queue);
+    credit_ept = rpmsg_lite_create_ept(peer.rpmsg, RL_ADDR_ANY, peer_credit_rx, NULL);
+    rpmsg_ns_bind(peer.rpmsg, peer_ns_cb, NULL);
+    for (int i = 0; i < EPT_COUNT; i++) {
+        while (peer.epts[i].addr == RL_ADDR_ANY) {
+            usleep(1000);
+        }
+    }
+    /* subscribe to the credits */
+    rpmsg_lite_send(peer.rpmsg, credit_ept, peer.epts[EPT_CREDIT].addr, (char *)&hello, sizeof(hello), RL_BLOCK);
+    while (peer.epts[EPT_BULK].credits == 0) {
+        usleep(1000);
+    }
+    if (pthread_create(&flood_thread, NULL, peer_flood, NULL) != 0) {
+        return 1;
+    }
+
+    printf("RPMsg priority classes: %u pings of %u B per phase, bulk callback %u us, %u bulk credits\n", pings,
+           PING_SIZE, bulk_us, peer.epts[EPT_BULK].credits);
+    if (run_phase("idle", bulk, &peer.epts[EPT_CTRL], false, pings) != 0 ||
+        run_phase("same", bulk, &peer.epts[EPT_CTRL], true, pings) != 0 ||
+        run_phase("high", bulk, &peer.epts[EPT_CTRL_HI], true, pings) != 0) {
+        return 1;
+    }
+    return 0;
+}
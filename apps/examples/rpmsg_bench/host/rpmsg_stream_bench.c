@@ -0,0 +1,172 @@
+/*
+ * RPMsg stream benchmark on a host
+ *
+ * Sends messages larger than the MTU with oblfr_rpmsg_stream_send() from the
+ * remote side (oblfr_rpmsg), which the master echoes fragment
+ * by fragment, and checks the reassembled echoes. Reports the throughput of
+ * oblfr_rpmsg_stream_get_stats().
+ *
+ *     rpmsg_stream_bench [-n messages] [-s message size]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <unistd.h>
+
+#include "rpmsg_lite.h"
+#include "rpmsg_ns.h"
+#include "rpmsg_queue.h"
+#include "oblfr_rpmsg_host.h"
+#include "oblfr_rpmsg_stream.h"
+
+#define STREAM_ENDPOINT "rpmsg-stream"
+#define SHMEM_SIZE      platform_loopback_shmem_size(RL_PLATFORM_LOOPBACK_MASTER_LINK_ID)
+
+static void *shmem;
+static sem_t echo_sem;
+static uint8_t *tx_data;
+static uint32_t errors;
+
+/* master side, echoes every fragment */
+typedef struct peer_link_s {
+    struct rpmsg_lite_instance *rpmsg;
+    struct rpmsg_lite_endpoint *ept;
+    volatile uint32_t dst;
+} peer_link_t;
+
+static void peer_ns_cb(uint32_t new_ept, const char *new_ept_name, uint32_t flags, void *user_data)
+{
+    peer_link_t *link = user_data;
+
+    if (flags == RL_NS_CREATE && strcmp(new_ept_name, STREAM_ENDPOINT) == 0) {
+        link->dst = new_ept;
+    }
+}
+
+static void *peer_main(void *arg)
+{
+    peer_link_t link = { .dst = RL_ADDR_ANY };
+    oblfr_rpmsg_frag_t hello = { 0 };
+    rpmsg_queue_handle queue;
+    uint32_t src, len;
+    char *msg;
+
+    link.rpmsg = rpmsg_lite_master_init(shmem, SHMEM_SIZE, RL_PLATFORM_LOOPBACK_MASTER_LINK_ID, RL_NO_FLAGS);
+    if (link.rpmsg == NULL) {
+        fprintf(stderr, "peer: rpmsg_lite_master_init failed\n");
+        return NULL;
+    }
+    queue = rpmsg_queue_create(link.rpmsg);
+    link.ept = rpmsg_lite_create_ept(link.rpmsg, RL_ADDR_ANY, rpmsg_queue_rx_cb, queue);
+    rpmsg_ns_bind(link.rpmsg, peer_ns_cb, &link);
+    while (link.dst == RL_ADDR_ANY) {
+        usleep(1000);
+    }
+    /* an empty message, so the stream learns our address */
+    rpmsg_lite_send(link.rpmsg, link.ept, link.dst, (char *)&hello, sizeof(hello), RL_BLOCK);
+
+    while (rpmsg_queue_recv_nocopy(link.rpmsg, queue, &src, &msg, &len, RL_BLOCK) == RL_SUCCESS) {
+        if (rpmsg_lite_send(link.rpmsg, link.ept, src, msg, len, RL_BLOCK) != RL_SUCCESS) {
+            fprintf(stderr, "peer: echo failed\n");
+        }
+        rpmsg_queue_nocopy_free(link.rpmsg, msg);
+    }
+    return NULL;
+}
+
+static void stream_rx(oblfr_rpmsg_stream_t *stream, void *data, size_t len, void *priv)
+{
+    size_t *expected = priv;
+
+    if (len != 0) {
+        if (len != *expected || memcmp(data, tx_data, len) != 0) {
+            errors++;
+        }
+    }
+    oblfr_rpmsg_stream_release(stream, data);
+    sem_post(&echo_sem);
+}
+
+int main(int argc, char **argv)
+{
+    static size_t expected;
+    static oblfr_rpmsg_stream_cfg_t cfg = {
+        .name = STREAM_ENDPOINT,
+        .cb = stream_rx,
+        .priv = &expected,
+        .buf_count = 2,
+        /* the peer echoes all fragments in flight at once */
+        .credits = OBLFR_RPMSG_CREDITS_ALL,
+    };
+    oblfr_rpmsg_stream_t *stream;
+    oblfr_rpmsg_stream_stats_t stats;
+    uint32_t messages = 100;
+    size_t size = 256 * 1024;
+    pthread_t peer_thread;
+    int opt;
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+            case 'n':
+                messages = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                size = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n messages] [-s message size]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    tx_data = malloc(size);
+    if (tx_data == NULL) {
+        return 1;
+    }
+    for (size_t i = 0; i < size; i++) {
+        tx_data[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+    expected = size;
+    cfg.max_len = size;
+
+    shmem = platform_loopback_shmem_map(NULL, SHMEM_SIZE);
+    if (shmem == NULL) {
+        return 1;
+    }
+    sem_init(&echo_sem, 0, 0);
+    oblfr_rpmsg_host_set_shmem(shmem);
+    if (init_rpmsg() != OBLFR_OK) {
+        return 1;
+    }
+    stream = oblfr_rpmsg_stream_add(&cfg);
+    if (stream == NULL || pthread_create(&peer_thread, NULL, peer_main, NULL) != 0) {
+        return 1;
+    }
+    /* the empty hello */
+    sem_wait(&echo_sem);
+
+    printf("RPMsg stream: %u messages of %zu B, %u B per fragment\n", messages, size,
+           (uint32_t)(oblfr_rpmsg_get_mtu() - sizeof(oblfr_rpmsg_frag_t)));
+    for (uint32_t i = 0; i < messages; i++) {
+        if (oblfr_rpmsg_stream_send(stream, tx_data, size, (OBLFR_Timeout)1000) != OBLFR_OK) {
+            fprintf(stderr, "oblfr_rpmsg_stream_send failed\n");
+            return 1;
+        }
+        while (sem_wait(&echo_sem) != 0 && errno == EINTR) {
+        }
+    }
+
+    oblfr_rpmsg_stream_get_stats(stream, &stats);
+    printf("  tx %u messages %u fragments %8u KB/s\n", stats.tx_msgs, stats.tx_frags, stats.tx_bytes_per_s / 1024);
+    printf("  rx %u messages %u fragments %8u KB/s, %u dropped\n", stats.rx_msgs, stats.rx_frags,
+           stats.rx_bytes_per_s / 1024, stats.rx_dropped);
+    if (errors != 0 || stats.rx_msgs != messages + 1) {
+        fprintf(stderr, "%u echoes differ, %u of %u received\n", errors, stats.rx_msgs - 1, messages);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,227 @@
+/*
+ * Host stand-ins of the SDK for oblfr_rpmsg.c: the FreeRTOS tasks, timers and
+ * critical sections on pthreads, and the shared memory of sdkconfig.h.
+ *
+ * The interrupt thread of the loopback platform is the mailbox interrupt, so
+ * a critical section masks it, as disabling the interrupts does on the target,
+ * and holds a lock for the other tasks, which the single core of the target
+ * would not run meanwhile.
+ */
+#include <stdlib.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "rpmsg_lite.h"
+#include "oblfr_rpmsg_host.h"
+#include "task.h"
+#include "timers.h"
+
+uintptr_t oblfr_rpmsg_host_shmem;
+uint32_t oblfr_rpmsg_host_shmem_size;
+uint32_t oblfr_rpmsg_host_init_flags = RL_NO_FLAGS;
+
+void oblfr_rpmsg_host_set_shmem(void *shmem)
+{
+    oblfr_rpmsg_host_shmem = (uintptr_t)shmem;
+    oblfr_rpmsg_host_shmem_size = platform_loopback_shmem_size(RL_PLATFORM_LOOPBACK_MASTER_LINK_ID);
+}
+
+void oblfr_rpmsg_host_set_init_flags(uint32_t flags)
+{
+    oblfr_rpmsg_host_init_flags = flags;
+}
+
+/* critical sections */
+
+static pthread_mutex_t critical_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread uint32_t critical_nesting;
+
+void vHostEnterCritical(void)
+{
+    /* waits for the handlers running on the interrupt thread */
+    platform_interrupt_disable(RL_GET_VQ_ID(RL_PLATFORM_BL808_M0_LINK_ID, 0U));
+    if (critical_nesting++ == 0) {
+        pthread_mutex_lock(&critical_lock);
+    }
+}
+
+void vHostExitCritical(void)
+{
+    if (--critical_nesting == 0) {
+        pthread_mutex_unlock(&critical_lock);
+    }
+    platform_interrupt_enable(RL_GET_VQ_ID(RL_PLATFORM_BL808_M0_LINK_ID, 0U));
+}
+
+/* tasks */
+
+struct host_task_s {
+    pthread_t thread;
+    TaskFunction_t code;
+    void *arg;
+};
+
+static __thread TaskHandle_t current_task;
+
+static void *host_task_main(void *arg)
+{
+    TaskHandle_t task = arg;
+
+    current_task = task;
+    task->code(task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char *pcName, uint32_t usStackDepth, void *pvParameters,
+                       UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask)
+{
+    TaskHandle_t task = calloc(1, sizeof(*task));
+
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    task->code = pxTaskCode;
+    task->arg = pvParameters;
+    /* before the task runs, it may look for its handle */
+    if (pxCreatedTask != NULL) {
+        *pxCreatedTask = task;
+    }
+    if (pthread_create(&task->thread, NULL, host_task_main, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+    if (xTaskToDelete == NULL || xTaskToDelete == current_task) {
+        pthread_exit(NULL);
+    }
+    pthread_cancel(xTaskToDelete->thread);
+    free(xTaskToDelete);
+}
+
+void vTaskDelay(TickType_t xTicksToDelay)
+{
+    usleep((useconds_t)xTicksToDelay * portTICK_PERIOD_MS * 1000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current_task;
+}
+
+/* timers */
+
+struct host_timer_s {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    TickType_t period;
+    bool reload;
+    bool active;
+    bool stop;
+    struct timespec expiry;
+    void *id;
+    TimerCallbackFunction_t callback;
+};
+
+static void host_timer_add(struct timespec *ts, TickType_t ticks)
+{
+    uint32_t ms = ticks * portTICK_PERIOD_MS;
+
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long)(ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+static void *host_timer_main(void *arg)
+{
+    TimerHandle_t timer = arg;
+
+    pthread_mutex_lock(&timer->lock);
+    while (!timer->stop) {
+        if (!timer->active) {
+            pthread_cond_wait(&timer->cond, &timer->lock);
+            continue;
+        }
+        /* woken up early when restarted or deleted */
+        if (pthread_cond_timedwait(&timer->cond, &timer->lock, &timer->expiry) != ETIMEDOUT || timer->stop) {
+            continue;
+        }
+        timer->active = timer->reload;
+        if (timer->reload) {
+            host_timer_add(&timer->expiry, timer->period);
+        }
+        pthread_mutex_unlock(&timer->lock);
+        timer->callback(timer);
+        pthread_mutex_lock(&timer->lock);
+    }
+    pthread_mutex_unlock(&timer->lock);
+    pthread_mutex_destroy(&timer->lock);
+    pthread_cond_destroy(&timer->cond);
+    free(timer);
+    return NULL;
+}
+
+TimerHandle_t xTimerCreate(const char *pcTimerName, TickType_t xTimerPeriod, UBaseType_t uxAutoReload, void *pvTimerID,
+                           TimerCallbackFunction_t pxCallbackFunction)
+{
+    TimerHandle_t timer = calloc(1, sizeof(*timer));
+    pthread_condattr_t attr;
+
+    if (timer == NULL) {
+        return NULL;
+    }
+    timer->period = xTimerPeriod;
+    timer->reload = uxAutoReload != pdFALSE;
+    timer->id = pvTimerID;
+    timer->callback = pxCallbackFunction;
+    pthread_mutex_init(&timer->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&timer->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    if (pthread_create(&timer->thread, NULL, host_timer_main, timer) != 0) {
+        pthread_mutex_destroy(&timer->lock);
+        pthread_cond_destroy(&timer->cond);
+        free(timer);
+        return NULL;
+    }
+    pthread_detach(timer->thread);
+    return timer;
+}
+
+BaseType_t xTimerStart(TimerHandle_t xTimer, TickType_t xTicksToWait)
+{
+    pthread_mutex_lock(&xTimer->lock);
+    clock_gettime(CLOCK_MONOTONIC, &xTimer->expiry);
+    host_timer_add(&xTimer->expiry, xTimer->period);
+    xTimer->active = true;
+    pthread_cond_signal(&xTimer->cond);
+    pthread_mutex_unlock(&xTimer->lock);
+    return pdPASS;
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t xTimer)
+{
+    return __atomic_load_n(&xTimer->active, __ATOMIC_RELAXED) ? pdTRUE : pdFALSE;
+}
+
+/* the thread of the timer frees it */
+BaseType_t xTimerDelete(TimerHandle_t xTimer, TickType_t xTicksToWait)
+{
+    pthread_mutex_lock(&xTimer->lock);
+    xTimer->stop = true;
+    pthread_cond_signal(&xTimer->cond);
+    pthread_mutex_unlock(&xTimer->lock);
+    return pdPASS;
+}
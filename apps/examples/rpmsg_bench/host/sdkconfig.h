@@ -0,0 +1,21 @@
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+/*
+Configuration of the host builds, oblfr_common.h and oblfr_mailbox.h include it.
+oblfr_rpmsg.c runs on the remote link of the loopback platform, in the shared
+memory set by oblfr_rpmsg_host_set_shmem(), with the flags of
+oblfr_rpmsg_host_set_init_flags(). The rest keeps the defaults of the target.
+*/
+#include <stdint.h>
+
+extern uintptr_t oblfr_rpmsg_host_shmem;
+extern uint32_t oblfr_rpmsg_host_shmem_size;
+extern uint32_t oblfr_rpmsg_host_init_flags;
+
+#define RL_PLATFORM_BL808_M0_LINK_ID RL_PLATFORM_LOOPBACK_REMOTE_LINK_ID
+#define CONFIG_RPMSG_SHMEM_ADDR      oblfr_rpmsg_host_shmem
+#define CONFIG_RPMSG_SHMEM_SIZE      oblfr_rpmsg_host_shmem_size
+#define OBLFR_RPMSG_INIT_FLAGS       oblfr_rpmsg_host_init_flags
+
+#endif // SDKCONFIG_H
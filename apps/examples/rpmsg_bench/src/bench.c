@@ -0,0 +1,458 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+
+#define DBG_TAG "BENCH"
+#include <log.h>
+
+/* latency histogram: 8 sub-buckets per power of two of microseconds, so
+   percentiles are within 12.5% */
+#define HIST_SUB_BITS 3
+#define HIST_SUB      (1U << HIST_SUB_BITS)
+#define HIST_BUCKETS  ((32 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct bench_hist_s {
+    uint32_t buckets[HIST_BUCKETS];
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+} bench_hist_t;
+
+typedef enum bench_path_e {
+    BENCH_PATH_COPY,
+    BENCH_PATH_ZEROCOPY,
+    BENCH_PATH_SENDV,
+    BENCH_PATH_MAX,
+} bench_path_t;
+
+static const char *bench_path_name[] = { "copy", "zerocopy", "sendv" };
+
+/* state shared with bench_rx() */
+static struct {
+    volatile bool hello;
+    volatile uint32_t echo_seq;
+    volatile uint32_t sync_seq;
+    volatile uint32_t sync_count;
+    volatile uint32_t data_count;
+    volatile uint32_t data_expected;
+    volatile uint32_t data_bytes;
+    volatile uint32_t errors;
+} bench_state;
+
+static bench_cfg_t *bench_cfg;
+static uint8_t *bench_tx_buf;
+static bench_hist_t bench_hist;
+
+static uint32_t hist_index(uint32_t v)
+{
+    uint32_t msb;
+
+    if (v < HIST_SUB) {
+        return v;
+    }
+    msb = 31 - __builtin_clz(v);
+    return (msb - HIST_SUB_BITS + 1) * HIST_SUB + ((v >> (msb - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+/* largest value of a bucket */
+static uint32_t hist_value(uint32_t index)
+{
+    uint32_t shift;
+
+    if (index < HIST_SUB) {
+        return index;
+    }
+    shift = index / HIST_SUB - 1;
+    return ((HIST_SUB + index % HIST_SUB) << shift) + ((1U << shift) - 1);
+}
+
+static void hist_reset(bench_hist_t *hist)
+{
+    memset(hist, 0, sizeof(*hist));
+    hist->min = UINT32_MAX;
+}
+
+static void hist_add(bench_hist_t *hist, uint32_t v)
+{
+    hist->buckets[hist_index(v)]++;
+    hist->count++;
+    hist->sum += v;
+    if (v < hist->min) {
+        hist->min = v;
+    }
+    if (v > hist->max) {
+        hist->max = v;
+    }
+}
+
+/* value below which permille of the samples are */
+static uint32_t hist_percentile(bench_hist_t *hist, uint32_t permille)
+{
+    uint64_t target = ((uint64_t)hist->count * permille + 999) / 1000;
+    uint64_t seen = 0;
+
+    for (uint32_t i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= target && seen > 0) {
+            /* the bucket bound can be above the largest sample */
+            return hist_value(i) < hist->max ? hist_value(i) : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+/* one line per power of two */
+static void hist_print(bench_hist_t *hist)
+{
+    uint32_t lines[33] = { 0 };
+    uint32_t peak = 0, first = 33, last = 0;
+
+    for (uint32_t i = 0; i < HIST_BUCKETS; i++) {
+        if (hist->buckets[i] == 0) {
+            continue;
+        }
+        uint32_t v = hist_value(i);
+        uint32_t line = v == 0 ? 0 : 32 - __builtin_clz(v);
+        lines[line] += hist->buckets[i];
+    }
+    for (uint32_t i = 0; i < 33; i++) {
+        if (lines[i] == 0) {
+            continue;
+        }
+        peak = lines[i] > peak ? lines[i] : peak;
+        first = i < first ? i : first;
+        last = i;
+    }
+    for (uint32_t i = first; i <= last && peak > 0; i++) {
+        char bar[41];
+        uint32_t len = (uint32_t)(((uint64_t)lines[i] * 40 + peak - 1) / peak);
+        memset(bar, '#', len);
+        bar[len] = '\0';
+        printf("  < %7lu us %7lu %s\r\n", (unsigned long)(1UL << i), (unsigned long)lines[i], bar);
+    }
+}
+
+void bench_rx(void *data, size_t len, void *priv)
+{
+    bench_msg_t *msg = data;
+
+    if (len < sizeof(bench_msg_t) || msg->magic != BENCH_MAGIC) {
+        bench_state.errors++;
+        return;
+    }
+    switch (msg->type) {
+        case BENCH_MSG_HELLO:
+            bench_state.hello = true;
+            break;
+        case BENCH_MSG_ECHO:
+            bench_state.echo_seq = msg->seq;
+            break;
+        case BENCH_MSG_SYNC:
+            bench_state.sync_count = msg->count;
+            bench_state.sync_seq = msg->seq;
+            break;
+        case BENCH_MSG_DATA:
+            bench_state.data_bytes += len;
+            /* only wake the benchmark for the last one */
+            if (++bench_state.data_count != bench_state.data_expected) {
+                return;
+            }
+            break;
+        default:
+            bench_state.errors++;
+            return;
+    }
+    bench_port_signal();
+}
+
+/* send a message of len bytes with the header filled in */
+static oblfr_err_t bench_send(bench_path_t path, uint8_t type, uint32_t seq, uint32_t count, uint32_t size, uint32_t len)
+{
+    bench_msg_t hdr = {
+        .magic = BENCH_MAGIC,
+        .type = type,
+        .seq = seq,
+        .count = count,
+        .size = size,
+    };
+
+    if (path == BENCH_PATH_ZEROCOPY) {
+        uint32_t buf_size;
+        uint8_t *buf = oblfr_rpmsg_device_send_buffer_alloc(bench_cfg->device, &buf_size, (OBLFR_Timeout)bench_cfg->timeout_ms);
+        if (buf == NULL || buf_size < len) {
+            LOG_E("Can't allocate a buffer\r\n");
+            return OBLFR_ERR_ERROR;
+        }
+        memcpy(buf, &hdr, sizeof(hdr));
+        return oblfr_rpmsg_device_send_buffer(bench_cfg->device, buf, len);
+    }
+    if (path == BENCH_PATH_SENDV) {
+        /* header and payload from different buffers */
+        struct iovec iov[2] = {
+            { .iov_base = &hdr, .iov_len = sizeof(hdr) },
+            { .iov_base = bench_tx_buf + sizeof(hdr), .iov_len = len - sizeof(hdr) },
+        };
+        return oblfr_rpmsg_device_sendv(bench_cfg->device, iov, 2, (OBLFR_Timeout)bench_cfg->timeout_ms);
+    }
+    memcpy(bench_tx_buf, &hdr, sizeof(hdr));
+    return oblfr_rpmsg_device_send(bench_cfg->device, bench_tx_buf, len, (OBLFR_Timeout)bench_cfg->timeout_ms);
+}
+
+/* send a message the peer answers, without waiting for the rest of a kick batch */
+static oblfr_err_t bench_send_flush(bench_path_t path, uint8_t type, uint32_t seq, uint32_t count, uint32_t size, uint32_t len)
+{
+    oblfr_err_t ret = bench_send(path, type, seq, count, size, len);
+    if (ret != OBLFR_OK) {
+        return ret;
+    }
+    return oblfr_rpmsg_flush();
+}
+
+/* wait until *value reaches expected */
+static oblfr_err_t bench_wait(volatile uint32_t *value, uint32_t expected)
+{
+    while (*value != expected) {
+        if (!bench_port_wait(bench_cfg->timeout_ms)) {
+            LOG_E("Timeout waiting for the peer\r\n");
+            return OBLFR_ERR_TIMEOUT;
+        }
+    }
+    return OBLFR_OK;
+}
+
+static oblfr_err_t bench_sync(uint32_t *count)
+{
+    static uint32_t seq;
+    oblfr_err_t ret;
+
+    seq++;
+    ret = bench_send_flush(BENCH_PATH_COPY, BENCH_MSG_SYNC, seq, 0, 0, sizeof(bench_msg_t));
+    if (ret != OBLFR_OK) {
+        return ret;
+    }
+    ret = bench_wait(&bench_state.sync_seq, seq);
+    *count = bench_state.sync_count;
+    return ret;
+}
+
+static void bench_print_rate(const char *what, uint32_t msgs, uint64_t bytes, uint64_t us)
+{
+    if (us == 0) {
+        us = 1;
+    }
+    printf("  %-8s %8lu msg/s %8lu.%02lu MB/s\r\n", what, (unsigned long)((uint64_t)msgs * 1000000 / us),
+           (unsigned long)(bytes / us), (unsigned long)(bytes * 100 / us % 100));
+}
+
+/* notifications per message sent and received since before */
+static void bench_print_kicks(const oblfr_rpmsg_stats_t *before)
+{
+    oblfr_rpmsg_stats_t now;
+    uint32_t sent, received, tx, rx;
+
+    if (oblfr_rpmsg_get_stats(&now) != OBLFR_OK) {
+        return;
+    }
+    sent = now.sent - before->sent;
+    received = now.received - before->received;
+    tx = (uint32_t)((uint64_t)(now.tx_kicks - before->tx_kicks) * 100 / (sent ? sent : 1));
+    rx = (uint32_t)((uint64_t)(now.rx_kicks - before->rx_kicks) * 100 / (received ? received : 1));
+    printf("  kicks    tx %lu.%02lu rx %lu.%02lu per message\r\n", (unsigned long)(tx / 100), (unsigned long)(tx % 100),
+           (unsigned long)(rx / 100), (unsigned long)(rx % 100));
+}
+
+static oblfr_err_t bench_latency(bench_path_t path, uint32_t size, bool histogram)
+{
+    uint32_t iterations = bench_cfg->latency_iterations;
+    uint64_t start, t;
+    oblfr_err_t ret;
+
+    hist_reset(&bench_hist);
+    bench_state.echo_seq = 0;
+    start = bench_port_time_us();
+    for (uint32_t i = 1; i <= iterations; i++) {
+        t = bench_port_time_us();
+        ret = bench_send_flush(path, BENCH_MSG_ECHO, i, 0, 0, size);
+        if (ret != OBLFR_OK) {
+            return ret;
+        }
+        ret = bench_wait(&bench_state.echo_seq, i);
+        if (ret != OBLFR_OK) {
+            return ret;
+        }
+        hist_add(&bench_hist, (uint32_t)(bench_port_time_us() - t));
+    }
+    t = bench_port_time_us() - start;
+
+    printf("latency  %-8s %4lu B: min %lu p50 %lu p99 %lu p999 %lu max %lu avg %lu us, %lu msg/s\r\n",
+           bench_path_name[path], (unsigned long)size, (unsigned long)bench_hist.min,
+           (unsigned long)hist_percentile(&bench_hist, 500), (unsigned long)hist_percentile(&bench_hist, 990),
+           (unsigned long)hist_percentile(&bench_hist, 999), (unsigned long)bench_hist.max,
+           (unsigned long)(bench_hist.sum / bench_hist.count), (unsigned long)((uint64_t)iterations * 1000000 / (t ? t : 1)));
+    if (histogram) {
+        hist_print(&bench_hist);
+    }
+    return OBLFR_OK;
+}
+
+static oblfr_err_t bench_stream(bench_path_t path, uint32_t size)
+{
+    uint32_t count = bench_cfg->stream_count, sunk;
+    oblfr_rpmsg_stats_t stats;
+    uint64_t start, t;
+    oblfr_err_t ret;
+
+    /* start from a known count */
+    ret = bench_sync(&sunk);
+    if (ret != OBLFR_OK) {
+        return ret;
+    }
+    oblfr_rpmsg_get_stats(&stats);
+    start = bench_port_time_us();
+    for (uint32_t i = 1; i <= count; i++) {
+        ret = bench_send(path, BENCH_MSG_SINK, i, 0, 0, size);
+        if (ret != OBLFR_OK) {
+            return ret;
+        }
+    }
+    ret = bench_sync(&sunk);
+    if (ret != OBLFR_OK) {
+        return ret;
+    }
+    t = bench_port_time_us() - start;
+
+    printf("stream   %-8s %4lu B:\r\n", bench_path_name[path], (unsigned long)size);
+    bench_print_rate("tx", sunk, (uint64_t)sunk * size, t);
+    bench_print_kicks(&stats);
+    if (sunk != count) {
+        LOG_E("Peer received %lu of %lu messages\r\n", (unsigned long)sunk, (unsigned long)count);
+        return OBLFR_ERR_ERROR;
+    }
+    return OBLFR_OK;
+}
+
+static oblfr_err_t bench_mixed(uint32_t size)
+{
+    uint32_t count = bench_cfg->stream_count, sunk;
+    oblfr_rpmsg_stats_t stats;
+    uint64_t start, t;
+    oblfr_err_t ret;
+
+    ret = bench_sync(&sunk);
+    if (ret != OBLFR_OK) {
+        return ret;
+    }
+    oblfr_rpmsg_get_stats(&stats);
+    /* bench_rx() wakes us on the count-th DATA message */
+    bench_state.data_count = 0;
+    bench_state.data_bytes = 0;
+    bench_state.data_expected = count;
+
+    start = bench_port_time_us();
+    ret = bench_send_flush(BENCH_PATH_COPY, BENCH_MSG_SOURCE, 0, count, size, sizeof(bench_msg_t));
+    if (ret != OBLFR_OK) {
+        return ret;
+    }
+    for (uint32_t i = 1; i <= count; i++) {
+        ret = bench_send(BENCH_PATH_COPY, BENCH_MSG_SINK, i, 0, 0, size);
+        if (ret != OBLFR_OK) {
+            return ret;
+        }
+    }
+    ret = bench_wait(&bench_state.data_count, count);
+    if (ret != OBLFR_OK) {
+        return ret;
+    }
+    ret = bench_sync(&sunk);
+    if (ret != OBLFR_OK) {
+        return ret;
+    }
+    t = bench_port_time_us() - start;
+
+    printf("mixed    %-8s %4lu B:\r\n", bench_path_name[BENCH_PATH_COPY], (unsigned long)size);
+    bench_print_rate("tx", sunk, (uint64_t)sunk * size, t);
+    bench_print_rate("rx", count, bench_state.data_bytes, t);
+    bench_print_rate("total", sunk + count, (uint64_t)sunk * size + bench_state.data_bytes, t);
+    bench_print_kicks(&stats);
+    if (sunk != count) {
+        LOG_E("Peer received %lu of %lu messages\r\n", (unsigned long)sunk, (unsigned long)count);
+        return OBLFR_ERR_ERROR;
+    }
+    return OBLFR_OK;
+}
+
+/* next size of the sweep: powers of two, then the MTU */
+static uint32_t bench_next_size(uint32_t size, uint32_t mtu)
+{
+    if (size == mtu) {
+        return 0;
+    }
+    return size * 2 < mtu ? size * 2 : mtu;
+}
+
+oblfr_err_t bench_run(bench_cfg_t *cfg)
+{
+    uint32_t mtu = oblfr_rpmsg_get_mtu();
+    oblfr_err_t ret = OBLFR_OK;
+
+    if (cfg->device == NULL || mtu < sizeof(bench_msg_t)) {
+        return OBLFR_ERR_INVALID;
+    }
+    if (cfg->latency_iterations == 0) {
+        cfg->latency_iterations = 1000;
+    }
+    if (cfg->stream_count == 0) {
+        cfg->stream_count = 2000;
+    }
+    if (cfg->timeout_ms == 0) {
+        cfg->timeout_ms = 1000;
+    }
+    bench_cfg = cfg;
+    memset((void *)&bench_state, 0, sizeof(bench_state));
+
+    bench_tx_buf = malloc(mtu);
+    if (bench_tx_buf == NULL) {
+        return OBLFR_ERR_NOMEM;
+    }
+    memset(bench_tx_buf, 0x5A, mtu);
+
+    LOG_I("Waiting for the peer\r\n");
+    while (!bench_state.hello) {
+        bench_port_wait(1000);
+    }
+    /* answer, so the peer knows our address is valid */
+    ret = bench_send_flush(BENCH_PATH_COPY, BENCH_MSG_HELLO, 0, 0, 0, sizeof(bench_msg_t));
+    if (ret != OBLFR_OK) {
+        goto out;
+    }
+    printf("RPMsg benchmark: MTU %lu B, %lu ping-pongs, %lu messages per stream\r\n", (unsigned long)mtu,
+           (unsigned long)cfg->latency_iterations, (unsigned long)cfg->stream_count);
+
+    for (uint32_t size = sizeof(bench_msg_t); size != 0 && ret == OBLFR_OK; size = bench_next_size(size, mtu)) {
+        for (bench_path_t path = BENCH_PATH_COPY; path < BENCH_PATH_MAX && ret == OBLFR_OK; path++) {
+            /* histograms of the smallest and largest messages */
+            ret = bench_latency(path, size, size == sizeof(bench_msg_t) || size == mtu);
+        }
+    }
+    for (uint32_t size = sizeof(bench_msg_t); size != 0 && ret == OBLFR_OK; size = bench_next_size(size, mtu)) {
+        for (bench_path_t path = BENCH_PATH_COPY; path < BENCH_PATH_MAX && ret == OBLFR_OK; path++) {
+            ret = bench_stream(path, size);
+        }
+    }
+    for (uint32_t size = sizeof(bench_msg_t); size != 0 && ret == OBLFR_OK; size = bench_next_size(size, mtu)) {
+        ret = bench_mixed(size);
+    }
+    if (ret == OBLFR_OK) {
+        ret = bench_send_flush(BENCH_PATH_COPY, BENCH_MSG_DONE, 0, 0, 0, sizeof(bench_msg_t));
+    }
+    if (bench_state.errors != 0) {
+        LOG_W("%lu malformed messages received\r\n", (unsigned long)bench_state.errors);
+    }
+
+out:
+    free(bench_tx_buf);
+    bench_tx_buf = NULL;
+    return ret;
+}
@@ -0,0 +1,53 @@
+#ifndef RPMSG_BENCH_H
+#define RPMSG_BENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "oblfr_common.h"
+#include "oblfr_rpmsg.h"
+#include "bench_msg.h"
+
+/**
+ * @brief Benchmark configuration
+ */
+typedef struct bench_cfg_s {
+    oblfr_queue_entry_t *device;    /**< endpoint, with bench_rx() as callback */
+    uint32_t latency_iterations;    /**< ping-pongs per size. If 0, 1000 */
+    uint32_t stream_count;          /**< messages per size of stream and mixed. If 0, 2000 */
+    uint32_t timeout_ms;            /**< wait for an answer at most this long. If 0, 1000 */
+} bench_cfg_t;
+
+/**
+ * @brief Receive callback of the benchmark endpoint (oblfr_device_cfg_t cb)
+ */
+void bench_rx(void *data, size_t len, void *priv);
+
+/**
+ * @brief Wait for the peer and run all tests, printing the results
+ *
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_TIMEOUT if the peer did not answer
+ *          OBLFR_ERR_ERROR if a send failed
+ */
+oblfr_err_t bench_run(bench_cfg_t *cfg);
+
+/* provided by the port (src/main.c on the target, host/ on the host) */
+
+/**
+ * @brief Monotonic time in microseconds
+ */
+uint64_t bench_port_time_us(void);
+
+/**
+ * @brief Wake bench_port_wait(), called from the receive callback
+ */
+void bench_port_signal(void);
+
+/**
+ * @brief Wait for a bench_port_signal()
+ * @return false on timeout
+ */
+bool bench_port_wait(uint32_t timeout_ms);
+
+#endif // RPMSG_BENCH_H
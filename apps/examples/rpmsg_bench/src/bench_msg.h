@@ -0,0 +1,57 @@
+#ifndef RPMSG_BENCH_MSG_H
+#define RPMSG_BENCH_MSG_H
+
+#include <stdint.h>
+
+/*
+RPMsg benchmark
+
+The benchmark runs on the remote side (M0) and measures its endpoint against a
+peer on the master side (Linux on D0, or the master thread/process of the host
+build, see host/). The peer announces itself with a HELLO, then answers:
+
+ECHO:   sends the message back unchanged
+SINK:   counts it
+SYNC:   answers a SYNC with count = messages sunk since the previous SYNC
+SOURCE: sends count DATA messages of size bytes, while still answering
+DONE:   the benchmark is over
+
+Every message starts with a bench_msg_t, so the smallest message is 16 bytes.
+
+Tests, for each message size (powers of two up to the MTU, and the MTU):
+latency:    ECHO ping-pong, one message in flight. Reports p50/p99/p999 and a histogram
+stream:     SINK messages back to back then a SYNC, unidirectional throughput
+mixed:      SOURCE and SINK at the same time, throughput in both directions
+
+latency and stream run with oblfr_rpmsg_device_send() (copy) and with
+oblfr_rpmsg_device_send_buffer_alloc()/oblfr_rpmsg_device_send_buffer() (zero-copy)
+*/
+
+#define BENCH_MAGIC 0xB5
+
+/**
+ * @brief Message types
+ */
+typedef enum bench_msg_type_e {
+    BENCH_MSG_HELLO = 1,    /**< peer is ready */
+    BENCH_MSG_ECHO,         /**< send back */
+    BENCH_MSG_SINK,         /**< count */
+    BENCH_MSG_SYNC,         /**< answer with the count */
+    BENCH_MSG_SOURCE,       /**< send count DATA messages of size bytes */
+    BENCH_MSG_DATA,         /**< sent by the peer for a SOURCE */
+    BENCH_MSG_DONE,         /**< benchmark finished */
+} bench_msg_type_t;
+
+/**
+ * @brief Header of every message, little endian
+ */
+typedef struct __attribute__((packed)) bench_msg_s {
+    uint8_t magic;          /**< BENCH_MAGIC */
+    uint8_t type;           /**< @ref bench_msg_type_t */
+    uint16_t reserved;
+    uint32_t seq;
+    uint32_t count;         /**< SOURCE: messages to send, SYNC answer: messages sunk */
+    uint32_t size;          /**< SOURCE: size of the messages */
+} bench_msg_t;
+
+#endif // RPMSG_BENCH_MSG_H
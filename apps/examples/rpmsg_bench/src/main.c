@@ -0,0 +1,129 @@
+/**
+ * @file main.c
+ * @brief
+ *
+ * Copyright (c) 2023 Justin Hammond
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <board.h>
+#include <bflb_mtimer.h>
+#include <FreeRTOS.h>
+#include <semphr.h>
+#include "oblfr_mailbox.h"
+#include "oblfr_rpmsg.h"
+#include "sdkconfig.h"
+#include "bench.h"
+
+#define DBG_TAG "MAIN"
+#include <log.h>
+
+static SemaphoreHandle_t bench_sem;
+
+uint64_t bench_port_time_us(void)
+{
+    return bflb_mtimer_get_time_us();
+}
+
+/* bound by the rpmsg_char driver, so /dev/rpmsgN appears on Linux */
+static oblfr_device_cfg_t endpoint = {
+    .name = "rpmsg-raw",
+    .cb = bench_rx,
+    .priv = NULL,
+    /* the only endpoint, and the peer does not follow the credits */
+    .credits = OBLFR_RPMSG_CREDITS_ALL,
+};
+
+void bench_port_signal(void)
+{
+    if (endpoint.direct)
+    {
+        /* bench_rx() runs in the mailbox interrupt */
+        BaseType_t woken = pdFALSE;
+        xSemaphoreGiveFromISR(bench_sem, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+    else
+    {
+        /* bench_rx() runs in the rpmsg task */
+        xSemaphoreGive(bench_sem);
+    }
+}
+
+bool bench_port_wait(uint32_t timeout_ms)
+{
+    return xSemaphoreTake(bench_sem, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+}
+
+int app_main(void)
+{
+    LOG_I("Starting Mailbox Handlers\r\n");
+
+    if (oblfr_mailbox_init() != OBLFR_OK)
+    {
+        LOG_E("oblfr_mailbox_init failed\r\n");
+        while (1)
+        {
+            ;
+        }
+    }
+    if (init_rpmsg(NULL) != OBLFR_OK)
+    {
+        LOG_E("init_rpmsg failed\r\n");
+        while (1)
+        {
+            ;
+        }
+    }
+
+    bench_sem = xSemaphoreCreateCounting(0xFFFF, 0);
+    if (bench_sem == NULL)
+    {
+        LOG_E("Failed to create semaphore\r\n");
+        while (1)
+        {
+            ;
+        }
+    }
+
+    bench_cfg_t cfg = {
+        .device = oblfr_rpmsg_device_add(&endpoint),
+    };
+    if (cfg.device == NULL)
+    {
+        LOG_E("oblfr_rpmsg_device_add failed\r\n");
+        while (1)
+        {
+            ;
+        }
+    }
+
+    LOG_I("Run rpmsg_bench_peer /dev/rpmsgN on Linux to start\r\n");
+    while (1)
+    {
+        LOG_I("Receiving in the %s\r\n", endpoint.direct ? "mailbox interrupt (direct)" : "rpmsg task");
+        if (bench_run(&cfg) != OBLFR_OK)
+        {
+            LOG_E("Benchmark failed\r\n");
+        }
+        oblfr_rpmsg_dump();
+        /* alternate, to compare the latency of both receive modes */
+        endpoint.direct = !endpoint.direct;
+    }
+}
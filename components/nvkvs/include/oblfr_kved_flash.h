@@ -10,11 +10,34 @@
 typedef struct oblfr_kved_flash_driver_s {
     uint32_t flash_addr;                        /**< Start Address in Flash to store the configuration */
     uint32_t flash_sector_size;                 /**< Flash Sector Size. Auto Populated */
-    uint32_t max_entries;                       /**< Max number of entries in the flash. If 0, then auto calculated from Flash Sector Size. (255 for Flash Sector Size of 4096Bytes) */
+    uint32_t max_entries;                       /**< Max number of entries in the flash. If 0, then auto calculated from Flash Sector Size. (255 for Flash Sector Size of 4096Bytes). Larger values span the index over multiple Flash Sectors */
+    bool xip_read;                              /**< Read Index and String Tables directly from the memory mapped (XIP) flash. Required for oblfr_nvkvs_get_string_ref() */
 } oblfr_kved_flash_driver_t;
 
 
+/**
+ * @brief Create a KVED flash driver. The configuration is copied, so several drivers
+ *        (for different partitions) can be active at the same time
+ * @return the driver, or NULL if out of memory
+*/
 kved_flash_driver_t *oblfr_kved_flash_configure(oblfr_kved_flash_driver_t *cfg);
+
+/**
+ * @brief Size of the flash partition (all tables) used by a KVED flash driver
+*/
+uint32_t oblfr_kved_flash_partition_size(kved_flash_driver_t *driver);
+
 void oblfr_kved_flash_close(kved_flash_driver_t *driver);
 
+/**
+ * @brief Memory mapped (XIP) address of a flash address, to read data like a factory partition in place
+ * @return  the address, or NULL if the flash address is not in the XIP window
+*/
+const void *oblfr_kved_flash_xip_ptr(uint32_t flash_addr);
+
+/**
+ * @brief Erase sector size of the flash, in bytes
+*/
+uint32_t oblfr_kved_flash_erase_size(void);
+
 #endif // OBLFR_KVED_MEMORY_H
\ No newline at end of file
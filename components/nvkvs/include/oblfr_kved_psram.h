@@ -0,0 +1,72 @@
+#ifndef OBLFR_KVED_PSRAM_H
+#define OBLFR_KVED_PSRAM_H
+
+#include "kved.h"
+
+/*
+PSRAM storage with a flash mirror
+
+The working KVED tables live in PSRAM, so writes run at RAM speed. PSRAM keeps its
+content over a soft reset, and a validated header in front of the tables lets the
+next boot pick the image up again. A background task copies the tables to flash at
+most mirror_window_ms after they change (or on demand with oblfr_kved_psram_sync()),
+and a cold boot restores the newest valid mirror.
+
+PSRAM (psram_addr):
++--------------------------------+
+| HEADER (32 bytes)              |
++--------------------------------+
+| INDEX A, INDEX B               |
+| STRING A, STRING B             | <= working tables
++--------------------------------+
+| SNAPSHOT                       | <= copy of the tables being mirrored
++--------------------------------+
+
+Flash (mirror_flash_addr), two slots used alternately, so a reset while
+mirroring leaves the previous mirror intact:
++--------------------------------+
+| SLOT 0: HEADER + TABLES        |
++--------------------------------+
+| SLOT 1: HEADER + TABLES        |
++--------------------------------+
+*/
+
+/**
+ * @brief PSRAM driver configuration
+*/
+typedef struct oblfr_kved_psram_driver_s {
+    void *psram_addr;               /**< PSRAM address of the image (oblfr_kved_psram_size() bytes). Must be reserved for it (not heap), PSRAM must be initialized (uhs_psram_init()) */
+    uint32_t max_entries;           /**< Max number of entries. If 0, 255 */
+    uint32_t mirror_flash_addr;     /**< Start Address in Flash of the mirror (oblfr_kved_psram_mirror_size() bytes), aligned to the Flash Sector Size */
+    uint32_t mirror_window_ms;      /**< Changes reach the flash mirror at most this long after they were made. If 0, CONFIG_COMPONENT_NVKVS_PSRAM_MIRROR_WINDOW_MS */
+} oblfr_kved_psram_driver_t;
+
+/**
+ * @brief Create a KVED PSRAM driver. The configuration is copied, so several drivers
+ *        (for different regions) can be active at the same time
+ * @return the driver, or NULL if out of memory
+*/
+kved_flash_driver_t *oblfr_kved_psram_configure(oblfr_kved_psram_driver_t *cfg);
+
+/**
+ * @brief Size of the PSRAM region used by a KVED PSRAM driver
+*/
+uint32_t oblfr_kved_psram_size(kved_flash_driver_t *driver);
+
+/**
+ * @brief Size of the flash region used by the mirror of a KVED PSRAM driver
+*/
+uint32_t oblfr_kved_psram_mirror_size(kved_flash_driver_t *driver);
+
+/**
+ * @brief Mirror pending changes to flash now, instead of waiting for the mirror window
+ * @return true if the flash mirror is up to date
+*/
+bool oblfr_kved_psram_sync(kved_flash_driver_t *driver);
+
+/**
+ * @brief Mirror pending changes, stop the mirror task and free the driver
+*/
+void oblfr_kved_psram_close(kved_flash_driver_t *driver);
+
+#endif // OBLFR_KVED_PSRAM_H
@@ -23,6 +23,7 @@
 #include "kved.h"
 #include "oblfr_kved_flash.h"
 #include "oblfr_kved_memory.h"
+#include "oblfr_kved_psram.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -34,6 +35,7 @@ extern "C" {
 typedef enum {
     OBLFR_NVKVS_STORAGE_FLASH,  /**< Flash storage - Need to provide a oblfr_kved_flash_driver_t configuration*/
     OBLFR_NVKVS_STORAGE_RAM,    /**< RAM storage */
+    OBLFR_NVKVS_STORAGE_PSRAM,  /**< PSRAM storage mirrored to flash - Need to provide a oblfr_kved_psram_driver_t configuration */
 } oblfr_nvkvs_storage_t;
 
 /**
@@ -43,9 +45,46 @@ typedef struct  {
     oblfr_nvkvs_storage_t storage;          /**< Storage type */
     union  {
         oblfr_kved_flash_driver_t *flash;   /**< Flash driver configuration */
+        oblfr_kved_psram_driver_t *psram;   /**< PSRAM driver configuration */
     } drv_cfg;
+    uint8_t shards;                         /**< Number of independent KVED instances to spread the keys over (by key hash). 
+                                                 0 or 1 for a single instance. With flash storage, each shard uses its own partition, 
+                                                 placed one after another from flash_addr (with PSRAM storage, from psram_addr 
+                                                 and mirror_flash_addr). Changing this loses all existing keys */
+    const void *factory;                    /**< Optional memory mapped read-only factory partition (see oblfr_nvkvs_factory.h), 
+                                                 e.g. oblfr_kved_flash_xip_ptr() of its flash address. Keys that are not in the 
+                                                 writable storage are read from it. NULL for none */
 } oblfr_nvkvs_cfg_t;
 
+/**
+ * @brief NVKVS statistics, see oblfr_nvkvs_get_stats()
+ * 
+ * Counters are summed over all shards and start at zero at oblfr_nvkvs_init()
+ */
+typedef struct oblfr_nvkvs_stats_s {
+    uint32_t compactions;               /**< compactions since init */
+    uint32_t compaction_last_us;        /**< duration of the last compaction, in us */
+    uint32_t compaction_max_us;         /**< duration of the slowest compaction, in us */
+    uint32_t lifetime_compactions;      /**< compactions since the storage was formatted */
+    uint32_t sector_erases[4];          /**< erases since init of Index A, Index B, String A and String B */
+    uint32_t string_bytes_total;        /**< size of the string area */
+    uint32_t string_bytes_allocated;    /**< bytes of the string area written, including stale data */
+    uint32_t string_bytes_live;         /**< bytes of the string area still referenced by a key */
+    float string_fragmentation;         /**< fraction (0..1) of the written string area holding stale data */
+    uint64_t bytes_written;             /**< bytes written to the storage since init */
+    uint64_t user_bytes_written;        /**< bytes of keys and values written by the application since init */
+    float write_amplification;          /**< bytes_written / user_bytes_written */
+    uint32_t lookups;                   /**< key lookups since init */
+    float avg_lookup_probes;            /**< average number of index entries read per lookup */
+} oblfr_nvkvs_stats_t;
+
+/** Members of a packed group of bools, see oblfr_nvkvs_set_packed_bool() */
+#define OBLFR_NVKVS_PACKED_BOOL_SLOTS 64
+/** Members of a packed group of uint8_t, see oblfr_nvkvs_set_packed_u8() */
+#define OBLFR_NVKVS_PACKED_U8_SLOTS 8
+/** Members of a packed group of uint16_t, see oblfr_nvkvs_set_packed_u16() */
+#define OBLFR_NVKVS_PACKED_U16_SLOTS 4
+
 /**
  * @brief NVKVS handle
  */
@@ -67,6 +106,11 @@ typedef enum oblfr_nvkvs_data_types_e
 	OBLFR_NVKVS_DATA_TYPE_UINT64,    /**< 64 bits, signed */
 	OBLFR_NVKVS_DATA_TYPE_INT64,     /**< 64 bits, unsigned */
 	OBLFR_NVKVS_DATA_TYPE_DOUBLE,    /**< Double precision floating point (double) */
+	OBLFR_NVKVS_DATA_TYPE_UINT8_ARRAY,  /**< Array of 8 bits unsigned values, up to @ref CONFIG_COMPONENT_NVKVS_MAX_ARRAY_SIZE bytes */
+	OBLFR_NVKVS_DATA_TYPE_UINT16_ARRAY, /**< Array of 16 bits unsigned values, up to @ref CONFIG_COMPONENT_NVKVS_MAX_ARRAY_SIZE bytes */
+	OBLFR_NVKVS_DATA_TYPE_UINT32_ARRAY, /**< Array of 32 bits unsigned values, up to @ref CONFIG_COMPONENT_NVKVS_MAX_ARRAY_SIZE bytes */
+	OBLFR_NVKVS_DATA_TYPE_FLOAT_ARRAY,  /**< Array of single precision floats, up to @ref CONFIG_COMPONENT_NVKVS_MAX_ARRAY_SIZE bytes */
+	OBLFR_NVKVS_DATA_TYPE_DOUBLE_ARRAY, /**< Array of double precision floats, up to @ref CONFIG_COMPONENT_NVKVS_MAX_ARRAY_SIZE bytes */
 } oblfr_nvkvs_data_types_t;
 
 /**
@@ -85,6 +129,11 @@ typedef union oblfr_nvkvs_value_u
 	uint64_t u64;                                           /**< unsigned 64 bits value */
 	int64_t i64;                                            /**< signed 64 bits value */
 	double dbl;                                             /**< double precision float */
+	uint8_t u8a[KVED_MAX_ARRAY_SIZE];                       /**< array of unsigned 8 bits values */
+	uint16_t u16a[KVED_MAX_ARRAY_SIZE / sizeof(uint16_t)];  /**< array of unsigned 16 bits values */
+	uint32_t u32a[KVED_MAX_ARRAY_SIZE / sizeof(uint32_t)];  /**< array of unsigned 32 bits values */
+	float flta[KVED_MAX_ARRAY_SIZE / sizeof(float)];        /**< array of single precision floats */
+	double dbla[KVED_MAX_ARRAY_SIZE / sizeof(double)];      /**< array of double precision floats */
 } oblfr_nvkvs_value_t;
 
 /**
@@ -94,6 +143,7 @@ typedef struct oblfr_nvkvs_data_s {
     char key[8];
     oblfr_nvkvs_data_types_t type;
     oblfr_nvkvs_value_t value;
+    uint16_t size;  /**< size in bytes of array values (and of any value returned by oblfr_nvkvs_get_data(), strings including terminator) */
 } oblfr_nvkvs_data_t;
 
 
@@ -138,6 +188,20 @@ oblfr_err_t oblfr_nvkvs_dump(oblfr_nvkvs_handle_t *handle);
  */
 oblfr_err_t oblfr_nvkvs_compact(oblfr_nvkvs_handle_t *handle);
 
+/**
+ * @brief Make the NVKVS storage durable now
+ * 
+ * With PSRAM storage, changes are mirrored to flash by a background task within
+ * the mirror window. This function mirrors pending changes immediately, e.g. before
+ * a power down. Other storage types are always durable (flash) or never (RAM)
+ * @param in handle NVKVS handle
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid
+ *          OBLFR_ERR_NOTSUPPORTED if the storage is RAM
+ *          OBLFR_ERR_ERROR if the changes could not be written to flash
+ */
+oblfr_err_t oblfr_nvkvs_sync(oblfr_nvkvs_handle_t *handle);
+
 /**
  * @brief Get the maximum number of entries the storage can hold
  * 
@@ -146,7 +210,7 @@ oblfr_err_t oblfr_nvkvs_compact(oblfr_nvkvs_handle_t *handle);
  * @param in handle NVKVS handle
  * @return  Number of entries the storage can hold
  */
-uint16_t oblfr_nvkvs_get_size(oblfr_nvkvs_handle_t *handle);
+uint32_t oblfr_nvkvs_get_size(oblfr_nvkvs_handle_t *handle);
 
 /**
  * @brief Get the number of used entries in the storage
@@ -154,7 +218,7 @@ uint16_t oblfr_nvkvs_get_size(oblfr_nvkvs_handle_t *handle);
  * @param in handle NVKVS handle
  * @return  Number of used entries in the storage
  */
-uint16_t oblfr_nvkvs_used_entries(oblfr_nvkvs_handle_t *handle);
+uint32_t oblfr_nvkvs_used_entries(oblfr_nvkvs_handle_t *handle);
 
 /** 
  * @brief Get the number of free entries in the storage.
@@ -164,7 +228,7 @@ uint16_t oblfr_nvkvs_used_entries(oblfr_nvkvs_handle_t *handle);
  * @param in handle NVKVS handle
  * @return  Number of free entries in the storage
 */
-uint16_t oblfr_nvkvs_free_entries(oblfr_nvkvs_handle_t *handle);
+uint32_t oblfr_nvkvs_free_entries(oblfr_nvkvs_handle_t *handle);
 
 /**
  * @brief Get the number of deleted entries in the storage
@@ -172,7 +236,23 @@ uint16_t oblfr_nvkvs_free_entries(oblfr_nvkvs_handle_t *handle);
  * @param in handle NVKVS handle
  * @return  Number of deleted entries in the storage
 */
-uint16_t oblfr_nvkvs_deleted_entries(oblfr_nvkvs_handle_t *handle);
+uint32_t oblfr_nvkvs_deleted_entries(oblfr_nvkvs_handle_t *handle);
+
+/**
+ * @brief Get the statistics of the storage
+ * 
+ * Reports compactions, flash erases and writes, fragmentation of the string
+ * area and the cost of lookups, to track the health of the storage.
+ * Only lifetime_compactions is kept in the storage, the other counters restart
+ * at every oblfr_nvkvs_init() and do not tell the wear of the flash
+ * 
+ * @param in handle NVKVS handle
+ * @param out stats structure to store the statistics
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid
+ *          OBLFR_ERR_ERROR if the statistics could not be retrieved
+ */
+oblfr_err_t oblfr_nvkvs_get_stats(oblfr_nvkvs_handle_t *handle, oblfr_nvkvs_stats_t *stats);
 
 /**
  * @brief obtain a index to the first entry in the database
@@ -181,7 +261,7 @@ uint16_t oblfr_nvkvs_deleted_entries(oblfr_nvkvs_handle_t *handle);
  * @return  index to the first entry in the database
  *          0 if the database is empty
  */
-int16_t oblfr_nvkvs_iter_init(oblfr_nvkvs_handle_t *handle);
+int32_t oblfr_nvkvs_iter_init(oblfr_nvkvs_handle_t *handle);
 
 /**
  * @brief obtain a index to the next entry in the database
@@ -191,7 +271,7 @@ int16_t oblfr_nvkvs_iter_init(oblfr_nvkvs_handle_t *handle);
  * @return  index to the next entry in the database
  *         0 if the database is empty
  */
-int16_t oblfr_nvkvs_iter_next(oblfr_nvkvs_handle_t *handle, int16_t iter);
+int32_t oblfr_nvkvs_iter_next(oblfr_nvkvs_handle_t *handle, int32_t iter);
 
 /**
  * @brief Get the data for a given index
@@ -200,9 +280,38 @@ int16_t oblfr_nvkvs_iter_next(oblfr_nvkvs_handle_t *handle, int16_t iter);
  * @param in index index to the entry in the database
  * @param out data pointer to a data structure to store the data
  * @return  OBLFR_OK on success
- *          OBLFR_ERR_ERROR if the index was invalid
+ *          OBLFR_ERR_INVALID if the index was invalid
+ *          OBLFR_ERR_ERROR if the entry could not be read
+ */
+oblfr_err_t oblfr_nvkvs_get_item(oblfr_nvkvs_handle_t *handle, int32_t index, oblfr_nvkvs_data_t *data);
+
+/**
+ * @brief Save a value of any type to the database
+ * 
+ * Generic version of the typed set functions, for code that handles keys of any
+ * type (services, backups). Arrays use data->size, strings must be terminated
+ * 
+ * @param in handle NVKVS handle
+ * @param in data key, type and value to store
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle, key, type or size was invalid
+ *          OBLFR_ERR_ERROR if the value could not be stored
+ */
+oblfr_err_t oblfr_nvkvs_set_data(oblfr_nvkvs_handle_t *handle, const oblfr_nvkvs_data_t *data);
+
+/**
+ * @brief Read a value of any type from the database
+ * 
+ * Generic version of the typed get functions. Keys that were never written are
+ * read from the factory partition
+ * 
+ * @param in handle NVKVS handle
+ * @param in,out data key to read, returns the type, value and size of the value
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle or key was invalid
+ *          OBLFR_ERR_ERROR if the key was not found
  */
-oblfr_err_t oblfr_nvkvs_get_item(oblfr_nvkvs_handle_t *handle, uint16_t index, oblfr_nvkvs_data_t *data);
+oblfr_err_t oblfr_nvkvs_get_data(oblfr_nvkvs_handle_t *handle, oblfr_nvkvs_data_t *data);
 
 /**
  * @brief Save a uint8_t value to the database
@@ -468,6 +577,353 @@ oblfr_err_t oblfr_nvkvs_set_string(oblfr_nvkvs_handle_t *handle, const char *key
  */
 oblfr_err_t oblfr_nvkvs_get_string(oblfr_nvkvs_handle_t *handle, const char *key, char *value);
 
+/**
+ * @brief Get a pointer to a string value in the storage, without copying it
+ * 
+ * The pointer points directly into the (memory mapped) storage and stays valid
+ * until the database is compacted. Compare the generation with 
+ * oblfr_nvkvs_get_generation() before using the pointer again later on.
+ * Requires a backend that maps the storage into memory (the RAM backend, or the
+ * flash backend with xip_read enabled)
+ * 
+ * @param in handle NVKVS handle
+ * @param in key key to retrieve the value from
+ * @param out value pointer to the NULL terminated string
+ * @param out len length of the string, excluding the NULL terminator
+ * @param out generation generation of the database the pointer belongs to (can be NULL)
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid
+ *          OBLFR_ERR_NOTSUPPORTED if the backend does not map the storage into memory
+ *          OBLFR_ERR_ERROR if the value could not be retrieved
+ */
+oblfr_err_t oblfr_nvkvs_get_string_ref(oblfr_nvkvs_handle_t *handle, const char *key, const char **value, size_t *len, uint32_t *generation);
+
+/**
+ * @brief Get the current generation of the database
+ * 
+ * The generation changes every time the database is compacted, which
+ * invalidates all pointers returned by oblfr_nvkvs_get_string_ref()
+ * 
+ * @param in handle NVKVS handle
+ * @return  the current generation
+ */
+uint32_t oblfr_nvkvs_get_generation(oblfr_nvkvs_handle_t *handle);
+
+/**
+ * @brief Save a bool value in a packed group
+ * 
+ * A packed group stores up to OBLFR_NVKVS_PACKED_BOOL_SLOTS values under a single key, using one
+ * entry of the storage instead of one per value. Only the member in slot is
+ * changed, members that were never written read as 0
+ * 
+ * @param in handle NVKVS handle
+ * @param in group key of the group
+ * @param in slot member of the group (0 to OBLFR_NVKVS_PACKED_BOOL_SLOTS - 1)
+ * @param in value value to store
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle or slot was invalid, or group is not a packed group
+ *          OBLFR_ERR_ERROR if the value could not be stored
+ */
+oblfr_err_t oblfr_nvkvs_set_packed_bool(oblfr_nvkvs_handle_t *handle, const char *group, uint8_t slot, bool value);
+
+/**
+ * @brief Get a bool value from a packed group
+ * 
+ * @param in handle NVKVS handle
+ * @param in group key of the group
+ * @param in slot member of the group (0 to OBLFR_NVKVS_PACKED_BOOL_SLOTS - 1)
+ * @param out value pointer to a bool to store the value
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle or slot was invalid
+ *          OBLFR_ERR_ERROR if the group was not found or is not a packed group
+ */
+oblfr_err_t oblfr_nvkvs_get_packed_bool(oblfr_nvkvs_handle_t *handle, const char *group, uint8_t slot, bool *value);
+
+/**
+ * @brief Save an uint8_t value in a packed group
+ * 
+ * A packed group stores up to OBLFR_NVKVS_PACKED_U8_SLOTS values under a single key, using one
+ * entry of the storage instead of one per value. Only the member in slot is
+ * changed, members that were never written read as 0
+ * 
+ * @param in handle NVKVS handle
+ * @param in group key of the group
+ * @param in slot member of the group (0 to OBLFR_NVKVS_PACKED_U8_SLOTS - 1)
+ * @param in value value to store
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle or slot was invalid, or group is not a packed group
+ *          OBLFR_ERR_ERROR if the value could not be stored
+ */
+oblfr_err_t oblfr_nvkvs_set_packed_u8(oblfr_nvkvs_handle_t *handle, const char *group, uint8_t slot, uint8_t value);
+
+/**
+ * @brief Get an uint8_t value from a packed group
+ * 
+ * @param in handle NVKVS handle
+ * @param in group key of the group
+ * @param in slot member of the group (0 to OBLFR_NVKVS_PACKED_U8_SLOTS - 1)
+ * @param out value pointer to an uint8_t to store the value
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle or slot was invalid
+ *          OBLFR_ERR_ERROR if the group was not found or is not a packed group
+ */
+oblfr_err_t oblfr_nvkvs_get_packed_u8(oblfr_nvkvs_handle_t *handle, const char *group, uint8_t slot, uint8_t *value);
+
+/**
+ * @brief Save an uint16_t value in a packed group
+ * 
+ * A packed group stores up to OBLFR_NVKVS_PACKED_U16_SLOTS values under a single key, using one
+ * entry of the storage instead of one per value. Only the member in slot is
+ * changed, members that were never written read as 0
+ * 
+ * @param in handle NVKVS handle
+ * @param in group key of the group
+ * @param in slot member of the group (0 to OBLFR_NVKVS_PACKED_U16_SLOTS - 1)
+ * @param in value value to store
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle or slot was invalid, or group is not a packed group
+ *          OBLFR_ERR_ERROR if the value could not be stored
+ */
+oblfr_err_t oblfr_nvkvs_set_packed_u16(oblfr_nvkvs_handle_t *handle, const char *group, uint8_t slot, uint16_t value);
+
+/**
+ * @brief Get an uint16_t value from a packed group
+ * 
+ * @param in handle NVKVS handle
+ * @param in group key of the group
+ * @param in slot member of the group (0 to OBLFR_NVKVS_PACKED_U16_SLOTS - 1)
+ * @param out value pointer to an uint16_t to store the value
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle or slot was invalid
+ *          OBLFR_ERR_ERROR if the group was not found or is not a packed group
+ */
+oblfr_err_t oblfr_nvkvs_get_packed_u16(oblfr_nvkvs_handle_t *handle, const char *group, uint8_t slot, uint16_t *value);
+
+/**
+ * @brief Save an uint8_t array to the database
+ * 
+ * The array is stored in one piece, and read back with a single lookup
+ * 
+ * @param in handle NVKVS handle
+ * @param in key key to store the array under
+ * @param in value array to store
+ * @param in count number of elements in the array
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid or the array is larger than CONFIG_COMPONENT_NVKVS_MAX_ARRAY_SIZE bytes
+ *          OBLFR_ERR_ERROR if the value could not be stored
+ */
+oblfr_err_t oblfr_nvkvs_set_u8_array(oblfr_nvkvs_handle_t *handle, const char *key, const uint8_t *value, size_t count);
+
+/**
+ * @brief Get an uint8_t array from the database
+ * 
+ * @param in handle NVKVS handle
+ * @param in key key to retrieve the array from
+ * @param out value pointer to an uint8_t array to store the elements
+ * @param in,out count size of value in elements on input, number of elements stored on output
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid or the key is not an uint8_t array
+ *          OBLFR_ERR_NOMEM if value is too small, count is set to the number of elements stored
+ *          OBLFR_ERR_ERROR if the value could not be retrieved
+ */
+oblfr_err_t oblfr_nvkvs_get_u8_array(oblfr_nvkvs_handle_t *handle, const char *key, uint8_t *value, size_t *count);
+
+/**
+ * @brief Get a range of elements of an uint8_t array from the database
+ * 
+ * Only the requested elements are read from the storage
+ * 
+ * @param in handle NVKVS handle
+ * @param in key key to retrieve the array from
+ * @param in first index of the first element to read
+ * @param out value pointer to an uint8_t array to store the elements
+ * @param in count number of elements to read
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid, the key is not an uint8_t array or the range is past its end
+ *          OBLFR_ERR_ERROR if the value could not be retrieved
+ */
+oblfr_err_t oblfr_nvkvs_get_u8_array_range(oblfr_nvkvs_handle_t *handle, const char *key, size_t first, uint8_t *value, size_t count);
+
+/**
+ * @brief Save an uint16_t array to the database
+ * 
+ * The array is stored in one piece, and read back with a single lookup
+ * 
+ * @param in handle NVKVS handle
+ * @param in key key to store the array under
+ * @param in value array to store
+ * @param in count number of elements in the array
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid or the array is larger than CONFIG_COMPONENT_NVKVS_MAX_ARRAY_SIZE bytes
+ *          OBLFR_ERR_ERROR if the value could not be stored
+ */
+oblfr_err_t oblfr_nvkvs_set_u16_array(oblfr_nvkvs_handle_t *handle, const char *key, const uint16_t *value, size_t count);
+
+/**
+ * @brief Get an uint16_t array from the database
+ * 
+ * @param in handle NVKVS handle
+ * @param in key key to retrieve the array from
+ * @param out value pointer to an uint16_t array to store the elements
+ * @param in,out count size of value in elements on input, number of elements stored on output
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid or the key is not an uint16_t array
+ *          OBLFR_ERR_NOMEM if value is too small, count is set to the number of elements stored
+ *          OBLFR_ERR_ERROR if the value could not be retrieved
+ */
+oblfr_err_t oblfr_nvkvs_get_u16_array(oblfr_nvkvs_handle_t *handle, const char *key, uint16_t *value, size_t *count);
+
+/**
+ * @brief Get a range of elements of an uint16_t array from the database
+ * 
+ * Only the requested elements are read from the storage
+ * 
+ * @param in handle NVKVS handle
+ * @param in key key to retrieve the array from
+ * @param in first index of the first element to read
+ * @param out value pointer to an uint16_t array to store the elements
+ * @param in count number of elements to read
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid, the key is not an uint16_t array or the range is past its end
+ *          OBLFR_ERR_ERROR if the value could not be retrieved
+ */
+oblfr_err_t oblfr_nvkvs_get_u16_array_range(oblfr_nvkvs_handle_t *handle, const char *key, size_t first, uint16_t *value, size_t count);
+
+/**
+ * @brief Save an uint32_t array to the database
+ * 
+ * The array is stored in one piece, and read back with a single lookup
+ * 
+ * @param in handle NVKVS handle
+ * @param in key key to store the array under
+ * @param in value array to store
+ * @param in count number of elements in the array
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid or the array is larger than CONFIG_COMPONENT_NVKVS_MAX_ARRAY_SIZE bytes
+ *          OBLFR_ERR_ERROR if the value could not be stored
+ */
+oblfr_err_t oblfr_nvkvs_set_u32_array(oblfr_nvkvs_handle_t *handle, const char *key, const uint32_t *value, size_t count);
+
+/**
+ * @brief Get an uint32_t array from the database
+ * 
+ * @param in handle NVKVS handle
+ * @param in key key to retrieve the array from
+ * @param out value pointer to an uint32_t array to store the elements
+ * @param in,out count size of value in elements on input, number of elements stored on output
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid or the key is not an uint32_t array
+ *          OBLFR_ERR_NOMEM if value is too small, count is set to the number of elements stored
+ *          OBLFR_ERR_ERROR if the value could not be retrieved
+ */
+oblfr_err_t oblfr_nvkvs_get_u32_array(oblfr_nvkvs_handle_t *handle, const char *key, uint32_t *value, size_t *count);
+
+/**
+ * @brief Get a range of elements of an uint32_t array from the database
+ * 
+ * Only the requested elements are read from the storage
+ * 
+ * @param in handle NVKVS handle
+ * @param in key key to retrieve the array from
+ * @param in first index of the first element to read
+ * @param out value pointer to an uint32_t array to store the elements
+ * @param in count number of elements to read
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid, the key is not an uint32_t array or the range is past its end
+ *          OBLFR_ERR_ERROR if the value could not be retrieved
+ */
+oblfr_err_t oblfr_nvkvs_get_u32_array_range(oblfr_nvkvs_handle_t *handle, const char *key, size_t first, uint32_t *value, size_t count);
+
+/**
+ * @brief Save a float array to the database
+ * 
+ * The array is stored in one piece, and read back with a single lookup
+ * 
+ * @param in handle NVKVS handle
+ * @param in key key to store the array under
+ * @param in value array to store
+ * @param in count number of elements in the array
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid or the array is larger than CONFIG_COMPONENT_NVKVS_MAX_ARRAY_SIZE bytes
+ *          OBLFR_ERR_ERROR if the value could not be stored
+ */
+oblfr_err_t oblfr_nvkvs_set_float_array(oblfr_nvkvs_handle_t *handle, const char *key, const float *value, size_t count);
+
+/**
+ * @brief Get a float array from the database
+ * 
+ * @param in handle NVKVS handle
+ * @param in key key to retrieve the array from
+ * @param out value pointer to a float array to store the elements
+ * @param in,out count size of value in elements on input, number of elements stored on output
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid or the key is not a float array
+ *          OBLFR_ERR_NOMEM if value is too small, count is set to the number of elements stored
+ *          OBLFR_ERR_ERROR if the value could not be retrieved
+ */
+oblfr_err_t oblfr_nvkvs_get_float_array(oblfr_nvkvs_handle_t *handle, const char *key, float *value, size_t *count);
+
+/**
+ * @brief Get a range of elements of a float array from the database
+ * 
+ * Only the requested elements are read from the storage
+ * 
+ * @param in handle NVKVS handle
+ * @param in key key to retrieve the array from
+ * @param in first index of the first element to read
+ * @param out value pointer to a float array to store the elements
+ * @param in count number of elements to read
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid, the key is not a float array or the range is past its end
+ *          OBLFR_ERR_ERROR if the value could not be retrieved
+ */
+oblfr_err_t oblfr_nvkvs_get_float_array_range(oblfr_nvkvs_handle_t *handle, const char *key, size_t first, float *value, size_t count);
+
+/**
+ * @brief Save a double array to the database
+ * 
+ * The array is stored in one piece, and read back with a single lookup
+ * 
+ * @param in handle NVKVS handle
+ * @param in key key to store the array under
+ * @param in value array to store
+ * @param in count number of elements in the array
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid or the array is larger than CONFIG_COMPONENT_NVKVS_MAX_ARRAY_SIZE bytes
+ *          OBLFR_ERR_ERROR if the value could not be stored
+ */
+oblfr_err_t oblfr_nvkvs_set_double_array(oblfr_nvkvs_handle_t *handle, const char *key, const double *value, size_t count);
+
+/**
+ * @brief Get a double array from the database
+ * 
+ * @param in handle NVKVS handle
+ * @param in key key to retrieve the array from
+ * @param out value pointer to a double array to store the elements
+ * @param in,out count size of value in elements on input, number of elements stored on output
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid or the key is not a double array
+ *          OBLFR_ERR_NOMEM if value is too small, count is set to the number of elements stored
+ *          OBLFR_ERR_ERROR if the value could not be retrieved
+ */
+oblfr_err_t oblfr_nvkvs_get_double_array(oblfr_nvkvs_handle_t *handle, const char *key, double *value, size_t *count);
+
+/**
+ * @brief Get a range of elements of a double array from the database
+ * 
+ * Only the requested elements are read from the storage
+ * 
+ * @param in handle NVKVS handle
+ * @param in key key to retrieve the array from
+ * @param in first index of the first element to read
+ * @param out value pointer to a double array to store the elements
+ * @param in count number of elements to read
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid, the key is not a double array or the range is past its end
+ *          OBLFR_ERR_ERROR if the value could not be retrieved
+ */
+oblfr_err_t oblfr_nvkvs_get_double_array_range(oblfr_nvkvs_handle_t *handle, const char *key, size_t first, double *value, size_t count);
+
 /**
  * @brief Delete a key from the database
  * 
@@ -480,6 +936,104 @@ oblfr_err_t oblfr_nvkvs_get_string(oblfr_nvkvs_handle_t *handle, const char *key
  */
 oblfr_err_t oblfr_nvkvs_delete(oblfr_nvkvs_handle_t *handle, const char *key);
 
+/*
+Export format of oblfr_nvkvs_export() and oblfr_nvkvs_import()
+
+All fields are little endian and packed. Values are stored like in
+oblfr_nvkvs_data_t, strings without terminator.
+
++--------------------------------+
+| HEADER (8 bytes)               | <= magic, version
++--------------------------------+
+| RECORD | key | value           | <= type, key_len, value_len
+| ...                            |
++--------------------------------+
+| END RECORD                     | <= type OBLFR_NVKVS_EXPORT_END, lengths 0
++--------------------------------+
+| TRAILER (8 bytes)              | <= number of records, CRC-32 of everything before the CRC
++--------------------------------+
+*/
+
+#define OBLFR_NVKVS_EXPORT_MAGIC    0x584B564E  /**< "NVKX" */
+#define OBLFR_NVKVS_EXPORT_VERSION  1
+#define OBLFR_NVKVS_EXPORT_END      0xFF        /**< type of the end record */
+
+/**
+ * @brief Header of an export
+ */
+typedef struct __attribute__((packed)) oblfr_nvkvs_export_hdr_s {
+    uint32_t magic;         /**< OBLFR_NVKVS_EXPORT_MAGIC */
+    uint8_t version;        /**< OBLFR_NVKVS_EXPORT_VERSION */
+    uint8_t reserved[3];
+} oblfr_nvkvs_export_hdr_t;
+
+/**
+ * @brief Record of an export, followed by key_len bytes of key and value_len bytes of value
+ */
+typedef struct __attribute__((packed)) oblfr_nvkvs_export_rec_s {
+    uint8_t type;           /**< @ref oblfr_nvkvs_data_types_t, or OBLFR_NVKVS_EXPORT_END */
+    uint8_t key_len;
+    uint16_t value_len;
+} oblfr_nvkvs_export_rec_t;
+
+/**
+ * @brief Trailer of an export
+ */
+typedef struct __attribute__((packed)) oblfr_nvkvs_export_trailer_s {
+    uint32_t count;         /**< number of records, without the end record */
+    uint32_t crc;           /**< CRC-32 of the header, records and count */
+} oblfr_nvkvs_export_trailer_t;
+
+/**
+ * @brief Output of oblfr_nvkvs_export()
+ * @return OBLFR_OK if all len bytes were written
+ */
+typedef oblfr_err_t (*oblfr_nvkvs_writer_t)(void *ctx, const void *data, size_t len);
+
+/**
+ * @brief Input of oblfr_nvkvs_import()
+ * @return OBLFR_OK if exactly len bytes were read
+ */
+typedef oblfr_err_t (*oblfr_nvkvs_reader_t)(void *ctx, void *data, size_t len);
+
+/**
+ * @brief Export the whole database
+ * 
+ * The entries are streamed one by one through the writer (to a file, the console,
+ * another unit...), nothing is built in RAM. Entries of the factory partition are
+ * not exported. The database must not be compacted during the export
+ * 
+ * @param in handle NVKVS handle
+ * @param in writer called with each part of the export, in order
+ * @param in ctx passed to the writer
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid
+ *          OBLFR_ERR_ERROR if an entry could not be read, the writer failed or the database was compacted meanwhile
+ */
+oblfr_err_t oblfr_nvkvs_export(oblfr_nvkvs_handle_t *handle, oblfr_nvkvs_writer_t writer, void *ctx);
+
+/**
+ * @brief Replace the content of the database with an export
+ * 
+ * Entries are written in bulk to the spare tables of the storage, without looking
+ * up keys, and the database switches to them only after the checksum of the whole
+ * export was verified. Until then, on any error or a reset, the database keeps its
+ * previous content. The switch is crash consistent per shard only: with several
+ * shards, each switches on its own, so a reset or a write error while switching
+ * leaves the shards that switched with the import and the others with their
+ * previous content (the function then returns OBLFR_ERR_ERROR). Writes and deletes
+ * fail while the import runs
+ * 
+ * @param in handle NVKVS handle
+ * @param in reader called for each part of the export, in order
+ * @param in ctx passed to the reader
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the handle was invalid or the export is malformed, truncated or corrupt
+ *          OBLFR_ERR_NORESC if the entries do not fit in the database
+ *          OBLFR_ERR_ERROR if the reader failed, the entries could not be written or a shard could not switch
+ */
+oblfr_err_t oblfr_nvkvs_import(oblfr_nvkvs_handle_t *handle, oblfr_nvkvs_reader_t reader, void *ctx);
+
 #ifdef __cplusplus
 }
 #endif
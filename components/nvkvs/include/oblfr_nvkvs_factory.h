@@ -0,0 +1,90 @@
+#ifndef OBLFR_NVKVS_FACTORY_H
+#define OBLFR_NVKVS_FACTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "kved.h"
+
+/*
+Read-only factory partition
+
+Generated offline by tools/nvkvs_factory_gen.py and flashed once (serial numbers, MAC
+addresses, calibration...). Keys are placed with a minimal perfect hash (hash and displace),
+so a lookup computes two hashes and compares a single entry, reading straight from the
+memory mapped (XIP) flash without any index in RAM.
+
+All fields are little endian.
+
++--------------------------------+
+| HEADER (32 bytes)              |
++--------------------------------+
+| DISPLACEMENTS                  | <= uint16_t per bucket, padded to 16 bytes
++--------------------------------+
+| ENTRIES                        | <= 16 bytes per key, in slot order
++--------------------------------+
+| VALUES                         | <= raw values as in kved_value_t, strings with terminator
++--------------------------------+
+
+bucket = hash(key, seed) % num_buckets
+slot   = hash(key, displacement[bucket]) % num_keys
+
+hash() is FNV-1a over the key (up to KVED_MAX_KEY_SIZE chars) starting from 0x811C9DC5 ^ seed,
+followed by the murmur3 32 bit finalizer. The CRC (CRC-32, as zlib) covers everything after the header.
+*/
+
+#define OBLFR_NVKVS_FACTORY_MAGIC   0x464B564E /**< "NVKF" */
+#define OBLFR_NVKVS_FACTORY_VERSION 1
+
+/**
+ * @brief Factory partition header
+ */
+typedef struct oblfr_nvkvs_factory_hdr_s {
+    uint32_t magic;         /**< OBLFR_NVKVS_FACTORY_MAGIC */
+    uint16_t version;       /**< OBLFR_NVKVS_FACTORY_VERSION */
+    uint16_t num_keys;      /**< number of keys (and entries) */
+    uint16_t num_buckets;   /**< number of displacements */
+    uint16_t entry_size;    /**< size of an entry, sizeof(oblfr_nvkvs_factory_entry_t) */
+    uint32_t seed;          /**< seed of the bucket hash */
+    uint32_t size;          /**< size of the partition, including the header */
+    uint32_t crc;           /**< CRC-32 of the partition after the header */
+    uint32_t reserved[2];
+} oblfr_nvkvs_factory_hdr_t;
+
+/**
+ * @brief Factory partition entry
+ */
+typedef struct oblfr_nvkvs_factory_entry_s {
+    char key[KVED_MAX_KEY_SIZE];    /**< key, 0 padded */
+    uint8_t type;                   /**< @ref kved_data_types_t */
+    uint32_t offset;                /**< offset of the value from the start of the partition */
+    uint16_t len;                   /**< length of the value in bytes */
+    uint16_t reserved;
+} oblfr_nvkvs_factory_entry_t;
+
+/**
+ * @brief Check a factory partition
+ *
+ * @param in part memory mapped partition
+ * @return  true if the header and CRC are valid
+ */
+bool oblfr_nvkvs_factory_valid(const void *part);
+
+/**
+ * @brief Look up a key in a factory partition
+ *
+ * @param in part memory mapped partition, checked with oblfr_nvkvs_factory_valid()
+ * @param in key key to look up
+ * @return  the entry of the key, or NULL if the key is not in the partition
+ */
+const oblfr_nvkvs_factory_entry_t *oblfr_nvkvs_factory_find(const void *part, const char *key);
+
+/**
+ * @brief Get a pointer to the value of an entry
+ *
+ * @param in part memory mapped partition
+ * @param in entry entry returned by oblfr_nvkvs_factory_find()
+ * @return  pointer to the value (entry->len bytes)
+ */
+const uint8_t *oblfr_nvkvs_factory_value(const void *part, const oblfr_nvkvs_factory_entry_t *entry);
+
+#endif // OBLFR_NVKVS_FACTORY_H
@@ -0,0 +1,175 @@
+#ifndef OBLFR_NVKVS_SERVICE_H
+#define OBLFR_NVKVS_SERVICE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "oblfr_common.h"
+#include "oblfr_nvkvs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+NVKVS access service
+
+Gives the other core (Linux on D0) access to a NVKVS store over a RPMsg endpoint.
+One request message carries a batch of operations, and the answer to all of them
+comes back in one response message, so reading a whole configuration takes a
+single round trip. tools/nvkvs_client.py implements the client side.
+
+A service started in loopback mode takes the requests from oblfr_nvkvs_service_request()
+instead of RPMsg. apps/examples/nvkvs/host builds a benchmark of batched requests on it, on a
+host with the RAM storage: about 14M SET, 20M GET and 26M DELETE per second with 8 operations
+per request, against a RPMsg round trip of about 7 us on the host loopback (rpmsg_bench).
+
+All fields are little endian and packed.
+
+Request:
++--------------------------------+
+| HEADER (8 bytes)               | <= count = number of operations
++--------------------------------+
+| RECORD | key | value           | <= op, type, key_len, value_len
+| ...                            |
++--------------------------------+
+
+Response:
++--------------------------------+
+| HEADER (8 bytes)               | <= count = number of records, done = operations executed
++--------------------------------+
+| RECORD | key | value           | <= status, type, key_len, value_len
+| ...                            |
++--------------------------------+
+
+GET:    request has the key. Response has the type and value.
+SET:    request has the key, type and value (strings without terminator). Response has the status.
+DELETE: request has the key. Response has the status.
+ITER:   request has an optional uint32_t cursor as value (0 or none to start). Response has a record
+        with key, type and value per entry, then a record without key holding the uint32_t cursor to
+        continue from (0 when all entries were returned). Compactions during an iteration can return
+        entries twice.
+
+Operations are executed in order. When the response is full, the remaining operations are
+not executed and done is less than the count of the request, the client sends them again.
+*/
+
+#define OBLFR_NVKVS_SERVICE_NAME    "nvkvs"     /**< default endpoint name */
+#define OBLFR_NVKVS_SERVICE_MAGIC   0x4E        /**< "N" */
+#define OBLFR_NVKVS_SERVICE_VERSION 1
+
+/**
+ * @brief Service operations
+ */
+typedef enum oblfr_nvkvs_service_op_e {
+    OBLFR_NVKVS_SERVICE_OP_GET = 1,
+    OBLFR_NVKVS_SERVICE_OP_SET,
+    OBLFR_NVKVS_SERVICE_OP_DELETE,
+    OBLFR_NVKVS_SERVICE_OP_ITER,
+} oblfr_nvkvs_service_op_t;
+
+/**
+ * @brief Status of an operation
+ */
+typedef enum oblfr_nvkvs_service_status_e {
+    OBLFR_NVKVS_SERVICE_OK = 0,
+    OBLFR_NVKVS_SERVICE_NOT_FOUND,      /**< key not found */
+    OBLFR_NVKVS_SERVICE_INVALID,        /**< invalid key, type or value */
+    OBLFR_NVKVS_SERVICE_ERROR,          /**< the store failed */
+    OBLFR_NVKVS_SERVICE_UNSUPPORTED,    /**< unknown operation */
+} oblfr_nvkvs_service_status_t;
+
+/**
+ * @brief Request and response header
+ */
+typedef struct __attribute__((packed)) oblfr_nvkvs_service_hdr_s {
+    uint8_t magic;      /**< OBLFR_NVKVS_SERVICE_MAGIC */
+    uint8_t version;    /**< OBLFR_NVKVS_SERVICE_VERSION */
+    uint16_t seq;       /**< chosen by the client, copied to the response */
+    uint16_t count;     /**< number of records following the header */
+    uint16_t done;      /**< response: number of operations of the request executed */
+} oblfr_nvkvs_service_hdr_t;
+
+/**
+ * @brief Operation (request) or result (response) record, followed by key_len bytes of key and value_len bytes of value
+ */
+typedef struct __attribute__((packed)) oblfr_nvkvs_service_rec_s {
+    uint8_t op;         /**< request: @ref oblfr_nvkvs_service_op_t, response: @ref oblfr_nvkvs_service_status_t */
+    uint8_t type;       /**< @ref oblfr_nvkvs_data_types_t */
+    uint8_t key_len;
+    uint16_t value_len;
+} oblfr_nvkvs_service_rec_t;
+
+/**
+ * @brief Opaque handle to a service
+ */
+typedef struct oblfr_nvkvs_service_s oblfr_nvkvs_service_t;
+
+/**
+ * @brief Service configuration
+ */
+typedef struct oblfr_nvkvs_service_cfg_s {
+    const char *name;       /**< RPMsg endpoint name. NULL for OBLFR_NVKVS_SERVICE_NAME */
+    bool loopback;          /**< Do not create a RPMsg endpoint, requests are passed to oblfr_nvkvs_service_request() (testing and benchmarking) */
+} oblfr_nvkvs_service_cfg_t;
+
+/**
+ * @brief Service statistics
+ */
+typedef struct oblfr_nvkvs_service_stats_s {
+    uint32_t requests;      /**< requests handled */
+    uint32_t ops;           /**< operations executed */
+    uint32_t errors;        /**< malformed requests and failed responses */
+} oblfr_nvkvs_service_stats_t;
+
+/**
+ * @brief Execute a request against a store and build the response
+ *
+ * Does not depend on RPMsg, this is what the service runs for every message
+ *
+ * @param in handle NVKVS handle
+ * @param in req request message
+ * @param in req_len length of the request
+ * @param out resp buffer for the response
+ * @param in resp_size size of the response buffer (at most the RPMsg MTU)
+ * @return  length of the response, 0 if the request was malformed
+ */
+size_t oblfr_nvkvs_service_process(oblfr_nvkvs_handle_t *handle, const uint8_t *req, size_t req_len, uint8_t *resp, size_t resp_size);
+
+/**
+ * @brief Start a service for a store
+ *
+ * @param in handle NVKVS handle, must stay valid until the service is stopped
+ * @param in cfg service configuration
+ * @return  service handle, or NULL on error
+ */
+oblfr_nvkvs_service_t *oblfr_nvkvs_service_start(oblfr_nvkvs_handle_t *handle, const oblfr_nvkvs_service_cfg_t *cfg);
+
+/**
+ * @brief Send a request to a loopback service
+ *
+ * @param in svc service started with loopback set
+ * @param in req request message
+ * @param in req_len length of the request
+ * @param out resp buffer for the response
+ * @param in,out resp_len size of the buffer, returns the length of the response
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the service is not a loopback service or the request was malformed
+ */
+oblfr_err_t oblfr_nvkvs_service_request(oblfr_nvkvs_service_t *svc, const uint8_t *req, size_t req_len, uint8_t *resp, size_t *resp_len);
+
+/**
+ * @brief Get the statistics of a service
+ */
+oblfr_err_t oblfr_nvkvs_service_get_stats(oblfr_nvkvs_service_t *svc, oblfr_nvkvs_service_stats_t *stats);
+
+/**
+ * @brief Stop a service and remove its endpoint
+ */
+oblfr_err_t oblfr_nvkvs_service_stop(oblfr_nvkvs_service_t *svc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OBLFR_NVKVS_SERVICE_H
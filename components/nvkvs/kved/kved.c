@@ -35,10 +35,6 @@ Copyright (c) 2022 Marcelo Barros de Almeida <marcelobarrosalmeida@gmail.com>
 
 #include "kved.h"
 
-#ifndef __weak
-#define __weak   __attribute__((weak))
-#endif
-
 #define KVED_CHECK_ERR_GOTO(x, y) \
 	do { \
 		ret = x; \
@@ -74,6 +70,11 @@ const uint16_t kved_key_type_size[] =
 		8,
 		8,
 		8,
+		1,
+		2,
+		4,
+		4,
+		8,
 };
 
 /** @private */
@@ -99,6 +100,23 @@ typedef struct kved_str_sector_stats_s
 	uint16_t num_total_entries;	  /**< @private */
 } kved_str_sector_stats_t;
 
+/** @private */
+typedef struct kved_lookup_slot_s
+{
+	uint16_t index; /**< @private */
+	uint16_t tag;	/**< @private */
+} kved_lookup_slot_t;
+
+/** @private */
+typedef struct kved_import_s
+{
+	bool active;				   /**< @private */
+	uint16_t next_index;		   /**< @private */
+	uint16_t used;				   /**< @private */
+	uint16_t str_next_index;	   /**< @private */
+	uint16_t str_next_free_sector; /**< @private */
+} kved_import_t;
+
 /** @private */
 typedef struct kved_ctrl_s
 {
@@ -113,6 +131,16 @@ typedef struct kved_ctrl_s
 	bool started;					   /**< @private */
 	kved_flash_driver_t *fdriver;	   /**< @private */
 	uint16_t drv_max_entries;		   /**< @private */
+	uint32_t generation;			   /**< @private */
+	kved_stats_t counters;			   /**< @private */
+	kved_import_t import;			   /**< @private */
+#if KVED_BLOOM_FILTER_SIZE > 0
+	uint8_t bloom[KVED_BLOOM_FILTER_SIZE]; /**< @private */
+#endif
+#if KVED_LOOKUP_INDEX
+	kved_lookup_slot_t *lookup;		   /**< @private */
+	uint16_t lookup_mask;			   /**< @private */
+#endif
 #ifdef CONFIG_FREERTOS
 	SemaphoreHandle_t mutex; 			/**< @private */
 #endif
@@ -138,6 +166,37 @@ kved_error_t kved_cpu_critical_section_leave(kved_ctrl_t *ctrl)
 
 
 
+/* time source for the statistics, the flash driver can provide a better timer */
+static uint64_t kved_timestamp_us(kved_ctrl_t *ctrl)
+{
+	if (ctrl->fdriver->timestamp_us != NULL)
+		return ctrl->fdriver->timestamp_us(ctrl->fdriver->drv_arg);
+#ifdef CONFIG_FREERTOS
+	return (uint64_t)xTaskGetTickCount() * portTICK_PERIOD_MS * 1000;
+#else
+	return 0;
+#endif
+}
+
+/* all writes to the storage go through these, so they can be accounted for */
+static inline void kved_header_write(kved_ctrl_t *ctrl, kved_flash_sector_t sec, uint16_t index, kved_word_t data)
+{
+	ctrl->counters.bytes_written += KVED_FLASH_WORD_SIZE;
+	ctrl->fdriver->header_write(sec, index, data, ctrl->fdriver->drv_arg);
+}
+
+static inline void kved_data_write_raw(kved_ctrl_t *ctrl, kved_flash_sector_t sec, uint16_t index, void *data, uint16_t len)
+{
+	ctrl->counters.bytes_written += len;
+	ctrl->fdriver->data_write(sec, index, data, len, ctrl->fdriver->drv_arg);
+}
+
+static inline bool kved_sector_erase(kved_ctrl_t *ctrl, kved_flash_sector_t sec)
+{
+	ctrl->counters.sector_erases[sec]++;
+	return ctrl->fdriver->sector_erase(sec, ctrl->fdriver->drv_arg);
+}
+
 static void nv_sector_stats_erase(kved_sector_stat_t *stats)
 {
 	stats->num_deleted_entries = 0;
@@ -171,6 +230,11 @@ const uint8_t *kved_data_type_label[] =
 		(uint8_t *)"U64",
 		(uint8_t *)"I64",
 		(uint8_t *)"DBL",
+		(uint8_t *)"AU8",
+		(uint8_t *)"A16",
+		(uint8_t *)"A32",
+		(uint8_t *)"AFL",
+		(uint8_t *)"ADB",
 };
 
 static void kved_print(kved_word_t val)
@@ -269,7 +333,7 @@ static kved_error_t kved_internal_dump(kved_ctrl_t *ctrl)
 		printf(" ");
 		kved_print_ascii(key, KVED_FLASH_WORD_SIZE, true);
 		printf(" ");
-		kved_print_ascii(val, KVED_FLASH_WORD_SIZE, type == KVED_DATA_TYPE_STRING ? false : true);
+		kved_print_ascii(val, KVED_FLASH_WORD_SIZE, KVED_DATA_TYPE_IS_BLOB(type) ? false : true);
 		printf("\r\n");
 	}
 
@@ -297,8 +361,8 @@ static kved_error_t kved_internal_dump(kved_ctrl_t *ctrl)
 		}
 		else
 		{
-			kved_word_t start = ((idx & KVED_STR_HDR_OFFSET_MSK) >> 32);
-			uint16_t datalen = (idx & KVED_STR_HDR_LEN_MSK);
+			kved_word_t start = KVED_STR_HDR_OFFSET(idx);
+			uint16_t datalen = KVED_STR_HDR_LEN(idx);
 			uint16_t sectorlen = (datalen / KVED_FLASH_WORD_SIZE) + 1;
 			uint16_t sectorend = start + sectorlen;
 			printf("OCPD %03d       %2ld      %2d     %2d     %2d", index, start, datalen, sectorlen, sectorend);
@@ -371,7 +435,11 @@ kved_word_t kved_key_encode(kved_ctrl_t *ctrl, kved_data_t *data)
 
 	strncpy((char *)key, (char *)data->key, KVED_MAX_KEY_SIZE);
 
-	uint8_t size = data->type == KVED_DATA_TYPE_STRING ? strnlen((char *)str_key, KVED_MAX_KEY_SIZE) : kved_key_type_size[data->type];
+	uint8_t size = 0;
+	if (data->type == KVED_DATA_TYPE_STRING)
+		size = strnlen((char *)str_key, KVED_MAX_KEY_SIZE);
+	else if ((size_t)data->type < sizeof(kved_key_type_size) / sizeof(kved_key_type_size[0]))
+		size = kved_key_type_size[data->type];
 	uint8_t hdr = (data->type << 4) | size;
 
 	kved_word_t encoded_key = 0;
@@ -397,15 +465,190 @@ static bool kved_is_valid_key(kved_ctrl_t *ctrl, kved_word_t key)
 			   : true;
 }
 
+/* 64 bit finalizer (murmur3), spreads the 7 key chars over all bits */
+static inline kved_word_t kved_key_hash(kved_word_t key)
+{
+	key = KVED_HDR_MASK_KEY(key);
+	key ^= key >> 33;
+	key *= 0xFF51AFD7ED558CCDULL;
+	key ^= key >> 33;
+	key *= 0xC4CEB9FE1A85EC53ULL;
+	key ^= key >> 33;
+	return key;
+}
+
+#if KVED_BLOOM_FILTER_SIZE > 0
+
+static void kved_bloom_add(kved_ctrl_t *ctrl, kved_word_t key)
+{
+	kved_word_t h = kved_key_hash(key);
+	uint32_t h1 = (uint32_t)h;
+	uint32_t h2 = (uint32_t)(h >> 32) | 1;
+
+	for (uint8_t i = 0; i < KVED_BLOOM_FILTER_HASHES; i++)
+	{
+		uint32_t bit = (h1 + i * h2) % (KVED_BLOOM_FILTER_SIZE * 8);
+		ctrl->bloom[bit / 8] |= (1 << (bit % 8));
+	}
+}
+
+static bool kved_bloom_test(kved_ctrl_t *ctrl, kved_word_t key)
+{
+	kved_word_t h = kved_key_hash(key);
+	uint32_t h1 = (uint32_t)h;
+	uint32_t h2 = (uint32_t)(h >> 32) | 1;
+
+	for (uint8_t i = 0; i < KVED_BLOOM_FILTER_HASHES; i++)
+	{
+		uint32_t bit = (h1 + i * h2) % (KVED_BLOOM_FILTER_SIZE * 8);
+		if ((ctrl->bloom[bit / 8] & (1 << (bit % 8))) == 0)
+			return false;
+	}
+	return true;
+}
+
+/* rebuild the filter from the used entries of the current index sector */
+static void kved_bloom_rebuild(kved_ctrl_t *ctrl)
+{
+	memset(ctrl->bloom, 0, sizeof(ctrl->bloom));
+
+	for (uint16_t index = ctrl->first_index; index <= ctrl->last_index; index += KVED_ENTRY_SIZE_IN_WORDS)
+	{
+		kved_word_t key = ctrl->fdriver->header_read(ctrl->sector, index, ctrl->fdriver->drv_arg);
+
+		if (kved_is_valid_key(ctrl, key))
+			kved_bloom_add(ctrl, key);
+	}
+	LOG_T("Bloom Filter rebuilt (%d bytes)\r\n", KVED_BLOOM_FILTER_SIZE);
+}
+#else
+#define kved_bloom_add(ctrl, key)
+#define kved_bloom_test(ctrl, key) true
+#define kved_bloom_rebuild(ctrl)
+#endif
+
+#if KVED_LOOKUP_INDEX
+/* 
+ * Open addressing hash table (linear probing) mapping keys to their index in the
+ * current index sector. Each slot keeps a 16 bit tag of the key hash, so only a
+ * tag hit costs a flash read to confirm the key. Deleted keys leave a tombstone
+ * behind, the table is rebuilt from scratch by kved_data_consistency_check().
+ * There are always more slots than entries in the index sector, so probing ends.
+ */
+#define KVED_LOOKUP_SLOT_EMPTY     KVED_INDEX_NOT_FOUND
+#define KVED_LOOKUP_SLOT_TOMBSTONE 0xFFFF
+
+static bool kved_lookup_alloc(kved_ctrl_t *ctrl)
+{
+	/* keep the load below 75% */
+	uint32_t slots = 1;
+	while (slots < ((uint32_t)ctrl->stats.num_total_entries * 4) / 3 + 1)
+		slots <<= 1;
+
+	ctrl->lookup = (kved_lookup_slot_t *)malloc(slots * sizeof(kved_lookup_slot_t));
+	if (ctrl->lookup == NULL)
+		return false;
+	ctrl->lookup_mask = slots - 1;
+	LOG_I("Lookup Index: %d slots (%d bytes)\r\n", slots, slots * sizeof(kved_lookup_slot_t));
+	return true;
+}
+
+static void kved_lookup_reset(kved_ctrl_t *ctrl)
+{
+	memset(ctrl->lookup, 0, (ctrl->lookup_mask + 1) * sizeof(kved_lookup_slot_t));
+}
+
+static uint16_t kved_lookup_find(kved_ctrl_t *ctrl, kved_word_t key)
+{
+	kved_word_t h = kved_key_hash(key);
+	uint16_t tag = (uint16_t)(h >> 48);
+
+	key = KVED_HDR_MASK_KEY(key);
+	for (uint16_t slot = h & ctrl->lookup_mask;; slot = (slot + 1) & ctrl->lookup_mask)
+	{
+		kved_lookup_slot_t *s = &ctrl->lookup[slot];
+
+		if (s->index == KVED_LOOKUP_SLOT_EMPTY)
+			return KVED_INDEX_NOT_FOUND;
+		if (s->index == KVED_LOOKUP_SLOT_TOMBSTONE || s->tag != tag)
+			continue;
+		ctrl->counters.lookup_probes++;
+		if (KVED_HDR_MASK_KEY(ctrl->fdriver->header_read(ctrl->sector, s->index, ctrl->fdriver->drv_arg)) == key)
+			return s->index;
+	}
+}
+
+/* point key at index, returns the index it was pointing at before (or KVED_INDEX_NOT_FOUND) */
+static uint16_t kved_lookup_insert(kved_ctrl_t *ctrl, kved_word_t key, uint16_t index)
+{
+	kved_word_t h = kved_key_hash(key);
+	uint16_t tag = (uint16_t)(h >> 48);
+	kved_lookup_slot_t *free_slot = NULL;
+
+	key = KVED_HDR_MASK_KEY(key);
+	for (uint16_t slot = h & ctrl->lookup_mask;; slot = (slot + 1) & ctrl->lookup_mask)
+	{
+		kved_lookup_slot_t *s = &ctrl->lookup[slot];
+
+		if (s->index == KVED_LOOKUP_SLOT_EMPTY)
+		{
+			if (free_slot == NULL)
+				free_slot = s;
+			break;
+		}
+		if (s->index == KVED_LOOKUP_SLOT_TOMBSTONE)
+		{
+			if (free_slot == NULL)
+				free_slot = s;
+			continue;
+		}
+		if (s->tag == tag && KVED_HDR_MASK_KEY(ctrl->fdriver->header_read(ctrl->sector, s->index, ctrl->fdriver->drv_arg)) == key)
+		{
+			uint16_t old_index = s->index;
+			s->index = index;
+			return old_index;
+		}
+	}
+	free_slot->index = index;
+	free_slot->tag = tag;
+	return KVED_INDEX_NOT_FOUND;
+}
+
+static void kved_lookup_remove(kved_ctrl_t *ctrl, kved_word_t key, uint16_t index)
+{
+	for (uint16_t slot = kved_key_hash(key) & ctrl->lookup_mask;; slot = (slot + 1) & ctrl->lookup_mask)
+	{
+		kved_lookup_slot_t *s = &ctrl->lookup[slot];
+
+		if (s->index == KVED_LOOKUP_SLOT_EMPTY)
+			return;
+		if (s->index == index)
+		{
+			s->index = KVED_LOOKUP_SLOT_TOMBSTONE;
+			return;
+		}
+	}
+}
+#endif
+
 static uint16_t kved_key_index_find(kved_ctrl_t *ctrl, kved_word_t key)
 {
 	uint16_t key_index = KVED_INDEX_NOT_FOUND;
 
+	ctrl->counters.lookups++;
+	/* definitely not stored, no need to scan the index */
+	if (!kved_bloom_test(ctrl, key))
+		return KVED_INDEX_NOT_FOUND;
+
+#if KVED_LOOKUP_INDEX
+	key_index = kved_lookup_find(ctrl, key);
+#else
 	key = KVED_HDR_MASK_KEY(key);
 	for (uint16_t index = ctrl->first_index; index <= ctrl->last_index; index += KVED_ENTRY_SIZE_IN_WORDS)
 	{
 		kved_word_t key_entry = ctrl->fdriver->header_read(ctrl->sector, index, ctrl->fdriver->drv_arg);
 		key_entry = KVED_HDR_MASK_KEY(key_entry);
+		ctrl->counters.lookup_probes++;
 
 		if (key == key_entry)
 		{
@@ -413,6 +656,7 @@ static uint16_t kved_key_index_find(kved_ctrl_t *ctrl, kved_word_t key)
 			break;
 		}
 	}
+#endif
 
 	return key_index;
 }
@@ -427,29 +671,83 @@ static kved_word_t kved_value_encode(kved_data_t *data)
 	return data->value.u64;
 }
 
-static void kved_value_string_decode(kved_ctrl_t *ctrl, kved_data_t *data, kved_word_t value)
+/* raw length of a value kept in the String Table, strings include their NULL terminator */
+static uint16_t kved_blob_len(kved_data_t *data)
+{
+	if (KVED_DATA_TYPE_IS_ARRAY(data->type))
+		return data->size;
+	return strlen((const char *)data->value.str) + 1;
+}
+
+/* FNV-1a folded to 16 bits, 0 is reserved for headers without a hash */
+static uint16_t kved_string_hash(const uint8_t *str, size_t len)
+{
+	uint32_t h = 0x811C9DC5;
+
+	for (size_t i = 0; i < len; i++)
+	{
+		h ^= str[i];
+		h *= 0x01000193;
+	}
+	h = (h >> 16) ^ (h & 0xFFFF);
+	return h == KVED_STR_HASH_NONE ? 1 : h;
+}
+
+/* strings are hashed without their NULL terminator, as the headers written before arrays existed */
+static uint16_t kved_blob_hash(kved_data_t *data, uint16_t len)
+{
+	return kved_string_hash(data->value.str, KVED_DATA_TYPE_IS_ARRAY(data->type) ? len : len - 1);
+}
+
+/* words a String Table record of len bytes takes, including the word after its data */
+static uint16_t kved_string_words(uint16_t len)
+{
+	return (len / KVED_FLASH_WORD_SIZE) + 2;
+}
+
+/* check the String Table data ending end words after its first record fits the sector */
+static bool kved_string_fits(kved_ctrl_t *ctrl, kved_flash_sector_t str_sector, uint32_t end)
+{
+	return ((uint32_t)kved_string_entry_to_start_sector(ctrl, 0) + end) * KVED_FLASH_WORD_SIZE <=
+		   ctrl->fdriver->sector_size(str_sector, ctrl->fdriver->drv_arg);
+}
+
+/* get the start sector and raw length (including the NULL terminator of strings) of a String Table entry from its index */
+static bool kved_string_header_get(kved_ctrl_t *ctrl, kved_word_t value, uint16_t *offset, uint16_t *len, uint16_t *hash)
 {
 	/* check the read index is within our index range */
 	if (value > ctrl->str_stats.num_total_entries)
 	{
 		LOG_E("Invalid index %ld\r\n", value);
-		return;
+		return false;
 	}
 	kved_word_t index = ctrl->fdriver->header_read(ctrl->str_sector, kved_string_entry_to_header(ctrl, value), ctrl->fdriver->drv_arg);
-	uint16_t offset = kved_string_entry_to_start_sector(ctrl, (index >> 32));
-	uint16_t len = (index & 0xFFFFFFFF);
+	*offset = kved_string_entry_to_start_sector(ctrl, KVED_STR_HDR_OFFSET(index));
+	*len = KVED_STR_HDR_LEN(index);
+	if (hash != NULL)
+		*hash = KVED_STR_HDR_HASH(index);
 	/* TODO check if its within our sector space */
-	if (len > KVED_MAX_STRING_SIZE)
+	if (*len > KVED_MAX_BLOB_SIZE)
 	{
-		LOG_E("Invalid len %d\r\n", len);
-		return;
+		LOG_E("Invalid len %d\r\n", *len);
+		return false;
 	}
+	return true;
+}
+
+static void kved_value_string_decode(kved_ctrl_t *ctrl, kved_data_t *data, kved_word_t value)
+{
+	uint16_t offset, len;
+
+	if (!kved_string_header_get(ctrl, value, &offset, &len, NULL))
+		return;
 	ctrl->fdriver->data_read(ctrl->str_sector, offset, data->value.str, len, ctrl->fdriver->drv_arg);
+	data->size = len;
 }
 
 static void kved_value_decode(kved_ctrl_t *ctrl, kved_data_t *data, kved_word_t value)
 {
-	if (data->type == KVED_DATA_TYPE_STRING)
+	if (KVED_DATA_TYPE_IS_BLOB(data->type))
 	{
 		kved_value_string_decode(ctrl, data, value);
 	}
@@ -462,6 +760,7 @@ static void kved_value_decode(kved_ctrl_t *ctrl, kved_data_t *data, kved_word_t
 static kved_error_t kved_sector_switch(kved_ctrl_t *ctrl, kved_word_t cnt, kved_word_t upd_key, kved_data_t *upd_data)
 {
 	LOG_T("Switching Index and String Sectors!!\r\n");
+	uint64_t start_us = kved_timestamp_us(ctrl);
 	uint16_t next_index = KVED_HDR_SIZE_IN_WORDS;
 	uint16_t total_items = 0;
 	uint16_t used_items = 0;
@@ -470,11 +769,34 @@ static kved_error_t kved_sector_switch(kved_ctrl_t *ctrl, kved_word_t cnt, kved_
 	kved_flash_sector_t next_sector = ctrl->sector == KVED_FLASH_SECTOR_A ? KVED_FLASH_SECTOR_B : KVED_FLASH_SECTOR_A;
 	kved_flash_sector_t next_str_sector = ctrl->str_sector == KVED_FLASH_STRING_SECTOR_A ? KVED_FLASH_STRING_SECTOR_B : KVED_FLASH_STRING_SECTOR_A;
 
-	ctrl->fdriver->sector_erase(next_sector, ctrl->fdriver->drv_arg);
-	ctrl->fdriver->sector_erase(next_str_sector, ctrl->fdriver->drv_arg);
-
 	upd_key = KVED_HDR_MASK_KEY(upd_key);
 
+	/* the live strings and arrays must fit the String Table, check before anything is erased */
+	uint32_t str_words = 0;
+	for (uint16_t index = ctrl->first_index; index <= ctrl->last_index; index += KVED_ENTRY_SIZE_IN_WORDS)
+	{
+		kved_word_t key = ctrl->fdriver->header_read(ctrl->sector, index, ctrl->fdriver->drv_arg);
+		uint16_t offset, len;
+
+		if (!kved_is_valid_key(ctrl, key) || !KVED_DATA_TYPE_IS_BLOB(KVED_HDR_MASK_TYPE(key)))
+			continue;
+		if (KVED_HDR_MASK_KEY(key) == upd_key)
+		{
+			if (upd_data != NULL && KVED_DATA_TYPE_IS_BLOB(upd_data->type))
+				str_words += kved_string_words(kved_blob_len(upd_data));
+		}
+		else if (kved_string_header_get(ctrl, ctrl->fdriver->header_read(ctrl->sector, index + 1, ctrl->fdriver->drv_arg), &offset, &len, NULL))
+			str_words += kved_string_words(len);
+	}
+	if (!kved_string_fits(ctrl, next_str_sector, str_words))
+	{
+		LOG_E("No space in the String Table\r\n");
+		return KVED_TABLE_FULL;
+	}
+
+	kved_sector_erase(ctrl, next_sector);
+	kved_sector_erase(ctrl, next_str_sector);
+
 	for (uint16_t index = ctrl->first_index; index <= ctrl->last_index; index += KVED_ENTRY_SIZE_IN_WORDS)
 	{
 		kved_word_t key = ctrl->fdriver->header_read(ctrl->sector, index, ctrl->fdriver->drv_arg);
@@ -483,58 +805,60 @@ static kved_error_t kved_sector_switch(kved_ctrl_t *ctrl, kved_word_t cnt, kved_
 		{
 			kved_word_t val = ctrl->fdriver->header_read(ctrl->sector, index + 1, ctrl->fdriver->drv_arg);
 
-			ctrl->fdriver->header_write(next_sector, next_index++, key, ctrl->fdriver->drv_arg);
+			kved_header_write(ctrl, next_sector, next_index++, key);
 
 			if (KVED_HDR_MASK_KEY(key) == upd_key)
 			{
-				if (KVED_HDR_MASK_TYPE(key) == KVED_DATA_TYPE_STRING)
+				if (KVED_DATA_TYPE_IS_BLOB(KVED_HDR_MASK_TYPE(key)))
 				{
 					/* write the String Index Header and actual data with the updated string */
-					kved_word_t len = strlen((const char *)upd_data->value.str)+1;
+					kved_word_t len = kved_blob_len(upd_data);
 					kved_word_t offset = str_next_free_sector;
-					kved_word_t ptr = (offset << 32) + len;
+					kved_word_t ptr = KVED_STR_HDR_ENCODE(offset, kved_blob_hash(upd_data, len), len);
 					kved_word_t sectorlen = (len / KVED_FLASH_WORD_SIZE) + 1;
 					LOG_T("Write New String IDX %d, Offset %ld, Raw Len %ld, Sector Len %ld encoded %lx\r\n", next_index, offset, len, sectorlen, ptr);
 					/* write our String Data Out */
-					ctrl->fdriver->data_write(next_str_sector, kved_string_entry_to_start_sector(ctrl, offset), upd_data->value.str, len, ctrl->fdriver->drv_arg);
+					kved_data_write_raw(ctrl, next_str_sector, kved_string_entry_to_start_sector(ctrl, offset), upd_data->value.str, len);
 					/* write our string index to the header */
-					ctrl->fdriver->header_write(next_str_sector, kved_string_entry_to_header(ctrl, str_next_index), ptr, ctrl->fdriver->drv_arg);
+					kved_header_write(ctrl, next_str_sector, kved_string_entry_to_header(ctrl, str_next_index), ptr);
 
 					/* finally write our main header */
-					ctrl->fdriver->header_write(next_sector, next_index++, str_next_index, ctrl->fdriver->drv_arg);
+					kved_header_write(ctrl, next_sector, next_index++, str_next_index);
 					str_next_index++;
 					str_next_free_sector += sectorlen +1;
 				}
 				else
 				{
-					ctrl->fdriver->header_write(next_sector, next_index++, kved_value_encode(upd_data), ctrl->fdriver->drv_arg);
+					kved_header_write(ctrl, next_sector, next_index++, kved_value_encode(upd_data));
 				}
 			}
 			else
 			{
-				if (KVED_HDR_MASK_TYPE(key) == KVED_DATA_TYPE_STRING)
+				if (KVED_DATA_TYPE_IS_BLOB(KVED_HDR_MASK_TYPE(key)))
 				{
 					/* write the String Index Header and actual data with the existing string */
 					kved_data_t old_data;
+					old_data.type = KVED_HDR_MASK_TYPE(key);
 					kved_value_string_decode(ctrl, &old_data, val);
-					kved_word_t len = strlen((const char *)old_data.value.str)+1;
+					kved_word_t len = kved_blob_len(&old_data);
 					kved_word_t offset = str_next_free_sector;
-					kved_word_t ptr = (offset << 32) + len;
+					/* (re)calculate the hash, headers of older databases might not have one */
+					kved_word_t ptr = KVED_STR_HDR_ENCODE(offset, kved_blob_hash(&old_data, len), len);
 					kved_word_t sectorlen = (len / KVED_FLASH_WORD_SIZE) + 1;
 					LOG_T("Write Old String IDX %d, Offset %ld, Raw Len %ld, Sector Len %ld encoded %lx\r\n", next_index, offset, len, sectorlen, ptr);
 					/* write our String Data Out */
-					ctrl->fdriver->data_write(next_str_sector, kved_string_entry_to_start_sector(ctrl, offset), old_data.value.str, len, ctrl->fdriver->drv_arg);
+					kved_data_write_raw(ctrl, next_str_sector, kved_string_entry_to_start_sector(ctrl, offset), old_data.value.str, len);
 					/* write our string index to the header */
-					ctrl->fdriver->header_write(next_str_sector, kved_string_entry_to_header(ctrl, str_next_index), ptr, ctrl->fdriver->drv_arg);
+					kved_header_write(ctrl, next_str_sector, kved_string_entry_to_header(ctrl, str_next_index), ptr);
 
 					/* finally write our main header */
-					ctrl->fdriver->header_write(next_sector, next_index++, str_next_index, ctrl->fdriver->drv_arg);
+					kved_header_write(ctrl, next_sector, next_index++, str_next_index);
 					str_next_index++;
 					str_next_free_sector += sectorlen +1;
 				}
 				else
 				{
-					ctrl->fdriver->header_write(next_sector, next_index++, val, ctrl->fdriver->drv_arg);
+					kved_header_write(ctrl, next_sector, next_index++, val);
 				}
 			}
 			used_items++;
@@ -545,6 +869,8 @@ static kved_error_t kved_sector_switch(kved_ctrl_t *ctrl, kved_word_t cnt, kved_
 
 	kved_flash_sector_t last_sector = ctrl->sector;
 	ctrl->sector = next_sector;
+	/* strings moved, invalidates any pointer from kved_data_read_ref() */
+	ctrl->generation++;
 	ctrl->first_index = KVED_HDR_SIZE_IN_WORDS;
 	ctrl->last_index = (ctrl->fdriver->sector_size(ctrl->sector, ctrl->fdriver->drv_arg) / KVED_FLASH_WORD_SIZE) - KVED_HDR_SIZE_IN_WORDS;
 	ctrl->first_free_index = next_index;
@@ -562,15 +888,23 @@ static kved_error_t kved_sector_switch(kved_ctrl_t *ctrl, kved_word_t cnt, kved_
 	else
 		cnt++;
 
-	ctrl->fdriver->header_write(next_sector, 1, cnt, ctrl->fdriver->drv_arg);
-	ctrl->fdriver->header_write(next_sector, 0, KVED_SIGNATURE_ENTRY(ctrl), ctrl->fdriver->drv_arg);
-	ctrl->fdriver->header_write(next_str_sector, 0, KVED_STR_SIGNATURE_ENTRY(ctrl), ctrl->fdriver->drv_arg);
-	ctrl->fdriver->header_write(next_str_sector, ctrl->stats.num_total_entries + 1, KVED_STR_SIGNATURE_END(ctrl), ctrl->fdriver->drv_arg); 
+	kved_header_write(ctrl, next_sector, 1, cnt);
+	kved_header_write(ctrl, next_sector, 0, KVED_SIGNATURE_ENTRY(ctrl));
+	kved_header_write(ctrl, next_str_sector, 0, KVED_STR_SIGNATURE_ENTRY(ctrl));
+	kved_header_write(ctrl, next_str_sector, ctrl->stats.num_total_entries + 1, KVED_STR_SIGNATURE_END(ctrl)); 
 
 
-	ctrl->fdriver->header_write(last_sector, 0, 0, ctrl->fdriver->drv_arg); // only invalidate header, it is faster
+	kved_header_write(ctrl, last_sector, 0, 0); // only invalidate header, it is faster
 
 	KVED_CHECK_ERR_RETURN(kved_data_consistency_check(ctrl));
+	/* deleted keys are dropped from the filter here */
+	kved_bloom_rebuild(ctrl);
+
+	ctrl->counters.compaction_last_at_us = kved_timestamp_us(ctrl);
+	ctrl->counters.compaction_last_us = ctrl->counters.compaction_last_at_us - start_us;
+	if (ctrl->counters.compaction_last_us > ctrl->counters.compaction_max_us)
+		ctrl->counters.compaction_max_us = ctrl->counters.compaction_last_us;
+	ctrl->counters.compactions++;
 	return KVED_OK;
 }
 
@@ -578,6 +912,11 @@ kved_error_t kved_compact_database(kved_ctrl_t *ctrl)
 {
 	kved_error_t ret = KVED_OK;
 	KVED_CHECK_ERR_GOTO(kved_cpu_critical_section_enter(ctrl), err);
+	if (ctrl->import.active)
+	{
+		ret = KVED_BUSY;
+		goto err;
+	}
 	kved_word_t cnt = ctrl->fdriver->header_read(ctrl->sector, 1, ctrl->fdriver->drv_arg);
 	KVED_CHECK_ERR_GOTO(kved_sector_switch(ctrl, cnt, KVED_SIGNATURE_ENTRY(ctrl), 0), err);
 	err:
@@ -586,6 +925,169 @@ kved_error_t kved_compact_database(kved_ctrl_t *ctrl)
 	return ret;
 }
 
+/* bulk import: entries are appended to the spare sectors, which become the active ones on commit */
+static inline kved_flash_sector_t kved_import_sector(kved_ctrl_t *ctrl)
+{
+	return ctrl->sector == KVED_FLASH_SECTOR_A ? KVED_FLASH_SECTOR_B : KVED_FLASH_SECTOR_A;
+}
+
+static inline kved_flash_sector_t kved_import_str_sector(kved_ctrl_t *ctrl)
+{
+	return ctrl->str_sector == KVED_FLASH_STRING_SECTOR_A ? KVED_FLASH_STRING_SECTOR_B : KVED_FLASH_STRING_SECTOR_A;
+}
+
+static kved_error_t kved_internal_import_begin(kved_ctrl_t *ctrl)
+{
+	if (!ctrl->started)
+		return KVED_NOT_INITIALIZED;
+
+	if (ctrl->import.active)
+		return KVED_BUSY;
+
+	kved_sector_erase(ctrl, kved_import_sector(ctrl));
+	kved_sector_erase(ctrl, kved_import_str_sector(ctrl));
+
+	memset(&ctrl->import, 0, sizeof(ctrl->import));
+	ctrl->import.next_index = KVED_HDR_SIZE_IN_WORDS;
+	ctrl->import.active = true;
+	return KVED_OK;
+}
+
+kved_error_t kved_import_begin(kved_ctrl_t *ctrl)
+{
+	kved_error_t ret;
+	KVED_CHECK_ERR_GOTO(kved_cpu_critical_section_enter(ctrl), err);
+	ret = kved_internal_import_begin(ctrl);
+	err:
+		KVED_CHECK_ERR_RETURN(kved_cpu_critical_section_leave(ctrl));
+	return ret;
+}
+
+static kved_error_t kved_internal_import_add(kved_ctrl_t *ctrl, kved_data_t *data)
+{
+	if (!ctrl->import.active)
+		return KVED_ERROR;
+
+	if (KVED_DATA_TYPE_IS_ARRAY(data->type) &&
+		(data->size == 0 || data->size > KVED_MAX_ARRAY_SIZE || (data->size % kved_key_type_size[data->type]) != 0))
+	{
+		LOG_E("Invalid array size %d\r\n", data->size);
+		return KVED_ERROR;
+	}
+
+	kved_word_t key = kved_key_encode(ctrl, data);
+
+	if (!kved_is_valid_key(ctrl, key))
+		return KVED_INVALID_KEY;
+
+	if (ctrl->import.used == ctrl->stats.num_total_entries)
+		return KVED_TABLE_FULL;
+
+	kved_flash_sector_t sector = kved_import_sector(ctrl);
+	kved_word_t value = kved_value_encode(data);
+
+	if (KVED_DATA_TYPE_IS_BLOB(data->type))
+	{
+		kved_flash_sector_t str_sector = kved_import_str_sector(ctrl);
+		kved_word_t len = kved_blob_len(data);
+		kved_word_t offset = ctrl->import.str_next_free_sector;
+		kved_word_t sectorlen = (len / KVED_FLASH_WORD_SIZE) + 1;
+
+		/* the String Table is never compacted during an import, so it has to hold all the data */
+		if (!kved_string_fits(ctrl, str_sector, offset + kved_string_words(len)))
+			return KVED_TABLE_FULL;
+
+		kved_data_write_raw(ctrl, str_sector, kved_string_entry_to_start_sector(ctrl, offset), data->value.str, len);
+		kved_header_write(ctrl, str_sector, kved_string_entry_to_header(ctrl, ctrl->import.str_next_index),
+						  KVED_STR_HDR_ENCODE(offset, kved_blob_hash(data, len), len));
+		value = ctrl->import.str_next_index++;
+		ctrl->import.str_next_free_sector += sectorlen + 1;
+		ctrl->counters.user_bytes_written += len;
+	}
+
+	kved_header_write(ctrl, sector, ctrl->import.next_index + 1, value);
+	kved_header_write(ctrl, sector, ctrl->import.next_index, key);
+	ctrl->import.next_index += KVED_ENTRY_SIZE_IN_WORDS;
+	ctrl->import.used++;
+	ctrl->counters.user_bytes_written += KVED_ENTRY_SIZE_IN_WORDS * KVED_FLASH_WORD_SIZE;
+	return KVED_OK;
+}
+
+kved_error_t kved_import_add(kved_ctrl_t *ctrl, kved_data_t *data)
+{
+	kved_error_t ret;
+	KVED_CHECK_ERR_GOTO(kved_cpu_critical_section_enter(ctrl), err);
+	ret = kved_internal_import_add(ctrl, data);
+	err:
+		KVED_CHECK_ERR_RETURN(kved_cpu_critical_section_leave(ctrl));
+	return ret;
+}
+
+static kved_error_t kved_internal_import_commit(kved_ctrl_t *ctrl)
+{
+	if (!ctrl->import.active)
+		return KVED_ERROR;
+
+	kved_flash_sector_t last_sector = ctrl->sector;
+	kved_flash_sector_t last_str_sector = ctrl->str_sector;
+	kved_flash_sector_t next_sector = kved_import_sector(ctrl);
+	kved_flash_sector_t next_str_sector = kved_import_str_sector(ctrl);
+	kved_word_t cnt = ctrl->fdriver->header_read(ctrl->sector, 1, ctrl->fdriver->drv_arg);
+
+	// same rules as a sector switch: skip the value of an erased word
+	if ((cnt + 1) == KVED_FLASH_UINT_MAX)
+		cnt = 0;
+	else
+		cnt++;
+
+	kved_header_write(ctrl, next_sector, 1, cnt);
+	kved_header_write(ctrl, next_sector, 0, KVED_SIGNATURE_ENTRY(ctrl));
+	kved_header_write(ctrl, next_str_sector, 0, KVED_STR_SIGNATURE_ENTRY(ctrl));
+	kved_header_write(ctrl, next_str_sector, ctrl->stats.num_total_entries + 1, KVED_STR_SIGNATURE_END(ctrl));
+
+	/* the old String Table holds none of the imported data, do not let it be picked at boot.
+	   Invalidated before the old index, which loses against the newer count anyway */
+	kved_header_write(ctrl, last_str_sector, 0, 0);
+	kved_header_write(ctrl, last_sector, 0, 0);
+
+	ctrl->import.active = false;
+	ctrl->sector = next_sector;
+	ctrl->str_sector = next_str_sector;
+	ctrl->generation++;
+	ctrl->first_index = KVED_HDR_SIZE_IN_WORDS;
+	ctrl->last_index = (ctrl->fdriver->sector_size(ctrl->sector, ctrl->fdriver->drv_arg) / KVED_FLASH_WORD_SIZE) - KVED_HDR_SIZE_IN_WORDS;
+	ctrl->first_free_index = ctrl->import.next_index;
+	ctrl->stats.num_deleted_entries = 0;
+	ctrl->stats.num_used_entries = ctrl->import.used;
+	ctrl->stats.num_free_entries = ctrl->stats.num_total_entries - ctrl->import.used;
+
+	/* also drops keys that were imported twice, keeping the last value */
+	KVED_CHECK_ERR_RETURN(kved_data_consistency_check(ctrl));
+	kved_bloom_rebuild(ctrl);
+	return KVED_OK;
+}
+
+kved_error_t kved_import_commit(kved_ctrl_t *ctrl)
+{
+	kved_error_t ret;
+	KVED_CHECK_ERR_GOTO(kved_cpu_critical_section_enter(ctrl), err);
+	ret = kved_internal_import_commit(ctrl);
+	err:
+		KVED_CHECK_ERR_RETURN(kved_cpu_critical_section_leave(ctrl));
+	return ret;
+}
+
+kved_error_t kved_import_abort(kved_ctrl_t *ctrl)
+{
+	kved_error_t ret;
+	KVED_CHECK_ERR_GOTO(kved_cpu_critical_section_enter(ctrl), err);
+	/* the staged sectors are erased again by the next switch */
+	ctrl->import.active = false;
+	err:
+		KVED_CHECK_ERR_RETURN(kved_cpu_critical_section_leave(ctrl));
+	return ret;
+}
+
 
 
 static kved_error_t kved_internal_strdata_write(kved_ctrl_t *ctrl, kved_data_t *data)
@@ -594,19 +1096,25 @@ static kved_error_t kved_internal_strdata_write(kved_ctrl_t *ctrl, kved_data_t *
 	/* find our first free index */
 	kved_word_t idx = ctrl->str_ctrl.next_free_index;
 
-	/* calc the index data - offset << 32 | len encoded with null termnator */
-	kved_word_t len = strlen((const char *)data->value.str)+1;
+	/* calc the index data - offset << 32 | hash << 16 | len encoded with null termnator */
+	kved_word_t len = kved_blob_len(data);
 	kved_word_t offset = ctrl->str_ctrl.next_free_sector;
-	kved_word_t ptr = (offset << 32) + len;
+	kved_word_t ptr = KVED_STR_HDR_ENCODE(offset, kved_blob_hash(data, len), len);
 	kved_word_t sectorlen = (len / KVED_FLASH_WORD_SIZE) + 1;
 
+	if (!kved_string_fits(ctrl, ctrl->str_sector, offset + kved_string_words(len)))
+	{
+		LOG_E("No space in the String Table\r\n");
+		return KVED_TABLE_FULL;
+	}
+
 	LOG_T("String IDX %ld, Offset %ld, Raw Len %ld, Sector Len %ld encoded %lx\r\n", idx, offset, len, sectorlen, ptr);
 
 	/* write our string index to the header */
-	ctrl->fdriver->header_write(ctrl->str_sector, kved_string_entry_to_header(ctrl, idx), ptr, ctrl->fdriver->drv_arg);
+	kved_header_write(ctrl, ctrl->str_sector, kved_string_entry_to_header(ctrl, idx), ptr);
 
 	/* write our String Data Out */
-	ctrl->fdriver->data_write(ctrl->str_sector, kved_string_entry_to_start_sector(ctrl, offset), data->value.str, len, ctrl->fdriver->drv_arg);
+	kved_data_write_raw(ctrl, ctrl->str_sector, kved_string_entry_to_start_sector(ctrl, offset), data->value.str, len);
 
 	/* update our string controls with new index and free_offset */
 	ctrl->str_ctrl.next_free_index++;
@@ -616,6 +1124,29 @@ static kved_error_t kved_internal_strdata_write(kved_ctrl_t *ctrl, kved_data_t *
 	return KVED_OK;
 }
 
+/* compare the stored string (or array) with data, only reads it when length and hash match */
+static bool kved_string_unchanged(kved_ctrl_t *ctrl, uint16_t key_index, kved_word_t key, kved_data_t *data)
+{
+	kved_word_t stored_value = ctrl->fdriver->header_read(ctrl->sector, key_index + 1, ctrl->fdriver->drv_arg);
+	uint16_t offset, stored_len, stored_hash;
+
+	/* type changed, the value might be a plain word and not a string index */
+	if (ctrl->fdriver->header_read(ctrl->sector, key_index, ctrl->fdriver->drv_arg) != key)
+		return false;
+	if (!kved_string_header_get(ctrl, stored_value, &offset, &stored_len, &stored_hash))
+		return false;
+
+	uint16_t len = kved_blob_len(data);
+	if (len != stored_len)
+		return false;
+	if (stored_hash != KVED_STR_HASH_NONE && stored_hash != kved_blob_hash(data, len))
+		return false;
+
+	kved_data_t stored_data;
+	ctrl->fdriver->data_read(ctrl->str_sector, offset, stored_data.value.str, stored_len, ctrl->fdriver->drv_arg);
+	return memcmp(data->value.str, stored_data.value.str, len) == 0;
+}
+
 static kved_error_t kved_internal_data_write(kved_ctrl_t *ctrl, kved_data_t *data)
 {
 	bool sector_changed = false;
@@ -623,6 +1154,17 @@ static kved_error_t kved_internal_data_write(kved_ctrl_t *ctrl, kved_data_t *dat
 	if (!ctrl->started)
 		return KVED_NOT_INITIALIZED;
 
+	/* a sector switch would erase the staged import, and the import replaces everything anyway */
+	if (ctrl->import.active)
+		return KVED_BUSY;
+
+	if (KVED_DATA_TYPE_IS_ARRAY(data->type) &&
+		(data->size == 0 || data->size > KVED_MAX_ARRAY_SIZE || (data->size % kved_key_type_size[data->type]) != 0))
+	{
+		LOG_E("Invalid array size %d\r\n", data->size);
+		return KVED_ERROR;
+	}
+
 	kved_word_t key = kved_key_encode(ctrl, data);
 
 	if (!kved_is_valid_key(ctrl, key))
@@ -634,17 +1176,15 @@ static kved_error_t kved_internal_data_write(kved_ctrl_t *ctrl, kved_data_t *dat
 	// check if the value has changed or not (for existing keys)
 	if (old_entry)
 	{
-		if (data->type == KVED_DATA_TYPE_STRING) {
-			kved_word_t stored_value = ctrl->fdriver->header_read(ctrl->sector, key_index + 1, ctrl->fdriver->drv_arg);
-			kved_data_t stored_data;
-			kved_value_string_decode(ctrl, &stored_data, stored_value);
-			if (strcmp((const char *)data->value.str, (const char *)stored_data.value.str) == 0) {
+		if (KVED_DATA_TYPE_IS_BLOB(data->type)) {
+			if (kved_string_unchanged(ctrl, key_index, key, data)) {
 				LOG_T("IDX %d String Value has not changed, skipping write\r\n", key_index);
 				return KVED_OK;
 			}
 		} else { 
+			kved_word_t stored_key = ctrl->fdriver->header_read(ctrl->sector, key_index, ctrl->fdriver->drv_arg);
 			kved_word_t stored_value = ctrl->fdriver->header_read(ctrl->sector, key_index + 1, ctrl->fdriver->drv_arg);
-			if (stored_value == kved_value_encode(data)) {
+			if (stored_key == key && stored_value == kved_value_encode(data)) {
 				LOG_T("IDX %d Value has not changed, skipping write\r\n", key_index);
 				return KVED_OK;
 			}
@@ -661,11 +1201,17 @@ static kved_error_t kved_internal_data_write(kved_ctrl_t *ctrl, kved_data_t *dat
 	// Let's do a sector switch and leave the garbage behind.
 	// If we are writing using an existing entries it will
 	// be their valued updated during the process.
-	if (ctrl->stats.num_free_entries == 0)
+	// Arrays may be larger than the strings the String Table is sized for,
+	// so a full String Table also requires a clean up.
+	bool str_full = KVED_DATA_TYPE_IS_BLOB(data->type) &&
+		!kved_string_fits(ctrl, ctrl->str_sector, ctrl->str_ctrl.next_free_sector + kved_string_words(kved_blob_len(data)));
+	if (ctrl->stats.num_free_entries == 0 || str_full)
 	{
 		kved_word_t cnt = ctrl->fdriver->header_read(ctrl->sector, 1, ctrl->fdriver->drv_arg);
 		KVED_CHECK_ERR_RETURN(kved_sector_switch(ctrl, cnt, key, data));
 		sector_changed = true;
+		if (old_entry)
+			ctrl->counters.user_bytes_written += KVED_ENTRY_SIZE_IN_WORDS * KVED_FLASH_WORD_SIZE + (KVED_DATA_TYPE_IS_BLOB(data->type) ? kved_blob_len(data) : 0);
 	}
 
 
@@ -677,19 +1223,27 @@ static kved_error_t kved_internal_data_write(kved_ctrl_t *ctrl, kved_data_t *dat
 	if (!old_entry || old_entry_updated_in_the_same_sector)
 	{
 
-		if (data->type == KVED_DATA_TYPE_STRING)
+		if (KVED_DATA_TYPE_IS_BLOB(data->type))
 		{
-			if (kved_internal_strdata_write(ctrl, data) != KVED_OK)
+			ctrl->counters.user_bytes_written += kved_blob_len(data);
+			kved_error_t ret = kved_internal_strdata_write(ctrl, data);
+			if (ret != KVED_OK)
 			{
 				LOG_E("Could Not Write String Data\r\n");
-				return KVED_CORRUPT_TABLE;
+				return ret;
 			}
 		}
 
 		// first data, after key
 		LOG_T("Writing Index %d\r\n", ctrl->first_free_index);
-		ctrl->fdriver->header_write(ctrl->sector, ctrl->first_free_index + 1, kved_value_encode(data), ctrl->fdriver->drv_arg);
-		ctrl->fdriver->header_write(ctrl->sector, ctrl->first_free_index, key, ctrl->fdriver->drv_arg);
+		ctrl->counters.user_bytes_written += KVED_ENTRY_SIZE_IN_WORDS * KVED_FLASH_WORD_SIZE;
+		kved_header_write(ctrl, ctrl->sector, ctrl->first_free_index + 1, kved_value_encode(data));
+		kved_header_write(ctrl, ctrl->sector, ctrl->first_free_index, key);
+		kved_bloom_add(ctrl, key);
+#if KVED_LOOKUP_INDEX
+		/* an updated key now points to the new entry, the old one is deleted below */
+		kved_lookup_insert(ctrl, key, ctrl->first_free_index);
+#endif
 
 		ctrl->stats.num_free_entries--;
 		ctrl->stats.num_used_entries++;
@@ -698,7 +1252,7 @@ static kved_error_t kved_internal_data_write(kved_ctrl_t *ctrl, kved_data_t *dat
 		// Existing data written in the same sector: erase the old entry
 		if (old_entry_updated_in_the_same_sector)
 		{
-			ctrl->fdriver->header_write(ctrl->sector, key_index, KVED_DELETED_ENTRY, ctrl->fdriver->drv_arg);
+			kved_header_write(ctrl, ctrl->sector, key_index, KVED_DELETED_ENTRY);
 
 			ctrl->stats.num_deleted_entries++;
 			ctrl->stats.num_used_entries--;
@@ -722,6 +1276,91 @@ kved_error_t kved_data_write(kved_ctrl_t *ctrl, kved_data_t *data)
 	return ret;
 }
 
+/* mask of a slice of a packed value word */
+static inline kved_word_t kved_slice_mask(uint8_t width)
+{
+	return width >= 64 ? KVED_FLASH_UINT_MAX : (((kved_word_t)1 << width) - 1);
+}
+
+static kved_error_t kved_internal_data_read_slice(kved_ctrl_t *ctrl, kved_data_t *data, uint8_t shift, uint8_t width)
+{
+	if (!ctrl->started)
+		return KVED_NOT_INITIALIZED;
+
+	if (width == 0 || shift + width > KVED_FLASH_WORD_SIZE * 8)
+		return KVED_ERROR;
+
+	data->type = KVED_DATA_TYPE_UINT64;
+	kved_word_t key = kved_key_encode(ctrl, data);
+
+	if (!kved_is_valid_key(ctrl, key))
+		return KVED_INVALID_KEY;
+
+	uint16_t key_index = kved_key_index_find(ctrl, key);
+
+	if (key_index == KVED_INDEX_NOT_FOUND)
+		return KVED_INVALID_KEY;
+
+	if (ctrl->fdriver->header_read(ctrl->sector, key_index, ctrl->fdriver->drv_arg) != key)
+		return KVED_INVALID_KEY;
+
+	kved_word_t value = ctrl->fdriver->header_read(ctrl->sector, key_index + 1, ctrl->fdriver->drv_arg);
+	data->value.u64 = (value >> shift) & kved_slice_mask(width);
+	return KVED_OK;
+}
+
+kved_error_t kved_data_read_slice(kved_ctrl_t *ctrl, kved_data_t *data, uint8_t shift, uint8_t width)
+{
+	kved_error_t ret;
+	KVED_CHECK_ERR_GOTO(kved_cpu_critical_section_enter(ctrl), err);
+	ret = kved_internal_data_read_slice(ctrl, data, shift, width);
+	err:
+		KVED_CHECK_ERR_RETURN(kved_cpu_critical_section_leave(ctrl));
+	return ret;
+}
+
+static kved_error_t kved_internal_data_write_slice(kved_ctrl_t *ctrl, kved_data_t *data, uint8_t shift, uint8_t width)
+{
+	if (!ctrl->started)
+		return KVED_NOT_INITIALIZED;
+
+	if (width == 0 || shift + width > KVED_FLASH_WORD_SIZE * 8)
+		return KVED_ERROR;
+
+	kved_word_t mask = kved_slice_mask(width);
+	kved_word_t slice = data->value.u64 & mask;
+
+	data->type = KVED_DATA_TYPE_UINT64;
+	kved_word_t key = kved_key_encode(ctrl, data);
+
+	if (!kved_is_valid_key(ctrl, key))
+		return KVED_INVALID_KEY;
+
+	/* merge with the other members of the group, a new group starts with all members 0 */
+	kved_word_t value = 0;
+	uint16_t key_index = kved_key_index_find(ctrl, key);
+	if (key_index != KVED_INDEX_NOT_FOUND)
+	{
+		if (ctrl->fdriver->header_read(ctrl->sector, key_index, ctrl->fdriver->drv_arg) != key)
+			return KVED_INVALID_KEY;
+		value = ctrl->fdriver->header_read(ctrl->sector, key_index + 1, ctrl->fdriver->drv_arg);
+	}
+	data->value.u64 = (value & ~(mask << shift)) | (slice << shift);
+
+	/* an unchanged member does not cost a write */
+	return kved_internal_data_write(ctrl, data);
+}
+
+kved_error_t kved_data_write_slice(kved_ctrl_t *ctrl, kved_data_t *data, uint8_t shift, uint8_t width)
+{
+	kved_error_t ret;
+	KVED_CHECK_ERR_GOTO(kved_cpu_critical_section_enter(ctrl), err);
+	ret = kved_internal_data_write_slice(ctrl, data, shift, width);
+	err:
+		KVED_CHECK_ERR_RETURN(kved_cpu_critical_section_leave(ctrl));
+	return ret;
+}
+
 static int16_t kved_internal_first_used_index_get(kved_ctrl_t *ctrl)
 {
 	uint16_t first_index = KVED_INDEX_NOT_FOUND;
@@ -933,11 +1572,153 @@ kved_error_t kved_data_read(kved_ctrl_t *ctrl, kved_data_t *data)
 	return ret;
 }
 
+static kved_error_t kved_internal_data_read_range(kved_ctrl_t *ctrl, kved_data_t *data, uint16_t offset, uint16_t len)
+{
+	if (!ctrl->started)
+		return KVED_NOT_INITIALIZED;
+
+	kved_word_t key = kved_key_encode(ctrl, data);
+
+	if (!kved_is_valid_key(ctrl, key))
+		return KVED_INVALID_KEY;
+
+	uint16_t key_index = kved_key_index_find(ctrl, key);
+
+	if (key_index == KVED_INDEX_NOT_FOUND)
+		return KVED_INVALID_KEY;
+
+	data->type = KVED_HDR_MASK_TYPE(ctrl->fdriver->header_read(ctrl->sector, key_index, ctrl->fdriver->drv_arg));
+	if (!KVED_DATA_TYPE_IS_ARRAY(data->type))
+		return KVED_INVALID_KEY;
+
+	kved_word_t value = ctrl->fdriver->header_read(ctrl->sector, key_index + 1, ctrl->fdriver->drv_arg);
+	uint16_t start, rawlen;
+	if (!kved_string_header_get(ctrl, value, &start, &rawlen, NULL))
+		return KVED_CORRUPT_TABLE;
+
+	data->size = rawlen;
+	if ((uint32_t)offset + len > rawlen)
+		return KVED_INVALID_INDEX;
+	if (len == 0)
+		return KVED_OK;
+
+	/* data is read in words, only fetch the words holding the range and copy the slice out */
+	uint8_t buf[KVED_MAX_ARRAY_SIZE + KVED_FLASH_WORD_SIZE];
+	uint16_t skip = offset % KVED_FLASH_WORD_SIZE;
+	ctrl->fdriver->data_read(ctrl->str_sector, start + offset / KVED_FLASH_WORD_SIZE, buf, skip + len, ctrl->fdriver->drv_arg);
+	memcpy(data->value.u8a, buf + skip, len);
+	return KVED_OK;
+}
+
+kved_error_t kved_data_read_range(kved_ctrl_t *ctrl, kved_data_t *data, uint16_t offset, uint16_t len)
+{
+	kved_error_t ret;
+	KVED_CHECK_ERR_GOTO(kved_cpu_critical_section_enter(ctrl), err);
+	ret = kved_internal_data_read_range(ctrl, data, offset, len);
+	err:
+		KVED_CHECK_ERR_RETURN(kved_cpu_critical_section_leave(ctrl));
+	return ret;
+}
+
+static kved_error_t kved_internal_data_read_ref(kved_ctrl_t *ctrl, kved_data_t *data, const uint8_t **ref, uint16_t *len, uint32_t *generation)
+{
+	if (!ctrl->started)
+		return KVED_NOT_INITIALIZED;
+
+	kved_word_t key = kved_key_encode(ctrl, data);
+
+	if (!kved_is_valid_key(ctrl, key))
+		return KVED_INVALID_KEY;
+
+	uint16_t key_index = kved_key_index_find(ctrl, key);
+
+	if (key_index == KVED_INDEX_NOT_FOUND)
+		return KVED_INVALID_KEY;
+
+	data->type = KVED_HDR_MASK_TYPE(ctrl->fdriver->header_read(ctrl->sector, key_index, ctrl->fdriver->drv_arg));
+	if (data->type != KVED_DATA_TYPE_STRING)
+		return KVED_INVALID_KEY;
+
+	/* only after the lookup, callers tell missing keys from unmapped drivers */
+	if (ctrl->fdriver->data_ptr == NULL)
+		return KVED_NOT_SUPPORTED;
+
+	kved_word_t value = ctrl->fdriver->header_read(ctrl->sector, key_index + 1, ctrl->fdriver->drv_arg);
+	uint16_t offset, rawlen;
+	if (!kved_string_header_get(ctrl, value, &offset, &rawlen, NULL) || rawlen == 0)
+		return KVED_CORRUPT_TABLE;
+
+	const uint8_t *ptr = ctrl->fdriver->data_ptr(ctrl->str_sector, offset, ctrl->fdriver->drv_arg);
+	if (ptr == NULL)
+		return KVED_NOT_SUPPORTED;
+
+	*ref = ptr;
+	*len = rawlen - 1;
+	*generation = ctrl->generation;
+	return KVED_OK;
+}
+
+kved_error_t kved_data_read_ref(kved_ctrl_t *ctrl, kved_data_t *data, const uint8_t **ref, uint16_t *len, uint32_t *generation)
+{
+	kved_error_t ret;
+	KVED_CHECK_ERR_GOTO(kved_cpu_critical_section_enter(ctrl), err);
+	ret = kved_internal_data_read_ref(ctrl, data, ref, len, generation);
+	err:
+		KVED_CHECK_ERR_RETURN(kved_cpu_critical_section_leave(ctrl));
+	return ret;
+}
+
+static kved_error_t kved_internal_stats_get(kved_ctrl_t *ctrl, kved_stats_t *stats)
+{
+	if (!ctrl->started)
+		return KVED_NOT_INITIALIZED;
+
+	*stats = ctrl->counters;
+	stats->lifetime_compactions = ctrl->fdriver->header_read(ctrl->sector, 1, ctrl->fdriver->drv_arg);
+
+	/* words taken by the data area of the String Table, and by the strings still referenced */
+	uint32_t str_words = ctrl->fdriver->sector_size(ctrl->str_sector, ctrl->fdriver->drv_arg) / KVED_FLASH_WORD_SIZE;
+	stats->string_bytes_total = (str_words - kved_string_entry_to_start_sector(ctrl, 0)) * KVED_FLASH_WORD_SIZE;
+	stats->string_bytes_allocated = ctrl->str_ctrl.next_free_sector * KVED_FLASH_WORD_SIZE;
+	stats->string_bytes_live = 0;
+	for (uint16_t index = ctrl->first_index; index <= ctrl->last_index; index += KVED_ENTRY_SIZE_IN_WORDS)
+	{
+		kved_word_t key = ctrl->fdriver->header_read(ctrl->sector, index, ctrl->fdriver->drv_arg);
+
+		if (!kved_is_valid_key(ctrl, key) || !KVED_DATA_TYPE_IS_BLOB(KVED_HDR_MASK_TYPE(key)))
+			continue;
+
+		uint16_t offset, len;
+		kved_word_t val = ctrl->fdriver->header_read(ctrl->sector, index + 1, ctrl->fdriver->drv_arg);
+		if (kved_string_header_get(ctrl, val, &offset, &len, NULL))
+			stats->string_bytes_live += ((len / KVED_FLASH_WORD_SIZE) + 2) * KVED_FLASH_WORD_SIZE;
+	}
+	return KVED_OK;
+}
+
+kved_error_t kved_stats_get(kved_ctrl_t *ctrl, kved_stats_t *stats)
+{
+	kved_error_t ret;
+	KVED_CHECK_ERR_GOTO(kved_cpu_critical_section_enter(ctrl), err);
+	ret = kved_internal_stats_get(ctrl, stats);
+	err:
+		KVED_CHECK_ERR_RETURN(kved_cpu_critical_section_leave(ctrl));
+	return ret;
+}
+
+uint32_t kved_generation_get(kved_ctrl_t *ctrl)
+{
+	return ctrl->generation;
+}
+
 static kved_error_t kved_internal_data_delete(kved_ctrl_t *ctrl, kved_data_t *data)
 {
 	if (!ctrl->started)
 		return KVED_NOT_INITIALIZED;
 
+	if (ctrl->import.active)
+		return KVED_BUSY;
+
 	kved_word_t key = kved_key_encode(ctrl, data);
 
 	if (!kved_is_valid_key(ctrl, key)) {
@@ -949,7 +1730,10 @@ static kved_error_t kved_internal_data_delete(kved_ctrl_t *ctrl, kved_data_t *da
 	if (key_index == KVED_INDEX_NOT_FOUND) {
 		return KVED_INVALID_KEY;
 	}
-	ctrl->fdriver->header_write(ctrl->sector, key_index, KVED_DELETED_ENTRY, ctrl->fdriver->drv_arg);
+#if KVED_LOOKUP_INDEX
+	kved_lookup_remove(ctrl, key, key_index);
+#endif
+	kved_header_write(ctrl, ctrl->sector, key_index, KVED_DELETED_ENTRY);
 
 	ctrl->stats.num_deleted_entries++;
 	ctrl->stats.num_used_entries--;
@@ -1023,10 +1807,10 @@ static void kved_sector_consistency_check(kved_ctrl_t *ctrl)
 
 		// Invalidate selected sectors ...
 		if (invalidate_a)
-			ctrl->fdriver->header_write(KVED_FLASH_SECTOR_A, 0, 0, ctrl->fdriver->drv_arg);
+			kved_header_write(ctrl, KVED_FLASH_SECTOR_A, 0, 0);
 
 		if (invalidate_b)
-			ctrl->fdriver->header_write(KVED_FLASH_SECTOR_B, 0, 0, ctrl->fdriver->drv_arg);
+			kved_header_write(ctrl, KVED_FLASH_SECTOR_B, 0, 0);
 	}
 }
 
@@ -1047,6 +1831,7 @@ static kved_error_t kved_string_consistency_check(kved_ctrl_t *ctrl)
 	}
 	memset(&ctrl->str_stats, 0, sizeof(ctrl->str_stats));
 	bool free_entry_set = false;
+	uint16_t next_free_sector = 0;
 	for (uint16_t i = 0; i < ctrl->stats.num_total_entries; i++)
 	{
 		kved_word_t ptr = ctrl->fdriver->header_read(ctrl->str_sector, kved_string_entry_to_header(ctrl, i), ctrl->fdriver->drv_arg);
@@ -1071,8 +1856,13 @@ static kved_error_t kved_string_consistency_check(kved_ctrl_t *ctrl)
 			// uint16_t sectorend = start + sectorlen;
 			// LOG_I("Index %d Start: %lu RawLen: %u SectorLen: %u SectorEnd: %u\r\n", i, start, datalen, sectorlen, sectorend);
 			ctrl->str_stats.num_used_entries++;
+			/* string data is never erased in place, new data goes after the last entry */
+			uint16_t end = KVED_STR_HDR_OFFSET(ptr) + (KVED_STR_HDR_LEN(ptr) / KVED_FLASH_WORD_SIZE) + 2;
+			if (end > next_free_sector)
+				next_free_sector = end;
 		}
 	}
+	ctrl->str_ctrl.next_free_sector = next_free_sector;
 	ctrl->str_stats.num_total_entries = ctrl->str_stats.num_free_entries + ctrl->str_stats.num_deleted_entries + ctrl->str_stats.num_used_entries;
 	if (ctrl->str_stats.num_total_entries != ctrl->stats.num_total_entries)
 	{
@@ -1091,6 +1881,9 @@ static kved_error_t kved_data_consistency_check(kved_ctrl_t *ctrl)
 		return KVED_CORRUPT_TABLE;
 	}
 	LOG_T("Checking Data Consistency\r\n");
+#if KVED_LOOKUP_INDEX
+	kved_lookup_reset(ctrl);
+#endif
 	for (uint16_t index = ctrl->first_index; index <= ctrl->last_index; index += KVED_ENTRY_SIZE_IN_WORDS)
 	{
 		kved_word_t key = ctrl->fdriver->header_read(ctrl->sector, index, ctrl->fdriver->drv_arg);
@@ -1107,7 +1900,7 @@ static kved_error_t kved_data_consistency_check(kved_ctrl_t *ctrl)
 		// by application, removing any unknown or unexpected key (application knows its owns keys, kved not).
 		if ((key == KVED_FLASH_UINT_MAX) && (val != KVED_FLASH_UINT_MAX))
 		{
-			ctrl->fdriver->header_write(ctrl->sector, index, 0, ctrl->fdriver->drv_arg);
+			kved_header_write(ctrl, ctrl->sector, index, 0);
 			ctrl->stats.num_deleted_entries++;
 			ctrl->stats.num_free_entries--;
 			LOG_W("Deleted Entry at Index %d\r\n", index);
@@ -1120,6 +1913,18 @@ static kved_error_t kved_data_consistency_check(kved_ctrl_t *ctrl)
 		// and erase the old entry.
 		if (kved_is_valid_key(ctrl, key))
 		{
+#if KVED_LOOKUP_INDEX
+			// The lookup index is filled in index order, so if the key is already
+			// in there, it points to the older entry.
+			uint16_t dup_key_index = kved_lookup_insert(ctrl, key, index);
+			if (dup_key_index != KVED_INDEX_NOT_FOUND)
+			{
+				LOG_W("Duplicated Key Found at Index %d\r\n", index);
+				kved_header_write(ctrl, ctrl->sector, dup_key_index, 0);
+				ctrl->stats.num_deleted_entries++;
+				ctrl->stats.num_used_entries--;
+			}
+#else
 			LOG_T("Looking for duplicated keys\r\n");
 			for (uint16_t dup_key_index = index + KVED_ENTRY_SIZE_IN_WORDS; dup_key_index <= ctrl->last_index; dup_key_index += KVED_ENTRY_SIZE_IN_WORDS)
 			{
@@ -1129,13 +1934,14 @@ static kved_error_t kved_data_consistency_check(kved_ctrl_t *ctrl)
 					if (KVED_HDR_MASK_KEY(dup_key) == KVED_HDR_MASK_KEY(key))
 					{
 						LOG_W("Duplicated Key Found at Index %d\r\n", dup_key_index);
-						ctrl->fdriver->header_write(ctrl->sector, index, 0, ctrl->fdriver->drv_arg);
+						kved_header_write(ctrl, ctrl->sector, index, 0);
 						ctrl->stats.num_deleted_entries++;
 						ctrl->stats.num_used_entries--;
 						break;
 					}
 				}
 			}
+#endif
 		}
 	}
 	LOG_T("Done\r\n");
@@ -1156,23 +1962,39 @@ kved_ctrl_t *kved_init(kved_flash_driver_t *driver)
 {
 	LOG_I("Starting KVED Backend\r\n");
 	kved_ctrl_t *ctrl = (kved_ctrl_t*)malloc(sizeof(kved_ctrl_t));
+	if (ctrl == NULL) {
+		LOG_E("KVED: Could not allocate the control block!\r\n");
+		return NULL;
+	}
 	bzero(ctrl, sizeof(kved_ctrl_t));
 
 #ifdef CONFIG_FREERTOS
 	ctrl->mutex = xSemaphoreCreateMutex();
+	if (ctrl->mutex == NULL) {
+		LOG_E("KVED: Could not create the mutex!\r\n");
+		free(ctrl);
+		return NULL;
+	}
 #endif	
 	ctrl->fdriver = driver;
 
 	if (ctrl->fdriver->init(ctrl->fdriver->drv_arg) == false) {
 		LOG_E("Flash Driver Init Failed!\r\n");
-		return NULL;
+		goto err_ctrl;
 	}
 
 	ctrl->drv_max_entries = ctrl->fdriver->max_entries(ctrl->fdriver->drv_arg);
 
 	if (ctrl->drv_max_entries <= 0) {
 		LOG_E("Flash Driver Max Entries Invalid!\r\n");
-		return NULL;
+		goto err_ctrl;
+	}
+
+	/* entries are addressed by 16 bit word indexes */
+	if ((ctrl->fdriver->sector_size(KVED_FLASH_SECTOR_A, ctrl->fdriver->drv_arg) / KVED_FLASH_WORD_SIZE) > KVED_MAX_INDEX_WORDS ||
+		(ctrl->fdriver->sector_size(KVED_FLASH_STRING_SECTOR_A, ctrl->fdriver->drv_arg) / KVED_FLASH_WORD_SIZE) > KVED_MAX_STRING_WORDS) {
+		LOG_E("Flash Driver Sectors too large!\r\n");
+		goto err_ctrl;
 	}
 
 	kved_sector_consistency_check(ctrl);
@@ -1194,13 +2016,21 @@ kved_ctrl_t *kved_init(kved_flash_driver_t *driver)
 	{
 		LOG_I("No Valid Index Sector Found, Formating...\r\n");
 		ctrl->sector = KVED_FLASH_SECTOR_A;
-		ctrl->fdriver->sector_erase(ctrl->sector, ctrl->fdriver->drv_arg);
-		ctrl->fdriver->header_write(ctrl->sector, 1, 0, ctrl->fdriver->drv_arg); // first cnt, after ID
-		ctrl->fdriver->header_write(ctrl->sector, 0, KVED_SIGNATURE_ENTRY(ctrl), ctrl->fdriver->drv_arg);
+		kved_sector_erase(ctrl, ctrl->sector);
+		kved_header_write(ctrl, ctrl->sector, 1, 0); // first cnt, after ID
+		kved_header_write(ctrl, ctrl->sector, 0, KVED_SIGNATURE_ENTRY(ctrl));
 	}
 
 	kved_sector_stats_read(ctrl);
 
+#if KVED_LOOKUP_INDEX
+	if (!kved_lookup_alloc(ctrl))
+	{
+		LOG_E("KVED: Could not allocate Lookup Index!\r\n");
+		goto err_ctrl;
+	}
+#endif
+
 	kved_word_t id_str_sec_a = ctrl->fdriver->header_read(KVED_FLASH_STRING_SECTOR_A, 0, ctrl->fdriver->drv_arg);
 	kved_word_t end_str_sec_a = ctrl->fdriver->header_read(KVED_FLASH_STRING_SECTOR_A, ctrl->stats.num_total_entries + 1, ctrl->fdriver->drv_arg);
 	kved_word_t id_str_sec_b = ctrl->fdriver->header_read(KVED_FLASH_STRING_SECTOR_B, 0, ctrl->fdriver->drv_arg);
@@ -1220,30 +2050,48 @@ kved_ctrl_t *kved_init(kved_flash_driver_t *driver)
 	{
 		LOG_I("No Valid String Sector Found, Formating...\r\n");
 		ctrl->str_sector = KVED_FLASH_STRING_SECTOR_A;
-		ctrl->fdriver->sector_erase(ctrl->str_sector, ctrl->fdriver->drv_arg);
-		ctrl->fdriver->header_write(ctrl->str_sector, 0, KVED_STR_SIGNATURE_ENTRY(ctrl), ctrl->fdriver->drv_arg);
+		kved_sector_erase(ctrl, ctrl->str_sector);
+		kved_header_write(ctrl, ctrl->str_sector, 0, KVED_STR_SIGNATURE_ENTRY(ctrl));
 		/* After Signature we have X entries as indexes to the strings/raw data then a Signature for the end of this index table */
-		ctrl->fdriver->header_write(ctrl->str_sector, ctrl->stats.num_total_entries + 1, KVED_STR_SIGNATURE_END(ctrl), ctrl->fdriver->drv_arg);
+		kved_header_write(ctrl, ctrl->str_sector, ctrl->stats.num_total_entries + 1, KVED_STR_SIGNATURE_END(ctrl));
 	}
 	LOG_I("Checking Data Consistency...\r\n");
 	if (kved_data_consistency_check(ctrl) != KVED_OK)
 	{
 		LOG_E("KVED: Data consistency check failed!\r\n");
-		free(ctrl);
-		return NULL;
+		goto err_lookup;
 	}
 
+	kved_bloom_rebuild(ctrl);
+
 	ctrl->started = true;
 
 	kved_dump(ctrl);
 	LOG_I("Started KVED Backend\r\n");
 	return ctrl;
+
+	err_lookup:
+#if KVED_LOOKUP_INDEX
+		free(ctrl->lookup);
+#endif
+	err_ctrl:
+#ifdef CONFIG_FREERTOS
+		vSemaphoreDelete(ctrl->mutex);
+#endif
+		free(ctrl);
+	return NULL;
 }
 
 void kved_deinit(kved_ctrl_t *ctrl) {
 	if (ctrl == NULL) {
 		return;
 	}
+#if KVED_LOOKUP_INDEX
+	free(ctrl->lookup);
+#endif
+#ifdef CONFIG_FREERTOS
+	vSemaphoreDelete(ctrl->mutex);
+#endif
 	free(ctrl);
 	ctrl = NULL;
 }
\ No newline at end of file
@@ -15,6 +15,7 @@ Copyright (c) 2022 Marcelo Barros de Almeida <marcelobarrosalmeida@gmail.com>
 @brief KVED (key/value embedded databse): simple key/value persistence for embedded applications.
 @{
 */
+#include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
 #include "sdkconfig.h"
@@ -26,6 +27,28 @@ Copyright (c) 2022 Marcelo Barros de Almeida <marcelobarrosalmeida@gmail.com>
 #else
 #define KVED_MAX_STRING_SIZE CONFIG_COMPONENT_NVKVS_MAX_STRING_SIZE
 #endif
+/** Maximum supported array size, per record, in bytes */
+#ifdef CONFIG_COMPONENT_NVKVS_MAX_ARRAY_SIZE
+#define KVED_MAX_ARRAY_SIZE CONFIG_COMPONENT_NVKVS_MAX_ARRAY_SIZE
+#else
+#define KVED_MAX_ARRAY_SIZE KVED_MAX_STRING_SIZE
+#endif
+/** Largest record of the String Table, a string or an array */
+#define KVED_MAX_BLOB_SIZE (KVED_MAX_ARRAY_SIZE > KVED_MAX_STRING_SIZE ? KVED_MAX_ARRAY_SIZE : KVED_MAX_STRING_SIZE)
+/** Size in bytes of the in-RAM Bloom filter over the live keys, 0 disables it */
+#ifdef CONFIG_COMPONENT_NVKVS_BLOOM_FILTER_SIZE
+#define KVED_BLOOM_FILTER_SIZE CONFIG_COMPONENT_NVKVS_BLOOM_FILTER_SIZE
+#else
+#define KVED_BLOOM_FILTER_SIZE 0
+#endif
+/** Number of bits set/tested per key in the Bloom filter */
+#define KVED_BLOOM_FILTER_HASHES 3
+/** Keep an in-RAM hash table from keys to index entries, so lookups do not scan the index */
+#ifdef CONFIG_COMPONENT_NVKVS_LOOKUP_INDEX
+#define KVED_LOOKUP_INDEX 1
+#else
+#define KVED_LOOKUP_INDEX 0
+#endif
 //#define KVED_DEBUG
 
 
@@ -61,8 +84,10 @@ String Table:
 | STRING DATA 3           | EMPTY                                |
 +------------+------------+------------+------------+------------+
 
-IDX Headers are 8 bytes long and contain the offset and length of the string data.
-The offset is stored in the first 4 bytes and the length in the last 4 bytes.
+IDX Headers are 8 bytes long and contain the offset, hash and length of the string data.
+The offset is stored in the first 4 bytes, a 16 bit hash of the string in the next 2 bytes
+and the length in the last 2 bytes. The hash is never 0, a hash of 0 means the header was
+written without one, and the string has to be compared in full.
 The offset is relative to the start of the string data are, and points to the sector that contains the start of the string
 The Length is the raw length of the string, including the NULL terminator. (not the number of sectors it occupies)
 The Number of IDX entries equals the total number of keys in the main index.
@@ -73,6 +98,30 @@ Empty space in the String Table is filled with 0xFF.
 
 When compacting the tables, only referenced strings are copied to the new string table.
 
+Packed groups are plain KVED_DATA_TYPE_UINT64 entries whose value word is split in slices
+(64 flags, 8 bytes, 4 half words...). Members are read and written by their slice with
+kved_data_read_slice() and kved_data_write_slice(), so small values do not each take a 16 byte entry.
+
+Arrays (KVED_DATA_TYPE_*_ARRAY) are stored in the String Table the same way, as one contiguous
+run of bytes. Their length is the size of the array in bytes (there is no terminator), and
+the size nibble of the key entry holds the size of one element.
+
+Index Size:
+The Main Index is not limited to a single flash sector. The flash driver sizes it from
+max_entries, spanning as many flash sectors as needed, and it is addressed linearly
+from the header in its first sector (up to KVED_MAX_INDEX_WORDS words, ~16k entries).
+As max_entries is part of the signatures, changing it reformats the database.
+With KVED_LOOKUP_INDEX, a hash table in RAM maps keys to their index entry so a lookup
+does not depend on the size of the index. It is rebuilt by the consistency check when
+the database is mounted and after every sector switch.
+
+Bloom Filter:
+When KVED_BLOOM_FILTER_SIZE is non zero, a Bloom filter over the (masked) keys of all used
+entries is kept in RAM. It is rebuilt when the database is mounted and after every sector
+switch, and keys are added to it as they are inserted. Deleted keys stay in the filter
+until the next rebuild, which only costs an index scan on a lookup. A key that is not in
+the filter is not in the index, so misses return without reading the flash.
+
 */
 
 
@@ -92,7 +141,13 @@ typedef uint64_t kved_word_t; /**< Main KVED Header Entry Size */
 #define KVED_STR_DELETED_ENTRY    0x0000000000000000ULL
 #define KVED_STR_FREE_ENTRY       0xFFFFFFFFFFFFFFFFULL
 #define KVED_STR_HDR_OFFSET_MSK   0xFFFFFFFF00000000ULL
-#define KVED_STR_HDR_LEN_MSK      0x00000000FFFFFFFFULL
+#define KVED_STR_HDR_HASH_MSK     0x00000000FFFF0000ULL
+#define KVED_STR_HDR_LEN_MSK      0x000000000000FFFFULL
+#define KVED_STR_HDR_ENCODE(offset, hash, len) (((kved_word_t)(offset) << 32) | ((kved_word_t)(hash) << 16) | (len))
+#define KVED_STR_HDR_OFFSET(h)    (((h) & KVED_STR_HDR_OFFSET_MSK) >> 32)
+#define KVED_STR_HDR_HASH(h)      (((h) & KVED_STR_HDR_HASH_MSK) >> 16)
+#define KVED_STR_HDR_LEN(h)       ((h) & KVED_STR_HDR_LEN_MSK)
+#define KVED_STR_HASH_NONE        0 /**< header written without a hash (older databases) */
 
 #define KVED_HDR_SIZE_IN_WORDS    2 /**< kved header size */
 #define KVED_ENTRY_SIZE_IN_WORDS  2 /**< kved entry size */
@@ -106,6 +161,10 @@ typedef uint64_t kved_word_t; /**< Main KVED Header Entry Size */
 #define KVED_MAX_KEY_SIZE    (KVED_FLASH_WORD_SIZE-1) 
 /** Index return value when a key is not found in the database */
 #define KVED_INDEX_NOT_FOUND 0 
+/** Largest index sector, in words. Indexes are returned as positive int16_t */
+#define KVED_MAX_INDEX_WORDS 0x8000
+/** Largest string sector, in words */
+#define KVED_MAX_STRING_WORDS 0xFFFF
 
 
 typedef struct kved_ctrl_s kved_ctrl_t;
@@ -126,8 +185,18 @@ typedef enum kved_data_types_e
 	KVED_DATA_TYPE_UINT64,    /**< 64 bits, signed */
 	KVED_DATA_TYPE_INT64,     /**< 64 bits, unsigned */
 	KVED_DATA_TYPE_DOUBLE,    /**< Double precision floating point (double) */
+	KVED_DATA_TYPE_UINT8_ARRAY,  /**< Array of 8 bits unsigned values, up to @ref KVED_MAX_ARRAY_SIZE bytes */
+	KVED_DATA_TYPE_UINT16_ARRAY, /**< Array of 16 bits unsigned values, up to @ref KVED_MAX_ARRAY_SIZE bytes */
+	KVED_DATA_TYPE_UINT32_ARRAY, /**< Array of 32 bits unsigned values, up to @ref KVED_MAX_ARRAY_SIZE bytes */
+	KVED_DATA_TYPE_FLOAT_ARRAY,  /**< Array of single precision floats, up to @ref KVED_MAX_ARRAY_SIZE bytes */
+	KVED_DATA_TYPE_DOUBLE_ARRAY, /**< Array of double precision floats, up to @ref KVED_MAX_ARRAY_SIZE bytes */
 } kved_data_types_t;
 
+/** Types whose value is stored in the String Table (the index entry holds the string index) */
+#define KVED_DATA_TYPE_IS_BLOB(t)  ((t) == KVED_DATA_TYPE_STRING || (t) >= KVED_DATA_TYPE_UINT8_ARRAY)
+/** Types holding an array of numeric values */
+#define KVED_DATA_TYPE_IS_ARRAY(t) ((t) >= KVED_DATA_TYPE_UINT8_ARRAY)
+
 /**
 @brief Union with supported data types
 */
@@ -144,6 +213,11 @@ typedef union kved_value_u
 	uint64_t u64; /**< unsigned 64 bits value */
 	int64_t i64; /**< signed 64 bits value */
 	double dbl; /**< double precision float */
+	uint8_t u8a[KVED_MAX_ARRAY_SIZE]; /**< array of unsigned 8 bits values */
+	uint16_t u16a[KVED_MAX_ARRAY_SIZE / sizeof(uint16_t)]; /**< array of unsigned 16 bits values */
+	uint32_t u32a[KVED_MAX_ARRAY_SIZE / sizeof(uint32_t)]; /**< array of unsigned 32 bits values */
+	float flta[KVED_MAX_ARRAY_SIZE / sizeof(float)]; /**< array of single precision floats */
+	double dbla[KVED_MAX_ARRAY_SIZE / sizeof(double)]; /**< array of double precision floats */
 } kved_value_t; 
 
 /**
@@ -154,6 +228,7 @@ typedef struct kved_data_s
 	kved_value_t value;             /**< User value */                  
 	uint8_t key[KVED_MAX_KEY_SIZE]; /**< String used as access key */
 	kved_data_types_t type;         /**< Data type used according to @ref kved_data_types_t */
+	uint16_t size;                  /**< Size in bytes of array values (set by the caller on write, by kved on read) */
 } kved_data_t;
 
 /**
@@ -183,10 +258,33 @@ typedef struct {
   uint32_t (*sector_size)(kved_flash_sector_t sec, void *drv_arg);											/**< Get Table Size */
   bool (*init)( void *drv_arg);																				/**< Init driver */
   uint16_t (*max_entries)(void *drv_arg);																	/**< Max entries in table */
+  const void *(*data_ptr)(kved_flash_sector_t sec, uint16_t index, void *drv_arg);							/**< Optional: pointer to memory mapped data in String Table, NULL if not mapped */
+  uint64_t (*timestamp_us)(void *drv_arg);																	/**< Optional: time source (in us) of the statistics, NULL to count RTOS ticks */
   void *drv_arg;																							/**< Driver argument */		
 } kved_flash_driver_t;
 
 
+/**
+@brief Runtime statistics of a database, see @ref kved_stats_get.
+Counters start at zero when the database is mounted.
+*/
+typedef struct kved_stats_s
+{
+	uint32_t compactions;            /**< Table switches (compactions) since mount */
+	uint32_t compaction_last_us;     /**< Duration of the last compaction, in us */
+	uint32_t compaction_max_us;      /**< Duration of the slowest compaction, in us */
+	uint64_t compaction_last_at_us;  /**< Timestamp of the end of the last compaction */
+	kved_word_t lifetime_compactions; /**< Compactions since the database was formatted (the counter kept in the index header) */
+	uint32_t sector_erases[KVED_FLASH_NUM_SECTORS]; /**< Erases per table since mount */
+	uint32_t string_bytes_total;     /**< Size of the String Table data area */
+	uint32_t string_bytes_allocated; /**< Bytes of the data area written so far, including stale data */
+	uint32_t string_bytes_live;      /**< Bytes of the data area still referenced by a key */
+	uint64_t bytes_written;          /**< Bytes written to the storage since mount */
+	uint64_t user_bytes_written;     /**< Bytes of keys and values written by the application since mount */
+	uint32_t lookups;                /**< Key lookups since mount */
+	uint32_t lookup_probes;          /**< Index entries read by those lookups */
+} kved_stats_t;
+
 typedef enum kved_error_e 
 {
 	KVED_OK = 0,
@@ -197,6 +295,8 @@ typedef enum kved_error_e
 	KVED_TABLE_FULL = -5,
 	KVED_CORRUPT_TABLE = -6,
 	KVED_ERROR = -7,
+	KVED_NOT_SUPPORTED = -8,
+	KVED_BUSY = -9,
 } kved_error_t;
 
 
@@ -253,6 +353,74 @@ if(kved_data_read(&kv2))
 */
 kved_error_t kved_data_read(kved_ctrl_t *ctrl, kved_data_t *data);
 
+/**
+@brief Writes one member of a packed group.
+A packed group is a @ref KVED_DATA_TYPE_UINT64 entry whose value word holds several small
+values, each in its own slice of bits. Updating a member keeps the others, so a group of
+flags or bytes costs a single index entry. Members of a new group start as 0.
+@param[in] data - key of the group, value.u64 holds the value of the member
+@param[in] shift - position of the first bit of the member in the value word
+@param[in] width - number of bits of the member
+@return KVED_OK: recording successful.
+@return KVED_INVALID_KEY: the key exists but is not a packed group.
+@return KVED_ERROR: the slice does not fit in the value word.
+*/
+kved_error_t kved_data_write_slice(kved_ctrl_t *ctrl, kved_data_t *data, uint8_t shift, uint8_t width);
+
+/**
+@brief Reads one member of a packed group, see @ref kved_data_write_slice.
+@param[in,out] data - key of the group, value.u64 receives the value of the member
+@param[in] shift - position of the first bit of the member in the value word
+@param[in] width - number of bits of the member
+@return KVED_OK: read successfully.
+@return KVED_INVALID_KEY: group not found or not a packed group.
+*/
+kved_error_t kved_data_read_slice(kved_ctrl_t *ctrl, kved_data_t *data, uint8_t shift, uint8_t width);
+
+/**
+@brief Retrieves part of an array value, without reading the rest of it.
+@param[in,out] data - structure with the key to look up. On return, type is set and size
+holds the size in bytes of the whole stored array
+@param[in] offset - first byte of the stored array to read
+@param[in] len - number of bytes to read, stored from the start of data->value
+@return KVED_OK: read successfully.
+@return KVED_INVALID_KEY: key not found or not an array.
+@return KVED_INVALID_INDEX: offset + len is past the end of the stored array.
+*/
+kved_error_t kved_data_read_range(kved_ctrl_t *ctrl, kved_data_t *data, uint16_t offset, uint16_t len);
+
+/**
+@brief Retrieves a pointer to a string stored in the database, without copying it.
+Only available if the flash driver maps the String Table into memory (see data_ptr
+in @ref kved_flash_driver_t). The pointer stays valid until the database is compacted,
+which changes the generation returned by @ref kved_generation_get.
+@param[in] data - structure with the key to look up
+@param[out] ref - pointer to the NULL terminated string
+@param[out] len - length of the string, excluding terminator
+@param[out] generation - generation of the database the pointer belongs to
+@return KVED_OK: read successfully.
+@return KVED_INVALID_KEY: key not found or not a string.
+@return KVED_NOT_SUPPORTED: the key exists but the flash driver does not map the String Table.
+*/
+kved_error_t kved_data_read_ref(kved_ctrl_t *ctrl, kved_data_t *data, const uint8_t **ref, uint16_t *len, uint32_t *generation);
+
+/**
+@brief Retrieves the runtime statistics of the database.
+The time base of the compaction durations is the timestamp_us function of the
+flash driver, or the RTOS tick count when the driver has none.
+@param[out] stats - structure where the statistics will be stored
+@return KVED_OK: read successfully.
+*/
+kved_error_t kved_stats_get(kved_ctrl_t *ctrl, kved_stats_t *stats);
+
+/**
+@brief Returns the current generation of the database. 
+The generation changes every time the tables are switched (compacted), invalidating
+any pointer returned by @ref kved_data_read_ref.
+@return Generation
+*/
+uint32_t kved_generation_get(kved_ctrl_t *ctrl);
+
 /**
 @brief Deletes a previously saved value in the database, if it exists.
 @param[in] data - Structure where the retrieved value will be stored (type and content)
@@ -343,6 +511,42 @@ int16_t kved_deleted_entries_get(kved_ctrl_t *ctrl);
  */
 kved_error_t kved_compact_database(kved_ctrl_t *ctrl);
 
+/**
+@brief Starts a bulk import, replacing the whole content of the database.
+Entries are staged with @ref kved_import_add in the spare tables (the ones a compaction
+would switch to), so the current content stays readable and is only replaced when
+@ref kved_import_commit switches tables. A reset before that keeps the old content.
+Until the import is committed or aborted, writes, deletes and compactions return KVED_BUSY.
+@return KVED_OK: import started.
+@return KVED_BUSY: an import is already in progress.
+*/
+kved_error_t kved_import_begin(kved_ctrl_t *ctrl);
+
+/**
+@brief Stages an entry of a bulk import, see @ref kved_import_begin.
+Keys are not looked up: if a key is added twice, the last value wins at commit.
+@param[in] data - entry to add (key, type, value and size of arrays)
+@return KVED_OK: entry staged.
+@return KVED_INVALID_KEY: invalid key.
+@return KVED_TABLE_FULL: no space left in the index or in the String Table.
+@return KVED_ERROR: no import in progress or invalid array size.
+*/
+kved_error_t kved_import_add(kved_ctrl_t *ctrl, kved_data_t *data);
+
+/**
+@brief Switches to the tables staged by a bulk import. Like a compaction, the signatures
+of the new tables are written last, so the switch is atomic across resets.
+Invalidates any pointer from @ref kved_data_read_ref.
+@return KVED_OK: the database holds the imported entries.
+@return KVED_ERROR: no import in progress.
+*/
+kved_error_t kved_import_commit(kved_ctrl_t *ctrl);
+
+/**
+@brief Drops a bulk import, the database keeps its content.
+*/
+kved_error_t kved_import_abort(kved_ctrl_t *ctrl);
+
 /**
 @brief Print all values stored in the database
 */
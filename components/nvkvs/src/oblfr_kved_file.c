@@ -6,6 +6,7 @@ Copyright (c) 2022 Marcelo Barros de Almeida <marcelobarrosalmeida@gmail.com>
 */
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -37,9 +38,12 @@ Copyright (c) 2022 Marcelo Barros de Almeida <marcelobarrosalmeida@gmail.com>
 /*                               no of entries    *   max string size     +   no of idx's      * 2 bytes for index     +  Magic Headers */
 #define FLASH_STR_SECTOR_SIZE ((FLASH_NUM_ENTRIES * KVED_MAX_STRING_SIZE) + (FLASH_NUM_ENTRIES * KVED_FLASH_WORD_SIZE) + (FLASH_NUM_ENTRIES * 2))
 
+#define FLASH_FILE_SIZE ((FLASH_SECTOR_SIZE * 2) + (FLASH_STR_SECTOR_SIZE * 2))
+
 typedef struct file_driver_s {
 	char filename[13];
 	FILE *file;
+	uint8_t *map;	/* read only mapping of the file, emulates the XIP window of the flash */
 } file_driver_t;
 
 
@@ -88,6 +92,7 @@ bool oblfr_kved_file_sector_erase(kved_flash_sector_t sec, void *drv_arg)
 				fwrite(&data, 1, 1, file_driver->file);
 			break;
 	}
+	fflush(file_driver->file);
 	return true;
 }
 
@@ -101,6 +106,7 @@ void oblfr_kved_file_header_write(kved_flash_sector_t sec, uint16_t index, kved_
 	uint16_t addr = get_sector_addr(sec) + get_index_address(index);
 	fseek(file_driver->file, addr, SEEK_SET);
 	fwrite(&data, sizeof(kved_word_t), 1, file_driver->file);
+	fflush(file_driver->file);
 }
 
 kved_word_t oblfr_kved_file_header_read(kved_flash_sector_t sec, uint16_t index, void *drv_arg)
@@ -127,6 +133,7 @@ void oblfr_kved_file_data_write(kved_flash_sector_t sec, uint16_t index, void *d
 	uint16_t addr = get_sector_addr(sec) + get_index_address(index);
 	fseek(file_driver->file, addr, SEEK_SET);
 	fwrite(data, 1, len, file_driver->file);
+	fflush(file_driver->file);
 }
 
 void oblfr_kved_file_data_read(kved_flash_sector_t sec, uint16_t index, void *data, uint16_t len, void *drv_arg)
@@ -141,6 +148,15 @@ void oblfr_kved_file_data_read(kved_flash_sector_t sec, uint16_t index, void *da
 	fread(data, 1, len, file_driver->file);
 }
 
+const void *oblfr_kved_file_data_ptr(kved_flash_sector_t sec, uint16_t index, void *drv_arg)
+{
+	file_driver_t *file_driver = (file_driver_t *)drv_arg;
+	if (file_driver == NULL || file_driver->map == NULL) {
+		return NULL;
+	}
+	return file_driver->map + get_sector_addr(sec) + get_index_address(index);
+}
+
 uint32_t oblfr_kved_file_sector_size(kved_flash_sector_t sec, void *drv_arg)
 {
 	// sector sizes must be equal
@@ -148,11 +164,18 @@ uint32_t oblfr_kved_file_sector_size(kved_flash_sector_t sec, void *drv_arg)
 		return FLASH_STR_SECTOR_SIZE;
 	else if (sec == KVED_FLASH_SECTOR_A || sec == KVED_FLASH_SECTOR_B)
 		return FLASH_SECTOR_SIZE;
+	return 0;
 }
 
-void oblfr_kved_file_init(void *drv_arg)
+bool oblfr_kved_file_init(void *drv_arg)
 {
 	LOG_T("oblfr_kved_file_init()\r\n");
+	return true;
+}
+
+uint16_t oblfr_kved_file_max_entries(void *drv_arg)
+{
+	return FLASH_NUM_ENTRIES;
 }
 
 static kved_flash_driver_t oblfr_kved_file_driver = {
@@ -163,6 +186,8 @@ static kved_flash_driver_t oblfr_kved_file_driver = {
 	.data_read = oblfr_kved_file_data_read,
 	.data_write = oblfr_kved_file_data_write,
 	.sector_size = oblfr_kved_file_sector_size,
+	.max_entries = oblfr_kved_file_max_entries,
+	.data_ptr = oblfr_kved_file_data_ptr,
 };
 
 kved_flash_driver_t *oblfr_kved_file_configure() {
@@ -182,12 +207,27 @@ kved_flash_driver_t *oblfr_kved_file_configure() {
 		LOG_E("Failed to open file %s\r\n", file_driver->filename);
 		return NULL;
 	}
+	/* map the whole file, like the flash is mapped into the XIP window on the target */
+	if (ftruncate(fileno(file_driver->file), FLASH_FILE_SIZE) != 0) {
+		LOG_E("Failed to size file %s: %s\r\n", file_driver->filename, strerror(errno));
+		file_driver->map = NULL;
+	} else {
+		file_driver->map = mmap(NULL, FLASH_FILE_SIZE, PROT_READ, MAP_SHARED, fileno(file_driver->file), 0);
+		if (file_driver->map == MAP_FAILED) {
+			LOG_E("Failed to map file %s: %s\r\n", file_driver->filename, strerror(errno));
+			file_driver->map = NULL;
+		}
+	}
 	oblfr_kved_file_driver.drv_arg = file_driver;
 	return &oblfr_kved_file_driver;
 }
 
 void oblfr_kved_file_close(kved_flash_driver_t *driver) {
 	file_driver_t *file_driver = (file_driver_t *)driver->drv_arg;
+	if (file_driver->map != NULL) {
+		munmap(file_driver->map, FLASH_FILE_SIZE);
+		file_driver->map = NULL;
+	}
 	if (file_driver->file != NULL) {
 		fclose(file_driver->file);
 		file_driver->file = NULL;
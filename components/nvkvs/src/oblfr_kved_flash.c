@@ -12,6 +12,8 @@ Copyright (c) 2022 Marcelo Barros de Almeida <marcelobarrosalmeida@gmail.com>
 #include <stdlib.h>
 #include <assert.h>
 #include <bflb_flash.h>
+#include <bflb_l1c.h>
+#include <bflb_mtimer.h>
 
 #include "oblfr_kved_flash.h"
 
@@ -21,13 +23,22 @@ Copyright (c) 2022 Marcelo Barros de Almeida <marcelobarrosalmeida@gmail.com>
 
 uint32_t oblfr_kved_flash_sector_size(kved_flash_sector_t sec, void *drv_arg);
 
+/* microsecond timer for the KVED statistics */
+static uint64_t oblfr_kved_flash_timestamp_us(void *drv_arg)
+{
+	return bflb_mtimer_get_time_us();
+}
+
 static uint32_t get_sector_addr(kved_flash_sector_t sec, uint16_t index, void *drv_arg) {
 	uint32_t addr = ((oblfr_kved_flash_driver_t *)drv_arg)->flash_addr;
 	uint32_t flash_sector_size = ((oblfr_kved_flash_driver_t *)drv_arg)->flash_sector_size;
 	uint32_t start_addr = ((addr) & (~(flash_sector_size - 1)));
-	uint8_t sectors_required = 0;
+	uint16_t sectors_required = 0;
 	/* all fall through in switch statement */
 	switch (sec) {
+		case KVED_FLASH_NUM_SECTORS:
+			/* end of the partition */
+			sectors_required += (oblfr_kved_flash_sector_size(KVED_FLASH_STRING_SECTOR_B, drv_arg) / flash_sector_size) + 1;
 		case KVED_FLASH_STRING_SECTOR_B:
 			/* calc the size of FLASH_STR_SECTOR_A to figure out the start of string sector b*/
 			sectors_required += (oblfr_kved_flash_sector_size(KVED_FLASH_STRING_SECTOR_A, drv_arg) / flash_sector_size) + 1;
@@ -40,8 +51,6 @@ static uint32_t get_sector_addr(kved_flash_sector_t sec, uint16_t index, void *d
 		case KVED_FLASH_SECTOR_A:
 			/* flash sector A starts at start_addr */
 			break;
-		case KVED_FLASH_NUM_SECTORS:
-			break;
 	}
 	//LOG_D("Sectors required for %d is %d\r\n", sec, sectors_required);
 	//LOG_D("Final Start Address %x\r\n", start_addr + (sectors_required * flash_sector_size));
@@ -49,6 +58,29 @@ static uint32_t get_sector_addr(kved_flash_sector_t sec, uint16_t index, void *d
 	return start_addr + (sectors_required * flash_sector_size) + (sizeof(kved_word_t) * index);
 }
 
+#ifndef FLASH_XIP_END
+/* the XIP window maps 64MB of flash */
+#define FLASH_XIP_END (FLASH_XIP_BASE + 64 * 1024 * 1024)
+#endif
+
+/* address of flash addr in the XIP window, the window starts at the flash offset of our image */
+static void *get_xip_addr(uint32_t addr) {
+	return (void *)(uintptr_t)(FLASH_XIP_BASE + addr - bflb_flash_get_image_offset());
+}
+
+/* the flash range [addr, addr + size) is mapped by the XIP window */
+static bool xip_window_fits(uint32_t addr, uint32_t size) {
+	uint32_t offset = bflb_flash_get_image_offset();
+
+	return addr >= offset && size <= FLASH_XIP_END - FLASH_XIP_BASE && addr - offset <= FLASH_XIP_END - FLASH_XIP_BASE - size;
+}
+
+const void *oblfr_kved_flash_xip_ptr(uint32_t flash_addr) {
+	if (!xip_window_fits(flash_addr, 1))
+		return NULL;
+	return get_xip_addr(flash_addr);
+}
+
 bool oblfr_kved_flash_sector_erase(kved_flash_sector_t sec, void *drv_arg)
 {
 	uint32_t addr = get_sector_addr(sec, 0, drv_arg);
@@ -57,6 +89,8 @@ bool oblfr_kved_flash_sector_erase(kved_flash_sector_t sec, void *drv_arg)
 		LOG_E("Erase Sector %d Failed\r\n", sec);
 		return false;
 	}
+	if (((oblfr_kved_flash_driver_t *)drv_arg)->xip_read)
+		bflb_l1c_dcache_invalidate_range(get_xip_addr(addr), oblfr_kved_flash_sector_size(sec, drv_arg));
 	return true;
 }
 
@@ -67,12 +101,17 @@ void oblfr_kved_flash_header_write(kved_flash_sector_t sec, uint16_t index, kved
 		LOG_E("Write Sector %d Failed\r\n", sec);
 		return;
 	}
+	if (((oblfr_kved_flash_driver_t *)drv_arg)->xip_read)
+		bflb_l1c_dcache_invalidate_range(get_xip_addr(addr), sizeof(kved_word_t));
 }
 
 kved_word_t oblfr_kved_flash_header_read(kved_flash_sector_t sec, uint16_t index, void *drv_arg)
 {
 	uint32_t addr = get_sector_addr(sec, index, drv_arg);
 	kved_word_t data;
+	if (((oblfr_kved_flash_driver_t *)drv_arg)->xip_read) {
+		return *(volatile kved_word_t *)get_xip_addr(addr);
+	}
 	if (bflb_flash_read(addr, (uint8_t*)&data, sizeof(kved_word_t)) != 0) {
 		LOG_E("Read Sector %d Failed\r\n", sec);
 		return 0;
@@ -87,11 +126,17 @@ void oblfr_kved_flash_data_write(kved_flash_sector_t sec, uint16_t index, void *
 		LOG_E("Write Sector %d Failed\r\n", sec);
 		return;
 	}
+	if (((oblfr_kved_flash_driver_t *)drv_arg)->xip_read)
+		bflb_l1c_dcache_invalidate_range(get_xip_addr(addr), len);
 }
 
 void oblfr_kved_flash_data_read(kved_flash_sector_t sec, uint16_t index, void *data, uint16_t len, void *drv_arg)
 {
 	uint32_t addr = get_sector_addr(sec, index, drv_arg);
+	if (((oblfr_kved_flash_driver_t *)drv_arg)->xip_read) {
+		memcpy(data, get_xip_addr(addr), len);
+		return;
+	}
 	if (bflb_flash_read(addr, data, len) != 0) {
 		LOG_E("Read Sector %d Failed\r\n", sec);
 		return;
@@ -99,6 +144,13 @@ void oblfr_kved_flash_data_read(kved_flash_sector_t sec, uint16_t index, void *d
 	return;
 }
 
+const void *oblfr_kved_flash_data_ptr(kved_flash_sector_t sec, uint16_t index, void *drv_arg)
+{
+	if (!((oblfr_kved_flash_driver_t *)drv_arg)->xip_read)
+		return NULL;
+	return get_xip_addr(get_sector_addr(sec, index, drv_arg));
+}
+
 uint32_t oblfr_kved_flash_sector_size(kved_flash_sector_t sec, void *drv_arg)
 {
 	oblfr_kved_flash_driver_t *flash_drv = (oblfr_kved_flash_driver_t *)drv_arg;
@@ -106,37 +158,60 @@ uint32_t oblfr_kved_flash_sector_size(kved_flash_sector_t sec, void *drv_arg)
 	if (sec == KVED_FLASH_STRING_SECTOR_A || sec == KVED_FLASH_STRING_SECTOR_B) {
 				/* No of strings times string size              +  indexes               and 2 magic bytes                */
 		return ( flash_drv->max_entries * KVED_MAX_STRING_SIZE) + ((flash_drv->max_entries + 2) * sizeof(kved_word_t));
-	} else if (sec == KVED_FLASH_SECTOR_A || sec == KVED_FLASH_SECTOR_B)
-		return (flash_drv->flash_sector_size);
+	} else if (sec == KVED_FLASH_SECTOR_A || sec == KVED_FLASH_SECTOR_B) {
+		/* the index spans as many flash sectors as required for max_entries (including the header) */
+		uint32_t index_size = flash_drv->max_entries * sizeof(kved_word_t) * 2;
+		return ((index_size + flash_drv->flash_sector_size - 1) / flash_drv->flash_sector_size) * flash_drv->flash_sector_size;
+	}
 	return 0;
 }
 
-bool oblfr_kved_flash_init(void *drv_arg)
+uint32_t oblfr_kved_flash_erase_size(void)
 {
-	oblfr_kved_flash_driver_t *flash_drv = (oblfr_kved_flash_driver_t *)drv_arg;
     spi_flash_cfg_type flashCfg;
     uint8_t *pFlashCfg = NULL;
     uint32_t flashCfgLen = 0;
 
     bflb_flash_get_cfg(&pFlashCfg, &flashCfgLen);
     arch_memcpy((void *)&flashCfg, pFlashCfg, flashCfgLen);
-	flash_drv->flash_sector_size = (flashCfg.sector_size * 1024);
+	return flashCfg.sector_size * 1024;
+}
+
+/* flash sector size and default number of entries, required to size the tables */
+static void oblfr_kved_flash_geometry(oblfr_kved_flash_driver_t *flash_drv)
+{
+	flash_drv->flash_sector_size = oblfr_kved_flash_erase_size();
 	if (flash_drv->max_entries == 0)
 		flash_drv->max_entries = (flash_drv->flash_sector_size) / (sizeof(kved_word_t) * 2);
-	else {
-		if (flash_drv->max_entries > (flash_drv->flash_sector_size) / (sizeof(kved_word_t) * 2)) {
-			LOG_E("Max Entries %d is greater than sector size %d\r\n", flash_drv->max_entries, flash_drv->flash_sector_size);
-			return false;
-		}
+}
+
+bool oblfr_kved_flash_init(void *drv_arg)
+{
+	oblfr_kved_flash_driver_t *flash_drv = (oblfr_kved_flash_driver_t *)drv_arg;
+
+	oblfr_kved_flash_geometry(flash_drv);
+	if ((oblfr_kved_flash_sector_size(KVED_FLASH_SECTOR_A, drv_arg) / sizeof(kved_word_t)) > KVED_MAX_INDEX_WORDS ||
+		(oblfr_kved_flash_sector_size(KVED_FLASH_STRING_SECTOR_A, drv_arg) / sizeof(kved_word_t)) > KVED_MAX_STRING_WORDS) {
+		LOG_E("Max Entries %d is too large for a KVED Index/String Table\r\n", flash_drv->max_entries);
+		return false;
+	}
+
+	/* the whole partition must be mapped, else read it with bflb_flash_read() */
+	uint32_t start = get_sector_addr(KVED_FLASH_SECTOR_A, 0, drv_arg);
+	if (flash_drv->xip_read && !xip_window_fits(start, get_sector_addr(KVED_FLASH_NUM_SECTORS, 0, drv_arg) - start)) {
+		LOG_W("Flash Partition 0x%x is not in the XIP window, disabling XIP reads\r\n", flash_drv->flash_addr);
+		flash_drv->xip_read = false;
 	}
 
 	LOG_I("Initializing KVED Flash Driver\r\n");
 	LOG_I("Flash Sector Size: %d\r\n", flash_drv->flash_sector_size);
 	LOG_I("Number of entries: %d - Max String Size %d\r\n", flash_drv->max_entries, KVED_MAX_STRING_SIZE);
-	LOG_I("Index Size: %dKB\r\n", oblfr_kved_flash_sector_size(KVED_FLASH_SECTOR_A, drv_arg)/1024);
+	LOG_I("Index Size: %dKB (%d Flash Sectors)\r\n", oblfr_kved_flash_sector_size(KVED_FLASH_SECTOR_A, drv_arg)/1024, oblfr_kved_flash_sector_size(KVED_FLASH_SECTOR_A, drv_arg)/flash_drv->flash_sector_size);
 	LOG_I("String Index Size: %dKB\r\n", oblfr_kved_flash_sector_size(KVED_FLASH_STRING_SECTOR_A, drv_arg)/1024);
-	LOG_I("Total KVED Partition Size: %dKB\r\n", ((oblfr_kved_flash_sector_size(KVED_FLASH_SECTOR_A, drv_arg) * 2) + (oblfr_kved_flash_sector_size(KVED_FLASH_STRING_SECTOR_A, drv_arg) * 2))/1024);
-	LOG_I("Start 0x%x - End 0x%x\r\n", flash_drv->flash_addr, flash_drv->flash_addr + ((oblfr_kved_flash_sector_size(KVED_FLASH_SECTOR_A, drv_arg) * 2) + (oblfr_kved_flash_sector_size(KVED_FLASH_STRING_SECTOR_A, drv_arg) * 2)));
+	LOG_I("Total KVED Partition Size: %dKB\r\n", (get_sector_addr(KVED_FLASH_NUM_SECTORS, 0, drv_arg) - get_sector_addr(KVED_FLASH_SECTOR_A, 0, drv_arg))/1024);
+	if (flash_drv->xip_read)
+		LOG_I("XIP Reads at 0x%x\r\n", (uint32_t)(uintptr_t)get_xip_addr(get_sector_addr(KVED_FLASH_SECTOR_A, 0, drv_arg)));
+	LOG_I("Start 0x%x - End 0x%x\r\n", get_sector_addr(KVED_FLASH_SECTOR_A, 0, drv_arg), get_sector_addr(KVED_FLASH_NUM_SECTORS, 0, drv_arg));
 	return true;
 }
 
@@ -146,25 +221,41 @@ uint16_t oblfr_kved_flash_max_entries(void *drv_arg)
 	return flash_drv->max_entries;
 }
 
-static kved_flash_driver_t oblfr_kved_flash_driver = {
-	.init = oblfr_kved_flash_init,
-	.sector_erase = oblfr_kved_flash_sector_erase,
-	.header_write = oblfr_kved_flash_header_write,
-	.header_read = oblfr_kved_flash_header_read,
-	.data_read = oblfr_kved_flash_data_read,
-	.data_write = oblfr_kved_flash_data_write,
-	.sector_size = oblfr_kved_flash_sector_size,
-	.max_entries = oblfr_kved_flash_max_entries,
-};
+/* a driver instance, the configuration is copied so every instance has its own partition */
+typedef struct oblfr_kved_flash_s {
+	kved_flash_driver_t driver;
+	oblfr_kved_flash_driver_t cfg;
+} oblfr_kved_flash_t;
 
 kved_flash_driver_t *oblfr_kved_flash_configure(oblfr_kved_flash_driver_t *cfg) {
-	
-	oblfr_kved_flash_driver.drv_arg = cfg;
+	oblfr_kved_flash_t *flash = calloc(1, sizeof(oblfr_kved_flash_t));
+	if (flash == NULL) {
+		LOG_E("Failed to allocate KVED Flash Driver\r\n");
+		return NULL;
+	}
+	flash->cfg = *cfg;
+	oblfr_kved_flash_geometry(&flash->cfg);
 
+	flash->driver.init = oblfr_kved_flash_init;
+	flash->driver.sector_erase = oblfr_kved_flash_sector_erase;
+	flash->driver.header_write = oblfr_kved_flash_header_write;
+	flash->driver.header_read = oblfr_kved_flash_header_read;
+	flash->driver.data_read = oblfr_kved_flash_data_read;
+	flash->driver.data_write = oblfr_kved_flash_data_write;
+	flash->driver.sector_size = oblfr_kved_flash_sector_size;
+	flash->driver.max_entries = oblfr_kved_flash_max_entries;
+	flash->driver.data_ptr = oblfr_kved_flash_data_ptr;
+	flash->driver.timestamp_us = oblfr_kved_flash_timestamp_us;
+	flash->driver.drv_arg = &flash->cfg;
 
-	return &oblfr_kved_flash_driver;
+	return &flash->driver;
 }
 
-void oblfr_kved_flash_close(kved_flash_driver_t *driver) {
+uint32_t oblfr_kved_flash_partition_size(kved_flash_driver_t *driver) {
+	return get_sector_addr(KVED_FLASH_NUM_SECTORS, 0, driver->drv_arg) - get_sector_addr(KVED_FLASH_SECTOR_A, 0, driver->drv_arg);
+}
 
+void oblfr_kved_flash_close(kved_flash_driver_t *driver) {
+	/* driver is the first member of oblfr_kved_flash_t */
+	free(driver);
 }
\ No newline at end of file
@@ -35,11 +35,13 @@ Copyright (c) 2022 Marcelo Barros de Almeida <marcelobarrosalmeida@gmail.com>
 /*                               no of entries    *   max string size     +   no of idx's      * 2 bytes for index     +  Magic Headers */
 #define FLASH_STR_SECTOR_SIZE ((FLASH_NUM_ENTRIES * KVED_MAX_STRING_SIZE) + (FLASH_NUM_ENTRIES * KVED_FLASH_WORD_SIZE) + (FLASH_NUM_ENTRIES * 2))
 
-uint32_t *sector_address[KVED_FLASH_NUM_SECTORS];
-uint32_t *data_bank0;
-uint32_t *data_bank1;
-uint32_t *str_bank0;
-uint32_t *str_bank1;
+/* a driver instance, drv_arg points to the sector banks of the instance */
+typedef struct oblfr_kved_memory_s {
+	kved_flash_driver_t driver;
+	uint32_t *sector_address[KVED_FLASH_NUM_SECTORS];
+} oblfr_kved_memory_t;
+
+#define SECTOR_ADDRESS(drv_arg) (((oblfr_kved_memory_t *)(drv_arg))->sector_address)
 
 static uint16_t get_index_address(uint16_t index)
 {
@@ -49,9 +51,9 @@ static uint16_t get_index_address(uint16_t index)
 bool oblfr_kved_memory_sector_erase(kved_flash_sector_t sec, void *drv_arg)
 {
 	if (sec == KVED_FLASH_SECTOR_A || sec == KVED_FLASH_SECTOR_B) {
-		memset(sector_address[sec], 0xFF, FLASH_SECTOR_SIZE);
+		memset(SECTOR_ADDRESS(drv_arg)[sec], 0xFF, FLASH_SECTOR_SIZE);
 	} else if (sec == KVED_FLASH_STRING_SECTOR_A || sec == KVED_FLASH_STRING_SECTOR_B) {
-		memset(sector_address[sec], 0xFF, FLASH_STR_SECTOR_SIZE);
+		memset(SECTOR_ADDRESS(drv_arg)[sec], 0xFF, FLASH_STR_SECTOR_SIZE);
 	} else {
 		return false;
 	}
@@ -61,30 +63,30 @@ bool oblfr_kved_memory_sector_erase(kved_flash_sector_t sec, void *drv_arg)
 
 void oblfr_kved_memory_header_write(kved_flash_sector_t sec, uint16_t index, kved_word_t data, void *drv_arg)
 {
-	sector_address[sec][get_index_address(index)] = ((uint32_t)(data >> 32));
-	sector_address[sec][get_index_address(index) + 1] = (data);
+	SECTOR_ADDRESS(drv_arg)[sec][get_index_address(index)] = ((uint32_t)(data >> 32));
+	SECTOR_ADDRESS(drv_arg)[sec][get_index_address(index) + 1] = (data);
 }
 
 kved_word_t oblfr_kved_memory_header_read(kved_flash_sector_t sec, uint16_t index, void *drv_arg)
 {
-	kved_word_t data = ((kved_word_t)sector_address[sec][get_index_address(index)] << 32) | sector_address[sec][get_index_address(index) + 1];
+	kved_word_t data = ((kved_word_t)SECTOR_ADDRESS(drv_arg)[sec][get_index_address(index)] << 32) | SECTOR_ADDRESS(drv_arg)[sec][get_index_address(index) + 1];
 	return data;
 }
 
 void oblfr_kved_memory_data_write(kved_flash_sector_t sec, uint16_t index, void *data, uint16_t len, void *drv_arg)
 {
-	for (int i = 0; i < len; i++)
-	{
-		sector_address[sec][get_index_address(index) + i] = ((uint32_t *)data)[i];
-	}
+	/* len is in bytes */
+	memcpy(&SECTOR_ADDRESS(drv_arg)[sec][get_index_address(index)], data, len);
 }
 
 void oblfr_kved_memory_data_read(kved_flash_sector_t sec, uint16_t index, void *data, uint16_t len, void *drv_arg)
 {
-	for (int i = 0; i < len; i++)
-	{
-		((uint32_t *)data)[i] = sector_address[sec][get_index_address(index) + i];
-	}
+	memcpy(data, &SECTOR_ADDRESS(drv_arg)[sec][get_index_address(index)], len);
+}
+
+const void *oblfr_kved_memory_data_ptr(kved_flash_sector_t sec, uint16_t index, void *drv_arg)
+{
+	return &SECTOR_ADDRESS(drv_arg)[sec][get_index_address(index)];
 }
 
 uint32_t oblfr_kved_memory_sector_size(kved_flash_sector_t sec, void *drv_arg)
@@ -111,45 +113,51 @@ uint16_t oblfr_kved_memory_max_entries(void *drv_arg)
 }
 
 
-static kved_flash_driver_t oblfr_kved_memory_driver = {
-	.init = oblfr_kved_memory_init,
-	.sector_erase = oblfr_kved_memory_sector_erase,
-	.header_write = oblfr_kved_memory_header_write,
-	.header_read = oblfr_kved_memory_header_read,
-	.data_read = oblfr_kved_memory_data_read,
-	.data_write = oblfr_kved_memory_data_write,
-	.sector_size = oblfr_kved_memory_sector_size,
-	.max_entries = oblfr_kved_memory_max_entries,
-};
-
 kved_flash_driver_t *oblfr_kved_memory_configure() {
-	
-
-	data_bank0 = malloc(FLASH_SECTOR_SIZE);
-	data_bank1 = malloc(FLASH_SECTOR_SIZE);
-	str_bank0 = malloc(FLASH_STR_SECTOR_SIZE);
-	str_bank1 = malloc(FLASH_STR_SECTOR_SIZE);
+	oblfr_kved_memory_t *mem = calloc(1, sizeof(oblfr_kved_memory_t));
+	if (mem == NULL) {
+		LOG_E("Failed to allocate KVED Memory Driver\r\n");
+		return NULL;
+	}
+	/* set first, oblfr_kved_memory_close() frees the banks through it */
+	mem->driver.drv_arg = mem;
+
+	mem->sector_address[KVED_FLASH_SECTOR_A] = malloc(FLASH_SECTOR_SIZE);
+	mem->sector_address[KVED_FLASH_SECTOR_B] = malloc(FLASH_SECTOR_SIZE);
+	mem->sector_address[KVED_FLASH_STRING_SECTOR_A] = malloc(FLASH_STR_SECTOR_SIZE);
+	mem->sector_address[KVED_FLASH_STRING_SECTOR_B] = malloc(FLASH_STR_SECTOR_SIZE);
+	for (int i = 0; i < KVED_FLASH_NUM_SECTORS; i++) {
+		if (mem->sector_address[i] == NULL) {
+			LOG_E("Failed to allocate KVED Memory Banks\r\n");
+			oblfr_kved_memory_close(&mem->driver);
+			return NULL;
+		}
+	}
 
 	LOG_I("Allocated %d memory for Main Table Size - Max Entries: %d\r\n", FLASH_SECTOR_SIZE * 2, (FLASH_NUM_ENTRIES/2)-1);
 	LOG_I("Allocated %ld memory for String Table Size - Max String Size: %ld\r\n", FLASH_STR_SECTOR_SIZE * 2, KVED_MAX_STRING_SIZE);
-	sector_address[KVED_FLASH_SECTOR_A] = data_bank0;
-	sector_address[KVED_FLASH_SECTOR_B] = data_bank1;
-	sector_address[KVED_FLASH_STRING_SECTOR_A] = str_bank0;
-	sector_address[KVED_FLASH_STRING_SECTOR_B] = str_bank1;
-
-	oblfr_kved_memory_sector_erase(KVED_FLASH_SECTOR_A, sector_address);
-	oblfr_kved_memory_sector_erase(KVED_FLASH_SECTOR_B, sector_address);
-	oblfr_kved_memory_sector_erase(KVED_FLASH_STRING_SECTOR_A, sector_address);
-	oblfr_kved_memory_sector_erase(KVED_FLASH_STRING_SECTOR_B, sector_address);
-
-	oblfr_kved_memory_driver.drv_arg = sector_address;
 
-	return &oblfr_kved_memory_driver;
+	mem->driver.init = oblfr_kved_memory_init;
+	mem->driver.sector_erase = oblfr_kved_memory_sector_erase;
+	mem->driver.header_write = oblfr_kved_memory_header_write;
+	mem->driver.header_read = oblfr_kved_memory_header_read;
+	mem->driver.data_read = oblfr_kved_memory_data_read;
+	mem->driver.data_write = oblfr_kved_memory_data_write;
+	mem->driver.sector_size = oblfr_kved_memory_sector_size;
+	mem->driver.max_entries = oblfr_kved_memory_max_entries;
+	mem->driver.data_ptr = oblfr_kved_memory_data_ptr;
+
+	oblfr_kved_memory_sector_erase(KVED_FLASH_SECTOR_A, mem);
+	oblfr_kved_memory_sector_erase(KVED_FLASH_SECTOR_B, mem);
+	oblfr_kved_memory_sector_erase(KVED_FLASH_STRING_SECTOR_A, mem);
+	oblfr_kved_memory_sector_erase(KVED_FLASH_STRING_SECTOR_B, mem);
+
+	return &mem->driver;
 }
 
 void oblfr_kved_memory_close(kved_flash_driver_t *driver) {
-	free(sector_address[KVED_FLASH_SECTOR_A]);
-	free(sector_address[KVED_FLASH_SECTOR_B]);
-	free(sector_address[KVED_FLASH_STRING_SECTOR_A]);
-	free(sector_address[KVED_FLASH_STRING_SECTOR_B]);
+	oblfr_kved_memory_t *mem = (oblfr_kved_memory_t *)driver->drv_arg;
+	for (int i = 0; i < KVED_FLASH_NUM_SECTORS; i++)
+		free(mem->sector_address[i]);
+	free(mem);
 }
\ No newline at end of file
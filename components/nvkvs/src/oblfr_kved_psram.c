@@ -0,0 +1,394 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <bflb_flash.h>
+#include <bflb_l1c.h>
+#include <bflb_mtimer.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "oblfr_kved_psram.h"
+#include "oblfr_kved_flash.h"
+#include "oblfr_nvkvs_crc.h"
+
+
+#define DBG_TAG "KVED_PSRAM"
+#include "log.h"
+
+#define PSRAM_IMAGE_MAGIC   0x504B564E /* "NVKP" */
+#define PSRAM_IMAGE_VERSION 1
+
+/* header in front of the tables, in PSRAM and in each flash mirror slot */
+typedef struct oblfr_kved_psram_hdr_s {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t max_entries;
+	uint32_t image_size;    /* size of the tables after the header */
+	uint32_t seq;           /* mirror sequence number, the newest valid slot is restored */
+	uint32_t image_crc;     /* CRC-32 of the tables, only used in the flash mirror */
+	uint32_t reserved[2];
+	uint32_t hdr_crc;       /* CRC-32 of the fields above */
+} oblfr_kved_psram_hdr_t;
+
+/* a driver instance */
+typedef struct oblfr_kved_psram_s {
+	kved_flash_driver_t driver;
+	oblfr_kved_psram_driver_t cfg;
+	oblfr_kved_psram_hdr_t *hdr;
+	uint8_t *sector_address[KVED_FLASH_NUM_SECTORS];
+	uint8_t *snapshot;
+	uint32_t image_size;
+	uint32_t slot_size;         /* size of a mirror slot, in whole flash sectors */
+	uint8_t slot;               /* slot of the newest mirror */
+	uint32_t seq;               /* sequence number of the newest mirror */
+	volatile bool dirty;        /* tables changed since the last snapshot */
+	uint64_t dirty_since_us;
+	SemaphoreHandle_t lock;         /* writes vs. taking a snapshot */
+	SemaphoreHandle_t mirror_lock;  /* mirror task vs. oblfr_kved_psram_sync() */
+	TaskHandle_t task;
+} oblfr_kved_psram_t;
+
+static void oblfr_kved_psram_hdr_seal(oblfr_kved_psram_t *psram, oblfr_kved_psram_hdr_t *hdr, uint32_t seq, uint32_t image_crc)
+{
+	memset(hdr, 0, sizeof(oblfr_kved_psram_hdr_t));
+	hdr->magic = PSRAM_IMAGE_MAGIC;
+	hdr->version = PSRAM_IMAGE_VERSION;
+	hdr->max_entries = psram->cfg.max_entries;
+	hdr->image_size = psram->image_size;
+	hdr->seq = seq;
+	hdr->image_crc = image_crc;
+	hdr->hdr_crc = oblfr_nvkvs_crc32((const uint8_t *)hdr, offsetof(oblfr_kved_psram_hdr_t, hdr_crc));
+}
+
+static bool oblfr_kved_psram_hdr_valid(oblfr_kved_psram_t *psram, const oblfr_kved_psram_hdr_t *hdr)
+{
+	return hdr->magic == PSRAM_IMAGE_MAGIC && hdr->version == PSRAM_IMAGE_VERSION &&
+		hdr->max_entries == psram->cfg.max_entries && hdr->image_size == psram->image_size &&
+		hdr->hdr_crc == oblfr_nvkvs_crc32((const uint8_t *)hdr, offsetof(oblfr_kved_psram_hdr_t, hdr_crc));
+}
+
+static uint32_t oblfr_kved_psram_slot_addr(oblfr_kved_psram_t *psram, uint8_t slot)
+{
+	return psram->cfg.mirror_flash_addr + (slot * psram->slot_size);
+}
+
+/* called with the lock held after every change of the tables */
+static void oblfr_kved_psram_touch(oblfr_kved_psram_t *psram, void *addr, uint32_t len)
+{
+	/* write back the cache, so the change survives a soft reset */
+	bflb_l1c_dcache_clean_range(addr, len);
+	if (!psram->dirty) {
+		psram->dirty = true;
+		psram->dirty_since_us = bflb_mtimer_get_time_us();
+		if (psram->task != NULL)
+			xTaskNotifyGive(psram->task);
+	}
+}
+
+/* copy the tables to the older mirror slot. Writes are only blocked while taking the snapshot */
+static bool oblfr_kved_psram_mirror(oblfr_kved_psram_t *psram)
+{
+	oblfr_kved_psram_hdr_t hdr;
+	bool ret = true;
+
+	xSemaphoreTake(psram->mirror_lock, portMAX_DELAY);
+	xSemaphoreTake(psram->lock, portMAX_DELAY);
+	if (!psram->dirty) {
+		xSemaphoreGive(psram->lock);
+		xSemaphoreGive(psram->mirror_lock);
+		return true;
+	}
+	memcpy(psram->snapshot, psram->sector_address[KVED_FLASH_SECTOR_A], psram->image_size);
+	psram->dirty = false;
+	xSemaphoreGive(psram->lock);
+
+	uint8_t slot = psram->slot ^ 1;
+	uint32_t addr = oblfr_kved_psram_slot_addr(psram, slot);
+	oblfr_kved_psram_hdr_seal(psram, &hdr, psram->seq + 1, oblfr_nvkvs_crc32(psram->snapshot, psram->image_size));
+	/* the header goes last, a slot without a valid header is ignored at boot */
+	if (bflb_flash_erase(addr, psram->slot_size) != 0 ||
+		bflb_flash_write(addr + sizeof(hdr), psram->snapshot, psram->image_size) != 0 ||
+		bflb_flash_write(addr, (uint8_t *)&hdr, sizeof(hdr)) != 0) {
+		LOG_E("Mirror to Flash 0x%x Failed\r\n", addr);
+		/* try again after the next window */
+		xSemaphoreTake(psram->lock, portMAX_DELAY);
+		psram->dirty = true;
+		psram->dirty_since_us = bflb_mtimer_get_time_us();
+		xSemaphoreGive(psram->lock);
+		ret = false;
+	} else {
+		psram->slot = slot;
+		psram->seq = hdr.seq;
+		LOG_D("Mirrored to Slot %d - Seq %d\r\n", slot, hdr.seq);
+	}
+	xSemaphoreGive(psram->mirror_lock);
+	return ret;
+}
+
+static void oblfr_kved_psram_task(void *arg)
+{
+	oblfr_kved_psram_t *psram = (oblfr_kved_psram_t *)arg;
+	TickType_t wait;
+
+	for (;;) {
+		wait = portMAX_DELAY;
+		if (psram->dirty) {
+			uint32_t age_ms = (uint32_t)((bflb_mtimer_get_time_us() - psram->dirty_since_us) / 1000);
+			if (age_ms >= psram->cfg.mirror_window_ms) {
+				oblfr_kved_psram_mirror(psram);
+				continue;
+			}
+			wait = pdMS_TO_TICKS(psram->cfg.mirror_window_ms - age_ms);
+		}
+		ulTaskNotifyTake(pdTRUE, wait);
+	}
+}
+
+static uint8_t *get_addr(kved_flash_sector_t sec, uint16_t index, void *drv_arg)
+{
+	return ((oblfr_kved_psram_t *)drv_arg)->sector_address[sec] + (sizeof(kved_word_t) * index);
+}
+
+uint32_t oblfr_kved_psram_sector_size(kved_flash_sector_t sec, void *drv_arg)
+{
+	oblfr_kved_psram_t *psram = (oblfr_kved_psram_t *)drv_arg;
+	// sector sizes must be equal
+	if (sec == KVED_FLASH_STRING_SECTOR_A || sec == KVED_FLASH_STRING_SECTOR_B)
+		return (psram->cfg.max_entries * KVED_MAX_STRING_SIZE) + ((psram->cfg.max_entries + 2) * sizeof(kved_word_t));
+	else if (sec == KVED_FLASH_SECTOR_A || sec == KVED_FLASH_SECTOR_B)
+		return psram->cfg.max_entries * sizeof(kved_word_t) * 2;
+	return 0;
+}
+
+bool oblfr_kved_psram_sector_erase(kved_flash_sector_t sec, void *drv_arg)
+{
+	oblfr_kved_psram_t *psram = (oblfr_kved_psram_t *)drv_arg;
+
+	if (sec >= KVED_FLASH_NUM_SECTORS)
+		return false;
+	xSemaphoreTake(psram->lock, portMAX_DELAY);
+	memset(psram->sector_address[sec], 0xFF, oblfr_kved_psram_sector_size(sec, drv_arg));
+	oblfr_kved_psram_touch(psram, psram->sector_address[sec], oblfr_kved_psram_sector_size(sec, drv_arg));
+	xSemaphoreGive(psram->lock);
+	return true;
+}
+
+void oblfr_kved_psram_header_write(kved_flash_sector_t sec, uint16_t index, kved_word_t data, void *drv_arg)
+{
+	oblfr_kved_psram_t *psram = (oblfr_kved_psram_t *)drv_arg;
+	uint8_t *addr = get_addr(sec, index, drv_arg);
+
+	xSemaphoreTake(psram->lock, portMAX_DELAY);
+	memcpy(addr, &data, sizeof(kved_word_t));
+	oblfr_kved_psram_touch(psram, addr, sizeof(kved_word_t));
+	xSemaphoreGive(psram->lock);
+}
+
+kved_word_t oblfr_kved_psram_header_read(kved_flash_sector_t sec, uint16_t index, void *drv_arg)
+{
+	kved_word_t data;
+	memcpy(&data, get_addr(sec, index, drv_arg), sizeof(kved_word_t));
+	return data;
+}
+
+void oblfr_kved_psram_data_write(kved_flash_sector_t sec, uint16_t index, void *data, uint16_t len, void *drv_arg)
+{
+	oblfr_kved_psram_t *psram = (oblfr_kved_psram_t *)drv_arg;
+	uint8_t *addr = get_addr(sec, index, drv_arg);
+
+	xSemaphoreTake(psram->lock, portMAX_DELAY);
+	memcpy(addr, data, len);
+	oblfr_kved_psram_touch(psram, addr, len);
+	xSemaphoreGive(psram->lock);
+}
+
+void oblfr_kved_psram_data_read(kved_flash_sector_t sec, uint16_t index, void *data, uint16_t len, void *drv_arg)
+{
+	memcpy(data, get_addr(sec, index, drv_arg), len);
+}
+
+const void *oblfr_kved_psram_data_ptr(kved_flash_sector_t sec, uint16_t index, void *drv_arg)
+{
+	return get_addr(sec, index, drv_arg);
+}
+
+uint16_t oblfr_kved_psram_max_entries(void *drv_arg)
+{
+	return ((oblfr_kved_psram_t *)drv_arg)->cfg.max_entries;
+}
+
+static uint64_t oblfr_kved_psram_timestamp_us(void *drv_arg)
+{
+	return bflb_mtimer_get_time_us();
+}
+
+/* newest mirror slot with a valid header, -1 if there is none */
+static int oblfr_kved_psram_newest_slot(oblfr_kved_psram_t *psram, oblfr_kved_psram_hdr_t *newest)
+{
+	oblfr_kved_psram_hdr_t hdr;
+	int found = -1;
+
+	for (uint8_t slot = 0; slot < 2; slot++) {
+		if (bflb_flash_read(oblfr_kved_psram_slot_addr(psram, slot), (uint8_t *)&hdr, sizeof(hdr)) != 0)
+			continue;
+		if (!oblfr_kved_psram_hdr_valid(psram, &hdr))
+			continue;
+		if (found < 0 || (int32_t)(hdr.seq - newest->seq) > 0) {
+			*newest = hdr;
+			found = slot;
+		}
+	}
+	return found;
+}
+
+/* restore the tables from the newest mirror slot that passes the CRC check */
+static bool oblfr_kved_psram_restore(oblfr_kved_psram_t *psram)
+{
+	oblfr_kved_psram_hdr_t hdr;
+	uint8_t *tables = psram->sector_address[KVED_FLASH_SECTOR_A];
+
+	for (uint8_t tries = 0; tries < 2; tries++) {
+		int slot = oblfr_kved_psram_newest_slot(psram, &hdr);
+		if (slot < 0)
+			return false;
+		if (bflb_flash_read(oblfr_kved_psram_slot_addr(psram, slot) + sizeof(hdr), tables, psram->image_size) == 0 &&
+			oblfr_nvkvs_crc32(tables, psram->image_size) == hdr.image_crc) {
+			psram->slot = slot;
+			psram->seq = hdr.seq;
+			LOG_I("Restored from Flash Mirror Slot %d - Seq %d\r\n", slot, hdr.seq);
+			return true;
+		}
+		LOG_W("Flash Mirror Slot %d is corrupted\r\n", slot);
+		/* drop the bad slot, the other one is tried next */
+		bflb_flash_erase(oblfr_kved_psram_slot_addr(psram, slot), psram->slot_size);
+	}
+	return false;
+}
+
+bool oblfr_kved_psram_init(void *drv_arg)
+{
+	oblfr_kved_psram_t *psram = (oblfr_kved_psram_t *)drv_arg;
+	oblfr_kved_psram_hdr_t mirror_hdr;
+
+	if ((oblfr_kved_psram_sector_size(KVED_FLASH_SECTOR_A, drv_arg) / sizeof(kved_word_t)) > KVED_MAX_INDEX_WORDS ||
+		(oblfr_kved_psram_sector_size(KVED_FLASH_STRING_SECTOR_A, drv_arg) / sizeof(kved_word_t)) > KVED_MAX_STRING_WORDS) {
+		LOG_E("Max Entries %d is too large for a KVED Index/String Table\r\n", psram->cfg.max_entries);
+		return false;
+	}
+
+	LOG_I("Initializing KVED PSRAM Driver\r\n");
+	LOG_I("Number of entries: %d - Max String Size %d\r\n", psram->cfg.max_entries, KVED_MAX_STRING_SIZE);
+	LOG_I("PSRAM Image at 0x%x - %dKB\r\n", (uint32_t)(uintptr_t)psram->cfg.psram_addr, oblfr_kved_psram_size(&psram->driver)/1024);
+	LOG_I("Flash Mirror at 0x%x - %dKB - Window %dms\r\n", psram->cfg.mirror_flash_addr, oblfr_kved_psram_mirror_size(&psram->driver)/1024, psram->cfg.mirror_window_ms);
+
+	int slot = oblfr_kved_psram_newest_slot(psram, &mirror_hdr);
+	if (oblfr_kved_psram_hdr_valid(psram, psram->hdr)) {
+		/* warm boot, PSRAM may hold changes that did not reach the mirror yet */
+		LOG_I("Using PSRAM Image from before the reset\r\n");
+		psram->slot = slot < 0 ? 1 : slot;
+		psram->seq = slot < 0 ? 0 : mirror_hdr.seq;
+		psram->dirty = true;
+	} else {
+		if (!oblfr_kved_psram_restore(psram)) {
+			/* nothing to restore, KVED formats the erased tables */
+			LOG_W("No valid Flash Mirror, starting empty\r\n");
+			memset(psram->sector_address[KVED_FLASH_SECTOR_A], 0xFF, psram->image_size);
+			psram->slot = 1;
+			psram->seq = 0;
+		}
+		oblfr_kved_psram_hdr_seal(psram, psram->hdr, 0, 0);
+		bflb_l1c_dcache_clean_range(psram->hdr, sizeof(oblfr_kved_psram_hdr_t) + psram->image_size);
+		psram->dirty = false;
+	}
+	psram->dirty_since_us = bflb_mtimer_get_time_us();
+
+	if (xTaskCreate(oblfr_kved_psram_task, "nvkvs_mirror", 1024, psram, 2, &psram->task) != pdPASS) {
+		LOG_E("Failed to create Mirror Task\r\n");
+		return false;
+	}
+	return true;
+}
+
+kved_flash_driver_t *oblfr_kved_psram_configure(oblfr_kved_psram_driver_t *cfg) {
+	oblfr_kved_psram_t *psram = calloc(1, sizeof(oblfr_kved_psram_t));
+	if (psram == NULL) {
+		LOG_E("Failed to allocate KVED PSRAM Driver\r\n");
+		return NULL;
+	}
+	psram->cfg = *cfg;
+	if (psram->cfg.max_entries == 0)
+		psram->cfg.max_entries = 255;
+	if (psram->cfg.mirror_window_ms == 0)
+		psram->cfg.mirror_window_ms = CONFIG_COMPONENT_NVKVS_PSRAM_MIRROR_WINDOW_MS;
+
+	/* tables are placed one after another after the header, then the snapshot */
+	psram->hdr = (oblfr_kved_psram_hdr_t *)psram->cfg.psram_addr;
+	psram->image_size = 0;
+	for (int i = 0; i < KVED_FLASH_NUM_SECTORS; i++) {
+		psram->sector_address[i] = (uint8_t *)psram->cfg.psram_addr + sizeof(oblfr_kved_psram_hdr_t) + psram->image_size;
+		psram->image_size += oblfr_kved_psram_sector_size(i, psram);
+	}
+	psram->snapshot = psram->sector_address[KVED_FLASH_SECTOR_A] + psram->image_size;
+
+	uint32_t flash_sector_size = oblfr_kved_flash_erase_size();
+	psram->slot_size = ((sizeof(oblfr_kved_psram_hdr_t) + psram->image_size + flash_sector_size - 1) / flash_sector_size) * flash_sector_size;
+
+	psram->lock = xSemaphoreCreateMutex();
+	psram->mirror_lock = xSemaphoreCreateMutex();
+	if (psram->lock == NULL || psram->mirror_lock == NULL) {
+		LOG_E("Failed to allocate KVED PSRAM Driver Locks\r\n");
+		oblfr_kved_psram_close(&psram->driver);
+		return NULL;
+	}
+
+	psram->driver.init = oblfr_kved_psram_init;
+	psram->driver.sector_erase = oblfr_kved_psram_sector_erase;
+	psram->driver.header_write = oblfr_kved_psram_header_write;
+	psram->driver.header_read = oblfr_kved_psram_header_read;
+	psram->driver.data_read = oblfr_kved_psram_data_read;
+	psram->driver.data_write = oblfr_kved_psram_data_write;
+	psram->driver.sector_size = oblfr_kved_psram_sector_size;
+	psram->driver.max_entries = oblfr_kved_psram_max_entries;
+	psram->driver.data_ptr = oblfr_kved_psram_data_ptr;
+	psram->driver.timestamp_us = oblfr_kved_psram_timestamp_us;
+	psram->driver.drv_arg = psram;
+
+	return &psram->driver;
+}
+
+uint32_t oblfr_kved_psram_size(kved_flash_driver_t *driver) {
+	oblfr_kved_psram_t *psram = (oblfr_kved_psram_t *)driver->drv_arg;
+	return sizeof(oblfr_kved_psram_hdr_t) + (psram->image_size * 2);
+}
+
+uint32_t oblfr_kved_psram_mirror_size(kved_flash_driver_t *driver) {
+	oblfr_kved_psram_t *psram = (oblfr_kved_psram_t *)driver->drv_arg;
+	return psram->slot_size * 2;
+}
+
+bool oblfr_kved_psram_sync(kved_flash_driver_t *driver) {
+	return oblfr_kved_psram_mirror((oblfr_kved_psram_t *)driver->drv_arg);
+}
+
+void oblfr_kved_psram_close(kved_flash_driver_t *driver) {
+	/* driver is the first member of oblfr_kved_psram_t */
+	oblfr_kved_psram_t *psram = (oblfr_kved_psram_t *)driver;
+
+	if (psram->task != NULL) {
+		/* stop the task outside of a mirror, then write what is left */
+		xSemaphoreTake(psram->mirror_lock, portMAX_DELAY);
+		vTaskDelete(psram->task);
+		psram->task = NULL;
+		xSemaphoreGive(psram->mirror_lock);
+		oblfr_kved_psram_mirror(psram);
+	}
+	if (psram->lock != NULL)
+		vSemaphoreDelete(psram->lock);
+	if (psram->mirror_lock != NULL)
+		vSemaphoreDelete(psram->mirror_lock);
+	free(psram);
+}
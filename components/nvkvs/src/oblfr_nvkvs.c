@@ -8,17 +8,123 @@
 #include "oblfr_nvkvs.h"
 #include "oblfr_kved_flash.h"
 #include "oblfr_kved_memory.h"
+#include "oblfr_kved_psram.h"
+#include "oblfr_nvkvs_crc.h"
+#ifdef CONFIG_COMPONENT_NVKVS_FACTORY
+#include "oblfr_nvkvs_factory.h"
+#endif
 
 #define DBG_TAG "NVKVS"
 #include "log.h"
 
-typedef struct oblfr_nvkvs_handle_s
+typedef struct oblfr_nvkvs_shard_s
 {
     kved_flash_driver_t *storage_driver;
-    oblfr_nvkvs_storage_t storage;
     kved_ctrl_t *kved_ctrl;
+} oblfr_nvkvs_shard_t;
+
+typedef struct oblfr_nvkvs_handle_s
+{
+    oblfr_nvkvs_storage_t storage;
+    uint8_t num_shards;
+    oblfr_nvkvs_shard_t *shards;
+    const void *factory;
 } oblfr_nvkvs_handle_t;
 
+/* Iterators encode the shard in the upper 16 bits and the KVED index in the lower 16 bits */
+#define NVKVS_ITER_ENCODE(shard, index) (((int32_t)(shard) << 16) | (index))
+#define NVKVS_ITER_SHARD(iter) ((iter) >> 16)
+#define NVKVS_ITER_INDEX(iter) ((iter) & 0xFFFF)
+
+/* FNV-1a over the key as stored by KVED (truncated to KVED_MAX_KEY_SIZE) */
+static uint8_t oblfr_nvkvs_key_to_shard(oblfr_nvkvs_handle_t *handle, const char *key)
+{
+    uint32_t h = 0x811C9DC5;
+
+    if (handle->num_shards == 1)
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < KVED_MAX_KEY_SIZE && key[i] != 0; i++)
+    {
+        h ^= (uint8_t)key[i];
+        h *= 0x01000193;
+    }
+    return h % handle->num_shards;
+}
+
+static kved_ctrl_t *oblfr_nvkvs_key_to_ctrl(oblfr_nvkvs_handle_t *handle, const char *key)
+{
+    return handle->shards[oblfr_nvkvs_key_to_shard(handle, key)].kved_ctrl;
+}
+
+#ifdef CONFIG_COMPONENT_NVKVS_FACTORY
+/* entry of a key in the read-only factory partition, NULL if there is none */
+static const oblfr_nvkvs_factory_entry_t *oblfr_nvkvs_factory_lookup(oblfr_nvkvs_handle_t *handle, const char *key)
+{
+    if (handle->factory == NULL)
+    {
+        return NULL;
+    }
+    return oblfr_nvkvs_factory_find(handle->factory, key);
+}
+#endif
+
+/* size of a scalar value, 0 for strings and arrays */
+static size_t oblfr_nvkvs_scalar_size(kved_data_types_t type)
+{
+    switch (type)
+    {
+    case KVED_DATA_TYPE_UINT8:
+    case KVED_DATA_TYPE_INT8:
+        return sizeof(uint8_t);
+    case KVED_DATA_TYPE_UINT16:
+    case KVED_DATA_TYPE_INT16:
+        return sizeof(uint16_t);
+    case KVED_DATA_TYPE_UINT32:
+    case KVED_DATA_TYPE_INT32:
+        return sizeof(uint32_t);
+    case KVED_DATA_TYPE_FLOAT:
+        return sizeof(float);
+    case KVED_DATA_TYPE_UINT64:
+    case KVED_DATA_TYPE_INT64:
+        return sizeof(uint64_t);
+    case KVED_DATA_TYPE_DOUBLE:
+        return sizeof(double);
+    default:
+        return 0;
+    }
+}
+
+/* read a key from its shard, keys that were never written fall back to the factory partition,
+   which must hold the type of kv unless any_type is set */
+static kved_error_t oblfr_nvkvs_data_read(oblfr_nvkvs_handle_t *handle, const char *key, kved_data_t *kv, bool any_type)
+{
+#ifdef CONFIG_COMPONENT_NVKVS_FACTORY
+    kved_data_types_t type = kv->type;
+#endif
+    kved_error_t err = kved_data_read(oblfr_nvkvs_key_to_ctrl(handle, key), kv);
+#ifdef CONFIG_COMPONENT_NVKVS_FACTORY
+    if (err == KVED_INVALID_KEY)
+    {
+        const oblfr_nvkvs_factory_entry_t *entry = oblfr_nvkvs_factory_lookup(handle, key);
+        if (entry != NULL && !any_type && entry->type != type)
+        {
+            LOG_W("%s: factory value is not of this type (%d)\r\n", key, entry->type);
+            return KVED_INVALID_KEY;
+        }
+        if (entry != NULL && entry->len <= sizeof(kv->value))
+        {
+            kv->type = entry->type;
+            kv->size = entry->len;
+            memcpy(&kv->value, oblfr_nvkvs_factory_value(handle->factory, entry), entry->len);
+            return KVED_OK;
+        }
+    }
+#endif
+    return err;
+}
+
 oblfr_nvkvs_handle_t *oblfr_nvkvs_init(const oblfr_nvkvs_cfg_t *cfg)
 {
     if (cfg == NULL)
@@ -33,32 +139,93 @@ oblfr_nvkvs_handle_t *oblfr_nvkvs_init(const oblfr_nvkvs_cfg_t *cfg)
         LOG_E("Failed to allocate memory for handle");
         return NULL;
     }
+    handle->storage = cfg->storage;
+    handle->num_shards = cfg->shards > 0 ? cfg->shards : 1;
+    handle->shards = calloc(handle->num_shards, sizeof(oblfr_nvkvs_shard_t));
+    if (handle->shards == NULL)
+    {
+        LOG_E("Failed to allocate memory for shards");
+        free(handle);
+        return NULL;
+    }
 
-    switch (cfg->storage)
+#ifdef CONFIG_COMPONENT_NVKVS_FLASH_BACKEND
+    uint32_t flash_addr = (cfg->storage == OBLFR_NVKVS_STORAGE_FLASH) ? cfg->drv_cfg.flash->flash_addr : 0;
+#endif
+#ifdef CONFIG_COMPONENT_NVKVS_PSRAM_BACKEND
+    oblfr_kved_psram_driver_t psram_cfg;
+    if (cfg->storage == OBLFR_NVKVS_STORAGE_PSRAM)
     {
+        psram_cfg = *cfg->drv_cfg.psram;
+    }
+#endif
+    for (uint8_t i = 0; i < handle->num_shards; i++)
+    {
+        oblfr_nvkvs_shard_t *shard = &handle->shards[i];
+
+        switch (cfg->storage)
+        {
 #ifdef CONFIG_COMPONENT_NVKVS_FLASH_BACKEND
-    case OBLFR_NVKVS_STORAGE_FLASH:
-        handle->storage_driver = oblfr_kved_flash_configure(cfg->drv_cfg.flash);
-        break;
+        case OBLFR_NVKVS_STORAGE_FLASH:
+        {
+            /* each shard gets its own partition, directly after the previous one */
+            oblfr_kved_flash_driver_t shard_cfg = *cfg->drv_cfg.flash;
+            shard_cfg.flash_addr = flash_addr;
+            shard->storage_driver = oblfr_kved_flash_configure(&shard_cfg);
+            if (shard->storage_driver != NULL)
+            {
+                flash_addr += oblfr_kved_flash_partition_size(shard->storage_driver);
+            }
+            break;
+        }
 #endif
 #ifdef CONFIG_COMPONENT_NVKVS_MEM_BACKEND
-    case OBLFR_NVKVS_STORAGE_RAM:
-        handle->storage_driver = oblfr_kved_memory_configure();
-        break;
+        case OBLFR_NVKVS_STORAGE_RAM:
+            shard->storage_driver = oblfr_kved_memory_configure();
+            break;
 #endif
-    default:
-        LOG_E("Invalid storage type");
-        return NULL;
-    }
-    handle->storage = cfg->storage;
+#ifdef CONFIG_COMPONENT_NVKVS_PSRAM_BACKEND
+        case OBLFR_NVKVS_STORAGE_PSRAM:
+            /* each shard gets its own PSRAM image and flash mirror, directly after the previous one */
+            shard->storage_driver = oblfr_kved_psram_configure(&psram_cfg);
+            if (shard->storage_driver != NULL)
+            {
+                psram_cfg.psram_addr = (uint8_t *)psram_cfg.psram_addr + oblfr_kved_psram_size(shard->storage_driver);
+                psram_cfg.mirror_flash_addr += oblfr_kved_psram_mirror_size(shard->storage_driver);
+            }
+            break;
+#endif
+        default:
+            LOG_E("Invalid storage type");
+            oblfr_nvkvs_deinit(handle);
+            return NULL;
+        }
+        if (shard->storage_driver == NULL)
+        {
+            LOG_E("Failed to configure storage for shard %d\r\n", i);
+            oblfr_nvkvs_deinit(handle);
+            return NULL;
+        }
 
-    handle->kved_ctrl = kved_init(handle->storage_driver);
-    if (handle->kved_ctrl == NULL)
+        shard->kved_ctrl = kved_init(shard->storage_driver);
+        if (shard->kved_ctrl == NULL)
+        {
+            LOG_E("Failed to initialize KVED for shard %d\r\n", i);
+            oblfr_nvkvs_deinit(handle);
+            return NULL;
+        }
+    }
+    if (handle->num_shards > 1)
     {
-        LOG_E("Failed to initialize KVED");
-        oblfr_nvkvs_deinit(handle);
-        return NULL;
+        LOG_I("NVKVS using %d shards\r\n", handle->num_shards);
+    }
+    handle->factory = NULL;
+#ifdef CONFIG_COMPONENT_NVKVS_FACTORY
+    if (cfg->factory != NULL && oblfr_nvkvs_factory_valid(cfg->factory))
+    {
+        handle->factory = cfg->factory;
     }
+#endif
 
     return handle;
 }
@@ -69,18 +236,37 @@ oblfr_err_t oblfr_nvkvs_deinit(oblfr_nvkvs_handle_t *handle)
     {
         return OBLFR_ERR_INVALID;
     }
-    kved_deinit(handle->kved_ctrl);
-    switch (handle->storage)
+    for (uint8_t i = 0; i < handle->num_shards; i++)
     {
-    case OBLFR_NVKVS_STORAGE_FLASH:
-        oblfr_kved_flash_close(handle->storage_driver);
-        break;
-    case OBLFR_NVKVS_STORAGE_RAM:
-        oblfr_kved_memory_close(handle->storage_driver);
-        break;
-    default:
-        return OBLFR_ERR_INVALID;
+        oblfr_nvkvs_shard_t *shard = &handle->shards[i];
+
+        kved_deinit(shard->kved_ctrl);
+        if (shard->storage_driver == NULL)
+        {
+            continue;
+        }
+        switch (handle->storage)
+        {
+#ifdef CONFIG_COMPONENT_NVKVS_FLASH_BACKEND
+        case OBLFR_NVKVS_STORAGE_FLASH:
+            oblfr_kved_flash_close(shard->storage_driver);
+            break;
+#endif
+#ifdef CONFIG_COMPONENT_NVKVS_MEM_BACKEND
+        case OBLFR_NVKVS_STORAGE_RAM:
+            oblfr_kved_memory_close(shard->storage_driver);
+            break;
+#endif
+#ifdef CONFIG_COMPONENT_NVKVS_PSRAM_BACKEND
+        case OBLFR_NVKVS_STORAGE_PSRAM:
+            oblfr_kved_psram_close(shard->storage_driver);
+            break;
+#endif
+        default:
+            break;
+        }
     }
+    free(handle->shards);
     free(handle);
 
     return OBLFR_OK;
@@ -92,7 +278,14 @@ oblfr_err_t oblfr_nvkvs_dump(oblfr_nvkvs_handle_t *handle)
     {
         return OBLFR_ERR_INVALID;
     }
-    kved_dump(handle->kved_ctrl);
+    for (uint8_t i = 0; i < handle->num_shards; i++)
+    {
+        if (handle->num_shards > 1)
+        {
+            printf("SHARD %d\r\n", i);
+        }
+        kved_dump(handle->shards[i].kved_ctrl);
+    }
     return OBLFR_OK;
 }
 
@@ -101,12 +294,41 @@ oblfr_err_t oblfr_nvkvs_compact(oblfr_nvkvs_handle_t *handle) {
     {
         return OBLFR_ERR_INVALID;
     }
-    if (kved_compact_database(handle->kved_ctrl) != KVED_OK) {
-        return OBLFR_ERR_ERROR;
+    for (uint8_t i = 0; i < handle->num_shards; i++)
+    {
+        if (kved_compact_database(handle->shards[i].kved_ctrl) != KVED_OK) {
+            return OBLFR_ERR_ERROR;
+        }
     }
     return OBLFR_OK;
 }
 
+oblfr_err_t oblfr_nvkvs_sync(oblfr_nvkvs_handle_t *handle)
+{
+    if (handle == NULL)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    switch (handle->storage)
+    {
+    case OBLFR_NVKVS_STORAGE_FLASH:
+        return OBLFR_OK;
+#ifdef CONFIG_COMPONENT_NVKVS_PSRAM_BACKEND
+    case OBLFR_NVKVS_STORAGE_PSRAM:
+        for (uint8_t i = 0; i < handle->num_shards; i++)
+        {
+            if (!oblfr_kved_psram_sync(handle->shards[i].storage_driver))
+            {
+                return OBLFR_ERR_ERROR;
+            }
+        }
+        return OBLFR_OK;
+#endif
+    default:
+        return OBLFR_ERR_NOTSUPPORTED;
+    }
+}
+
 
 oblfr_err_t oblfr_nvkvs_set_u8(oblfr_nvkvs_handle_t *handle, const char *key, uint8_t value)
 {
@@ -118,7 +340,7 @@ oblfr_err_t oblfr_nvkvs_set_u8(oblfr_nvkvs_handle_t *handle, const char *key, ui
         .type = KVED_DATA_TYPE_UINT8,
         .value.u8 = value};
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_write(handle->kved_ctrl, &kv1);
+    kved_error_t err = kved_data_write(oblfr_nvkvs_key_to_ctrl(handle, key), &kv1);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_write failed %d\r\n", err);
@@ -136,7 +358,7 @@ oblfr_err_t oblfr_nvkvs_get_u8(oblfr_nvkvs_handle_t *handle, const char *key, ui
         .type = KVED_DATA_TYPE_UINT8,
     };
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_read(handle->kved_ctrl, &kv1);
+    kved_error_t err = oblfr_nvkvs_data_read(handle, key, &kv1, false);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_read failed %d\r\n", err);
@@ -155,7 +377,7 @@ oblfr_err_t oblfr_nvkvs_set_i8(oblfr_nvkvs_handle_t *handle, const char *key, in
         .type = KVED_DATA_TYPE_INT8,
         .value.i8 = value};
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_write(handle->kved_ctrl, &kv1);
+    kved_error_t err = kved_data_write(oblfr_nvkvs_key_to_ctrl(handle, key), &kv1);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_write failed %d\r\n", err);
@@ -173,7 +395,7 @@ oblfr_err_t oblfr_nvkvs_get_i8(oblfr_nvkvs_handle_t *handle, const char *key, in
         .type = KVED_DATA_TYPE_INT8,
     };
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_read(handle->kved_ctrl, &kv1);
+    kved_error_t err = oblfr_nvkvs_data_read(handle, key, &kv1, false);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_read failed %d\r\n", err);
@@ -192,7 +414,7 @@ oblfr_err_t oblfr_nvkvs_set_u16(oblfr_nvkvs_handle_t *handle, const char *key, u
         .type = KVED_DATA_TYPE_UINT16,
         .value.u16 = value};
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_write(handle->kved_ctrl, &kv1);
+    kved_error_t err = kved_data_write(oblfr_nvkvs_key_to_ctrl(handle, key), &kv1);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_write failed %d\r\n", err);
@@ -210,7 +432,7 @@ oblfr_err_t oblfr_nvkvs_get_u16(oblfr_nvkvs_handle_t *handle, const char *key, u
         .type = KVED_DATA_TYPE_UINT16,
     };
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_read(handle->kved_ctrl, &kv1);
+    kved_error_t err = oblfr_nvkvs_data_read(handle, key, &kv1, false);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_read failed %d\r\n", err);
@@ -229,7 +451,7 @@ oblfr_err_t oblfr_nvkvs_set_i16(oblfr_nvkvs_handle_t *handle, const char *key, i
         .type = KVED_DATA_TYPE_INT16,
         .value.i16 = value};
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_write(handle->kved_ctrl, &kv1);
+    kved_error_t err = kved_data_write(oblfr_nvkvs_key_to_ctrl(handle, key), &kv1);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_write failed %d\r\n", err);
@@ -247,7 +469,7 @@ oblfr_err_t oblfr_nvkvs_get_i16(oblfr_nvkvs_handle_t *handle, const char *key, i
         .type = KVED_DATA_TYPE_INT16,
     };
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_read(handle->kved_ctrl, &kv1);
+    kved_error_t err = oblfr_nvkvs_data_read(handle, key, &kv1, false);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_read failed %d\r\n", err);
@@ -266,7 +488,7 @@ oblfr_err_t oblfr_nvkvs_set_u32(oblfr_nvkvs_handle_t *handle, const char *key, u
         .type = KVED_DATA_TYPE_UINT32,
         .value.u32 = value};
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_write(handle->kved_ctrl, &kv1);
+    kved_error_t err = kved_data_write(oblfr_nvkvs_key_to_ctrl(handle, key), &kv1);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_write failed %d\r\n", err);
@@ -284,7 +506,7 @@ oblfr_err_t oblfr_nvkvs_get_u32(oblfr_nvkvs_handle_t *handle, const char *key, u
         .type = KVED_DATA_TYPE_UINT32,
     };
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_read(handle->kved_ctrl, &kv1);
+    kved_error_t err = oblfr_nvkvs_data_read(handle, key, &kv1, false);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_read failed %d\r\n", err);
@@ -303,7 +525,7 @@ oblfr_err_t oblfr_nvkvs_set_i32(oblfr_nvkvs_handle_t *handle, const char *key, i
         .type = KVED_DATA_TYPE_INT32,
         .value.i32 = value};
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_write(handle->kved_ctrl, &kv1);
+    kved_error_t err = kved_data_write(oblfr_nvkvs_key_to_ctrl(handle, key), &kv1);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_write failed %d\r\n", err);
@@ -321,7 +543,7 @@ oblfr_err_t oblfr_nvkvs_get_i32(oblfr_nvkvs_handle_t *handle, const char *key, i
         .type = KVED_DATA_TYPE_INT32,
     };
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_read(handle->kved_ctrl, &kv1);
+    kved_error_t err = oblfr_nvkvs_data_read(handle, key, &kv1, false);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_read failed %d\r\n", err);
@@ -340,7 +562,7 @@ oblfr_err_t oblfr_nvkvs_set_u64(oblfr_nvkvs_handle_t *handle, const char *key, u
         .type = KVED_DATA_TYPE_UINT64,
         .value.u64 = value};
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_write(handle->kved_ctrl, &kv1);
+    kved_error_t err = kved_data_write(oblfr_nvkvs_key_to_ctrl(handle, key), &kv1);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_write failed %d\r\n", err);
@@ -358,7 +580,7 @@ oblfr_err_t oblfr_nvkvs_get_u64(oblfr_nvkvs_handle_t *handle, const char *key, u
         .type = KVED_DATA_TYPE_UINT64,
     };
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_read(handle->kved_ctrl, &kv1);
+    kved_error_t err = oblfr_nvkvs_data_read(handle, key, &kv1, false);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_read failed %d\r\n", err);
@@ -377,7 +599,7 @@ oblfr_err_t oblfr_nvkvs_set_i64(oblfr_nvkvs_handle_t *handle, const char *key, i
         .type = KVED_DATA_TYPE_INT64,
         .value.i64 = value};
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_write(handle->kved_ctrl, &kv1);
+    kved_error_t err = kved_data_write(oblfr_nvkvs_key_to_ctrl(handle, key), &kv1);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_write failed %d\r\n", err);
@@ -395,7 +617,7 @@ oblfr_err_t oblfr_nvkvs_get_i64(oblfr_nvkvs_handle_t *handle, const char *key, i
         .type = KVED_DATA_TYPE_INT64,
     };
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_read(handle->kved_ctrl, &kv1);
+    kved_error_t err = oblfr_nvkvs_data_read(handle, key, &kv1, false);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_read failed %d\r\n", err);
@@ -414,7 +636,7 @@ oblfr_err_t oblfr_nvkvs_set_float(oblfr_nvkvs_handle_t *handle, const char *key,
         .type = KVED_DATA_TYPE_FLOAT,
         .value.flt = value};
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_write(handle->kved_ctrl, &kv1);
+    kved_error_t err = kved_data_write(oblfr_nvkvs_key_to_ctrl(handle, key), &kv1);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_write failed %d\r\n", err);
@@ -432,7 +654,7 @@ oblfr_err_t oblfr_nvkvs_get_float(oblfr_nvkvs_handle_t *handle, const char *key,
         .type = KVED_DATA_TYPE_FLOAT,
     };
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_read(handle->kved_ctrl, &kv1);
+    kved_error_t err = oblfr_nvkvs_data_read(handle, key, &kv1, false);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_read failed %d\r\n", err);
@@ -451,7 +673,7 @@ oblfr_err_t oblfr_nvkvs_set_double(oblfr_nvkvs_handle_t *handle, const char *key
         .type = KVED_DATA_TYPE_DOUBLE,
         .value.dbl = value};
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_write(handle->kved_ctrl, &kv1);
+    kved_error_t err = kved_data_write(oblfr_nvkvs_key_to_ctrl(handle, key), &kv1);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_write failed %d\r\n", err);
@@ -469,7 +691,7 @@ oblfr_err_t oblfr_nvkvs_get_double(oblfr_nvkvs_handle_t *handle, const char *key
         .type = KVED_DATA_TYPE_DOUBLE,
     };
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_read(handle->kved_ctrl, &kv1);
+    kved_error_t err = oblfr_nvkvs_data_read(handle, key, &kv1, false);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_read failed %d\r\n", err);
@@ -493,7 +715,7 @@ oblfr_err_t oblfr_nvkvs_set_string(oblfr_nvkvs_handle_t *handle, const char *key
     };
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
     strncpy((char *)kv1.value.str, value, CONFIG_COMPONENT_NVKVS_MAX_STRING_SIZE);
-    kved_error_t err = kved_data_write(handle->kved_ctrl, &kv1);
+    kved_error_t err = kved_data_write(oblfr_nvkvs_key_to_ctrl(handle, key), &kv1);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_write failed %d\r\n", err);
@@ -512,7 +734,7 @@ oblfr_err_t oblfr_nvkvs_get_string(oblfr_nvkvs_handle_t *handle, const char *key
         .type = KVED_DATA_TYPE_STRING,
     };
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_read(handle->kved_ctrl, &kv1);
+    kved_error_t err = oblfr_nvkvs_data_read(handle, key, &kv1, false);
     if (err != KVED_OK)
     {
         LOG_E("kved_data_read failed %d\r\n", err);
@@ -522,6 +744,370 @@ oblfr_err_t oblfr_nvkvs_get_string(oblfr_nvkvs_handle_t *handle, const char *key
     return OBLFR_OK;
 }
 
+oblfr_err_t oblfr_nvkvs_get_string_ref(oblfr_nvkvs_handle_t *handle, const char *key, const char **value, size_t *len, uint32_t *generation)
+{
+    if (handle == NULL || value == NULL || len == NULL)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    if (strlen(key) > KVED_MAX_KEY_SIZE)
+    {
+        LOG_E("key is too long");
+        return OBLFR_ERR_INVALID;
+    }
+    kved_data_t kv1 = {
+        .type = KVED_DATA_TYPE_STRING,
+    };
+    strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
+    const uint8_t *ref;
+    uint16_t reflen;
+    uint32_t gen;
+    kved_error_t err = kved_data_read_ref(oblfr_nvkvs_key_to_ctrl(handle, key), &kv1, &ref, &reflen, &gen);
+#ifdef CONFIG_COMPONENT_NVKVS_FACTORY
+    if (err == KVED_INVALID_KEY)
+    {
+        /* the factory partition is never compacted, its pointers stay valid */
+        const oblfr_nvkvs_factory_entry_t *entry = oblfr_nvkvs_factory_lookup(handle, key);
+        if (entry != NULL && entry->type == KVED_DATA_TYPE_STRING && entry->len > 0)
+        {
+            *value = (const char *)oblfr_nvkvs_factory_value(handle->factory, entry);
+            *len = entry->len - 1;
+            if (generation != NULL)
+            {
+                *generation = oblfr_nvkvs_get_generation(handle);
+            }
+            return OBLFR_OK;
+        }
+    }
+#endif
+    if (err == KVED_NOT_SUPPORTED)
+    {
+        return OBLFR_ERR_NOTSUPPORTED;
+    }
+    if (err != KVED_OK)
+    {
+        LOG_E("kved_data_read_ref failed %d\r\n", err);
+        return OBLFR_ERR_ERROR;
+    }
+    *value = (const char *)ref;
+    *len = reflen;
+    if (generation != NULL)
+    {
+        /* the handle generation is the sum of all shards, use the one read with the string for its own shard */
+        uint8_t own = oblfr_nvkvs_key_to_shard(handle, key);
+        for (uint8_t i = 0; i < handle->num_shards; i++)
+        {
+            if (i != own)
+            {
+                gen += kved_generation_get(handle->shards[i].kved_ctrl);
+            }
+        }
+        *generation = gen;
+    }
+    return OBLFR_OK;
+}
+
+uint32_t oblfr_nvkvs_get_generation(oblfr_nvkvs_handle_t *handle)
+{
+    uint32_t gen = 0;
+    for (uint8_t i = 0; i < handle->num_shards; i++)
+    {
+        gen += kved_generation_get(handle->shards[i].kved_ctrl);
+    }
+    return gen;
+}
+
+static oblfr_err_t oblfr_nvkvs_set_packed(oblfr_nvkvs_handle_t *handle, const char *group, uint8_t shift, uint8_t width, uint64_t value)
+{
+    if (handle == NULL || strlen(group) > KVED_MAX_KEY_SIZE)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    kved_data_t kv1 = {
+        .value.u64 = value};
+    strncpy((char *)kv1.key, group, KVED_MAX_KEY_SIZE);
+    kved_error_t err = kved_data_write_slice(oblfr_nvkvs_key_to_ctrl(handle, group), &kv1, shift, width);
+    if (err == KVED_INVALID_KEY)
+    {
+        LOG_W("%s is not a packed group\r\n", group);
+        return OBLFR_ERR_INVALID;
+    }
+    if (err != KVED_OK)
+    {
+        LOG_E("kved_data_write_slice failed %d\r\n", err);
+        return OBLFR_ERR_ERROR;
+    }
+    return OBLFR_OK;
+}
+
+static oblfr_err_t oblfr_nvkvs_get_packed(oblfr_nvkvs_handle_t *handle, const char *group, uint8_t shift, uint8_t width, uint64_t *value)
+{
+    if (handle == NULL || strlen(group) > KVED_MAX_KEY_SIZE)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    kved_data_t kv1 = {
+    };
+    strncpy((char *)kv1.key, group, KVED_MAX_KEY_SIZE);
+    kved_error_t err = kved_data_read_slice(oblfr_nvkvs_key_to_ctrl(handle, group), &kv1, shift, width);
+#ifdef CONFIG_COMPONENT_NVKVS_FACTORY
+    if (err == KVED_INVALID_KEY)
+    {
+        const oblfr_nvkvs_factory_entry_t *entry = oblfr_nvkvs_factory_lookup(handle, group);
+        if (entry != NULL && entry->type == KVED_DATA_TYPE_UINT64 && entry->len == sizeof(uint64_t))
+        {
+            uint64_t word;
+            memcpy(&word, oblfr_nvkvs_factory_value(handle->factory, entry), sizeof(word));
+            *value = (word >> shift) & (width >= 64 ? UINT64_MAX : ((1ULL << width) - 1));
+            return OBLFR_OK;
+        }
+    }
+#endif
+    if (err != KVED_OK)
+    {
+        LOG_E("kved_data_read_slice failed %d\r\n", err);
+        return OBLFR_ERR_ERROR;
+    }
+    *value = kv1.value.u64;
+    return OBLFR_OK;
+}
+
+oblfr_err_t oblfr_nvkvs_set_packed_bool(oblfr_nvkvs_handle_t *handle, const char *group, uint8_t slot, bool value)
+{
+    if (slot >= OBLFR_NVKVS_PACKED_BOOL_SLOTS)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    return oblfr_nvkvs_set_packed(handle, group, slot * 1, 1, value);
+}
+oblfr_err_t oblfr_nvkvs_get_packed_bool(oblfr_nvkvs_handle_t *handle, const char *group, uint8_t slot, bool *value)
+{
+    uint64_t v;
+    if (slot >= OBLFR_NVKVS_PACKED_BOOL_SLOTS || value == NULL)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    oblfr_err_t ret = oblfr_nvkvs_get_packed(handle, group, slot * 1, 1, &v);
+    if (ret == OBLFR_OK)
+    {
+        *value = v;
+    }
+    return ret;
+}
+oblfr_err_t oblfr_nvkvs_set_packed_u8(oblfr_nvkvs_handle_t *handle, const char *group, uint8_t slot, uint8_t value)
+{
+    if (slot >= OBLFR_NVKVS_PACKED_U8_SLOTS)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    return oblfr_nvkvs_set_packed(handle, group, slot * 8, 8, value);
+}
+oblfr_err_t oblfr_nvkvs_get_packed_u8(oblfr_nvkvs_handle_t *handle, const char *group, uint8_t slot, uint8_t *value)
+{
+    uint64_t v;
+    if (slot >= OBLFR_NVKVS_PACKED_U8_SLOTS || value == NULL)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    oblfr_err_t ret = oblfr_nvkvs_get_packed(handle, group, slot * 8, 8, &v);
+    if (ret == OBLFR_OK)
+    {
+        *value = v;
+    }
+    return ret;
+}
+oblfr_err_t oblfr_nvkvs_set_packed_u16(oblfr_nvkvs_handle_t *handle, const char *group, uint8_t slot, uint16_t value)
+{
+    if (slot >= OBLFR_NVKVS_PACKED_U16_SLOTS)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    return oblfr_nvkvs_set_packed(handle, group, slot * 16, 16, value);
+}
+oblfr_err_t oblfr_nvkvs_get_packed_u16(oblfr_nvkvs_handle_t *handle, const char *group, uint8_t slot, uint16_t *value)
+{
+    uint64_t v;
+    if (slot >= OBLFR_NVKVS_PACKED_U16_SLOTS || value == NULL)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    oblfr_err_t ret = oblfr_nvkvs_get_packed(handle, group, slot * 16, 16, &v);
+    if (ret == OBLFR_OK)
+    {
+        *value = v;
+    }
+    return ret;
+}
+
+static oblfr_err_t oblfr_nvkvs_set_array(oblfr_nvkvs_handle_t *handle, const char *key, kved_data_types_t type, const void *value, size_t count, size_t elem_size)
+{
+    if (handle == NULL || value == NULL || strlen(key) > KVED_MAX_KEY_SIZE)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    if (count == 0 || count * elem_size > KVED_MAX_ARRAY_SIZE)
+    {
+        LOG_E("array size %d invalid\r\n", count * elem_size);
+        return OBLFR_ERR_INVALID;
+    }
+    kved_data_t kv1 = {
+        .type = type,
+        .size = count * elem_size,
+    };
+    strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
+    memcpy(kv1.value.u8a, value, kv1.size);
+    kved_error_t err = kved_data_write(oblfr_nvkvs_key_to_ctrl(handle, key), &kv1);
+    if (err != KVED_OK)
+    {
+        LOG_E("kved_data_write failed %d\r\n", err);
+        return OBLFR_ERR_ERROR;
+    }
+    return OBLFR_OK;
+}
+
+static oblfr_err_t oblfr_nvkvs_get_array(oblfr_nvkvs_handle_t *handle, const char *key, kved_data_types_t type, void *value, size_t *count, size_t elem_size)
+{
+    if (handle == NULL || value == NULL || count == NULL || strlen(key) > KVED_MAX_KEY_SIZE)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    kved_data_t kv1 = {
+        .type = type,
+    };
+    strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
+    kved_error_t err = oblfr_nvkvs_data_read(handle, key, &kv1, false);
+    if (err != KVED_OK)
+    {
+        LOG_E("kved_data_read failed %d\r\n", err);
+        return OBLFR_ERR_ERROR;
+    }
+    if (kv1.type != type)
+    {
+        LOG_W("%s is not an array of this type (%d)\r\n", key, kv1.type);
+        return OBLFR_ERR_INVALID;
+    }
+    size_t stored = kv1.size / elem_size;
+    if (stored > *count)
+    {
+        *count = stored;
+        return OBLFR_ERR_NOMEM;
+    }
+    memcpy(value, kv1.value.u8a, kv1.size);
+    *count = stored;
+    return OBLFR_OK;
+}
+
+static oblfr_err_t oblfr_nvkvs_get_array_range(oblfr_nvkvs_handle_t *handle, const char *key, kved_data_types_t type, size_t first, void *value, size_t count, size_t elem_size)
+{
+    if (handle == NULL || value == NULL || strlen(key) > KVED_MAX_KEY_SIZE)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    /* checked without a product, which could wrap */
+    if (first > KVED_MAX_ARRAY_SIZE / elem_size || count > KVED_MAX_ARRAY_SIZE / elem_size - first)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    kved_data_t kv1 = {
+        .type = type,
+    };
+    strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
+    kved_error_t err = kved_data_read_range(oblfr_nvkvs_key_to_ctrl(handle, key), &kv1, first * elem_size, count * elem_size);
+#ifdef CONFIG_COMPONENT_NVKVS_FACTORY
+    if (err == KVED_INVALID_KEY)
+    {
+        const oblfr_nvkvs_factory_entry_t *entry = oblfr_nvkvs_factory_lookup(handle, key);
+        if (entry != NULL && entry->type == type)
+        {
+            if ((first + count) * elem_size > entry->len)
+            {
+                return OBLFR_ERR_INVALID;
+            }
+            memcpy(value, oblfr_nvkvs_factory_value(handle->factory, entry) + first * elem_size, count * elem_size);
+            return OBLFR_OK;
+        }
+    }
+#endif
+    if (err == KVED_INVALID_INDEX)
+    {
+        LOG_W("%s: range %d-%d past the end of the array\r\n", key, first, first + count);
+        return OBLFR_ERR_INVALID;
+    }
+    if (err != KVED_OK)
+    {
+        LOG_E("kved_data_read_range failed %d\r\n", err);
+        return OBLFR_ERR_ERROR;
+    }
+    if (kv1.type != type)
+    {
+        LOG_W("%s is not an array of this type (%d)\r\n", key, kv1.type);
+        return OBLFR_ERR_INVALID;
+    }
+    memcpy(value, kv1.value.u8a, count * elem_size);
+    return OBLFR_OK;
+}
+
+oblfr_err_t oblfr_nvkvs_set_u8_array(oblfr_nvkvs_handle_t *handle, const char *key, const uint8_t *value, size_t count)
+{
+    return oblfr_nvkvs_set_array(handle, key, KVED_DATA_TYPE_UINT8_ARRAY, value, count, sizeof(uint8_t));
+}
+oblfr_err_t oblfr_nvkvs_get_u8_array(oblfr_nvkvs_handle_t *handle, const char *key, uint8_t *value, size_t *count)
+{
+    return oblfr_nvkvs_get_array(handle, key, KVED_DATA_TYPE_UINT8_ARRAY, value, count, sizeof(uint8_t));
+}
+oblfr_err_t oblfr_nvkvs_get_u8_array_range(oblfr_nvkvs_handle_t *handle, const char *key, size_t first, uint8_t *value, size_t count)
+{
+    return oblfr_nvkvs_get_array_range(handle, key, KVED_DATA_TYPE_UINT8_ARRAY, first, value, count, sizeof(uint8_t));
+}
+oblfr_err_t oblfr_nvkvs_set_u16_array(oblfr_nvkvs_handle_t *handle, const char *key, const uint16_t *value, size_t count)
+{
+    return oblfr_nvkvs_set_array(handle, key, KVED_DATA_TYPE_UINT16_ARRAY, value, count, sizeof(uint16_t));
+}
+oblfr_err_t oblfr_nvkvs_get_u16_array(oblfr_nvkvs_handle_t *handle, const char *key, uint16_t *value, size_t *count)
+{
+    return oblfr_nvkvs_get_array(handle, key, KVED_DATA_TYPE_UINT16_ARRAY, value, count, sizeof(uint16_t));
+}
+oblfr_err_t oblfr_nvkvs_get_u16_array_range(oblfr_nvkvs_handle_t *handle, const char *key, size_t first, uint16_t *value, size_t count)
+{
+    return oblfr_nvkvs_get_array_range(handle, key, KVED_DATA_TYPE_UINT16_ARRAY, first, value, count, sizeof(uint16_t));
+}
+oblfr_err_t oblfr_nvkvs_set_u32_array(oblfr_nvkvs_handle_t *handle, const char *key, const uint32_t *value, size_t count)
+{
+    return oblfr_nvkvs_set_array(handle, key, KVED_DATA_TYPE_UINT32_ARRAY, value, count, sizeof(uint32_t));
+}
+oblfr_err_t oblfr_nvkvs_get_u32_array(oblfr_nvkvs_handle_t *handle, const char *key, uint32_t *value, size_t *count)
+{
+    return oblfr_nvkvs_get_array(handle, key, KVED_DATA_TYPE_UINT32_ARRAY, value, count, sizeof(uint32_t));
+}
+oblfr_err_t oblfr_nvkvs_get_u32_array_range(oblfr_nvkvs_handle_t *handle, const char *key, size_t first, uint32_t *value, size_t count)
+{
+    return oblfr_nvkvs_get_array_range(handle, key, KVED_DATA_TYPE_UINT32_ARRAY, first, value, count, sizeof(uint32_t));
+}
+oblfr_err_t oblfr_nvkvs_set_float_array(oblfr_nvkvs_handle_t *handle, const char *key, const float *value, size_t count)
+{
+    return oblfr_nvkvs_set_array(handle, key, KVED_DATA_TYPE_FLOAT_ARRAY, value, count, sizeof(float));
+}
+oblfr_err_t oblfr_nvkvs_get_float_array(oblfr_nvkvs_handle_t *handle, const char *key, float *value, size_t *count)
+{
+    return oblfr_nvkvs_get_array(handle, key, KVED_DATA_TYPE_FLOAT_ARRAY, value, count, sizeof(float));
+}
+oblfr_err_t oblfr_nvkvs_get_float_array_range(oblfr_nvkvs_handle_t *handle, const char *key, size_t first, float *value, size_t count)
+{
+    return oblfr_nvkvs_get_array_range(handle, key, KVED_DATA_TYPE_FLOAT_ARRAY, first, value, count, sizeof(float));
+}
+oblfr_err_t oblfr_nvkvs_set_double_array(oblfr_nvkvs_handle_t *handle, const char *key, const double *value, size_t count)
+{
+    return oblfr_nvkvs_set_array(handle, key, KVED_DATA_TYPE_DOUBLE_ARRAY, value, count, sizeof(double));
+}
+oblfr_err_t oblfr_nvkvs_get_double_array(oblfr_nvkvs_handle_t *handle, const char *key, double *value, size_t *count)
+{
+    return oblfr_nvkvs_get_array(handle, key, KVED_DATA_TYPE_DOUBLE_ARRAY, value, count, sizeof(double));
+}
+oblfr_err_t oblfr_nvkvs_get_double_array_range(oblfr_nvkvs_handle_t *handle, const char *key, size_t first, double *value, size_t count)
+{
+    return oblfr_nvkvs_get_array_range(handle, key, KVED_DATA_TYPE_DOUBLE_ARRAY, first, value, count, sizeof(double));
+}
+
 oblfr_err_t oblfr_nvkvs_delete(oblfr_nvkvs_handle_t *handle, const char *key)
 {
     if (strlen(key) > KVED_MAX_KEY_SIZE)
@@ -531,7 +1117,7 @@ oblfr_err_t oblfr_nvkvs_delete(oblfr_nvkvs_handle_t *handle, const char *key)
     kved_data_t kv1 = {
     };
     strncpy((char *)kv1.key, key, KVED_MAX_KEY_SIZE);
-    kved_error_t err = kved_data_delete(handle->kved_ctrl, &kv1);
+    kved_error_t err = kved_data_delete(oblfr_nvkvs_key_to_ctrl(handle, key), &kv1);
     if (err != KVED_OK) {
         LOG_E("kved_data_delete failed %d\r\n", err);
         return OBLFR_ERR_ERROR;
@@ -539,33 +1125,203 @@ oblfr_err_t oblfr_nvkvs_delete(oblfr_nvkvs_handle_t *handle, const char *key)
     return OBLFR_OK;
 }
 
-uint16_t oblfr_nvkvs_get_size(oblfr_nvkvs_handle_t *handle) {
-    return kved_total_entries_get(handle->kved_ctrl);
+oblfr_err_t oblfr_nvkvs_set_data(oblfr_nvkvs_handle_t *handle, const oblfr_nvkvs_data_t *data)
+{
+    if (handle == NULL || data == NULL || strnlen(data->key, sizeof(data->key)) > KVED_MAX_KEY_SIZE || data->type > OBLFR_NVKVS_DATA_TYPE_DOUBLE_ARRAY)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    kved_data_t kv1 = {
+        .type = data->type,
+    };
+    strncpy((char *)kv1.key, data->key, KVED_MAX_KEY_SIZE);
+    if (KVED_DATA_TYPE_IS_ARRAY(kv1.type))
+    {
+        if (data->size == 0 || data->size > KVED_MAX_ARRAY_SIZE)
+        {
+            return OBLFR_ERR_INVALID;
+        }
+        kv1.size = data->size;
+        memcpy(kv1.value.u8a, data->value.u8a, data->size);
+    }
+    else if (kv1.type == KVED_DATA_TYPE_STRING)
+    {
+        /* the terminator is stored too */
+        if (strnlen((const char *)data->value.str, CONFIG_COMPONENT_NVKVS_MAX_STRING_SIZE) >= CONFIG_COMPONENT_NVKVS_MAX_STRING_SIZE)
+        {
+            return OBLFR_ERR_INVALID;
+        }
+        strcpy((char *)kv1.value.str, (const char *)data->value.str);
+    }
+    else
+    {
+        memcpy(&kv1.value, &data->value, oblfr_nvkvs_scalar_size(kv1.type));
+    }
+    kved_error_t err = kved_data_write(oblfr_nvkvs_key_to_ctrl(handle, data->key), &kv1);
+    if (err != KVED_OK)
+    {
+        LOG_E("kved_data_write failed %d\r\n", err);
+        return OBLFR_ERR_ERROR;
+    }
+    return OBLFR_OK;
+}
+
+oblfr_err_t oblfr_nvkvs_get_data(oblfr_nvkvs_handle_t *handle, oblfr_nvkvs_data_t *data)
+{
+    if (handle == NULL || data == NULL || strnlen(data->key, sizeof(data->key)) > KVED_MAX_KEY_SIZE)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    kved_data_t kv1 = {0};
+    strncpy((char *)kv1.key, data->key, KVED_MAX_KEY_SIZE);
+    if (oblfr_nvkvs_data_read(handle, data->key, &kv1, true) != KVED_OK)
+    {
+        return OBLFR_ERR_ERROR;
+    }
+    data->type = kv1.type;
+    if (KVED_DATA_TYPE_IS_BLOB(kv1.type))
+    {
+        data->size = kv1.size;
+        memcpy(data->value.u8a, kv1.value.u8a, kv1.size);
+    }
+    else
+    {
+        data->size = oblfr_nvkvs_scalar_size(kv1.type);
+        memcpy(&data->value, &kv1.value, data->size);
+    }
+    return OBLFR_OK;
+}
+
+uint32_t oblfr_nvkvs_get_size(oblfr_nvkvs_handle_t *handle) {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < handle->num_shards; i++)
+    {
+        total += kved_total_entries_get(handle->shards[i].kved_ctrl);
+    }
+    return total;
+}
+
+uint32_t oblfr_nvkvs_used_entries(oblfr_nvkvs_handle_t *handle) {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < handle->num_shards; i++)
+    {
+        total += kved_used_entries_get(handle->shards[i].kved_ctrl);
+    }
+    return total;
 }
 
-uint16_t oblfr_nvkvs_used_entries(oblfr_nvkvs_handle_t *handle) {
-    return kved_used_entries_get(handle->kved_ctrl);
+uint32_t oblfr_nvkvs_free_entries(oblfr_nvkvs_handle_t *handle) {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < handle->num_shards; i++)
+    {
+        total += kved_free_entries_get(handle->shards[i].kved_ctrl);
+    }
+    return total;
 }
 
-uint16_t oblfr_nvkvs_free_entries(oblfr_nvkvs_handle_t *handle) {
-    return kved_free_entries_get(handle->kved_ctrl);
+uint32_t oblfr_nvkvs_deleted_entries(oblfr_nvkvs_handle_t *handle) {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < handle->num_shards; i++)
+    {
+        total += kved_deleted_entries_get(handle->shards[i].kved_ctrl);
+    }
+    return total;
 }
 
-uint16_t oblfr_nvkvs_deleted_entries(oblfr_nvkvs_handle_t *handle) {
-    return kved_deleted_entries_get(handle->kved_ctrl);
+oblfr_err_t oblfr_nvkvs_get_stats(oblfr_nvkvs_handle_t *handle, oblfr_nvkvs_stats_t *stats)
+{
+    if (handle == NULL || stats == NULL)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    memset(stats, 0, sizeof(oblfr_nvkvs_stats_t));
+    uint64_t last_at = 0;
+    uint32_t probes = 0;
+    for (uint8_t i = 0; i < handle->num_shards; i++)
+    {
+        kved_stats_t ks;
+        if (kved_stats_get(handle->shards[i].kved_ctrl, &ks) != KVED_OK)
+        {
+            LOG_E("kved_stats_get failed\r\n");
+            return OBLFR_ERR_ERROR;
+        }
+        stats->compactions += ks.compactions;
+        if (ks.compactions > 0 && ks.compaction_last_at_us >= last_at)
+        {
+            last_at = ks.compaction_last_at_us;
+            stats->compaction_last_us = ks.compaction_last_us;
+        }
+        if (ks.compaction_max_us > stats->compaction_max_us)
+        {
+            stats->compaction_max_us = ks.compaction_max_us;
+        }
+        stats->lifetime_compactions += ks.lifetime_compactions;
+        for (uint8_t sec = 0; sec < KVED_FLASH_NUM_SECTORS; sec++)
+        {
+            stats->sector_erases[sec] += ks.sector_erases[sec];
+        }
+        stats->string_bytes_total += ks.string_bytes_total;
+        stats->string_bytes_allocated += ks.string_bytes_allocated;
+        stats->string_bytes_live += ks.string_bytes_live;
+        stats->bytes_written += ks.bytes_written;
+        stats->user_bytes_written += ks.user_bytes_written;
+        stats->lookups += ks.lookups;
+        probes += ks.lookup_probes;
+    }
+    if (stats->string_bytes_allocated > 0)
+    {
+        stats->string_fragmentation = 1.0f - (float)stats->string_bytes_live / stats->string_bytes_allocated;
+    }
+    if (stats->user_bytes_written > 0)
+    {
+        stats->write_amplification = (float)stats->bytes_written / stats->user_bytes_written;
+    }
+    if (stats->lookups > 0)
+    {
+        stats->avg_lookup_probes = (float)probes / stats->lookups;
+    }
+    return OBLFR_OK;
 }
 
-int16_t oblfr_nvkvs_iter_init(oblfr_nvkvs_handle_t *handle) {
-    return kved_first_used_index_get(handle->kved_ctrl);
+/* first used entry, starting at shard */
+static int32_t oblfr_nvkvs_iter_first_from(oblfr_nvkvs_handle_t *handle, uint8_t shard) {
+    for (; shard < handle->num_shards; shard++)
+    {
+        int16_t index = kved_first_used_index_get(handle->shards[shard].kved_ctrl);
+        if (index > 0)
+        {
+            return NVKVS_ITER_ENCODE(shard, index);
+        }
+    }
+    return 0;
 }
 
-int16_t oblfr_nvkvs_iter_next(oblfr_nvkvs_handle_t *handle, int16_t iter) {
-    return kved_next_used_index_get(handle->kved_ctrl, iter);
+int32_t oblfr_nvkvs_iter_init(oblfr_nvkvs_handle_t *handle) {
+    return oblfr_nvkvs_iter_first_from(handle, 0);
 }
 
-oblfr_err_t oblfr_nvkvs_get_item(oblfr_nvkvs_handle_t *handle, uint16_t index, oblfr_nvkvs_data_t *data) {
+int32_t oblfr_nvkvs_iter_next(oblfr_nvkvs_handle_t *handle, int32_t iter) {
+    uint8_t shard = NVKVS_ITER_SHARD(iter);
+    if (iter <= 0 || shard >= handle->num_shards)
+    {
+        return 0;
+    }
+    int16_t index = kved_next_used_index_get(handle->shards[shard].kved_ctrl, NVKVS_ITER_INDEX(iter));
+    if (index > 0)
+    {
+        return NVKVS_ITER_ENCODE(shard, index);
+    }
+    return oblfr_nvkvs_iter_first_from(handle, shard + 1);
+}
+
+oblfr_err_t oblfr_nvkvs_get_item(oblfr_nvkvs_handle_t *handle, int32_t iter, oblfr_nvkvs_data_t *data) {
     kved_data_t kv1;
-    if (kved_data_read_by_index(handle->kved_ctrl, index, &kv1) != KVED_OK) {
+    uint8_t shard = NVKVS_ITER_SHARD(iter);
+    if (iter <= 0 || shard >= handle->num_shards)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    if (kved_data_read_by_index(handle->shards[shard].kved_ctrl, NVKVS_ITER_INDEX(iter), &kv1) != KVED_OK) {
         LOG_W("kved_data_read_by_index failed\r\n");
         return OBLFR_ERR_ERROR;
     }
@@ -606,6 +1362,264 @@ oblfr_err_t oblfr_nvkvs_get_item(oblfr_nvkvs_handle_t *handle, uint16_t index, o
             LOG_I("KVED_DATA_TYPE_STRING %s\r\n", kv1.value.str);
             strncpy((char *)data->value.str, (char *)kv1.value.str, CONFIG_COMPONENT_NVKVS_MAX_STRING_SIZE);
             break;
+        case KVED_DATA_TYPE_UINT8_ARRAY:
+        case KVED_DATA_TYPE_UINT16_ARRAY:
+        case KVED_DATA_TYPE_UINT32_ARRAY:
+        case KVED_DATA_TYPE_FLOAT_ARRAY:
+        case KVED_DATA_TYPE_DOUBLE_ARRAY:
+            data->size = kv1.size;
+            memcpy(data->value.u8a, kv1.value.u8a, kv1.size);
+            break;
     }
     return OBLFR_OK;
-}
\ No newline at end of file
+}
+
+uint32_t oblfr_nvkvs_crc32_update(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= p[i];
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return crc;
+}
+
+uint32_t oblfr_nvkvs_crc32(const void *data, size_t len)
+{
+    return ~oblfr_nvkvs_crc32_update(0xFFFFFFFF, data, len);
+}
+
+static oblfr_err_t oblfr_nvkvs_export_write(oblfr_nvkvs_writer_t writer, void *ctx, uint32_t *crc, const void *data, size_t len)
+{
+    *crc = oblfr_nvkvs_crc32_update(*crc, data, len);
+    return writer(ctx, data, len);
+}
+
+static oblfr_err_t oblfr_nvkvs_import_read(oblfr_nvkvs_reader_t reader, void *ctx, uint32_t *crc, void *data, size_t len)
+{
+    oblfr_err_t err = reader(ctx, data, len);
+    if (err == OBLFR_OK)
+    {
+        *crc = oblfr_nvkvs_crc32_update(*crc, data, len);
+    }
+    return err;
+}
+
+oblfr_err_t oblfr_nvkvs_export(oblfr_nvkvs_handle_t *handle, oblfr_nvkvs_writer_t writer, void *ctx)
+{
+    if (handle == NULL || writer == NULL)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    uint32_t crc = 0xFFFFFFFF;
+    oblfr_nvkvs_export_hdr_t hdr = {
+        .magic = OBLFR_NVKVS_EXPORT_MAGIC,
+        .version = OBLFR_NVKVS_EXPORT_VERSION,
+    };
+    if (oblfr_nvkvs_export_write(writer, ctx, &crc, &hdr, sizeof(hdr)) != OBLFR_OK)
+    {
+        return OBLFR_ERR_ERROR;
+    }
+
+    oblfr_nvkvs_export_trailer_t trailer = {0};
+    for (uint8_t i = 0; i < handle->num_shards; i++)
+    {
+        kved_ctrl_t *ctrl = handle->shards[i].kved_ctrl;
+        /* indexes change when a shard is compacted */
+        uint32_t generation = kved_generation_get(ctrl);
+        for (int16_t index = kved_first_used_index_get(ctrl); index > 0; index = kved_next_used_index_get(ctrl, index))
+        {
+            kved_data_t kv1 = {0};
+            if (kved_data_read_by_index(ctrl, index, &kv1) != KVED_OK || kved_generation_get(ctrl) != generation)
+            {
+                LOG_E("export: shard %d changed or could not be read\r\n", i);
+                return OBLFR_ERR_ERROR;
+            }
+            struct __attribute__((packed)) {
+                oblfr_nvkvs_export_rec_t rec;
+                char key[KVED_MAX_KEY_SIZE];
+            } head;
+            head.rec.type = kv1.type;
+            head.rec.key_len = strnlen((const char *)kv1.key, KVED_MAX_KEY_SIZE);
+            if (kv1.type == KVED_DATA_TYPE_STRING)
+            {
+                head.rec.value_len = strnlen((const char *)kv1.value.str, kv1.size);
+            }
+            else if (KVED_DATA_TYPE_IS_ARRAY(kv1.type))
+            {
+                head.rec.value_len = kv1.size;
+            }
+            else
+            {
+                head.rec.value_len = oblfr_nvkvs_scalar_size(kv1.type);
+            }
+            memcpy(head.key, kv1.key, head.rec.key_len);
+            if (oblfr_nvkvs_export_write(writer, ctx, &crc, &head, sizeof(head.rec) + head.rec.key_len) != OBLFR_OK ||
+                oblfr_nvkvs_export_write(writer, ctx, &crc, &kv1.value, head.rec.value_len) != OBLFR_OK)
+            {
+                return OBLFR_ERR_ERROR;
+            }
+            trailer.count++;
+        }
+    }
+
+    oblfr_nvkvs_export_rec_t end = {
+        .type = OBLFR_NVKVS_EXPORT_END,
+    };
+    if (oblfr_nvkvs_export_write(writer, ctx, &crc, &end, sizeof(end)) != OBLFR_OK)
+    {
+        return OBLFR_ERR_ERROR;
+    }
+    crc = oblfr_nvkvs_crc32_update(crc, &trailer.count, sizeof(trailer.count));
+    trailer.crc = ~crc;
+    if (writer(ctx, &trailer, sizeof(trailer)) != OBLFR_OK)
+    {
+        return OBLFR_ERR_ERROR;
+    }
+    LOG_I("exported %ld entries\r\n", trailer.count);
+    return OBLFR_OK;
+}
+
+/* read the records of an import into the staged tables of the shards, returns the number of records in count */
+static oblfr_err_t oblfr_nvkvs_import_records(oblfr_nvkvs_handle_t *handle, oblfr_nvkvs_reader_t reader, void *ctx, uint32_t *crc, uint32_t *count)
+{
+    *count = 0;
+    while (true)
+    {
+        oblfr_nvkvs_export_rec_t rec;
+        if (oblfr_nvkvs_import_read(reader, ctx, crc, &rec, sizeof(rec)) != OBLFR_OK)
+        {
+            return OBLFR_ERR_ERROR;
+        }
+        if (rec.type == OBLFR_NVKVS_EXPORT_END)
+        {
+            return (rec.key_len == 0 && rec.value_len == 0) ? OBLFR_OK : OBLFR_ERR_INVALID;
+        }
+
+        kved_data_t kv1 = {
+            .type = rec.type,
+        };
+        bool valid = rec.key_len > 0 && rec.key_len <= KVED_MAX_KEY_SIZE;
+        if (rec.type > OBLFR_NVKVS_DATA_TYPE_DOUBLE_ARRAY)
+        {
+            valid = false;
+        }
+        else if (rec.type == KVED_DATA_TYPE_STRING)
+        {
+            /* room for the terminator */
+            valid &= rec.value_len < CONFIG_COMPONENT_NVKVS_MAX_STRING_SIZE;
+        }
+        else if (KVED_DATA_TYPE_IS_ARRAY(rec.type))
+        {
+            valid &= rec.value_len > 0 && rec.value_len <= KVED_MAX_ARRAY_SIZE;
+            kv1.size = rec.value_len;
+        }
+        else
+        {
+            valid &= rec.value_len == oblfr_nvkvs_scalar_size(rec.type);
+        }
+        if (!valid)
+        {
+            LOG_E("import: invalid record %ld\r\n", *count);
+            return OBLFR_ERR_INVALID;
+        }
+        if (oblfr_nvkvs_import_read(reader, ctx, crc, kv1.key, rec.key_len) != OBLFR_OK ||
+            oblfr_nvkvs_import_read(reader, ctx, crc, &kv1.value, rec.value_len) != OBLFR_OK)
+        {
+            return OBLFR_ERR_ERROR;
+        }
+
+        char key[KVED_MAX_KEY_SIZE + 1] = {0};
+        memcpy(key, kv1.key, rec.key_len);
+        kved_error_t err = kved_import_add(oblfr_nvkvs_key_to_ctrl(handle, key), &kv1);
+        if (err == KVED_TABLE_FULL)
+        {
+            LOG_E("import: no space left for %s\r\n", key);
+            return OBLFR_ERR_NORESC;
+        }
+        if (err != KVED_OK)
+        {
+            LOG_E("import: could not add %s: %d\r\n", key, err);
+            return err == KVED_INVALID_KEY ? OBLFR_ERR_INVALID : OBLFR_ERR_ERROR;
+        }
+        (*count)++;
+    }
+}
+
+oblfr_err_t oblfr_nvkvs_import(oblfr_nvkvs_handle_t *handle, oblfr_nvkvs_reader_t reader, void *ctx)
+{
+    if (handle == NULL || reader == NULL)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    uint32_t crc = 0xFFFFFFFF;
+    oblfr_nvkvs_export_hdr_t hdr;
+    if (oblfr_nvkvs_import_read(reader, ctx, &crc, &hdr, sizeof(hdr)) != OBLFR_OK)
+    {
+        return OBLFR_ERR_ERROR;
+    }
+    if (hdr.magic != OBLFR_NVKVS_EXPORT_MAGIC || hdr.version != OBLFR_NVKVS_EXPORT_VERSION)
+    {
+        LOG_E("import: not an export, or unsupported version\r\n");
+        return OBLFR_ERR_INVALID;
+    }
+
+    uint8_t started = 0;
+    uint8_t committed = 0;
+    oblfr_err_t ret = OBLFR_OK;
+    for (; started < handle->num_shards; started++)
+    {
+        if (kved_import_begin(handle->shards[started].kved_ctrl) != KVED_OK)
+        {
+            LOG_E("import: could not start on shard %d\r\n", started);
+            ret = OBLFR_ERR_ERROR;
+            goto abort;
+        }
+    }
+
+    uint32_t count;
+    ret = oblfr_nvkvs_import_records(handle, reader, ctx, &crc, &count);
+    if (ret != OBLFR_OK)
+    {
+        goto abort;
+    }
+    oblfr_nvkvs_export_trailer_t trailer;
+    if (oblfr_nvkvs_import_read(reader, ctx, &crc, &trailer.count, sizeof(trailer.count)) != OBLFR_OK ||
+        reader(ctx, &trailer.crc, sizeof(trailer.crc)) != OBLFR_OK)
+    {
+        ret = OBLFR_ERR_ERROR;
+        goto abort;
+    }
+    if (trailer.count != count || trailer.crc != ~crc)
+    {
+        LOG_E("import: corrupt export\r\n");
+        ret = OBLFR_ERR_INVALID;
+        goto abort;
+    }
+
+    /* nothing is replaced before the whole export was checked, then each shard switches on its own */
+    for (; committed < handle->num_shards; committed++)
+    {
+        if (kved_import_commit(handle->shards[committed].kved_ctrl) != KVED_OK)
+        {
+            LOG_E("import: could not switch shard %d, the %d shards before it hold the import\r\n", committed, committed);
+            ret = OBLFR_ERR_ERROR;
+            goto abort;
+        }
+    }
+    LOG_I("imported %ld entries\r\n", count);
+    return OBLFR_OK;
+
+abort:
+    /* the shards that did not switch keep their content */
+    for (uint8_t i = committed; i < started; i++)
+    {
+        kved_import_abort(handle->shards[i].kved_ctrl);
+    }
+    return ret;
+}
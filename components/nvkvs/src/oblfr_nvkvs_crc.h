@@ -0,0 +1,15 @@
+#ifndef OBLFR_NVKVS_CRC_H
+#define OBLFR_NVKVS_CRC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* internal to the NVKVS component, shared by the export format, the factory partition and the PSRAM mirror */
+
+/* CRC-32 (IEEE), crc starts at 0xFFFFFFFF and is inverted at the end */
+uint32_t oblfr_nvkvs_crc32_update(uint32_t crc, const void *data, size_t len);
+
+/* CRC-32 (IEEE) of a single buffer */
+uint32_t oblfr_nvkvs_crc32(const void *data, size_t len);
+
+#endif // OBLFR_NVKVS_CRC_H
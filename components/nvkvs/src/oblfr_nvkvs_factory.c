@@ -0,0 +1,103 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "oblfr_nvkvs_factory.h"
+#include "oblfr_nvkvs_crc.h"
+
+#define DBG_TAG "NVKVS_FACTORY"
+#include "log.h"
+
+/* must match hash() in tools/nvkvs_factory_gen.py */
+static uint32_t oblfr_nvkvs_factory_hash(const char *key, uint32_t seed)
+{
+    uint32_t h = 0x811C9DC5 ^ seed;
+
+    for (size_t i = 0; i < KVED_MAX_KEY_SIZE && key[i] != 0; i++)
+    {
+        h ^= (uint8_t)key[i];
+        h *= 0x01000193;
+    }
+    h ^= h >> 16;
+    h *= 0x85EBCA6B;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35;
+    h ^= h >> 16;
+    return h;
+}
+
+static const uint16_t *oblfr_nvkvs_factory_displacements(const oblfr_nvkvs_factory_hdr_t *hdr)
+{
+    return (const uint16_t *)((const uint8_t *)hdr + sizeof(oblfr_nvkvs_factory_hdr_t));
+}
+
+static const oblfr_nvkvs_factory_entry_t *oblfr_nvkvs_factory_entries(const oblfr_nvkvs_factory_hdr_t *hdr)
+{
+    /* displacements are padded to 16 bytes */
+    uint32_t disp_size = ((hdr->num_buckets * sizeof(uint16_t)) + 15) & ~15;
+    return (const oblfr_nvkvs_factory_entry_t *)((const uint8_t *)hdr + sizeof(oblfr_nvkvs_factory_hdr_t) + disp_size);
+}
+
+bool oblfr_nvkvs_factory_valid(const void *part)
+{
+    const oblfr_nvkvs_factory_hdr_t *hdr = part;
+
+    if (hdr == NULL || hdr->magic != OBLFR_NVKVS_FACTORY_MAGIC)
+    {
+        LOG_W("No factory partition found\r\n");
+        return false;
+    }
+    if (hdr->version != OBLFR_NVKVS_FACTORY_VERSION || hdr->entry_size != sizeof(oblfr_nvkvs_factory_entry_t))
+    {
+        LOG_E("Unsupported factory partition version %d\r\n", hdr->version);
+        return false;
+    }
+    if (hdr->num_keys > 0 && hdr->num_buckets == 0)
+    {
+        LOG_E("Invalid factory partition\r\n");
+        return false;
+    }
+    const uint8_t *end = (const uint8_t *)(oblfr_nvkvs_factory_entries(hdr) + hdr->num_keys);
+    if (hdr->size < (uint32_t)(end - (const uint8_t *)hdr))
+    {
+        LOG_E("Factory partition truncated\r\n");
+        return false;
+    }
+    if (oblfr_nvkvs_crc32((const uint8_t *)part + sizeof(oblfr_nvkvs_factory_hdr_t), hdr->size - sizeof(oblfr_nvkvs_factory_hdr_t)) != hdr->crc)
+    {
+        LOG_E("Factory partition CRC mismatch\r\n");
+        return false;
+    }
+    LOG_I("Factory partition: %d keys, %d bytes\r\n", hdr->num_keys, hdr->size);
+    return true;
+}
+
+const oblfr_nvkvs_factory_entry_t *oblfr_nvkvs_factory_find(const void *part, const char *key)
+{
+    const oblfr_nvkvs_factory_hdr_t *hdr = part;
+
+    if (hdr->num_keys == 0)
+    {
+        return NULL;
+    }
+    uint16_t bucket = oblfr_nvkvs_factory_hash(key, hdr->seed) % hdr->num_buckets;
+    uint16_t slot = oblfr_nvkvs_factory_hash(key, oblfr_nvkvs_factory_displacements(hdr)[bucket]) % hdr->num_keys;
+    const oblfr_nvkvs_factory_entry_t *entry = &oblfr_nvkvs_factory_entries(hdr)[slot];
+
+    /* every key maps to some slot, make sure it is ours */
+    if (strncmp(entry->key, key, KVED_MAX_KEY_SIZE) != 0)
+    {
+        return NULL;
+    }
+    if (entry->offset + entry->len > hdr->size)
+    {
+        return NULL;
+    }
+    return entry;
+}
+
+const uint8_t *oblfr_nvkvs_factory_value(const void *part, const oblfr_nvkvs_factory_entry_t *entry)
+{
+    return (const uint8_t *)part + entry->offset;
+}
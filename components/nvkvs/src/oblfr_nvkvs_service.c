@@ -0,0 +1,402 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "oblfr_common.h"
+#include "oblfr_nvkvs.h"
+#include "oblfr_nvkvs_service.h"
+#ifdef CONFIG_COMPONENT_RPMSG
+#include "oblfr_rpmsg.h"
+#endif
+
+#define DBG_TAG "NVKVS_SVC"
+#include "log.h"
+
+/* how long to wait for a free RPMsg buffer for a response, in ms */
+#define OBLFR_NVKVS_SERVICE_TX_TIMEOUT 100
+
+typedef struct oblfr_nvkvs_service_s
+{
+    oblfr_nvkvs_handle_t *handle;
+    bool loopback;
+#ifdef CONFIG_COMPONENT_RPMSG
+    oblfr_device_cfg_t device_cfg;
+    oblfr_queue_entry_t *device;
+#endif
+    oblfr_nvkvs_service_stats_t stats;
+} oblfr_nvkvs_service_t;
+
+/* response being built */
+typedef struct oblfr_nvkvs_service_resp_s
+{
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    uint16_t count;
+} oblfr_nvkvs_service_resp_t;
+
+/* size of a scalar value on the wire, 0 for strings and arrays */
+static size_t oblfr_nvkvs_service_scalar_size(uint8_t type)
+{
+    static const uint8_t sizes[] = {
+        [OBLFR_NVKVS_DATA_TYPE_UINT8] = sizeof(uint8_t),
+        [OBLFR_NVKVS_DATA_TYPE_INT8] = sizeof(int8_t),
+        [OBLFR_NVKVS_DATA_TYPE_UINT16] = sizeof(uint16_t),
+        [OBLFR_NVKVS_DATA_TYPE_INT16] = sizeof(int16_t),
+        [OBLFR_NVKVS_DATA_TYPE_UINT32] = sizeof(uint32_t),
+        [OBLFR_NVKVS_DATA_TYPE_INT32] = sizeof(int32_t),
+        [OBLFR_NVKVS_DATA_TYPE_FLOAT] = sizeof(float),
+        [OBLFR_NVKVS_DATA_TYPE_UINT64] = sizeof(uint64_t),
+        [OBLFR_NVKVS_DATA_TYPE_INT64] = sizeof(int64_t),
+        [OBLFR_NVKVS_DATA_TYPE_DOUBLE] = sizeof(double),
+    };
+    return type < sizeof(sizes) ? sizes[type] : 0;
+}
+
+static bool oblfr_nvkvs_service_fits(oblfr_nvkvs_service_resp_t *resp, size_t key_len, size_t value_len)
+{
+    return resp->len + sizeof(oblfr_nvkvs_service_rec_t) + key_len + value_len <= resp->size;
+}
+
+static bool oblfr_nvkvs_service_put(oblfr_nvkvs_service_resp_t *resp, uint8_t status, uint8_t type, const char *key, uint8_t key_len, const void *value, uint16_t value_len)
+{
+    oblfr_nvkvs_service_rec_t rec = {
+        .op = status,
+        .type = type,
+        .key_len = key_len,
+        .value_len = value_len,
+    };
+
+    if (!oblfr_nvkvs_service_fits(resp, key_len, value_len))
+    {
+        return false;
+    }
+    memcpy(resp->buf + resp->len, &rec, sizeof(rec));
+    resp->len += sizeof(rec);
+    memcpy(resp->buf + resp->len, key, key_len);
+    resp->len += key_len;
+    memcpy(resp->buf + resp->len, value, value_len);
+    resp->len += value_len;
+    resp->count++;
+    return true;
+}
+
+/* value of a key as sent on the wire, strings without terminator */
+static uint16_t oblfr_nvkvs_service_value_len(const oblfr_nvkvs_data_t *data)
+{
+    if (data->type == OBLFR_NVKVS_DATA_TYPE_STRING)
+    {
+        return strnlen((const char *)data->value.str, sizeof(data->value.str));
+    }
+    if (data->type >= OBLFR_NVKVS_DATA_TYPE_UINT8_ARRAY)
+    {
+        return data->size;
+    }
+    return oblfr_nvkvs_service_scalar_size(data->type);
+}
+
+static bool oblfr_nvkvs_service_get(oblfr_nvkvs_handle_t *handle, const char *key, oblfr_nvkvs_service_resp_t *resp)
+{
+    oblfr_nvkvs_data_t data;
+
+    strcpy(data.key, key);
+    if (oblfr_nvkvs_get_data(handle, &data) != OBLFR_OK)
+    {
+        return oblfr_nvkvs_service_put(resp, OBLFR_NVKVS_SERVICE_NOT_FOUND, 0, NULL, 0, NULL, 0);
+    }
+    return oblfr_nvkvs_service_put(resp, OBLFR_NVKVS_SERVICE_OK, data.type, NULL, 0, &data.value, oblfr_nvkvs_service_value_len(&data));
+}
+
+static oblfr_nvkvs_service_status_t oblfr_nvkvs_service_set(oblfr_nvkvs_handle_t *handle, const char *key, uint8_t type, const uint8_t *value, uint16_t value_len)
+{
+    oblfr_nvkvs_data_t data = {0};
+
+    strcpy(data.key, key);
+    data.type = type;
+    if (type == OBLFR_NVKVS_DATA_TYPE_STRING)
+    {
+        /* room for the terminator */
+        if (value_len >= sizeof(data.value.str))
+        {
+            return OBLFR_NVKVS_SERVICE_INVALID;
+        }
+    }
+    else if (type >= OBLFR_NVKVS_DATA_TYPE_UINT8_ARRAY && type <= OBLFR_NVKVS_DATA_TYPE_DOUBLE_ARRAY)
+    {
+        if (value_len > sizeof(data.value.u8a))
+        {
+            return OBLFR_NVKVS_SERVICE_INVALID;
+        }
+        data.size = value_len;
+    }
+    else if (value_len == 0 || value_len != oblfr_nvkvs_service_scalar_size(type))
+    {
+        return OBLFR_NVKVS_SERVICE_INVALID;
+    }
+    memcpy(&data.value, value, value_len);
+
+    switch (oblfr_nvkvs_set_data(handle, &data))
+    {
+    case OBLFR_OK:
+        return OBLFR_NVKVS_SERVICE_OK;
+    case OBLFR_ERR_INVALID:
+        return OBLFR_NVKVS_SERVICE_INVALID;
+    default:
+        return OBLFR_NVKVS_SERVICE_ERROR;
+    }
+}
+
+static bool oblfr_nvkvs_service_iter(oblfr_nvkvs_handle_t *handle, const uint8_t *value, uint16_t value_len, oblfr_nvkvs_service_resp_t *resp)
+{
+    oblfr_nvkvs_data_t data;
+    int32_t iter = 0;
+    uint32_t cursor = 0;
+    /* the cursor record always goes last */
+    size_t cursor_size = sizeof(oblfr_nvkvs_service_rec_t) + sizeof(cursor);
+
+    if (!oblfr_nvkvs_service_fits(resp, 0, sizeof(cursor)))
+    {
+        return false;
+    }
+    if (value_len == sizeof(cursor))
+    {
+        memcpy(&cursor, value, sizeof(cursor));
+    }
+    iter = cursor > 0 ? (int32_t)cursor : oblfr_nvkvs_iter_init(handle);
+    for (; iter > 0; iter = oblfr_nvkvs_iter_next(handle, iter))
+    {
+        if (oblfr_nvkvs_get_item(handle, iter, &data) != OBLFR_OK)
+        {
+            continue;
+        }
+        uint8_t key_len = strnlen(data.key, KVED_MAX_KEY_SIZE);
+        uint16_t len = oblfr_nvkvs_service_value_len(&data);
+        resp->size -= cursor_size;
+        bool put = oblfr_nvkvs_service_put(resp, OBLFR_NVKVS_SERVICE_OK, data.type, data.key, key_len, &data.value, len);
+        resp->size += cursor_size;
+        if (!put)
+        {
+            break;
+        }
+    }
+    cursor = iter > 0 ? (uint32_t)iter : 0;
+    return oblfr_nvkvs_service_put(resp, OBLFR_NVKVS_SERVICE_OK, 0, NULL, 0, &cursor, sizeof(cursor));
+}
+
+/* check the lengths of all records, so a malformed request is not executed partially */
+static bool oblfr_nvkvs_service_validate(const uint8_t *req, size_t req_len, uint16_t count)
+{
+    size_t pos = sizeof(oblfr_nvkvs_service_hdr_t);
+    oblfr_nvkvs_service_rec_t rec;
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        if (pos + sizeof(rec) > req_len)
+        {
+            return false;
+        }
+        memcpy(&rec, req + pos, sizeof(rec));
+        pos += sizeof(rec) + rec.key_len + rec.value_len;
+        if (pos > req_len || rec.key_len > KVED_MAX_KEY_SIZE)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t oblfr_nvkvs_service_process(oblfr_nvkvs_handle_t *handle, const uint8_t *req, size_t req_len, uint8_t *resp, size_t resp_size)
+{
+    oblfr_nvkvs_service_hdr_t hdr;
+    oblfr_nvkvs_service_rec_t rec;
+    oblfr_nvkvs_service_resp_t out = {
+        .buf = resp,
+        .size = resp_size,
+        .len = sizeof(oblfr_nvkvs_service_hdr_t),
+    };
+    size_t pos = sizeof(hdr);
+    uint16_t done;
+
+    if (handle == NULL || req_len < sizeof(hdr) || resp_size < sizeof(hdr))
+    {
+        return 0;
+    }
+    memcpy(&hdr, req, sizeof(hdr));
+    if (hdr.magic != OBLFR_NVKVS_SERVICE_MAGIC || hdr.version != OBLFR_NVKVS_SERVICE_VERSION || !oblfr_nvkvs_service_validate(req, req_len, hdr.count))
+    {
+        LOG_W("Malformed request\r\n");
+        return 0;
+    }
+
+    for (done = 0; done < hdr.count; done++)
+    {
+        char key[KVED_MAX_KEY_SIZE + 1];
+        bool put;
+
+        memcpy(&rec, req + pos, sizeof(rec));
+        memcpy(key, req + pos + sizeof(rec), rec.key_len);
+        key[rec.key_len] = 0;
+        const uint8_t *value = req + pos + sizeof(rec) + rec.key_len;
+
+        switch (rec.op)
+        {
+        case OBLFR_NVKVS_SERVICE_OP_GET:
+            put = oblfr_nvkvs_service_get(handle, key, &out);
+            break;
+        case OBLFR_NVKVS_SERVICE_OP_SET:
+            /* only execute what we can answer */
+            put = oblfr_nvkvs_service_fits(&out, 0, 0) &&
+                  oblfr_nvkvs_service_put(&out, oblfr_nvkvs_service_set(handle, key, rec.type, value, rec.value_len), rec.type, NULL, 0, NULL, 0);
+            break;
+        case OBLFR_NVKVS_SERVICE_OP_DELETE:
+            put = oblfr_nvkvs_service_fits(&out, 0, 0) &&
+                  oblfr_nvkvs_service_put(&out, oblfr_nvkvs_delete(handle, key) == OBLFR_OK ? OBLFR_NVKVS_SERVICE_OK : OBLFR_NVKVS_SERVICE_NOT_FOUND, 0, NULL, 0, NULL, 0);
+            break;
+        case OBLFR_NVKVS_SERVICE_OP_ITER:
+            put = oblfr_nvkvs_service_iter(handle, value, rec.value_len, &out);
+            break;
+        default:
+            put = oblfr_nvkvs_service_put(&out, OBLFR_NVKVS_SERVICE_UNSUPPORTED, 0, NULL, 0, NULL, 0);
+            break;
+        }
+        if (!put)
+        {
+            /* response is full */
+            break;
+        }
+        pos += sizeof(rec) + rec.key_len + rec.value_len;
+    }
+
+    hdr.count = out.count;
+    hdr.done = done;
+    memcpy(resp, &hdr, sizeof(hdr));
+    return out.len;
+}
+
+#ifdef CONFIG_COMPONENT_RPMSG
+static void oblfr_nvkvs_service_rx(void *data, size_t len, void *priv)
+{
+    oblfr_nvkvs_service_t *svc = (oblfr_nvkvs_service_t *)priv;
+    uint32_t size;
+
+    /* build the response straight in the RPMsg buffer */
+    uint8_t *resp = oblfr_rpmsg_device_send_buffer_alloc(svc->device, &size, OBLFR_NVKVS_SERVICE_TX_TIMEOUT);
+    if (resp == NULL)
+    {
+        LOG_W("No buffer for the response\r\n");
+        svc->stats.errors++;
+        return;
+    }
+    size_t resp_len = oblfr_nvkvs_service_process(svc->handle, data, len, resp, size);
+    if (resp_len == 0)
+    {
+        /* a TX buffer can only be given back by sending it, answer with an empty response */
+        oblfr_nvkvs_service_hdr_t hdr = {
+            .magic = OBLFR_NVKVS_SERVICE_MAGIC,
+            .version = OBLFR_NVKVS_SERVICE_VERSION,
+        };
+        memcpy(resp, &hdr, sizeof(hdr));
+        resp_len = sizeof(hdr);
+        svc->stats.errors++;
+    }
+    else
+    {
+        oblfr_nvkvs_service_hdr_t hdr;
+        memcpy(&hdr, resp, sizeof(hdr));
+        svc->stats.ops += hdr.done;
+    }
+    svc->stats.requests++;
+    if (oblfr_rpmsg_device_send_buffer(svc->device, resp, resp_len) != OBLFR_OK)
+    {
+        LOG_W("Failed to send the response\r\n");
+        svc->stats.errors++;
+    }
+}
+#endif
+
+oblfr_nvkvs_service_t *oblfr_nvkvs_service_start(oblfr_nvkvs_handle_t *handle, const oblfr_nvkvs_service_cfg_t *cfg)
+{
+    if (handle == NULL || cfg == NULL)
+    {
+        LOG_E("Invalid configuration\r\n");
+        return NULL;
+    }
+    oblfr_nvkvs_service_t *svc = calloc(1, sizeof(oblfr_nvkvs_service_t));
+    if (svc == NULL)
+    {
+        LOG_E("Failed to allocate memory for service\r\n");
+        return NULL;
+    }
+    svc->handle = handle;
+    svc->loopback = cfg->loopback;
+    if (svc->loopback)
+    {
+        LOG_I("NVKVS service in loopback mode\r\n");
+        return svc;
+    }
+#ifdef CONFIG_COMPONENT_RPMSG
+    strncpy(svc->device_cfg.name, cfg->name != NULL ? cfg->name : OBLFR_NVKVS_SERVICE_NAME, sizeof(svc->device_cfg.name) - 1);
+    svc->device_cfg.cb = oblfr_nvkvs_service_rx;
+    svc->device_cfg.priv = svc;
+    svc->device = oblfr_rpmsg_device_add(&svc->device_cfg);
+    if (svc->device == NULL)
+    {
+        LOG_E("Failed to add RPMsg endpoint %s\r\n", svc->device_cfg.name);
+        free(svc);
+        return NULL;
+    }
+    LOG_I("NVKVS service on RPMsg endpoint %s\r\n", svc->device_cfg.name);
+    return svc;
+#else
+    LOG_E("RPMsg is not enabled, only loopback mode is available\r\n");
+    free(svc);
+    return NULL;
+#endif
+}
+
+oblfr_err_t oblfr_nvkvs_service_request(oblfr_nvkvs_service_t *svc, const uint8_t *req, size_t req_len, uint8_t *resp, size_t *resp_len)
+{
+    if (svc == NULL || !svc->loopback || resp_len == NULL)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    svc->stats.requests++;
+    *resp_len = oblfr_nvkvs_service_process(svc->handle, req, req_len, resp, *resp_len);
+    if (*resp_len == 0)
+    {
+        svc->stats.errors++;
+        return OBLFR_ERR_INVALID;
+    }
+    oblfr_nvkvs_service_hdr_t hdr;
+    memcpy(&hdr, resp, sizeof(hdr));
+    svc->stats.ops += hdr.done;
+    return OBLFR_OK;
+}
+
+oblfr_err_t oblfr_nvkvs_service_get_stats(oblfr_nvkvs_service_t *svc, oblfr_nvkvs_service_stats_t *stats)
+{
+    if (svc == NULL || stats == NULL)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    *stats = svc->stats;
+    return OBLFR_OK;
+}
+
+oblfr_err_t oblfr_nvkvs_service_stop(oblfr_nvkvs_service_t *svc)
+{
+    oblfr_err_t ret = OBLFR_OK;
+
+    if (svc == NULL)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+#ifdef CONFIG_COMPONENT_RPMSG
+    if (!svc->loopback)
+    {
+        ret = oblfr_rpmsg_device_remove(svc->device);
+    }
+#endif
+    free(svc);
+    return ret;
+}
@@ -0,0 +1,202 @@
+#!/usr/bin/env python3
+"""
+Client for the NVKVS access service (see include/oblfr_nvkvs_service.h)
+
+Runs on Linux, talking to the "nvkvs" RPMsg endpoint of M0 through a rpmsg char
+device (/dev/rpmsgN, created with rpmsg_export_ept or by the rpmsg_char driver).
+Operations are batched, one request per MTU:
+
+    nvkvs_client.py /dev/rpmsg0 list
+    nvkvs_client.py /dev/rpmsg0 get serial hwrev
+    nvkvs_client.py /dev/rpmsg0 set name=string:bl808 boots=u32:12
+    nvkvs_client.py /dev/rpmsg0 delete name
+
+The Client class can be used on its own with any transport that has
+send(bytes) and recv() -> bytes.
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+MAGIC = 0x4E
+VERSION = 1
+HDR = struct.Struct("<BBHHH")
+REC = struct.Struct("<BBBH")
+MTU = 2032  # RL_BUFFER_PAYLOAD_SIZE, CONFIG_RPMSG_BUFFER_SIZE less the rpmsg header
+
+OP_GET, OP_SET, OP_DELETE, OP_ITER = 1, 2, 3, 4
+STATUS = ["ok", "not found", "invalid", "error", "unsupported"]
+
+# must match oblfr_nvkvs_data_types_t
+TYPES = {
+    "u8": (0, "B"),
+    "i8": (1, "b"),
+    "u16": (2, "H"),
+    "i16": (3, "h"),
+    "u32": (4, "I"),
+    "i32": (5, "i"),
+    "float": (6, "f"),
+    "string": (7, None),
+    "u64": (8, "Q"),
+    "i64": (9, "q"),
+    "double": (10, "d"),
+    "u8_array": (11, "B"),
+    "u16_array": (12, "H"),
+    "u32_array": (13, "I"),
+    "float_array": (14, "f"),
+    "double_array": (15, "d"),
+}
+TYPE_NAMES = {v[0]: k for k, v in TYPES.items()}
+
+
+def encode_value(type_name, value):
+    type_id, fmt = TYPES[type_name]
+    if type_name == "string":
+        return type_id, value.encode()
+    if type_name.endswith("_array"):
+        return type_id, struct.pack(f"<{len(value)}{fmt}", *value)
+    return type_id, struct.pack(f"<{fmt}", value)
+
+
+def decode_value(type_id, data):
+    name = TYPE_NAMES.get(type_id)
+    if name is None:
+        return data
+    fmt = TYPES[name][1]
+    if name == "string":
+        return data.decode(errors="replace")
+    if name.endswith("_array"):
+        return list(struct.unpack(f"<{len(data) // struct.calcsize(fmt)}{fmt}", data))
+    return struct.unpack(f"<{fmt}", data)[0]
+
+
+class ServiceError(Exception):
+    pass
+
+
+class Client:
+    def __init__(self, transport, mtu=MTU):
+        self.transport = transport
+        self.mtu = mtu
+        self.seq = 0
+
+    def _request(self, ops):
+        """send ops [(op, type, key, value)], returns the records of the executed ops and how many were executed"""
+        self.seq = (self.seq + 1) & 0xFFFF
+        body = b""
+        count = 0
+        for op, type_id, key, value in ops:
+            rec = REC.pack(op, type_id, len(key), len(value)) + key + value
+            if HDR.size + len(body) + len(rec) > self.mtu:
+                break
+            body += rec
+            count += 1
+        if count == 0:
+            raise ServiceError("operation does not fit in a message")
+        self.transport.send(HDR.pack(MAGIC, VERSION, self.seq, count, 0) + body)
+        resp = self.transport.recv()
+        magic, version, seq, rcount, done = HDR.unpack_from(resp)
+        if magic != MAGIC or version != VERSION or seq != self.seq:
+            raise ServiceError("unexpected response")
+        if done == 0:
+            raise ServiceError("request rejected")
+        records, pos = [], HDR.size
+        for _ in range(rcount):
+            status, type_id, key_len, value_len = REC.unpack_from(resp, pos)
+            pos += REC.size
+            key = resp[pos:pos + key_len].decode()
+            pos += key_len
+            records.append((status, type_id, key, resp[pos:pos + value_len]))
+            pos += value_len
+        return records, done
+
+    def _batch(self, ops):
+        """run ops in as many requests as needed, returns one record per op"""
+        results = []
+        while ops:
+            records, done = self._request(ops)
+            results += records
+            ops = ops[done:]
+        return results
+
+    def get(self, *keys):
+        records = self._batch([(OP_GET, 0, k.encode(), b"") for k in keys])
+        return {k: (decode_value(t, v) if s == 0 else None) for k, (s, t, _, v) in zip(keys, records)}
+
+    def set(self, items):
+        """items: {key: (type_name, value)}"""
+        ops = []
+        for key, (type_name, value) in items.items():
+            type_id, data = encode_value(type_name, value)
+            ops.append((OP_SET, type_id, key.encode(), data))
+        return {k: STATUS[s] for k, (s, _, _, _) in zip(items, self._batch(ops))}
+
+    def delete(self, *keys):
+        records = self._batch([(OP_DELETE, 0, k.encode(), b"") for k in keys])
+        return {k: STATUS[s] for k, (s, _, _, _) in zip(keys, records)}
+
+    def items(self):
+        cursor = 0
+        while True:
+            records, _ = self._request([(OP_ITER, 0, b"", struct.pack("<I", cursor))])
+            for status, type_id, key, value in records[:-1]:
+                yield key, TYPE_NAMES.get(type_id, type_id), decode_value(type_id, value)
+            cursor = struct.unpack("<I", records[-1][3])[0]
+            if cursor == 0:
+                return
+
+
+class RpmsgChar:
+    def __init__(self, path, mtu=MTU):
+        self.fd = os.open(path, os.O_RDWR)
+        self.mtu = mtu
+
+    def send(self, data):
+        os.write(self.fd, data)
+
+    def recv(self):
+        # a response fills up to a whole buffer, a shorter read would cut it
+        return os.read(self.fd, self.mtu)
+
+
+def parse_item(arg):
+    key, _, spec = arg.partition("=")
+    type_name, _, value = spec.partition(":")
+    if type_name not in TYPES:
+        sys.exit(f"{arg}: use key=type:value, type one of {', '.join(TYPES)}")
+    if type_name == "string":
+        return key, (type_name, value)
+    conv = float if "float" in type_name or "double" in type_name else lambda v: int(v, 0)
+    if type_name.endswith("_array"):
+        return key, (type_name, [conv(v) for v in value.split(",")])
+    return key, (type_name, conv(value))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Access the NVKVS of M0 over RPMsg")
+    parser.add_argument("device", help="rpmsg char device of the nvkvs endpoint")
+    parser.add_argument("command", choices=["list", "get", "set", "delete"])
+    parser.add_argument("args", nargs="*", help="keys, or key=type:value for set")
+    parser.add_argument("--mtu", type=int, default=MTU,
+                        help=f"RPMsg payload size of the link (default {MTU}, CONFIG_RPMSG_BUFFER_SIZE - 16)")
+    args = parser.parse_args()
+
+    client = Client(RpmsgChar(args.device, args.mtu), args.mtu)
+    if args.command == "list":
+        for key, type_name, value in client.items():
+            print(f"{key} ({type_name}) = {value}")
+    elif args.command == "get":
+        for key, value in client.get(*args.args).items():
+            print(f"{key} = {value}")
+    elif args.command == "set":
+        for key, status in client.set(dict(parse_item(a) for a in args.args)).items():
+            print(f"{key}: {status}")
+    else:
+        for key, status in client.delete(*args.args).items():
+            print(f"{key}: {status}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""
+Generate a read-only NVKVS factory partition (see include/oblfr_nvkvs_factory.h)
+
+The input is a JSON object mapping keys to values:
+
+    {
+        "serial": "BL808-000123",
+        "hwrev": {"type": "u8", "value": 3},
+        "mac": {"type": "u8_array", "value": [2, 0, 0, 0, 0, 1]},
+        "cal": {"type": "float_array", "value": [1.0, 1.01, 0.98]}
+    }
+
+Plain strings are stored as strings, plain integers as u32 (i32 if negative)
+and plain floats as float. Other types need the {"type", "value"} form.
+
+usage: nvkvs_factory_gen.py factory.json factory.bin
+Flash factory.bin and pass its memory mapped address (oblfr_kved_flash_xip_ptr())
+as factory in oblfr_nvkvs_cfg_t.
+"""
+
+import argparse
+import json
+import struct
+import sys
+import zlib
+
+MAX_KEY_SIZE = 7
+MAGIC = 0x464B564E
+VERSION = 1
+HDR_SIZE = 32
+ENTRY_SIZE = 16
+
+# must match kved_data_types_t
+TYPES = {
+    "u8": (0, "B"),
+    "i8": (1, "b"),
+    "u16": (2, "H"),
+    "i16": (3, "h"),
+    "u32": (4, "I"),
+    "i32": (5, "i"),
+    "float": (6, "f"),
+    "string": (7, None),
+    "u64": (8, "Q"),
+    "i64": (9, "q"),
+    "double": (10, "d"),
+    "u8_array": (11, "B"),
+    "u16_array": (12, "H"),
+    "u32_array": (13, "I"),
+    "float_array": (14, "f"),
+    "double_array": (15, "d"),
+}
+
+
+def hash(key, seed):
+    """FNV-1a + murmur3 finalizer, must match oblfr_nvkvs_factory_hash()"""
+    h = (0x811C9DC5 ^ seed) & 0xFFFFFFFF
+    for c in key[:MAX_KEY_SIZE]:
+        h ^= c
+        h = (h * 0x01000193) & 0xFFFFFFFF
+    h ^= h >> 16
+    h = (h * 0x85EBCA6B) & 0xFFFFFFFF
+    h ^= h >> 13
+    h = (h * 0xC2B2AE35) & 0xFFFFFFFF
+    h ^= h >> 16
+    return h
+
+
+def encode_value(key, spec):
+    if isinstance(spec, dict):
+        type_name, value = spec["type"], spec["value"]
+    elif isinstance(spec, str):
+        type_name, value = "string", spec
+    elif isinstance(spec, bool) or not isinstance(spec, (int, float)):
+        sys.exit(f"{key}: unsupported value {spec!r}, use the {{type, value}} form")
+    elif isinstance(spec, int):
+        type_name, value = ("i32" if spec < 0 else "u32"), spec
+    else:
+        type_name, value = "float", spec
+
+    if type_name not in TYPES:
+        sys.exit(f"{key}: unknown type {type_name}")
+    type_id, fmt = TYPES[type_name]
+    if type_name == "string":
+        data = value.encode() + b"\0"
+    elif type_name.endswith("_array"):
+        data = struct.pack(f"<{len(value)}{fmt}", *value)
+    else:
+        data = struct.pack(f"<{fmt}", value)
+    return type_id, data
+
+
+def place(keys, seed, num_buckets):
+    """hash and displace: returns the displacement of every bucket, and the slot of every key"""
+    n = len(keys)
+    buckets = [[] for _ in range(num_buckets)]
+    for k in keys:
+        buckets[hash(k, seed) % num_buckets].append(k)
+
+    disp = [0] * num_buckets
+    slots = {}
+    used = set()
+    # place the largest buckets first, while there is the most room
+    for b in sorted(range(num_buckets), key=lambda b: -len(buckets[b])):
+        if not buckets[b]:
+            continue
+        for d in range(0x10000):
+            wanted = [hash(k, d) % n for k in buckets[b]]
+            if len(set(wanted)) == len(wanted) and used.isdisjoint(wanted):
+                disp[b] = d
+                slots.update(zip(buckets[b], wanted))
+                used.update(wanted)
+                break
+        else:
+            return None
+    return disp, slots
+
+
+def build(items, seed):
+    keys = [k.encode() for k in items]
+    for k in keys:
+        if not 0 < len(k) <= MAX_KEY_SIZE:
+            sys.exit(f"{k.decode()}: keys are 1 to {MAX_KEY_SIZE} characters")
+    n = len(keys)
+    num_buckets = max(1, (n + 3) // 4)
+
+    disp, slots = [0] * num_buckets, {}
+    if n:
+        for s in range(seed, seed + 1000):
+            placed = place(keys, s, num_buckets)
+            if placed:
+                seed = s
+                disp, slots = placed
+                break
+        else:
+            sys.exit("could not find a perfect hash, try another --seed")
+
+    disp_blob = struct.pack(f"<{num_buckets}H", *disp)
+    disp_blob += b"\0" * (-len(disp_blob) % 16)
+    data_start = HDR_SIZE + len(disp_blob) + n * ENTRY_SIZE
+
+    entries = [b"\0" * ENTRY_SIZE] * n
+    data = b""
+    for name, k in zip(items, keys):
+        type_id, value = encode_value(name, items[name])
+        # keep values aligned to their natural size for XIP reads
+        data += b"\0" * (-len(data) % 8)
+        entries[slots[k]] = struct.pack("<7sBIHH", k, type_id, data_start + len(data), len(value), 0)
+        data += value
+
+    body = disp_blob + b"".join(entries) + data
+    size = HDR_SIZE + len(body)
+    hdr = struct.pack("<IHHHHIII8x", MAGIC, VERSION, n, num_buckets, ENTRY_SIZE, seed, size, zlib.crc32(body))
+    return hdr + body
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate a NVKVS factory partition")
+    parser.add_argument("input", help="JSON file with the keys and values")
+    parser.add_argument("output", help="binary partition to write")
+    parser.add_argument("--seed", type=int, default=0, help="first seed to try for the bucket hash")
+    args = parser.parse_args()
+
+    with open(args.input) as f:
+        items = json.load(f)
+    blob = build(items, args.seed)
+    with open(args.output, "wb") as f:
+        f.write(blob)
+    print(f"{args.output}: {len(items)} keys, {len(blob)} bytes")
+
+
+if __name__ == "__main__":
+    main()
@@ -1,6 +1,16 @@
 #ifndef IPC_H
 #define IPC_H
 #include "oblfr_mailbox.h"
+#if defined(__has_include) && __has_include(<sys/uio.h>)
+#include <sys/uio.h>
+#else
+/* newlib has no sys/uio.h */
+struct iovec
+{
+    void *iov_base;
+    size_t iov_len;
+};
+#endif
 /** 
  * @brief Device Status Enum
  */
@@ -35,6 +45,35 @@ typedef void (*oblfr_rpmsg_device_status_cb_t)(oblfr_device_cfg_t *device, devic
  * @param name Name of the endpoint
  * @param cb Callback function to be called when data is received
  * @param priv Private data to be passed to the callback function
+ * @param direct Call cb directly where the message is received, see below
+ * @param credits Receive buffers the endpoint may hold, 0 for CONFIG_RPMSG_EPT_CREDITS
+ *                (itself 0, all buffers, by default)
+ * @param priority Priority class of the rpmsg task running cb, 0 by default
+ *
+ * By default cb runs in the rpmsg task of its priority class, and may block.
+ * There are CONFIG_RPMSG_WORKERS classes, each with its own task, and class n
+ * runs n FreeRTOS priorities above class 0. The callbacks of a class run one
+ * after the other, so a slow callback only delays the endpoints of its class:
+ * a control endpoint in a higher class than a bulk one is not delayed by it.
+ * OBLFR_RPMSG_PRIO_HIGHEST, or any class beyond the last, is the last one. With direct, cb runs
+ * where the message is received, which saves queueing the message and
+ * switching to the rpmsg task, for latency critical endpoints. That is
+ * usually the mailbox interrupt, but also the rpmsg task of class 0 when it
+ * polls the link for a missed interrupt, so cb must work in both: it must
+ * return quickly and must not block, use only the FreeRTOS FromISR
+ * functions, and must not call oblfr_rpmsg_device_send() or any other rpmsg
+ * function. The data is released when cb returns.
+ *
+ * Without direct, cb may keep the data after it returns with
+ * oblfr_rpmsg_hold(), to pass it to another task without a copy.
+ *
+ * All endpoints receive into the same pool of buffers. A message is held
+ * from its arrival until cb returns, or until oblfr_rpmsg_release() if cb
+ * kept it, and an endpoint holding its credits
+ * drops the next messages, so a slow endpoint does not take the buffers of
+ * the others. The peer learns the credits from OBLFR_RPMSG_CREDIT_ENDPOINT
+ * to avoid the drops. OBLFR_RPMSG_CREDITS_ALL gives the whole pool to the
+ * endpoint, for links with a single endpoint.
  */
 typedef struct oblfr_device_cfg_s
 {
@@ -42,8 +81,40 @@ typedef struct oblfr_device_cfg_s
     oblfr_rpmsg_cb_t cb;
     oblfr_rpmsg_device_status_cb_t status_cb;
     void *priv;
+    bool direct;
+    uint16_t credits;
+    uint8_t priority;
 } oblfr_device_cfg_t;
 
+/** priority class of the highest rpmsg task */
+#define OBLFR_RPMSG_PRIO_HIGHEST 0xFF
+
+/** credits of an endpoint that may hold all receive buffers */
+#define OBLFR_RPMSG_CREDITS_ALL 0xFFFF
+
+/**
+ * @brief Endpoint advertising the credits of the others to the peer
+ *
+ * The peer subscribes by sending any message to it. It then receives an
+ * oblfr_rpmsg_credit_t for every endpoint, and again for an endpoint each
+ * time half of its credits were released since the last one. The peer may
+ * have credits messages of an endpoint in flight: sent - consumed < credits.
+ * consumed only grows (and wraps), an older value may arrive after a newer
+ * one. Direct endpoints do not hold buffers and are not advertised.
+ */
+#define OBLFR_RPMSG_CREDIT_ENDPOINT "rpmsg-credit"
+
+/**
+ * @brief Credit advertisement, see OBLFR_RPMSG_CREDIT_ENDPOINT
+ */
+typedef struct oblfr_rpmsg_credit_s
+{
+    uint32_t addr;      /**< address of the endpoint */
+    uint32_t consumed;  /**< messages released by the endpoint, since it was added */
+    uint16_t credits;   /**< messages the endpoint may hold */
+    uint16_t reserved;
+} oblfr_rpmsg_credit_t;
+
 /**
  * @brief Initialize a rpmsg device endpoint
  * 
@@ -76,6 +147,22 @@ oblfr_err_t oblfr_rpmsg_device_remove(oblfr_queue_entry_t *device);
  */
 oblfr_err_t oblfr_rpmsg_device_send(oblfr_queue_entry_t *device, void *data, size_t len, OBLFR_Timeout timeout);
 
+/**
+ * @brief Send data gathered from several buffers to a rpmsg device endpoint
+ *
+ * The pieces are copied straight into the shared memory buffer, in order,
+ * as one message, so a header and its payload need no temporary buffer
+ *
+ * @param device Opaque handle to the endpoint
+ * @param iov Pieces of the message
+ * @param iovcnt Number of pieces
+ * @param timeout Timeout in milliseconds to wait for a buffer
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the message is larger than the MTU
+ *          OBLFR_ERR_ERROR on failure
+ */
+oblfr_err_t oblfr_rpmsg_device_sendv(oblfr_queue_entry_t *device, const struct iovec *iov, int iovcnt, OBLFR_Timeout timeout);
+
 /** 
  * @brief Allocate a buffer for sending data to a rpmsg device endpoint for zerocopy sends
  * 
@@ -97,6 +184,32 @@ void  *oblfr_rpmsg_device_send_buffer_alloc(oblfr_queue_entry_t *device, uint32_
  */
 oblfr_err_t oblfr_rpmsg_device_send_buffer(oblfr_queue_entry_t *device, void *buffer, size_t len);
 
+/**
+ * @brief Keep the data of a received message after the callback returns
+ *
+ * Called by the callback of an endpoint that is not direct, with the data
+ * it was passed. The data stays in its shared memory buffer until
+ * oblfr_rpmsg_release(), so it can be handed to another task without a copy.
+ * A kept buffer counts against the credits of the endpoint, which drops the
+ * next messages while all its credits are held, see oblfr_device_cfg_t.
+ *
+ * @param data Data passed to the running callback
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if data is not the message of the running callback
+ */
+oblfr_err_t oblfr_rpmsg_hold(void *data);
+
+/**
+ * @brief Release the data of a message kept with oblfr_rpmsg_hold()
+ *
+ * From any task. The buffer returns to the other side, data is no longer valid.
+ *
+ * @param data Data passed to oblfr_rpmsg_hold()
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if data is not kept
+ */
+oblfr_err_t oblfr_rpmsg_release(void *data);
+
 /** 
  * @brief get the maximum size of a message that can be sent to a rpmsg device endpoint
  */
@@ -120,6 +233,73 @@ bool oblfr_rpmsg_is_ready(void);
  */
 oblfr_err_t init_rpmsg();
 
+/**
+ * @brief RPMSG counters, see oblfr_rpmsg_get_stats()
+ */
+typedef struct oblfr_rpmsg_stats_s
+{
+    uint32_t sent;      /**< messages sent, all endpoints */
+    uint32_t received;  /**< messages received, all endpoints */
+    uint32_t tx_kicks;  /**< notifications of sent messages */
+    uint32_t rx_kicks;  /**< notifications of released receive buffers */
+    uint32_t dropped;   /**< messages dropped by endpoints out of credits */
+} oblfr_rpmsg_stats_t;
+
+/**
+ * @brief Counters of an endpoint, see oblfr_rpmsg_get_device_stats()
+ */
+typedef struct oblfr_rpmsg_device_stats_s
+{
+    uint32_t sent;        /**< messages sent */
+    uint32_t received;    /**< messages passed to cb */
+    uint32_t dropped;     /**< messages dropped, the endpoint held all its credits */
+    uint32_t held;        /**< buffers held now */
+    uint32_t kept;        /**< buffers kept with oblfr_rpmsg_hold() now */
+    uint32_t held_max;    /**< most buffers held at once */
+    uint32_t credits;     /**< buffers the endpoint may hold */
+    uint32_t hold_us_avg; /**< time from arrival to release of a buffer, average */
+    uint32_t hold_us_max; /**< time from arrival to release of a buffer, longest */
+} oblfr_rpmsg_device_stats_t;
+
+/**
+ * @brief Notify the remote processor once per batch messages
+ *
+ * Messages below the batch are notified by a timer after
+ * CONFIG_RPMSG_KICK_FLUSH_MS, or by oblfr_rpmsg_flush()
+ *
+ * @param batch messages per notification, 1 to notify each one
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_ERROR if RPMSG is not initialized
+ */
+oblfr_err_t oblfr_rpmsg_set_kick_batch(uint32_t batch);
+
+/**
+ * @brief Notify the remote processor of the messages held back by the batch
+ *
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_ERROR if RPMSG is not initialized
+ */
+oblfr_err_t oblfr_rpmsg_flush(void);
+
+/**
+ * @brief Get the RPMSG counters
+ *
+ * @param stats filled with the counters since init_rpmsg()
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if RPMSG is not initialized
+ */
+oblfr_err_t oblfr_rpmsg_get_stats(oblfr_rpmsg_stats_t *stats);
+
+/**
+ * @brief Get the counters of an endpoint
+ *
+ * @param device Opaque handle to the endpoint
+ * @param stats filled with the counters since the endpoint was added
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID on an invalid handle
+ */
+oblfr_err_t oblfr_rpmsg_get_device_stats(oblfr_queue_entry_t *device, oblfr_rpmsg_device_stats_t *stats);
+
 /** 
  * @brief dump the internal state of the rpmsg communication
  * 
@@ -0,0 +1,137 @@
+#ifndef OBLFR_RPMSG_STREAM_H
+#define OBLFR_RPMSG_STREAM_H
+#include <stdint.h>
+#include <stddef.h>
+#include "oblfr_rpmsg.h"
+
+/*
+Streaming layer on top of a rpmsg device endpoint, for messages larger than
+the MTU. A message is sent as fragments of at most the MTU, each starting with
+a oblfr_rpmsg_frag_t header, and reassembled by the other side. Fragments are
+not acknowledged, so up to all tx buffers of the link are in flight at once.
+
+Every message of a stream endpoint carries the header, so the other side
+(Linux) has to implement it too.
+*/
+
+/**
+ * @brief Fragment header, in front of the payload of every message of a stream (little endian)
+ */
+typedef struct oblfr_rpmsg_frag_s
+{
+    uint32_t total;     /**< length of the whole message */
+    uint32_t offset;    /**< offset of this fragment in the message */
+    uint16_t seq;       /**< message number, increments per message */
+    uint16_t flags;     /**< reserved, 0 */
+} oblfr_rpmsg_frag_t;
+
+/**
+ * @brief Opaque handle to a stream endpoint
+ */
+typedef struct oblfr_rpmsg_stream_s oblfr_rpmsg_stream_t;
+
+/**
+ * @brief Callback for a reassembled message
+ *
+ * The buffer belongs to the application until it calls oblfr_rpmsg_stream_release()
+ */
+typedef void (*oblfr_rpmsg_stream_cb_t)(oblfr_rpmsg_stream_t *stream, void *data, size_t len, void *priv);
+
+/**
+ * @brief Stream endpoint configuration
+ *
+ * @param name Name of the endpoint
+ * @param cb Callback function to be called for each reassembled message
+ * @param status_cb Called when the endpoint goes up or down, with the device configuration of the stream
+ * @param priv Private data to be passed to the callback function
+ * @param max_len Largest message received, larger ones are dropped
+ * @param buf_count Number of reassembly buffers, 0 for 1
+ * @param bufs buf_count buffers of max_len bytes, or NULL to allocate them
+ * @param credits Fragments the endpoint may hold, see oblfr_device_cfg_t
+ * @param priority Priority class of the endpoint, see oblfr_device_cfg_t
+ */
+typedef struct oblfr_rpmsg_stream_cfg_s
+{
+    char name[16];
+    oblfr_rpmsg_stream_cb_t cb;
+    oblfr_rpmsg_device_status_cb_t status_cb;
+    void *priv;
+    size_t max_len;
+    uint32_t buf_count;
+    void **bufs;
+    uint16_t credits;
+    uint8_t priority;
+} oblfr_rpmsg_stream_cfg_t;
+
+/**
+ * @brief Stream counters, see oblfr_rpmsg_stream_get_stats()
+ */
+typedef struct oblfr_rpmsg_stream_stats_s
+{
+    uint32_t tx_msgs;           /**< messages sent */
+    uint32_t tx_frags;          /**< fragments sent */
+    uint64_t tx_bytes;          /**< payload bytes sent */
+    uint32_t tx_bytes_per_s;    /**< tx_bytes over the time spent sending them */
+    uint32_t rx_msgs;           /**< messages reassembled */
+    uint32_t rx_frags;          /**< fragments received */
+    uint64_t rx_bytes;          /**< payload bytes reassembled */
+    uint32_t rx_bytes_per_s;    /**< rx_bytes over the time from first to last fragments */
+    uint32_t rx_dropped;        /**< messages dropped: too large, no free buffer or fragment lost */
+} oblfr_rpmsg_stream_stats_t;
+
+/**
+ * @brief Initialize a stream endpoint
+ *
+ * @param cfg Stream configuration, must stay valid until oblfr_rpmsg_stream_remove()
+ * @return Opaque handle to the stream, NULL on error
+ */
+oblfr_rpmsg_stream_t *oblfr_rpmsg_stream_add(oblfr_rpmsg_stream_cfg_t *cfg);
+
+/**
+ * @brief Remove a stream endpoint
+ *
+ * Buffers still held by the application must not be released afterwards
+ *
+ * @param stream Opaque handle to the stream
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERROR on failure
+ */
+oblfr_err_t oblfr_rpmsg_stream_remove(oblfr_rpmsg_stream_t *stream);
+
+/**
+ * @brief Send a message of any length, fragmented as needed
+ *
+ * Each fragment is copied once, from data to the shared memory. Sends of
+ * several tasks on one stream are serialized.
+ *
+ * @param stream Opaque handle to the stream
+ * @param data Data to send
+ * @param len Length of the data
+ * @param timeout Timeout in milliseconds to wait for each tx buffer
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID on invalid arguments
+ *          OBLFR_ERROR on failure, the fragments sent are dropped by the other side
+ */
+oblfr_err_t oblfr_rpmsg_stream_send(oblfr_rpmsg_stream_t *stream, const void *data, size_t len, OBLFR_Timeout timeout);
+
+/**
+ * @brief Give a buffer passed to the stream callback back for reassembly
+ *
+ * @param stream Opaque handle to the stream
+ * @param data Buffer from the callback
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID if the buffer is not a reassembly buffer of the stream
+ */
+oblfr_err_t oblfr_rpmsg_stream_release(oblfr_rpmsg_stream_t *stream, void *data);
+
+/**
+ * @brief Get the stream counters and throughput
+ *
+ * @param stream Opaque handle to the stream
+ * @param stats filled with the counters since oblfr_rpmsg_stream_add()
+ * @return  OBLFR_OK on success
+ *          OBLFR_ERR_INVALID on invalid arguments
+ */
+oblfr_err_t oblfr_rpmsg_stream_get_stats(oblfr_rpmsg_stream_t *stream, oblfr_rpmsg_stream_stats_t *stats);
+
+#endif
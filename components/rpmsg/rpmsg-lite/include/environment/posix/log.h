@@ -0,0 +1,27 @@
+/*
+ * Stand-in for the SDK log.h when RPMsg-Lite is built on a host with the
+ * POSIX environment. Only on the include path of host builds.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef RPMSG_POSIX_LOG_H_
+#define RPMSG_POSIX_LOG_H_
+
+#include <stdio.h>
+
+#ifndef DBG_TAG
+#define DBG_TAG "RPMSG"
+#endif
+
+#define LOG_E(fmt, ...) fprintf(stderr, "[E][" DBG_TAG "] " fmt, ##__VA_ARGS__)
+#define LOG_W(fmt, ...) fprintf(stderr, "[W][" DBG_TAG "] " fmt, ##__VA_ARGS__)
+#ifdef RL_POSIX_VERBOSE
+#define LOG_I(fmt, ...) fprintf(stderr, "[I][" DBG_TAG "] " fmt, ##__VA_ARGS__)
+#define LOG_D(fmt, ...) fprintf(stderr, "[D][" DBG_TAG "] " fmt, ##__VA_ARGS__)
+#else
+#define LOG_I(fmt, ...)
+#define LOG_D(fmt, ...)
+#endif
+#define LOG_T(fmt, ...)
+
+#endif /* RPMSG_POSIX_LOG_H_ */
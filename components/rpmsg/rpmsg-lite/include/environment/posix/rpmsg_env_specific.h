@@ -0,0 +1,41 @@
+/*
+ * Copyright 2021 NXP
+ * All rights reserved.
+ *
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**************************************************************************
+ * FILE NAME
+ *
+ *       rpmsg_env_specific.h
+ *
+ * DESCRIPTION
+ *
+ *       This file contains POSIX (pthreads) specific constructions.
+ *
+ **************************************************************************/
+#ifndef RPMSG_ENV_SPECIFIC_H_
+#define RPMSG_ENV_SPECIFIC_H_
+
+#include <stdint.h>
+#include "rpmsg_default_config.h"
+
+typedef struct
+{
+    uint32_t src;
+    void *data;
+    uint32_t len;
+} rpmsg_queue_rx_cb_data_t;
+
+/* The interrupt handlers run in the interrupt thread of the platform, in parallel
+   to the tasks, so the rx callback takes the instance lock. Endpoint callbacks
+   must not send (rpmsg_queue_rx_cb() does not) */
+#define RL_ENV_THREADED_ISR (1)
+
+#if defined(RL_USE_STATIC_API) && (RL_USE_STATIC_API == 1)
+#error "The POSIX environment requires RL_USE_STATIC_API set to 0"
+#endif
+
+#endif /* RPMSG_ENV_SPECIFIC_H_ */
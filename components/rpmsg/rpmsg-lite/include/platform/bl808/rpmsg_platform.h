@@ -11,6 +11,7 @@
 #define RPMSG_PLATFORM_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 
 /*
  * No need to align the VRING as defined in Linux because k32l3a6 is not intended
@@ -37,6 +38,29 @@
 /* size of shared memory + 2*VRING size */
 #define RL_VRING_OVERHEAD (2UL * VRING_SIZE)
 
+/* default layout of the M0 link, from Kconfig, must match the Linux side */
+#ifndef CONFIG_RPMSG_VRING_SIZE
+#define CONFIG_RPMSG_VRING_SIZE VRING_SIZE
+#endif
+#ifndef CONFIG_RPMSG_BUFFER_COUNT
+#define CONFIG_RPMSG_BUFFER_COUNT 8
+#endif
+#ifndef CONFIG_RPMSG_BUFFER_SIZE
+#define CONFIG_RPMSG_BUFFER_SIZE 2048
+#endif
+
+/*
+ * Layout of the shared memory of a link (RL_ALLOW_CUSTOM_SHMEM_CONFIG):
+ * two vrings of vring_size bytes, then the buffers of both directions
+ */
+typedef struct rpmsg_platform_shmem_config
+{
+    uint32_t buffer_payload_size; /* buffer size - 16 (rpmsg header), replaces RL_BUFFER_PAYLOAD_SIZE */
+    uint16_t buffer_count;        /* buffers per direction, replaces RL_BUFFER_COUNT */
+    uint32_t vring_size;          /* replaces VRING_SIZE */
+    uint32_t vring_align;         /* replaces VRING_ALIGN */
+} rpmsg_platform_shmem_config_t;
+
 #define RL_GET_VQ_ID(link_id, queue_id) (((queue_id)&0x1U) | (((link_id) << 1U) & 0xFFFFFFFEU))
 #define RL_GET_LINK_ID(id)              (((id)&0xFFFFFFFEU) >> 1U)
 #define RL_GET_Q_ID(id)                 ((id)&0x1U)
@@ -51,6 +75,7 @@ int32_t platform_deinit_interrupt(uint32_t vector_id);
 int32_t platform_interrupt_enable(uint32_t vector_id);
 int32_t platform_interrupt_disable(uint32_t vector_id);
 int32_t platform_in_isr(void);
+void platform_inisr(bool in_isr);
 void platform_notify(uint32_t vector_id);
 
 /* platform low-level time-delay (busy loop) */
@@ -60,9 +85,17 @@ void platform_time_delay(uint32_t num_msec);
 void platform_map_mem_region(uint32_t vrt_addr, uint32_t phy_addr, uint32_t size, uint32_t flags);
 void platform_cache_all_flush_invalidate(void);
 void platform_cache_disable(void);
+void platform_cache_clean(void *addr, uint32_t len);
+void platform_cache_invalidate(void *addr, uint32_t len);
 uint32_t platform_vatopa(void *addr);
 void *platform_patova(uintptr_t addr);
 
+/* platform shared memory layout, checked by rpmsg_lite_remote_init() */
+int32_t platform_get_custom_shmem_config(uint32_t link_id, rpmsg_platform_shmem_config_t *cfg);
+int32_t platform_set_custom_shmem_config(uint32_t link_id, const rpmsg_platform_shmem_config_t *cfg);
+uint32_t platform_get_buffer_payload_size(uint32_t link_id);
+uint32_t platform_get_buffer_count(uint32_t link_id);
+
 /* platform init/deinit */
 int32_t platform_init(void);
 int32_t platform_deinit(void);
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2016 Freescale Semiconductor, Inc.
+ * Copyright 2016-2019 NXP
+ * All rights reserved.
+ *
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef RPMSG_PLATFORM_H_
+#define RPMSG_PLATFORM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Loopback platform, for host builds with the POSIX environment.
+ *
+ * The master (RL_PLATFORM_LOOPBACK_MASTER_LINK_ID) and the remote
+ * (RL_PLATFORM_LOOPBACK_REMOTE_LINK_ID) share the memory returned by
+ * platform_loopback_shmem_map(), in two threads of one process or in two
+ * processes. A kick sets a pending bit in a doorbell page in front of the
+ * shared memory and wakes the interrupt thread of the other side with a futex.
+ *
+ * Built with RL_USE_DCACHE, each process accesses the shared memory through
+ * a simulated write-back cache, and the maintenance of RPMsg-Lite is checked:
+ * what is not cleaned stays invisible to the other side, what is not
+ * invalidated stays stale, and platform_cache_clean() / _invalidate() abort
+ * when a line is lost. The two sides must then run in two processes.
+ */
+
+/* same layout as bl808, so the shared memory matches the target */
+#ifndef VRING_ALIGN
+#define VRING_ALIGN (0x1000U)
+#endif
+
+/* contains pool of descriptos and two circular buffers */
+#ifndef VRING_SIZE
+#define VRING_SIZE (0x4000UL)
+#endif
+
+/* size of shared memory + 2*VRING size */
+#define RL_VRING_OVERHEAD (2UL * VRING_SIZE)
+
+/*
+ * Layout of the shared memory of a link (RL_ALLOW_CUSTOM_SHMEM_CONFIG):
+ * two vrings of vring_size bytes, then the buffers of both directions
+ */
+typedef struct rpmsg_platform_shmem_config
+{
+    uint32_t buffer_payload_size; /* buffer size - 16 (rpmsg header), replaces RL_BUFFER_PAYLOAD_SIZE */
+    uint16_t buffer_count;        /* buffers per direction, replaces RL_BUFFER_COUNT */
+    uint32_t vring_size;          /* replaces VRING_SIZE */
+    uint32_t vring_align;         /* replaces VRING_ALIGN */
+} rpmsg_platform_shmem_config_t;
+
+#define RL_GET_VQ_ID(link_id, queue_id) (((queue_id)&0x1U) | (((link_id) << 1U) & 0xFFFFFFFEU))
+#define RL_GET_LINK_ID(id)              (((id)&0xFFFFFFFEU) >> 1U)
+#define RL_GET_Q_ID(id)                 ((id)&0x1U)
+
+#define RL_PLATFORM_LOOPBACK_MASTER_LINK_ID (0U)
+#define RL_PLATFORM_LOOPBACK_REMOTE_LINK_ID (1U)
+#define RL_PLATFORM_HIGHEST_LINK_ID         (1U)
+
+/* bus address of the shared memory given to RPMsg-Lite, the same in both processes */
+#define RL_PLATFORM_LOOPBACK_BUS_ADDR (0x10000000U)
+
+/* line of the simulated cache, the largest of the bl808 cores */
+#define RL_PLATFORM_LOOPBACK_CACHE_LINE (64U)
+
+/**
+ * platform_loopback_shmem_map
+ *
+ * Map the shared memory (with its doorbell page) for both sides of the link.
+ * Call before rpmsg_lite_master_init() / rpmsg_lite_remote_init(), and pass
+ * the returned address as shmem_addr of both. Only one mapping per process.
+ *
+ * @param name NULL for an anonymous mapping (two threads, or processes forked
+ *             after the call), else the name of a POSIX shared memory object,
+ *             mapped by both processes
+ * @param size size of the shared memory, at least
+ *             platform_loopback_shmem_size() of the master link
+ *
+ * @return address of the shared memory, NULL on error
+ */
+void *platform_loopback_shmem_map(const char *name, uint32_t size);
+
+/**
+ * platform_loopback_shmem_unmap
+ *
+ * Unmap the shared memory, after both sides were deinitialized. The named
+ * object is removed by whoever unmaps it first.
+ */
+void platform_loopback_shmem_unmap(void);
+
+/**
+ * platform_loopback_shmem_size
+ *
+ * Size of the shared memory for the layout of a link, its two vrings and
+ * the buffers of both directions.
+ */
+uint32_t platform_loopback_shmem_size(uint32_t link_id);
+
+/* platform shared memory layout, 8 buffers of 2048 bytes by default, the same for both links */
+int32_t platform_get_custom_shmem_config(uint32_t link_id, rpmsg_platform_shmem_config_t *cfg);
+int32_t platform_set_custom_shmem_config(uint32_t link_id, const rpmsg_platform_shmem_config_t *cfg);
+uint32_t platform_get_buffer_payload_size(uint32_t link_id);
+uint32_t platform_get_buffer_count(uint32_t link_id);
+
+/* platform interrupt related functions */
+int32_t platform_init_interrupt(uint32_t vector_id, void *isr_data);
+int32_t platform_deinit_interrupt(uint32_t vector_id);
+int32_t platform_interrupt_enable(uint32_t vector_id);
+int32_t platform_interrupt_disable(uint32_t vector_id);
+int32_t platform_in_isr(void);
+void platform_inisr(bool in_isr);
+void platform_notify(uint32_t vector_id);
+
+/* platform low-level time-delay (busy loop) */
+void platform_time_delay(uint32_t num_msec);
+
+/* platform memory functions */
+void platform_map_mem_region(uint32_t vrt_addr, uint32_t phy_addr, uint32_t size, uint32_t flags);
+void platform_cache_all_flush_invalidate(void);
+void platform_cache_disable(void);
+void platform_cache_clean(void *addr, uint32_t len);
+void platform_cache_invalidate(void *addr, uint32_t len);
+uint32_t platform_vatopa(void *addr);
+void *platform_patova(uintptr_t addr);
+
+/* platform init/deinit */
+int32_t platform_init(void);
+int32_t platform_deinit(void);
+
+#endif /* RPMSG_PLATFORM_H_ */
@@ -101,10 +101,15 @@
 #define MEM_BARRIER()  __DMB() 
 #define MEM_BARRIER_R() __DMB()
 #define MEM_BARRIER_W() __DMB()
-#else
+#elif defined(__arm__)
 #define MEM_BARRIER() __asm__ volatile("dsb" : : : "memory")
 #define MEM_BARRIER_R() __asm__ volatile("dsb" : : : "memory")
 #define MEM_BARRIER_W() __asm__ volatile("dsb" : : : "memory")
+#else
+/* hosted builds (POSIX environment) */
+#define MEM_BARRIER()  __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define MEM_BARRIER_R() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define MEM_BARRIER_W() __atomic_thread_fence(__ATOMIC_RELEASE)
 #endif
 
 #ifndef RL_PACKED_BEGIN
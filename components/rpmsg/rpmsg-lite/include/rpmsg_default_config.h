@@ -55,7 +55,9 @@
 //! @def RL_MS_PER_INTERVAL
 //!
 //! Delay in milliseconds used in non-blocking API functions for polling.
-//! The default value is 1.
+//! Senders waiting for a free tx buffer are woken when the other side
+//! notifies consumed buffers, and poll with this interval in case it does not.
+//! The default value is 10.
 #ifndef RL_MS_PER_INTERVAL
 #define RL_MS_PER_INTERVAL (10)
 #endif
@@ -67,10 +69,11 @@
 //! when multiple instances are running in parallel but different shared memory
 //! arrangement (vring size & alignment, buffers size & count) is required. Note,
 //! that once enabled the platform_get_custom_shmem_config() function needs
-//! to be implemented in platform layer. The default value is 0 (all RPMsg_Lite
-//! instances use the same shared memory arrangement as defined by common config macros).
+//! to be implemented in platform layer. The bl808 and loopback platforms
+//! implement it with a layout set at runtime, see platform_set_custom_shmem_config().
+//! The default value is 1 (the layout of each link comes from the platform layer).
 #ifndef RL_ALLOW_CUSTOM_SHMEM_CONFIG
-#define RL_ALLOW_CUSTOM_SHMEM_CONFIG (0)
+#define RL_ALLOW_CUSTOM_SHMEM_CONFIG (1)
 #endif
 
 #if !(defined(RL_ALLOW_CUSTOM_SHMEM_CONFIG) && (RL_ALLOW_CUSTOM_SHMEM_CONFIG == 1))
@@ -103,12 +106,13 @@
 //! Define the buffer payload and count per different link IDs (rpmsg_lite instance) when RL_ALLOW_CUSTOM_SHMEM_CONFIG
 //! is set.
 //! Refer to the rpmsg_plaform.h for the used link IDs.
+//! Both are read from the layout of the link in the platform layer.
 #ifndef RL_BUFFER_PAYLOAD_SIZE
-#define RL_BUFFER_PAYLOAD_SIZE(link_id) (496U)
+#define RL_BUFFER_PAYLOAD_SIZE(link_id) platform_get_buffer_payload_size(link_id)
 #endif
 
 #ifndef RL_BUFFER_COUNT
-#define RL_BUFFER_COUNT(link_id) (((link_id) == 0U) ? 256U : 2U)
+#define RL_BUFFER_COUNT(link_id) platform_get_buffer_count(link_id)
 #endif
 #endif /* !(defined(RL_ALLOW_CUSTOM_SHMEM_CONFIG) && (RL_ALLOW_CUSTOM_SHMEM_CONFIG == 1))*/
 
@@ -128,6 +132,18 @@
 #define RL_USE_STATIC_API (0)
 #endif
 
+//! @def RL_EPT_TABLE_SIZE
+//!
+//! Number of local endpoint addresses (0 to RL_EPT_TABLE_SIZE - 1) looked up
+//! in a table indexed by address, so the rx path costs the same whatever the
+//! number of endpoints. Automatically assigned addresses start at 1, and the
+//! name service endpoint is at 53. Other addresses are looked up in the list
+//! of endpoints.
+//! The default value is 64.
+#ifndef RL_EPT_TABLE_SIZE
+#define RL_EPT_TABLE_SIZE (64U)
+#endif
+
 //! @def RL_CLEAR_USED_BUFFERS
 //!
 //! Clearing used buffers before returning back to the pool of free buffers
@@ -163,6 +179,22 @@
 #define RL_DEBUG_CHECK_BUFFERS (0)
 #endif
 
+//! @def RL_USE_DCACHE
+//!
+//! The shared memory is accessed through a data cache that is not coherent
+//! with the other side. RPMsg-Lite then cleans the vring entries and buffers
+//! it writes, and invalidates those it reads, with env_cache_clean() and
+//! env_cache_invalidate(), so the cache can stay enabled.
+//! The default value is 1 with CONFIG_RPMSG_DCACHE (the M0 dcache stays on),
+//! else 0 (shared memory uncached or coherent).
+#ifndef RL_USE_DCACHE
+#if defined(CONFIG_RPMSG_DCACHE)
+#define RL_USE_DCACHE (1)
+#else
+#define RL_USE_DCACHE (0)
+#endif
+#endif
+
 //! @def RL_ALLOW_CONSUMED_BUFFERS_NOTIFICATION
 //!
 //! When enabled the opposite side is notified each time received buffers
@@ -346,6 +346,18 @@ void env_delete_sync_lock(void *lock);
  */
 void env_acquire_sync_lock(void *lock);
 
+/*!
+ * env_acquire_sync_lock_timeout
+ *
+ * Tries to acquire the sync lock, waiting at most timeout_ms.
+ *
+ * @param lock       - sync lock to acquire.
+ * @param timeout_ms - timeout in ms, RL_BLOCK to wait forever
+ *
+ * @return - 1 if acquired, 0 on timeout
+ */
+int32_t env_acquire_sync_lock_timeout(void *lock, uint32_t timeout_ms);
+
 /*!
  * env_release_sync_lock
  *
@@ -460,10 +472,41 @@ void env_disable_interrupt(uint32_t vector_id);
 
 void env_map_memory(uint32_t pa, uint32_t va, uint32_t size, uint32_t flags);
 
+/*!
+ * env_cache_clean
+ *
+ * Writes the cached data of a shared memory range back to memory,
+ * so the other side sees it.
+ *
+ * @param addr  Start of the range
+ * @param size  Size of the range, in bytes
+ */
+void env_cache_clean(void *addr, uint32_t size);
+
+/*!
+ * env_cache_invalidate
+ *
+ * Discards the cached data of a shared memory range, so the next
+ * reads get what the other side wrote.
+ *
+ * @param addr  Start of the range
+ * @param size  Size of the range, in bytes
+ */
+void env_cache_invalidate(void *addr, uint32_t size);
+
+/* cache maintenance of the shared memory, only with RL_USE_DCACHE */
+#if defined(RL_USE_DCACHE) && (RL_USE_DCACHE == 1)
+#define RL_CACHE_CLEAN(addr, size)      env_cache_clean((void *)(addr), (uint32_t)(size))
+#define RL_CACHE_INVALIDATE(addr, size) env_cache_invalidate((void *)(addr), (uint32_t)(size))
+#else
+#define RL_CACHE_CLEAN(addr, size)
+#define RL_CACHE_INVALIDATE(addr, size)
+#endif
+
 /*!
  * env_get_timestamp
  *
- * Returns a 64 bit time stamp.
+ * Returns a 64 bit time stamp, in ms.
  *
  *
  */
@@ -56,11 +56,11 @@ extern "C" {
 
 /* Shared memory "allocator" parameters */
 #define RL_WORD_SIZE (sizeof(uint32_t))
-#define RL_WORD_ALIGN_UP(a)                                                                                \
-    (((((uint32_t)(a)) & (RL_WORD_SIZE - 1U)) != 0U) ? ((((uint32_t)(a)) & (~(RL_WORD_SIZE - 1U))) + 4U) : \
-                                                       ((uint32_t)(a)))
+#define RL_WORD_ALIGN_UP(a)                                                                                   \
+    (((((uintptr_t)(a)) & (RL_WORD_SIZE - 1U)) != 0U) ? ((((uintptr_t)(a)) & (~(RL_WORD_SIZE - 1U))) + 4U) : \
+                                                        ((uintptr_t)(a)))
 #define RL_WORD_ALIGN_DOWN(a) \
-    (((((uint32_t)(a)) & (RL_WORD_SIZE - 1U)) != 0U) ? (((uint32_t)(a)) & (~(RL_WORD_SIZE - 1U))) : ((uint32_t)(a)))
+    (((((uintptr_t)(a)) & (RL_WORD_SIZE - 1U)) != 0U) ? (((uintptr_t)(a)) & (~(RL_WORD_SIZE - 1U))) : ((uintptr_t)(a)))
 
 /* Definitions for device types , null pointer, etc.*/
 #define RL_SUCCESS    (0)
@@ -87,7 +87,8 @@ extern "C" {
 #define RL_ALREADY_DONE  (RL_ERRORS_BASE - 8)
 
 /* Init flags */
-#define RL_NO_FLAGS (0)
+#define RL_NO_FLAGS  (0)
+#define RL_EVENT_IDX (1) /*!< VIRTIO_RING_F_EVENT_IDX negotiated, must match the other side */
 
 /*! \typedef rl_ept_rx_cb_t
     \brief Receive callback function type.
@@ -126,11 +127,20 @@ struct rpmsg_lite_instance
     struct virtqueue *rvq;      /*!< receive virtqueue */
     struct virtqueue *tvq;      /*!< transmit virtqueue */
     struct llist *rl_endpoints; /*!< linked list of endpoints */
+    struct llist *rl_ept_table[RL_EPT_TABLE_SIZE]; /*!< endpoints with addresses below RL_EPT_TABLE_SIZE */
     LOCK *lock;                 /*!< local RPMsg Lite mutex lock */
 #if defined(RL_USE_STATIC_API) && (RL_USE_STATIC_API == 1)
     LOCK_STATIC_CONTEXT lock_static_ctxt; /*!< Static context for lock object creation */
+#endif
+    void *tx_sync_lock; /*!< released when the other side returns tx buffers */
+#if defined(RL_USE_STATIC_API) && (RL_USE_STATIC_API == 1)
+    LOCK_STATIC_CONTEXT tx_sync_lock_static_ctxt; /*!< Static context for tx_sync_lock creation */
 #endif
     uint32_t link_state;                /*!< state of the link, up/down*/
+    uint32_t kick_batch;                /*!< notify the other side every kick_batch buffers, 0 or 1 for each */
+    uint32_t tx_unkicked;               /*!< buffers sent since the last tx notification */
+    uint32_t rx_unkicked;               /*!< buffers released since the last rx notification */
+    void *tx_released;                  /*!< tx buffers released unsent, see rpmsg_lite_release_tx_buffer() */
     char *sh_mem_base;                  /*!< base address of the shared memory */
     uint32_t sh_mem_remaining;          /*!< amount of remaining unused buffers in shared memory */
     uint32_t sh_mem_total;              /*!< total amount of buffers in shared memory */
@@ -302,6 +312,29 @@ uint32_t rpmsg_lite_is_link_up(struct rpmsg_lite_instance *rpmsg_lite_dev);
  */
 void rpmsg_lite_wait_for_link_up(struct rpmsg_lite_instance *rpmsg_lite_dev);
 
+/*!
+ * @brief Notify the other side only every batch sent or released buffers.
+ *
+ * Buffers below the batch stay in the vring unnoticed until more follow,
+ * rpmsg_lite_flush() is called or a sender has to wait for a tx buffer, so
+ * the application has to flush when it stops sending.
+ *
+ * @param rpmsg_lite_dev    RPMsg-Lite instance
+ * @param batch             Buffers per notification, 0 or 1 to notify each one (default)
+ *
+ * @return Status of function execution, RL_SUCCESS on success.
+ */
+int32_t rpmsg_lite_set_kick_batch(struct rpmsg_lite_instance *rpmsg_lite_dev, uint32_t batch);
+
+/*!
+ * @brief Notify the other side of the buffers held back by the kick batch.
+ *
+ * @param rpmsg_lite_dev    RPMsg-Lite instance
+ *
+ * @return Status of function execution, RL_SUCCESS on success.
+ */
+int32_t rpmsg_lite_flush(struct rpmsg_lite_instance *rpmsg_lite_dev);
+
 #if defined(RL_API_HAS_ZEROCOPY) && (RL_API_HAS_ZEROCOPY == 1)
 
 /*!
@@ -364,6 +397,21 @@ int32_t rpmsg_lite_send_nocopy(struct rpmsg_lite_instance *rpmsg_lite_dev,
                                uint32_t dst,
                                void *data,
                                uint32_t size);
+
+/*!
+ * @brief Releases a tx buffer that will not be sent.
+ *
+ * Hands a buffer allocated by rpmsg_lite_alloc_tx_buffer() back, when it is not
+ * sent or rpmsg_lite_send_nocopy() failed. The next allocation returns it.
+ *
+ * @param rpmsg_lite_dev    RPMsg-Lite instance
+ * @param txbuf             Tx buffer returned by rpmsg_lite_alloc_tx_buffer()
+ *
+ * @return Status of function execution, RL_SUCCESS on success.
+ *
+ * @see rpmsg_lite_alloc_tx_buffer
+ */
+int32_t rpmsg_lite_release_tx_buffer(struct rpmsg_lite_instance *rpmsg_lite_dev, void *txbuf);
 #endif /* RL_API_HAS_ZEROCOPY */
 
 //! @}
@@ -66,6 +66,7 @@ typedef uint8_t boolean;
 #define VQ_RING_DESC_CHAIN_END   (32768)
 #define VIRTQUEUE_FLAG_INDIRECT  (0x0001U)
 #define VIRTQUEUE_FLAG_EVENT_IDX (0x0002U)
+#define VIRTQUEUE_FLAG_REMOTE    (0x0004U) /* produces the used ring (device side) */
 #define VIRTQUEUE_MAX_NAME_SZ    (32) /* mind the alignment */
 
 /* Support for indirect buffer descriptors. */
@@ -138,6 +139,8 @@ struct virtqueue
 #if defined(RL_USE_ENVIRONMENT_CONTEXT) && (RL_USE_ENVIRONMENT_CONTEXT == 1)
     void *env; /* private pointer to environment layer internal context */
 #endif
+
+    uint32_t vq_notify_cnt; /* notifications sent to the other side */
 };
 
 /* struct to hold vring specific information */
@@ -496,6 +496,28 @@ void env_acquire_sync_lock(void *lock)
     }
 }
 
+/*!
+ * env_acquire_sync_lock_timeout
+ *
+ * Tries to acquire the lock, waiting at most timeout_ms for it.
+ */
+int32_t env_acquire_sync_lock_timeout(void *lock, uint32_t timeout_ms)
+{
+    SemaphoreHandle_t xSemaphore = (SemaphoreHandle_t)lock;
+    TickType_t ticks;
+
+    if (timeout_ms == RL_BLOCK)
+    {
+        ticks = portMAX_DELAY;
+    }
+    else
+    {
+        /* round up, so the lock is waited for at least timeout_ms */
+        ticks = (TickType_t)((timeout_ms + portTICK_PERIOD_MS - 1U) / portTICK_PERIOD_MS);
+    }
+    return (xSemaphoreTake(xSemaphore, ticks) == pdTRUE) ? 1 : 0;
+}
+
 /*!
  * env_release_sync_lock
  *
@@ -614,11 +636,35 @@ void env_disable_cache(void)
     platform_cache_disable();
 }
 
+/*!
+ * env_cache_clean
+ *
+ * Writes a cached shared memory range back to memory.
+ *
+ */
+
+void env_cache_clean(void *addr, uint32_t size)
+{
+    platform_cache_clean(addr, size);
+}
+
+/*!
+ * env_cache_invalidate
+ *
+ * Discards a cached shared memory range.
+ *
+ */
+
+void env_cache_invalidate(void *addr, uint32_t size)
+{
+    platform_cache_invalidate(addr, size);
+}
+
 /*!
  *
  * env_get_timestamp
  *
- * Returns a 64 bit time stamp.
+ * Returns a 64 bit time stamp, in ms.
  *
  *
  */
@@ -626,11 +672,11 @@ uint64_t env_get_timestamp(void)
 {
     if (env_in_isr() != 0)
     {
-        return (uint64_t)xTaskGetTickCountFromISR();
+        return (uint64_t)xTaskGetTickCountFromISR() * portTICK_PERIOD_MS;
     }
     else
     {
-        return (uint64_t)xTaskGetTickCount();
+        return (uint64_t)xTaskGetTickCount() * portTICK_PERIOD_MS;
     }
 }
 
@@ -0,0 +1,840 @@
+/*
+ *
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**************************************************************************
+ * FILE NAME
+ *
+ *       rpmsg_env_posix.c
+ *
+ *
+ * DESCRIPTION
+ *
+ *       This file is the POSIX (pthreads) implementation of the env layer,
+ *       to run RPMsg-Lite on a host (see the loopback platform).
+ *
+ *
+ **************************************************************************/
+
+#include "rpmsg_compiler.h"
+#include "rpmsg_env.h"
+#include "rpmsg_platform.h"
+#include "virtqueue.h"
+#include "rpmsg_lite.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Counting semaphore, used for the mutexes and the sync locks of RPMsg-Lite */
+typedef struct env_sema
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int32_t count;
+} env_sema_t;
+
+/* Queue of fixed size elements */
+typedef struct env_queue
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    int32_t length;
+    int32_t element_size;
+    int32_t head;
+    int32_t count;
+    uint8_t *data;
+} env_queue_t;
+
+static int32_t env_init_counter       = 0;
+static pthread_mutex_t env_init_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* link up events, see env_wait_for_link_up() */
+static pthread_mutex_t link_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t link_cond   = PTHREAD_COND_INITIALIZER;
+
+/* RL_ENV_MAX_MUTEX_COUNT is an arbitrary count greater than 'count'
+   if the inital count is 1, this function behaves as a mutex
+   if it is greater than 1, it acts as a "resource allocator" with
+   the maximum of 'count' resources available.
+   Currently, only the first use-case is applicable/applied in RPMsg-Lite.
+ */
+#define RL_ENV_MAX_MUTEX_COUNT (10)
+
+/* Max supported ISR counts */
+#define ISR_COUNT (16U)
+/*!
+ * Structure to keep track of registered ISR's.
+ */
+struct isr_info
+{
+    void *data;
+};
+static struct isr_info isr_table[ISR_COUNT];
+
+#if defined(RL_USE_ENVIRONMENT_CONTEXT) && (RL_USE_ENVIRONMENT_CONTEXT == 1)
+#error "This RPMsg-Lite port requires RL_USE_ENVIRONMENT_CONTEXT set to 0"
+#endif
+
+/*!
+ * env_in_isr
+ *
+ * @returns - true, if currently in ISR (the interrupt thread of the platform)
+ *
+ */
+static int32_t env_in_isr(void)
+{
+    return platform_in_isr();
+}
+
+/* absolute CLOCK_MONOTONIC deadline, timeout_ms from now */
+static void env_deadline(struct timespec *ts, uint32_t timeout_ms)
+{
+    (void)clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += (time_t)(timeout_ms / 1000U);
+    ts->tv_nsec += (long)(timeout_ms % 1000U) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L)
+    {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+static void env_cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    (void)pthread_condattr_init(&attr);
+    (void)pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    (void)pthread_cond_init(cond, &attr);
+    (void)pthread_condattr_destroy(&attr);
+}
+
+/*!
+ * env_wait_for_link_up
+ *
+ * Wait until the link_state parameter of the rpmsg_lite_instance is set.
+ *
+ */
+void env_wait_for_link_up(volatile uint32_t *link_state, uint32_t link_id)
+{
+    (void)pthread_mutex_lock(&link_mutex);
+    while (*link_state != 1U)
+    {
+        (void)pthread_cond_wait(&link_cond, &link_mutex);
+    }
+    (void)pthread_mutex_unlock(&link_mutex);
+}
+
+/*!
+ * env_tx_callback
+ *
+ * Wake the tasks waiting in env_wait_for_link_up().
+ *
+ */
+void env_tx_callback(uint32_t link_id)
+{
+    (void)pthread_mutex_lock(&link_mutex);
+    (void)pthread_cond_broadcast(&link_cond);
+    (void)pthread_mutex_unlock(&link_mutex);
+}
+
+/*!
+ * env_init
+ *
+ * Initializes OS/BM environment.
+ *
+ */
+int32_t env_init(void)
+{
+    int32_t retval = 0;
+
+    /* platform_init() runs under the lock, so other callers wait for it */
+    (void)pthread_mutex_lock(&env_init_mutex);
+    RL_ASSERT(env_init_counter >= 0);
+    if (env_init_counter < 0)
+    {
+        (void)pthread_mutex_unlock(&env_init_mutex);
+        return -1;
+    }
+    env_init_counter++;
+    if (env_init_counter == 1)
+    {
+        (void)memset(isr_table, 0, sizeof(isr_table));
+        retval = platform_init();
+    }
+    (void)pthread_mutex_unlock(&env_init_mutex);
+    return retval;
+}
+
+/*!
+ * env_deinit
+ *
+ * Uninitializes OS/BM environment.
+ *
+ * @returns - execution status
+ */
+int32_t env_deinit(void)
+{
+    int32_t retval = 0;
+
+    (void)pthread_mutex_lock(&env_init_mutex);
+    RL_ASSERT(env_init_counter > 0);
+    if (env_init_counter <= 0)
+    {
+        (void)pthread_mutex_unlock(&env_init_mutex);
+        return -1;
+    }
+    env_init_counter--;
+    if (env_init_counter <= 0)
+    {
+        /* last call */
+        (void)memset(isr_table, 0, sizeof(isr_table));
+        retval = platform_deinit();
+    }
+    (void)pthread_mutex_unlock(&env_init_mutex);
+    return retval;
+}
+
+/*!
+ * env_allocate_memory - implementation
+ *
+ * @param size
+ */
+void *env_allocate_memory(uint32_t size)
+{
+    return (malloc(size));
+}
+
+/*!
+ * env_free_memory - implementation
+ *
+ * @param ptr
+ */
+void env_free_memory(void *ptr)
+{
+    if (ptr != ((void *)0))
+    {
+        free(ptr);
+    }
+}
+
+/*!
+ *
+ * env_memset - implementation
+ *
+ * @param ptr
+ * @param value
+ * @param size
+ */
+void env_memset(void *ptr, int32_t value, uint32_t size)
+{
+    (void)memset(ptr, value, size);
+}
+
+/*!
+ *
+ * env_memcpy - implementation
+ *
+ * @param dst
+ * @param src
+ * @param len
+ */
+void env_memcpy(void *dst, void const *src, uint32_t len)
+{
+    (void)memcpy(dst, src, len);
+}
+
+/*!
+ *
+ * env_strcmp - implementation
+ *
+ * @param dst
+ * @param src
+ */
+
+int32_t env_strcmp(const char *dst, const char *src)
+{
+    return (strcmp(dst, src));
+}
+
+/*!
+ *
+ * env_strncpy - implementation
+ *
+ * @param dest
+ * @param src
+ * @param len
+ */
+void env_strncpy(char *dest, const char *src, uint32_t len)
+{
+    (void)strncpy(dest, src, len);
+}
+
+/*!
+ *
+ * env_strncmp - implementation
+ *
+ * @param dest
+ * @param src
+ * @param len
+ */
+int32_t env_strncmp(char *dest, const char *src, uint32_t len)
+{
+    return (strncmp(dest, src, len));
+}
+
+/*!
+ *
+ * env_mb - implementation
+ *
+ */
+void env_mb(void)
+{
+    MEM_BARRIER();
+}
+
+/*!
+ * env_rmb - implementation
+ */
+void env_rmb(void)
+{
+    MEM_BARRIER_R();
+}
+
+/*!
+ * env_wmb - implementation
+ */
+void env_wmb(void)
+{
+    MEM_BARRIER_W();
+}
+
+/*!
+ * env_map_vatopa - implementation
+ *
+ * @param address
+ */
+uint32_t env_map_vatopa(void *address)
+{
+    return platform_vatopa(address);
+}
+
+/*!
+ * env_map_patova - implementation
+ *
+ * @param address
+ */
+void *env_map_patova(uint32_t address)
+{
+    return platform_patova(address);
+}
+
+/*!
+ * env_create_mutex
+ *
+ * Creates a mutex with the given initial count.
+ *
+ */
+int32_t env_create_mutex(void **lock, int32_t count)
+{
+    env_sema_t *sema;
+
+    if (count > RL_ENV_MAX_MUTEX_COUNT)
+    {
+        return -1;
+    }
+
+    sema = env_allocate_memory(sizeof(env_sema_t));
+    if (sema == ((void *)0))
+    {
+        return -1;
+    }
+    (void)pthread_mutex_init(&sema->mutex, ((void *)0));
+    env_cond_init(&sema->cond);
+    sema->count = count;
+    *lock       = sema;
+    return 0;
+}
+
+/*!
+ * env_delete_mutex
+ *
+ * Deletes the given lock
+ *
+ */
+void env_delete_mutex(void *lock)
+{
+    env_sema_t *sema = (env_sema_t *)lock;
+
+    (void)pthread_cond_destroy(&sema->cond);
+    (void)pthread_mutex_destroy(&sema->mutex);
+    env_free_memory(sema);
+}
+
+/*!
+ * env_lock_mutex
+ *
+ * Tries to acquire the lock, if lock is not available then call to
+ * this function will suspend.
+ * Unlike with an RTOS, the interrupt thread of the platform can block, so it
+ * takes the lock too.
+ */
+void env_lock_mutex(void *lock)
+{
+    env_sema_t *sema = (env_sema_t *)lock;
+
+    (void)pthread_mutex_lock(&sema->mutex);
+    while (sema->count <= 0)
+    {
+        (void)pthread_cond_wait(&sema->cond, &sema->mutex);
+    }
+    sema->count--;
+    (void)pthread_mutex_unlock(&sema->mutex);
+}
+
+/*!
+ * env_unlock_mutex
+ *
+ * Releases the given lock.
+ */
+void env_unlock_mutex(void *lock)
+{
+    env_sema_t *sema = (env_sema_t *)lock;
+
+    (void)pthread_mutex_lock(&sema->mutex);
+    if (sema->count < RL_ENV_MAX_MUTEX_COUNT)
+    {
+        sema->count++;
+    }
+    (void)pthread_cond_signal(&sema->cond);
+    (void)pthread_mutex_unlock(&sema->mutex);
+}
+
+/*!
+ * env_create_sync_lock
+ *
+ * Creates a synchronization lock primitive. It is used
+ * when signal has to be sent from the interrupt context to main
+ * thread context.
+ */
+int32_t env_create_sync_lock(void **lock, int32_t state)
+{
+    return env_create_mutex(lock, state); /* state=1 .. initially free */
+}
+
+/*!
+ * env_delete_sync_lock
+ *
+ * Deletes the given lock
+ *
+ */
+void env_delete_sync_lock(void *lock)
+{
+    if (lock != ((void *)0))
+    {
+        env_delete_mutex(lock);
+    }
+}
+
+/*!
+ * env_acquire_sync_lock
+ *
+ * Tries to acquire the lock, if lock is not available then call to
+ * this function waits for lock to become available.
+ */
+void env_acquire_sync_lock(void *lock)
+{
+    env_lock_mutex(lock);
+}
+
+/*!
+ * env_acquire_sync_lock_timeout
+ *
+ * Tries to acquire the lock, waiting at most timeout_ms for it.
+ */
+int32_t env_acquire_sync_lock_timeout(void *lock, uint32_t timeout_ms)
+{
+    env_sema_t *sema = (env_sema_t *)lock;
+    struct timespec deadline;
+    int32_t acquired = 0;
+
+    if (timeout_ms != RL_BLOCK)
+    {
+        env_deadline(&deadline, timeout_ms);
+    }
+    (void)pthread_mutex_lock(&sema->mutex);
+    while (sema->count <= 0)
+    {
+        if (timeout_ms == RL_BLOCK)
+        {
+            (void)pthread_cond_wait(&sema->cond, &sema->mutex);
+        }
+        else if (pthread_cond_timedwait(&sema->cond, &sema->mutex, &deadline) == ETIMEDOUT)
+        {
+            break;
+        }
+    }
+    if (sema->count > 0)
+    {
+        sema->count--;
+        acquired = 1;
+    }
+    (void)pthread_mutex_unlock(&sema->mutex);
+    return acquired;
+}
+
+/*!
+ * env_release_sync_lock
+ *
+ * Releases the given lock.
+ */
+void env_release_sync_lock(void *lock)
+{
+    env_unlock_mutex(lock);
+}
+
+/*!
+ * env_sleep_msec
+ *
+ * Suspends the calling thread for given time , in msecs.
+ */
+void env_sleep_msec(uint32_t num_msec)
+{
+    struct timespec ts;
+
+    ts.tv_sec  = (time_t)(num_msec / 1000U);
+    ts.tv_nsec = (long)(num_msec % 1000U) * 1000000L;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+    {
+    }
+}
+
+/*!
+ * env_register_isr
+ *
+ * Registers interrupt handler data for the given interrupt vector.
+ *
+ * @param vector_id - virtual interrupt vector number
+ * @param data      - interrupt handler data (virtqueue)
+ */
+void env_register_isr(uint32_t vector_id, void *data)
+{
+    RL_ASSERT(vector_id < ISR_COUNT);
+    if (vector_id < ISR_COUNT)
+    {
+        isr_table[vector_id].data = data;
+    }
+}
+
+/*!
+ * env_unregister_isr
+ *
+ * Unregisters interrupt handler data for the given interrupt vector.
+ *
+ * @param vector_id - virtual interrupt vector number
+ */
+void env_unregister_isr(uint32_t vector_id)
+{
+    RL_ASSERT(vector_id < ISR_COUNT);
+    if (vector_id < ISR_COUNT)
+    {
+        isr_table[vector_id].data = ((void *)0);
+    }
+}
+
+/*!
+ * env_enable_interrupt
+ *
+ * Enables the given interrupt
+ *
+ * @param vector_id   - virtual interrupt vector number
+ */
+
+void env_enable_interrupt(uint32_t vector_id)
+{
+    (void)platform_interrupt_enable(vector_id);
+}
+
+/*!
+ * env_disable_interrupt
+ *
+ * Disables the given interrupt
+ *
+ * @param vector_id   - virtual interrupt vector number
+ */
+
+void env_disable_interrupt(uint32_t vector_id)
+{
+    (void)platform_interrupt_disable(vector_id);
+}
+
+/*!
+ * env_map_memory
+ *
+ * Enables memory mapping for given memory region.
+ *
+ * @param pa   - physical address of memory
+ * @param va   - logical address of memory
+ * @param size - memory size
+ * param flags - flags for cache/uncached  and access type
+ */
+
+void env_map_memory(uint32_t pa, uint32_t va, uint32_t size, uint32_t flags)
+{
+    platform_map_mem_region(va, pa, size, flags);
+}
+
+/*!
+ * env_disable_cache
+ *
+ * Disables system caches.
+ *
+ */
+
+void env_disable_cache(void)
+{
+    platform_cache_all_flush_invalidate();
+    platform_cache_disable();
+}
+
+/*!
+ * env_cache_clean
+ *
+ * Writes a cached shared memory range back to memory.
+ *
+ */
+
+void env_cache_clean(void *addr, uint32_t size)
+{
+    platform_cache_clean(addr, size);
+}
+
+/*!
+ * env_cache_invalidate
+ *
+ * Discards a cached shared memory range.
+ *
+ */
+
+void env_cache_invalidate(void *addr, uint32_t size)
+{
+    platform_cache_invalidate(addr, size);
+}
+
+/*!
+ *
+ * env_get_timestamp
+ *
+ * Returns a 64 bit time stamp, in ms.
+ *
+ *
+ */
+uint64_t env_get_timestamp(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000U) + ((uint64_t)ts.tv_nsec / 1000000U);
+}
+
+/*========================================================= */
+/* Util data / functions  */
+
+void env_isr(uint32_t vector)
+{
+    platform_inisr(true);
+    struct isr_info *info;
+    RL_ASSERT(vector < ISR_COUNT);
+    if (vector < ISR_COUNT)
+    {
+        info = &isr_table[vector];
+        if (info->data != ((void *)0))
+        {
+            virtqueue_notification((struct virtqueue *)info->data);
+        }
+    }
+    platform_inisr(false);
+}
+
+/*
+ * env_create_queue
+ *
+ * Creates a message queue.
+ *
+ * @param queue -  pointer to created queue
+ * @param length -  maximum number of elements in the queue
+ * @param element_size - queue element size in bytes
+ *
+ * @return - status of function execution
+ */
+int32_t env_create_queue(void **queue, int32_t length, int32_t element_size)
+{
+    env_queue_t *q = env_allocate_memory(sizeof(env_queue_t));
+
+    if (q == ((void *)0))
+    {
+        return -1;
+    }
+    q->data = env_allocate_memory((uint32_t)(length * element_size));
+    if (q->data == ((void *)0))
+    {
+        env_free_memory(q);
+        return -1;
+    }
+    (void)pthread_mutex_init(&q->mutex, ((void *)0));
+    env_cond_init(&q->not_empty);
+    env_cond_init(&q->not_full);
+    q->length       = length;
+    q->element_size = element_size;
+    q->head         = 0;
+    q->count        = 0;
+    *queue          = q;
+    return 0;
+}
+
+/*!
+ * env_delete_queue
+ *
+ * Deletes the message queue.
+ *
+ * @param queue - queue to delete
+ */
+
+void env_delete_queue(void *queue)
+{
+    env_queue_t *q = (env_queue_t *)queue;
+
+    (void)pthread_cond_destroy(&q->not_full);
+    (void)pthread_cond_destroy(&q->not_empty);
+    (void)pthread_mutex_destroy(&q->mutex);
+    env_free_memory(q->data);
+    env_free_memory(q);
+}
+
+/* wait on cond until pred is false, RL_BLOCK waits forever, 0 does not wait.
+   Called and returns with the queue mutex held, false on timeout */
+static bool env_queue_wait(env_queue_t *q, pthread_cond_t *cond, bool (*pred)(env_queue_t *q), uint32_t timeout_ms)
+{
+    struct timespec deadline;
+
+    if (timeout_ms != RL_BLOCK)
+    {
+        env_deadline(&deadline, timeout_ms);
+    }
+    while (pred(q))
+    {
+        if (timeout_ms == 0U)
+        {
+            return false;
+        }
+        if (timeout_ms == RL_BLOCK)
+        {
+            (void)pthread_cond_wait(cond, &q->mutex);
+        }
+        else if (pthread_cond_timedwait(cond, &q->mutex, &deadline) == ETIMEDOUT)
+        {
+            return !pred(q);
+        }
+    }
+    return true;
+}
+
+static bool env_queue_full(env_queue_t *q)
+{
+    return q->count == q->length;
+}
+
+static bool env_queue_empty(env_queue_t *q)
+{
+    return q->count == 0;
+}
+
+/*!
+ * env_put_queue
+ *
+ * Put an element in a queue.
+ * Like the FromISR calls of an RTOS, the interrupt thread does not wait.
+ *
+ * @param queue - queue to put element in
+ * @param msg - pointer to the message to be put into the queue
+ * @param timeout_ms - timeout in ms
+ *
+ * @return - status of function execution
+ */
+
+int32_t env_put_queue(void *queue, void *msg, uint32_t timeout_ms)
+{
+    env_queue_t *q = (env_queue_t *)queue;
+    int32_t tail;
+
+    (void)pthread_mutex_lock(&q->mutex);
+    if (!env_queue_wait(q, &q->not_full, env_queue_full, (env_in_isr() != 0) ? 0U : timeout_ms))
+    {
+        (void)pthread_mutex_unlock(&q->mutex);
+        LOG_E("Failed to send\r\n");
+        return 0;
+    }
+    tail = (q->head + q->count) % q->length;
+    (void)memcpy(&q->data[tail * q->element_size], msg, (size_t)q->element_size);
+    q->count++;
+    (void)pthread_cond_signal(&q->not_empty);
+    (void)pthread_mutex_unlock(&q->mutex);
+    return 1;
+}
+
+/*!
+ * env_get_queue
+ *
+ * Get an element out of a queue.
+ *
+ * @param queue - queue to get element from
+ * @param msg - pointer to a memory to save the message
+ * @param timeout_ms - timeout in ms
+ *
+ * @return - status of function execution
+ */
+
+int32_t env_get_queue(void *queue, void *msg, uint32_t timeout_ms)
+{
+    env_queue_t *q = (env_queue_t *)queue;
+
+    (void)pthread_mutex_lock(&q->mutex);
+    if (!env_queue_wait(q, &q->not_empty, env_queue_empty, (env_in_isr() != 0) ? 0U : timeout_ms))
+    {
+        (void)pthread_mutex_unlock(&q->mutex);
+        return 0;
+    }
+    (void)memcpy(msg, &q->data[q->head * q->element_size], (size_t)q->element_size);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    (void)pthread_cond_signal(&q->not_full);
+    (void)pthread_mutex_unlock(&q->mutex);
+    return 1;
+}
+
+/*!
+ * env_get_current_queue_size
+ *
+ * Get current queue size.
+ *
+ * @param queue - queue pointer
+ *
+ * @return - Number of queued items in the queue
+ */
+
+int32_t env_get_current_queue_size(void *queue)
+{
+    env_queue_t *q = (env_queue_t *)queue;
+    int32_t count;
+
+    (void)pthread_mutex_lock(&q->mutex);
+    count = q->count;
+    (void)pthread_mutex_unlock(&q->mutex);
+    return count;
+}
@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <bflb_mtimer.h>
+#include <bflb_l1c.h>
 
 #include "rpmsg_platform.h"
 #include "rpmsg_env.h"
@@ -28,6 +29,13 @@ static int32_t in_isr_counter = 0;
 static LOCK_STATIC_CONTEXT platform_lock_static_ctxt;
 #endif
 
+static rpmsg_platform_shmem_config_t platform_shmem_config = {
+    .buffer_payload_size = CONFIG_RPMSG_BUFFER_SIZE - 16U,
+    .buffer_count = CONFIG_RPMSG_BUFFER_COUNT,
+    .vring_size = CONFIG_RPMSG_VRING_SIZE,
+    .vring_align = VRING_ALIGN,
+};
+
 static void platform_isr_handle(uint16_t service, uint16_t op, uint32_t param, void *arg) {
     LOG_D("RP: Service %d, Op %d Param %d\r\n", service, op, param);
     env_isr(param);
@@ -202,6 +210,28 @@ void platform_cache_disable(void)
     LOG_W("Disable cache\r\n");
 }
 
+/**
+ * platform_cache_clean
+ *
+ * Write a range of the shared memory back from the M0 dcache
+ *
+ */
+void platform_cache_clean(void *addr, uint32_t len)
+{
+    bflb_l1c_dcache_clean_range(addr, len);
+}
+
+/**
+ * platform_cache_invalidate
+ *
+ * Drop a range of the shared memory from the M0 dcache
+ *
+ */
+void platform_cache_invalidate(void *addr, uint32_t len)
+{
+    bflb_l1c_dcache_invalidate_range(addr, len);
+}
+
 /**
  * platform_vatopa
  *
@@ -224,6 +254,47 @@ void *platform_patova(uintptr_t addr)
     return ((void *)(char *)addr);
 }
 
+/**
+ * platform_get_custom_shmem_config
+ *
+ * Layout of the shared memory of the link, the Kconfig one unless
+ * platform_set_custom_shmem_config() replaced it
+ */
+int32_t platform_get_custom_shmem_config(uint32_t link_id, rpmsg_platform_shmem_config_t *cfg)
+{
+    if (link_id > RL_PLATFORM_HIGHEST_LINK_ID)
+    {
+        return -1;
+    }
+    *cfg = platform_shmem_config;
+    return 0;
+}
+
+/**
+ * platform_set_custom_shmem_config
+ *
+ * Replace the layout of the link, before rpmsg_lite_remote_init(), which checks it
+ */
+int32_t platform_set_custom_shmem_config(uint32_t link_id, const rpmsg_platform_shmem_config_t *cfg)
+{
+    if (link_id > RL_PLATFORM_HIGHEST_LINK_ID)
+    {
+        return -1;
+    }
+    platform_shmem_config = *cfg;
+    return 0;
+}
+
+uint32_t platform_get_buffer_payload_size(uint32_t link_id)
+{
+    return platform_shmem_config.buffer_payload_size;
+}
+
+uint32_t platform_get_buffer_count(uint32_t link_id)
+{
+    return platform_shmem_config.buffer_count;
+}
+
 /**
  * platform_init
  *
@@ -0,0 +1,683 @@
+/*
+ *
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "rpmsg_platform.h"
+#include "rpmsg_env.h"
+
+#define DBG_TAG "RPMSG"
+#include <log.h>
+
+#if defined(RL_USE_ENVIRONMENT_CONTEXT) && (RL_USE_ENVIRONMENT_CONTEXT == 1)
+#error "This RPMsg-Lite port requires RL_USE_ENVIRONMENT_CONTEXT set to 0"
+#endif
+
+#define LINK_COUNT (RL_PLATFORM_HIGHEST_LINK_ID + 1U)
+
+/* in front of the shared memory, one page so the vrings keep their alignment */
+#define DOORBELL_SIZE (0x1000U)
+
+/*!
+ * Doorbell of each link, in shared memory. A kick to a link sets the bit
+ * of the queue in pending, then increments seq, the futex its interrupt
+ * thread waits on.
+ */
+struct doorbell
+{
+    uint32_t seq[LINK_COUNT];
+    uint32_t pending[LINK_COUNT];
+    uint32_t cache_lock; /* serializes the line copies of the simulated caches */
+};
+
+/*!
+ * Interrupt thread of a link, local to the process
+ */
+struct link_irq
+{
+    pthread_t thread;
+    pthread_mutex_t lock; /* held while the handlers run, so disabling waits for them */
+    int32_t isr_counter;
+    int32_t disable_counter;
+    uint32_t registered; /* queues with a handler, the kicks of the others stay pending */
+    bool stop;
+};
+
+static struct doorbell *doorbell;
+static uint8_t *shmem_base;
+static uint32_t shmem_size;
+static char shmem_name[64];
+
+#if defined(RL_USE_DCACHE) && (RL_USE_DCACHE == 1)
+/*!
+ * Simulated write-back cache of this process. RPMsg-Lite works on a private
+ * copy of the shared memory (shmem_base), which platform_cache_clean() writes
+ * to the shared memory (shmem_mem) and platform_cache_invalidate() reloads
+ * from it, a line at a time. The copy as of the last clean or invalidate
+ * (cache_synced) tells which lines were written since (dirty), and which
+ * lines the other side changed in the shared memory.
+ */
+static uint8_t *shmem_mem;
+static uint8_t *cache_synced;
+static uint32_t cache_links;
+#endif
+
+static struct link_irq link_irq[LINK_COUNT] = {
+    [0 ... RL_PLATFORM_HIGHEST_LINK_ID] = { .lock = PTHREAD_MUTEX_INITIALIZER },
+};
+static pthread_mutex_t platform_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static rpmsg_platform_shmem_config_t platform_shmem_config[LINK_COUNT] = {
+    [0 ... RL_PLATFORM_HIGHEST_LINK_ID] = {
+        .buffer_payload_size = 2032U,
+        .buffer_count = 8U,
+        .vring_size = VRING_SIZE,
+        .vring_align = VRING_ALIGN,
+    },
+};
+static __thread int32_t in_isr_counter = 0;
+
+static void futex_wake(uint32_t *addr)
+{
+    /* not FUTEX_PRIVATE_FLAG, the waiter can be in another process */
+    (void)syscall(SYS_futex, addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static void futex_wait(uint32_t *addr, uint32_t val)
+{
+    (void)syscall(SYS_futex, addr, FUTEX_WAIT, val, NULL, NULL, 0);
+}
+
+/* wake the interrupt thread of a link */
+static void platform_ring(uint32_t link_id)
+{
+    __atomic_fetch_add(&doorbell->seq[link_id], 1U, __ATOMIC_SEQ_CST);
+    futex_wake(&doorbell->seq[link_id]);
+}
+
+static void *platform_irq_thread(void *arg)
+{
+    uint32_t link_id     = (uint32_t)(uintptr_t)arg;
+    struct link_irq *irq = &link_irq[link_id];
+    uint32_t seq, pending, q;
+
+    for (;;)
+    {
+        seq = __atomic_load_n(&doorbell->seq[link_id], __ATOMIC_SEQ_CST);
+
+        pthread_mutex_lock(&irq->lock);
+        if (irq->stop)
+        {
+            pthread_mutex_unlock(&irq->lock);
+            break;
+        }
+        pending = 0;
+        if (irq->disable_counter == 0)
+        {
+            /* interrupts are level triggered: kicks while disabled stay pending */
+            pending = __atomic_fetch_and(&doorbell->pending[link_id], ~irq->registered, __ATOMIC_SEQ_CST) &
+                      irq->registered;
+            for (q = 0; q < 2U; q++)
+            {
+                if ((pending & (1U << q)) != 0U)
+                {
+                    LOG_D("RP: link %u queue %u kicked\r\n", link_id, q);
+                    env_isr(RL_GET_VQ_ID(link_id, q));
+                }
+            }
+        }
+        pthread_mutex_unlock(&irq->lock);
+
+        if (pending == 0U)
+        {
+            futex_wait(&doorbell->seq[link_id], seq);
+        }
+    }
+    return NULL;
+}
+
+void *platform_loopback_shmem_map(const char *name, uint32_t size)
+{
+    void *addr;
+    int fd = -1;
+
+    if (shmem_base != NULL)
+    {
+        LOG_E("RP: shared memory already mapped\r\n");
+        return NULL;
+    }
+
+    if (name == NULL)
+    {
+        addr = mmap(NULL, DOORBELL_SIZE + size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        shmem_name[0] = '\0';
+    }
+    else
+    {
+        fd = shm_open(name, O_CREAT | O_RDWR, 0600);
+        if (fd < 0)
+        {
+            LOG_E("RP: shm_open %s failed: %s\r\n", name, strerror(errno));
+            return NULL;
+        }
+        if (ftruncate(fd, (off_t)(DOORBELL_SIZE + size)) != 0)
+        {
+            LOG_E("RP: ftruncate %s failed: %s\r\n", name, strerror(errno));
+            close(fd);
+            return NULL;
+        }
+        addr = mmap(NULL, DOORBELL_SIZE + size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        strncpy(shmem_name, name, sizeof(shmem_name) - 1);
+    }
+    if (addr == MAP_FAILED)
+    {
+        LOG_E("RP: mmap failed: %s\r\n", strerror(errno));
+        return NULL;
+    }
+
+    doorbell   = (struct doorbell *)addr;
+    shmem_base = (uint8_t *)addr + DOORBELL_SIZE;
+    shmem_size = size;
+#if defined(RL_USE_DCACHE) && (RL_USE_DCACHE == 1)
+    /* private, so a process forked after the call gets a cache of its own */
+    /* aligned to the lines as the shared memory, which oblfr_rpmsg checks */
+    shmem_mem    = shmem_base;
+    shmem_base   = NULL;
+    cache_synced = malloc(size);
+    if ((posix_memalign((void **)&shmem_base, RL_PLATFORM_LOOPBACK_CACHE_LINE, size) != 0) || (cache_synced == NULL))
+    {
+        LOG_E("RP: no memory for the simulated cache\r\n");
+        free(shmem_base);
+        free(cache_synced);
+        (void)munmap(doorbell, DOORBELL_SIZE + size);
+        doorbell   = NULL;
+        shmem_base = NULL;
+        return NULL;
+    }
+    memcpy(shmem_base, shmem_mem, size);
+    memcpy(cache_synced, shmem_mem, size);
+    cache_links = 0;
+#endif
+    return shmem_base;
+}
+
+void platform_loopback_shmem_unmap(void)
+{
+    if (shmem_base == NULL)
+    {
+        return;
+    }
+#if defined(RL_USE_DCACHE) && (RL_USE_DCACHE == 1)
+    free(shmem_base);
+    free(cache_synced);
+    shmem_mem    = NULL;
+    cache_synced = NULL;
+#endif
+    (void)munmap(doorbell, DOORBELL_SIZE + shmem_size);
+    if (shmem_name[0] != '\0')
+    {
+        (void)shm_unlink(shmem_name);
+    }
+    doorbell   = NULL;
+    shmem_base = NULL;
+    shmem_size = 0;
+}
+
+int32_t platform_init_interrupt(uint32_t vector_id, void *isr_data)
+{
+    uint32_t link_id     = RL_GET_LINK_ID(vector_id);
+    struct link_irq *irq = &link_irq[link_id];
+    int32_t ret          = 0;
+
+    RL_ASSERT(link_id < LINK_COUNT);
+    RL_ASSERT(doorbell != NULL);
+
+#if defined(RL_USE_DCACHE) && (RL_USE_DCACHE == 1)
+    /* both sides would share the simulated cache, and see each other's writes */
+    if ((cache_links & ~(1U << link_id)) != 0U)
+    {
+        LOG_E("RP: the simulated cache needs each side of the link in its own process\r\n");
+        return -1;
+    }
+    cache_links |= 1U << link_id;
+#endif
+
+    /* Register ISR to environment layer */
+    env_register_isr(vector_id, isr_data);
+
+    pthread_mutex_lock(&platform_lock);
+
+    RL_ASSERT(0 <= irq->isr_counter);
+    if (irq->isr_counter == 0)
+    {
+        LOG_D("RP: init irq vector %u\r\n", vector_id);
+        irq->stop            = false;
+        irq->disable_counter = 0;
+        irq->registered      = 0;
+        if (pthread_create(&irq->thread, NULL, platform_irq_thread, (void *)(uintptr_t)link_id) != 0)
+        {
+            LOG_E("RP: can't start irq thread of link %u\r\n", link_id);
+            ret = -1;
+        }
+    }
+    if (ret == 0)
+    {
+        irq->isr_counter++;
+        /* the other side may have kicked the queue before its handler was there */
+        pthread_mutex_lock(&irq->lock);
+        irq->registered |= 1U << RL_GET_Q_ID(vector_id);
+        pthread_mutex_unlock(&irq->lock);
+        platform_ring(link_id);
+    }
+
+    pthread_mutex_unlock(&platform_lock);
+
+    return ret;
+}
+
+int32_t platform_deinit_interrupt(uint32_t vector_id)
+{
+    uint32_t link_id     = RL_GET_LINK_ID(vector_id);
+    struct link_irq *irq = &link_irq[link_id];
+
+    pthread_mutex_lock(&platform_lock);
+
+    RL_ASSERT(0 < irq->isr_counter);
+    irq->isr_counter--;
+    pthread_mutex_lock(&irq->lock);
+    irq->registered &= ~(1U << RL_GET_Q_ID(vector_id));
+    pthread_mutex_unlock(&irq->lock);
+    if (irq->isr_counter == 0)
+    {
+        LOG_D("RP: deinit irq vector %u\r\n", vector_id);
+        pthread_mutex_lock(&irq->lock);
+        irq->stop = true;
+        pthread_mutex_unlock(&irq->lock);
+        platform_ring(link_id);
+        pthread_join(irq->thread, NULL);
+    }
+
+    /* Unregister ISR from environment layer */
+    env_unregister_isr(vector_id);
+
+    pthread_mutex_unlock(&platform_lock);
+
+    return 0;
+}
+
+void platform_notify(uint32_t vector_id)
+{
+    /* the queue of the same index on the other side of the link */
+    uint32_t peer_link_id = RL_GET_LINK_ID(vector_id) ^ 1U;
+
+    __atomic_fetch_or(&doorbell->pending[peer_link_id], 1U << RL_GET_Q_ID(vector_id), __ATOMIC_SEQ_CST);
+    platform_ring(peer_link_id);
+}
+
+/**
+ * platform_time_delay
+ *
+ * @param num_msec Delay time in ms.
+ *
+ * This is not an accurate delay, it ensures at least num_msec passed when return.
+ */
+void platform_time_delay(uint32_t num_msec)
+{
+    env_sleep_msec(num_msec);
+}
+
+/**
+ * platform_in_isr
+ *
+ * Return whether the calling thread is running the interrupt handlers
+ *
+ * @return True for IRQ, false otherwise.
+ *
+ */
+int32_t platform_in_isr(void)
+{
+    return in_isr_counter > 0;
+}
+
+/**
+ * platform_interrupt_enable
+ *
+ * Enable peripheral-related interrupt
+ *
+ * @param vector_id Virtual vector ID that needs to be converted to IRQ number
+ *
+ * @return vector_id Return value is never checked.
+ *
+ */
+int32_t platform_interrupt_enable(uint32_t vector_id)
+{
+    uint32_t link_id     = RL_GET_LINK_ID(vector_id);
+    struct link_irq *irq = &link_irq[link_id];
+    bool in_isr          = platform_in_isr() != 0;
+
+    if (!in_isr)
+    {
+        pthread_mutex_lock(&irq->lock);
+    }
+    RL_ASSERT(0 < irq->disable_counter);
+    irq->disable_counter--;
+    if (!in_isr)
+    {
+        pthread_mutex_unlock(&irq->lock);
+    }
+
+    if (irq->disable_counter == 0)
+    {
+        LOG_D("RP: enable irq vector %u\r\n", vector_id);
+        /* deliver the kicks received while disabled */
+        platform_ring(link_id);
+    }
+    return ((int32_t)vector_id);
+}
+
+/**
+ * platform_interrupt_disable
+ *
+ * Disable peripheral-related interrupt. Waits for the handlers running
+ * on the interrupt thread, so they are not running on return.
+ *
+ * @param vector_id Virtual vector ID that needs to be converted to IRQ number
+ *
+ * @return vector_id Return value is never checked.
+ *
+ */
+int32_t platform_interrupt_disable(uint32_t vector_id)
+{
+    uint32_t link_id     = RL_GET_LINK_ID(vector_id);
+    struct link_irq *irq = &link_irq[link_id];
+    bool in_isr          = platform_in_isr() != 0;
+
+    if (!in_isr)
+    {
+        pthread_mutex_lock(&irq->lock);
+    }
+    RL_ASSERT(0 <= irq->disable_counter);
+    /* both virtqueues of a link use the same thread
+       if counter is set - the interrupts are disabled */
+    if (irq->disable_counter == 0)
+    {
+        LOG_D("RP: disable irq vector %u\r\n", vector_id);
+    }
+    irq->disable_counter++;
+    if (!in_isr)
+    {
+        pthread_mutex_unlock(&irq->lock);
+    }
+    return ((int32_t)vector_id);
+}
+
+/**
+ * platform_map_mem_region
+ *
+ * Dummy implementation
+ *
+ */
+void platform_map_mem_region(uint32_t vrt_addr, uint32_t phy_addr, uint32_t size, uint32_t flags)
+{
+}
+
+/**
+ * platform_cache_all_flush_invalidate
+ *
+ * Dummy implementation
+ *
+ */
+void platform_cache_all_flush_invalidate(void)
+{
+}
+
+/**
+ * platform_cache_disable
+ *
+ * Dummy implementation
+ *
+ */
+void platform_cache_disable(void)
+{
+}
+
+#if defined(RL_USE_DCACHE) && (RL_USE_DCACHE == 1)
+static void cache_lock(void)
+{
+    while (__atomic_exchange_n(&doorbell->cache_lock, 1U, __ATOMIC_ACQUIRE) != 0U)
+    {
+        (void)sched_yield();
+    }
+}
+
+static void cache_unlock(void)
+{
+    __atomic_store_n(&doorbell->cache_lock, 0U, __ATOMIC_RELEASE);
+}
+
+/* lines of [addr, addr + len), as offsets in the shared memory */
+static void cache_range(void *addr, uint32_t len, uint32_t *start, uint32_t *end)
+{
+    uint32_t offset = (uint32_t)((uint8_t *)addr - shmem_base);
+
+    RL_ASSERT(((uint8_t *)addr >= shmem_base) && (offset + len <= shmem_size));
+    *start = offset & ~(RL_PLATFORM_LOOPBACK_CACHE_LINE - 1U);
+    *end   = (offset + len + RL_PLATFORM_LOOPBACK_CACHE_LINE - 1U) & ~(RL_PLATFORM_LOOPBACK_CACHE_LINE - 1U);
+    if (*end > shmem_size)
+    {
+        *end = shmem_size;
+    }
+}
+
+/**
+ * platform_cache_clean
+ *
+ * Write the dirty lines of the range to the shared memory. Aborts if the
+ * other side changed a line written here since it was last synced: one of
+ * the writes is lost, on a real cache as well.
+ *
+ */
+void platform_cache_clean(void *addr, uint32_t len)
+{
+    uint32_t line, end, size;
+
+    cache_range(addr, len, &line, &end);
+    cache_lock();
+    for (; line < end; line += RL_PLATFORM_LOOPBACK_CACHE_LINE)
+    {
+        size = ((end - line) < RL_PLATFORM_LOOPBACK_CACHE_LINE) ? (end - line) : RL_PLATFORM_LOOPBACK_CACHE_LINE;
+        if (memcmp(shmem_base + line, cache_synced + line, size) == 0)
+        {
+            continue;
+        }
+        if (memcmp(shmem_mem + line, cache_synced + line, size) != 0)
+        {
+            cache_unlock();
+            LOG_E("RP: cache line 0x%x written by both sides\r\n", line + RL_PLATFORM_LOOPBACK_BUS_ADDR);
+            abort();
+        }
+        memcpy(shmem_mem + line, shmem_base + line, size);
+        memcpy(cache_synced + line, shmem_base + line, size);
+    }
+    cache_unlock();
+}
+
+/**
+ * platform_cache_invalidate
+ *
+ * Reload the lines of the range from the shared memory. Aborts on a dirty
+ * line, its writes would be lost: they must be cleaned first.
+ *
+ */
+void platform_cache_invalidate(void *addr, uint32_t len)
+{
+    uint32_t line, end, size;
+
+    cache_range(addr, len, &line, &end);
+    cache_lock();
+    for (; line < end; line += RL_PLATFORM_LOOPBACK_CACHE_LINE)
+    {
+        size = ((end - line) < RL_PLATFORM_LOOPBACK_CACHE_LINE) ? (end - line) : RL_PLATFORM_LOOPBACK_CACHE_LINE;
+        if (memcmp(shmem_base + line, cache_synced + line, size) != 0)
+        {
+            cache_unlock();
+            LOG_E("RP: invalidate of dirty cache line 0x%x\r\n", line + RL_PLATFORM_LOOPBACK_BUS_ADDR);
+            abort();
+        }
+        memcpy(shmem_base + line, shmem_mem + line, size);
+        memcpy(cache_synced + line, shmem_mem + line, size);
+    }
+    cache_unlock();
+}
+#else
+/**
+ * platform_cache_clean
+ *
+ * Dummy implementation, the shared memory is coherent
+ *
+ */
+void platform_cache_clean(void *addr, uint32_t len)
+{
+}
+
+/**
+ * platform_cache_invalidate
+ *
+ * Dummy implementation, the shared memory is coherent
+ *
+ */
+void platform_cache_invalidate(void *addr, uint32_t len)
+{
+}
+#endif /* RL_USE_DCACHE */
+
+/**
+ * platform_vatopa
+ *
+ * Translate to the bus address, the offset in the shared memory,
+ * as each process maps it at its own address
+ *
+ */
+uint32_t platform_vatopa(void *addr)
+{
+    RL_ASSERT(((uint8_t *)addr >= shmem_base) && ((uint8_t *)addr < shmem_base + shmem_size));
+    return (uint32_t)((uint8_t *)addr - shmem_base) + RL_PLATFORM_LOOPBACK_BUS_ADDR;
+}
+
+/**
+ * platform_patova
+ *
+ * Translate a bus address to the address in the mapping of this process
+ *
+ */
+void *platform_patova(uintptr_t addr)
+{
+    RL_ASSERT((addr >= RL_PLATFORM_LOOPBACK_BUS_ADDR) && (addr - RL_PLATFORM_LOOPBACK_BUS_ADDR < shmem_size));
+    return ((void *)(shmem_base + (addr - RL_PLATFORM_LOOPBACK_BUS_ADDR)));
+}
+
+/**
+ * platform_loopback_shmem_size
+ *
+ * Size of the shared memory for the layout of the link
+ */
+uint32_t platform_loopback_shmem_size(uint32_t link_id)
+{
+    const rpmsg_platform_shmem_config_t *cfg = &platform_shmem_config[link_id];
+
+    return 2U * cfg->vring_size + 2U * (uint32_t)cfg->buffer_count * (cfg->buffer_payload_size + 16U);
+}
+
+/**
+ * platform_get_custom_shmem_config
+ *
+ * Layout of the shared memory of the link
+ */
+int32_t platform_get_custom_shmem_config(uint32_t link_id, rpmsg_platform_shmem_config_t *cfg)
+{
+    if (link_id > RL_PLATFORM_HIGHEST_LINK_ID)
+    {
+        return -1;
+    }
+    *cfg = platform_shmem_config[link_id];
+    return 0;
+}
+
+/**
+ * platform_set_custom_shmem_config
+ *
+ * Replace the layout of the link, before the init of its side, which checks it.
+ * Both sides of the loopback link need the same layout.
+ */
+int32_t platform_set_custom_shmem_config(uint32_t link_id, const rpmsg_platform_shmem_config_t *cfg)
+{
+    if (link_id > RL_PLATFORM_HIGHEST_LINK_ID)
+    {
+        return -1;
+    }
+    platform_shmem_config[link_id] = *cfg;
+    return 0;
+}
+
+uint32_t platform_get_buffer_payload_size(uint32_t link_id)
+{
+    return platform_shmem_config[link_id].buffer_payload_size;
+}
+
+uint32_t platform_get_buffer_count(uint32_t link_id)
+{
+    return platform_shmem_config[link_id].buffer_count;
+}
+
+/**
+ * platform_init
+ *
+ * platform/environment init
+ */
+int32_t platform_init(void)
+{
+    if (shmem_base == NULL)
+    {
+        LOG_E("RP: map the shared memory with platform_loopback_shmem_map() first\r\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * platform_deinit
+ *
+ * platform/environment deinit process
+ */
+int32_t platform_deinit(void)
+{
+    return 0;
+}
+
+void platform_inisr(bool in_isr)
+{
+    if (in_isr)
+    {
+        in_isr_counter++;
+    }
+    else
+    {
+        in_isr_counter--;
+    }
+}
@@ -103,9 +103,49 @@ struct virtqueue_ops
 #endif
 #endif /* !(defined(RL_ALLOW_CUSTOM_SHMEM_CONFIG) && (RL_ALLOW_CUSTOM_SHMEM_CONFIG == 1)) */
 
+#if defined(RL_ALLOW_CUSTOM_SHMEM_CONFIG) && (RL_ALLOW_CUSTOM_SHMEM_CONFIG == 1)
+/*!
+ * @brief
+ * Check a shared memory layout from the platform layer, the checks done
+ * at build time for RL_BUFFER_COUNT and RL_BUFFER_SIZE without it.
+ *
+ * @param shmem_config  Layout of one link
+ *
+ * @return       RL_SUCCESS if both sides can use it, RL_ERR_PARAM otherwise
+ *
+ */
+static int32_t rpmsg_lite_check_shmem_config(const rpmsg_platform_shmem_config_t *shmem_config)
+{
+    uint32_t buffer_size = shmem_config->buffer_payload_size + 16UL;
+
+    /* shmem_config.buffer_count must be power of two (2, 4, ...) */
+    if ((0U == shmem_config->buffer_count) ||
+        (0U != (shmem_config->buffer_count & (shmem_config->buffer_count - 1U))))
+    {
+        return RL_ERR_PARAM;
+    }
+
+    /* buffer size must be power of two (256, 512, ...) */
+    if ((0U == shmem_config->buffer_payload_size) || (0U != (buffer_size & (buffer_size - 1U))))
+    {
+        return RL_ERR_PARAM;
+    }
+
+    /* each vring holds the descriptors and both rings of buffer_count buffers */
+    if ((0U == shmem_config->vring_align) || (0U != (shmem_config->vring_align & (shmem_config->vring_align - 1U))) ||
+        (shmem_config->vring_size < (uint32_t)vring_size(shmem_config->buffer_count, shmem_config->vring_align)))
+    {
+        return RL_ERR_PARAM;
+    }
+    return RL_SUCCESS;
+}
+#endif /* defined(RL_ALLOW_CUSTOM_SHMEM_CONFIG) && (RL_ALLOW_CUSTOM_SHMEM_CONFIG == 1) */
+
 /*!
  * @brief
- * Traverse the linked list of endpoints to get the one with defined address.
+ * Get the endpoint with defined address, from the table of endpoints
+ * if the address is below RL_EPT_TABLE_SIZE, else by traversing the
+ * linked list of endpoints.
  *
  * @param rpmsg_lite_dev    RPMsg Lite instance
  * @param addr              Local endpoint address
@@ -117,6 +157,11 @@ static struct llist *rpmsg_lite_get_endpoint_from_addr(struct rpmsg_lite_instanc
 {
     struct llist *rl_ept_lut_head;
 
+    if (addr < (uint32_t)RL_EPT_TABLE_SIZE)
+    {
+        return rpmsg_lite_dev->rl_ept_table[addr];
+    }
+
     rl_ept_lut_head = rpmsg_lite_dev->rl_endpoints;
     while (rl_ept_lut_head != RL_NULL)
     {
@@ -163,13 +208,23 @@ static void rpmsg_lite_rx_callback(struct virtqueue *vq)
 
     RL_ASSERT(rpmsg_lite_dev != RL_NULL);
 
-#if defined(RL_USE_ENVIRONMENT_CONTEXT) && (RL_USE_ENVIRONMENT_CONTEXT == 1)
+    /* interrupt threads run in parallel to the tasks, not just preempting them */
+#if (defined(RL_USE_ENVIRONMENT_CONTEXT) && (RL_USE_ENVIRONMENT_CONTEXT == 1)) || \
+    (defined(RL_ENV_THREADED_ISR) && (RL_ENV_THREADED_ISR == 1))
     env_lock_mutex(rpmsg_lite_dev->lock);
 #endif
     /* Process the received data from remote node */
     rpmsg_msg = (struct rpmsg_std_msg *)rpmsg_lite_dev->vq_ops->vq_rx(rpmsg_lite_dev->rvq, &len, &idx);
     while (rpmsg_msg != RL_NULL)
     {
+#if defined(RL_USE_DCACHE) && (RL_USE_DCACHE == 1)
+        /* the header first, it gives the length of the payload */
+        RL_CACHE_INVALIDATE(rpmsg_msg, sizeof(struct rpmsg_std_hdr));
+        if ((uint32_t)rpmsg_msg->hdr.len <= (len - (uint32_t)sizeof(struct rpmsg_std_hdr)))
+        {
+            RL_CACHE_INVALIDATE(rpmsg_msg->data, rpmsg_msg->hdr.len);
+        }
+#endif
         node = rpmsg_lite_get_endpoint_from_addr(rpmsg_lite_dev, rpmsg_msg->hdr.dst);
 
         cb_ret = RL_RELEASE;
@@ -184,6 +239,7 @@ static void rpmsg_lite_rx_callback(struct virtqueue *vq)
         if (cb_ret == RL_HOLD)
         {
             rpmsg_msg->hdr.reserved.idx = idx;
+            RL_CACHE_CLEAN(rpmsg_msg, sizeof(struct rpmsg_std_hdr));
         }
         else
         {
@@ -196,13 +252,16 @@ static void rpmsg_lite_rx_callback(struct virtqueue *vq)
 #if defined(RL_ALLOW_CONSUMED_BUFFERS_NOTIFICATION) && (RL_ALLOW_CONSUMED_BUFFERS_NOTIFICATION == 1)
         if ((rpmsg_msg == RL_NULL) && (rx_freed == RL_TRUE))
         {
-            /* Let the remote device know that some buffers have been freed */
+            /* Let the remote device know that some buffers have been freed,
+               including those held back by the kick batch */
             virtqueue_kick(rpmsg_lite_dev->rvq);
+            rpmsg_lite_dev->rx_unkicked = 0U;
         }
 #endif
     }
 
-#if defined(RL_USE_ENVIRONMENT_CONTEXT) && (RL_USE_ENVIRONMENT_CONTEXT == 1)
+#if (defined(RL_USE_ENVIRONMENT_CONTEXT) && (RL_USE_ENVIRONMENT_CONTEXT == 1)) || \
+    (defined(RL_ENV_THREADED_ISR) && (RL_ENV_THREADED_ISR == 1))
     env_unlock_mutex(rpmsg_lite_dev->lock);
 #endif  
 }
@@ -219,9 +278,46 @@ static void rpmsg_lite_tx_callback(struct virtqueue *vq)
 {
     struct rpmsg_lite_instance *rpmsg_lite_dev = (struct rpmsg_lite_instance *)vq->priv;
     RL_ASSERT(rpmsg_lite_dev != RL_NULL);
+    if (rpmsg_lite_dev->link_state == 0U)
+    {
+        /* the master has just set up the vrings, drop what the remote cached before */
+        RL_CACHE_INVALIDATE(rpmsg_lite_dev->rvq->vq_ring_mem, rpmsg_lite_dev->rvq->vq_ring_size);
+        RL_CACHE_INVALIDATE(rpmsg_lite_dev->tvq->vq_ring_mem, rpmsg_lite_dev->tvq->vq_ring_size);
+    }
     rpmsg_lite_dev->link_state = 1U;
     env_tx_callback(rpmsg_lite_dev->link_id);
+    /* the other side returned tx buffers, wake rpmsg_lite_tx_alloc_wait() */
+    env_release_sync_lock(rpmsg_lite_dev->tx_sync_lock);
+}
+
+#if defined(RL_CLEAR_USED_BUFFERS) && (RL_CLEAR_USED_BUFFERS == 1)
+/*!
+ * @brief
+ * Clears a received buffer before it goes back to the other side.
+ *
+ * With RL_USE_DCACHE only the message is cleared: the rest of the buffer
+ * was cleared when it was last used, and was not invalidated on receive.
+ *
+ * @param buffer  Buffer, with the rpmsg header
+ * @param len     Buffer length
+ *
+ */
+static void rpmsg_lite_clear_buffer(void *buffer, uint32_t len)
+{
+#if defined(RL_USE_DCACHE) && (RL_USE_DCACHE == 1)
+    struct rpmsg_std_msg *rpmsg_msg = (struct rpmsg_std_msg *)buffer;
+
+    if ((uint32_t)rpmsg_msg->hdr.len <= (len - (uint32_t)sizeof(struct rpmsg_std_hdr)))
+    {
+        len = (uint32_t)sizeof(struct rpmsg_std_hdr) + rpmsg_msg->hdr.len;
+    }
+    env_memset(buffer, 0x00, len);
+    RL_CACHE_CLEAN(buffer, len);
+#else
+    env_memset(buffer, 0x00, len);
+#endif
 }
+#endif /* RL_CLEAR_USED_BUFFERS */
 
 /****************************************************************************
 
@@ -300,7 +396,7 @@ static void vq_rx_free_remote(struct virtqueue *rvq, void *buffer, uint32_t len,
 {
     int32_t status;
 #if defined(RL_CLEAR_USED_BUFFERS) && (RL_CLEAR_USED_BUFFERS == 1)
-    env_memset(buffer, 0x00, len);
+    rpmsg_lite_clear_buffer(buffer, len);
 #endif
     status = virtqueue_add_consumed_buffer(rvq, idx, len);
     RL_ASSERT(status == VQUEUE_SUCCESS); /* must success here */
@@ -387,7 +483,7 @@ static void vq_rx_free_master(struct virtqueue *rvq, void *buffer, uint32_t len,
 {
     int32_t status;
 #if defined(RL_CLEAR_USED_BUFFERS) && (RL_CLEAR_USED_BUFFERS == 1)
-    env_memset(buffer, 0x00, len);
+    rpmsg_lite_clear_buffer(buffer, len);
 #endif
     status = virtqueue_add_buffer(rvq, idx);
     RL_ASSERT(status == VQUEUE_SUCCESS); /* must success here */
@@ -519,6 +615,10 @@ struct rpmsg_lite_endpoint *rpmsg_lite_create_ept(struct rpmsg_lite_instance *rp
         node->data = rl_ept;
 
         add_to_list((struct llist **)&rpmsg_lite_dev->rl_endpoints, node);
+        if (addr < (uint32_t)RL_EPT_TABLE_SIZE)
+        {
+            rpmsg_lite_dev->rl_ept_table[addr] = node;
+        }
     }
     env_unlock_mutex(rpmsg_lite_dev->lock);
 
@@ -553,6 +653,10 @@ int32_t rpmsg_lite_destroy_ept(struct rpmsg_lite_instance *rpmsg_lite_dev, struc
     if (node != RL_NULL)
     {
         remove_from_list((struct llist **)&rpmsg_lite_dev->rl_endpoints, node);
+        if (rl_ept->addr < (uint32_t)RL_EPT_TABLE_SIZE)
+        {
+            rpmsg_lite_dev->rl_ept_table[rl_ept->addr] = RL_NULL;
+        }
         env_unlock_mutex(rpmsg_lite_dev->lock);
 #if !(defined(RL_USE_STATIC_API) && (RL_USE_STATIC_API == 1))
         env_free_memory(node);
@@ -597,6 +701,172 @@ void rpmsg_lite_wait_for_link_up(struct rpmsg_lite_instance *rpmsg_lite_dev)
     env_wait_for_link_up(&rpmsg_lite_dev->link_state, rpmsg_lite_dev->link_id);
 }
 
+/*!
+ * @brief
+ * Internal function to notify the other side of a sent or
+ * released buffer, once per kick_batch buffers.
+ * Called with the instance lock held.
+ *
+ * @param rpmsg_lite_dev    RPMsg Lite instance
+ * @param vq                Virtqueue the buffer was added to
+ * @param unkicked          Counter of buffers not notified yet
+ *
+ */
+static void rpmsg_lite_kick(struct rpmsg_lite_instance *rpmsg_lite_dev, struct virtqueue *vq, uint32_t *unkicked)
+{
+    (*unkicked)++;
+    if (*unkicked >= rpmsg_lite_dev->kick_batch)
+    {
+        virtqueue_kick(vq);
+        *unkicked = 0U;
+    }
+}
+
+int32_t rpmsg_lite_set_kick_batch(struct rpmsg_lite_instance *rpmsg_lite_dev, uint32_t batch)
+{
+    if (rpmsg_lite_dev == RL_NULL)
+    {
+        return RL_ERR_PARAM;
+    }
+
+    env_lock_mutex(rpmsg_lite_dev->lock);
+    rpmsg_lite_dev->kick_batch = batch;
+    env_unlock_mutex(rpmsg_lite_dev->lock);
+
+    /* buffers held back by a bigger batch would wait for the next ones */
+    return rpmsg_lite_flush(rpmsg_lite_dev);
+}
+
+int32_t rpmsg_lite_flush(struct rpmsg_lite_instance *rpmsg_lite_dev)
+{
+    if (rpmsg_lite_dev == RL_NULL)
+    {
+        return RL_ERR_PARAM;
+    }
+
+    env_lock_mutex(rpmsg_lite_dev->lock);
+    if (rpmsg_lite_dev->tx_unkicked != 0U)
+    {
+        virtqueue_kick(rpmsg_lite_dev->tvq);
+        rpmsg_lite_dev->tx_unkicked = 0U;
+    }
+    if (rpmsg_lite_dev->rx_unkicked != 0U)
+    {
+        virtqueue_kick(rpmsg_lite_dev->rvq);
+        rpmsg_lite_dev->rx_unkicked = 0U;
+    }
+    env_unlock_mutex(rpmsg_lite_dev->lock);
+
+    return RL_SUCCESS;
+}
+
+/*!
+ * @brief
+ * Internal function to get a free tx buffer, the ones handed
+ * back unsent by rpmsg_lite_release_tx_buffer() first.
+ * Call with the instance locked.
+ *
+ * @param rpmsg_lite_dev    RPMsg Lite instance
+ * @param len               Length of the buffer, output
+ * @param idx               Index of the buffer, output
+ *
+ * @return  Buffer, RL_NULL if none is free
+ *
+ */
+static void *rpmsg_lite_tx_alloc(struct rpmsg_lite_instance *rpmsg_lite_dev, uint32_t *len, uint16_t *idx)
+{
+    struct rpmsg_std_msg *rpmsg_msg = rpmsg_lite_dev->tx_released;
+
+    if (rpmsg_msg == RL_NULL)
+    {
+        return rpmsg_lite_dev->vq_ops->vq_tx_alloc(rpmsg_lite_dev->tvq, len, idx);
+    }
+    /* released buffers are linked through their payload */
+    env_memcpy(&rpmsg_lite_dev->tx_released, rpmsg_msg->data, sizeof(void *));
+    *idx = rpmsg_msg->hdr.reserved.idx;
+    *len = virtqueue_get_buffer_length(rpmsg_lite_dev->tvq, *idx);
+    return rpmsg_msg;
+}
+
+/*!
+ * @brief
+ * Internal function to get a tx buffer, waiting for
+ * the other side to return one if none is free
+ *
+ * Woken by rpmsg_lite_tx_callback(), and every RL_MS_PER_INTERVAL
+ * in case the other side does not notify consumed buffers.
+ *
+ * @param rpmsg_lite_dev    RPMsg Lite instance
+ * @param len               Length of the buffer, output
+ * @param idx               Index of the buffer, output
+ * @param timeout           Timeout in ms, 0 if nonblocking, RL_BLOCK to wait forever
+ *
+ * @return  Buffer, RL_NULL on timeout
+ *
+ */
+static void *rpmsg_lite_tx_alloc_wait(struct rpmsg_lite_instance *rpmsg_lite_dev,
+                                      uint32_t *len,
+                                      uint16_t *idx,
+                                      uint32_t timeout)
+{
+    void *buffer;
+    uint64_t start;
+    uint32_t elapsed;
+    uint32_t wait;
+
+    /* Lock the device to enable exclusive access to virtqueues */
+    env_lock_mutex(rpmsg_lite_dev->lock);
+    buffer = rpmsg_lite_tx_alloc(rpmsg_lite_dev, len, idx);
+    if ((buffer == RL_NULL) && (rpmsg_lite_dev->tx_unkicked != 0U))
+    {
+        /* the other side cannot return what it was not told about */
+        virtqueue_kick(rpmsg_lite_dev->tvq);
+        rpmsg_lite_dev->tx_unkicked = 0U;
+    }
+    env_unlock_mutex(rpmsg_lite_dev->lock);
+
+    if ((buffer != RL_NULL) || (timeout == RL_FALSE))
+    {
+        if (buffer != RL_NULL)
+        {
+            /* the other side writes to the buffers it receives (held, cleared),
+               so drop the lines cached before it had the buffer */
+            RL_CACHE_INVALIDATE(buffer, *len);
+        }
+        return buffer;
+    }
+
+    start = env_get_timestamp();
+    while (buffer == RL_NULL)
+    {
+        wait = (uint32_t)RL_MS_PER_INTERVAL;
+        if (timeout != RL_BLOCK)
+        {
+            elapsed = (uint32_t)(env_get_timestamp() - start);
+            if (elapsed >= timeout)
+            {
+                return RL_NULL;
+            }
+            if ((timeout - elapsed) < wait)
+            {
+                wait = timeout - elapsed;
+            }
+        }
+        (void)env_acquire_sync_lock_timeout(rpmsg_lite_dev->tx_sync_lock, wait);
+
+        env_lock_mutex(rpmsg_lite_dev->lock);
+        buffer = rpmsg_lite_tx_alloc(rpmsg_lite_dev, len, idx);
+        env_unlock_mutex(rpmsg_lite_dev->lock);
+    }
+
+    /* the other side may have returned more than one buffer, pass the wake-up
+       on to the next waiting sender, if any */
+    env_release_sync_lock(rpmsg_lite_dev->tx_sync_lock);
+
+    RL_CACHE_INVALIDATE(buffer, *len);
+    return buffer;
+}
+
 /*!
  * @brief
  * Internal function to format a RPMsg compatible
@@ -624,7 +894,6 @@ static int32_t rpmsg_lite_format_message(struct rpmsg_lite_instance *rpmsg_lite_
     struct rpmsg_std_msg *rpmsg_msg;
     void *buffer;
     uint16_t idx;
-    uint32_t tick_count = 0U;
     uint32_t buff_len;
 
     if (rpmsg_lite_dev == RL_NULL)
@@ -642,30 +911,13 @@ static int32_t rpmsg_lite_format_message(struct rpmsg_lite_instance *rpmsg_lite_
         return RL_NOT_READY;
     }
 
-    /* Lock the device to enable exclusive access to virtqueues */
-    env_lock_mutex(rpmsg_lite_dev->lock);
     /* Get rpmsg buffer for sending message. */
-    buffer = rpmsg_lite_dev->vq_ops->vq_tx_alloc(rpmsg_lite_dev->tvq, &buff_len, &idx);
-    env_unlock_mutex(rpmsg_lite_dev->lock);
-
-    if ((buffer == RL_NULL) && (timeout == RL_FALSE))
+    buffer = rpmsg_lite_tx_alloc_wait(rpmsg_lite_dev, &buff_len, &idx, timeout);
+    if (buffer == RL_NULL)
     {
         return RL_ERR_NO_MEM;
     }
 
-    while (buffer == RL_NULL)
-    {
-        env_sleep_msec(RL_MS_PER_INTERVAL);
-        env_lock_mutex(rpmsg_lite_dev->lock);
-        buffer = rpmsg_lite_dev->vq_ops->vq_tx_alloc(rpmsg_lite_dev->tvq, &buff_len, &idx);
-        env_unlock_mutex(rpmsg_lite_dev->lock);
-        tick_count += (uint32_t)RL_MS_PER_INTERVAL;
-        if ((tick_count >= timeout) && (buffer == RL_NULL))
-        {
-            return RL_ERR_NO_MEM;
-        }
-    }
-
     rpmsg_msg = (struct rpmsg_std_msg *)buffer;
 
     /* Initialize RPMSG header. */
@@ -676,15 +928,15 @@ static int32_t rpmsg_lite_format_message(struct rpmsg_lite_instance *rpmsg_lite_
 
     /* Copy data to rpmsg buffer. */
     env_memcpy(rpmsg_msg->data, data, size);
+    RL_CACHE_CLEAN(rpmsg_msg, sizeof(struct rpmsg_std_hdr) + size);
 
     env_lock_mutex(rpmsg_lite_dev->lock);
     /* Enqueue buffer on virtqueue. */
 
     rpmsg_lite_dev->vq_ops->vq_tx(rpmsg_lite_dev->tvq, buffer, buff_len, idx);
 
-
     /* Let the other side know that there is a job to process. */
-    virtqueue_kick(rpmsg_lite_dev->tvq);
+    rpmsg_lite_kick(rpmsg_lite_dev, rpmsg_lite_dev->tvq, &rpmsg_lite_dev->tx_unkicked);
     env_unlock_mutex(rpmsg_lite_dev->lock);
 
     return RL_SUCCESS;
@@ -722,7 +974,6 @@ void *rpmsg_lite_alloc_tx_buffer(struct rpmsg_lite_instance *rpmsg_lite_dev, uin
     struct rpmsg_std_msg *rpmsg_msg;
     void *buffer;
     uint16_t idx;
-    uint32_t tick_count = 0U;
 
     if (size == RL_NULL)
     {
@@ -735,32 +986,14 @@ void *rpmsg_lite_alloc_tx_buffer(struct rpmsg_lite_instance *rpmsg_lite_dev, uin
         return RL_NULL;
     }
 
-    /* Lock the device to enable exclusive access to virtqueues */
-    env_lock_mutex(rpmsg_lite_dev->lock);
     /* Get rpmsg buffer for sending message. */
-    buffer = rpmsg_lite_dev->vq_ops->vq_tx_alloc(rpmsg_lite_dev->tvq, size, &idx);
-    env_unlock_mutex(rpmsg_lite_dev->lock);
-
-    if ((buffer == RL_NULL) && (timeout == RL_FALSE))
+    buffer = rpmsg_lite_tx_alloc_wait(rpmsg_lite_dev, size, &idx, timeout);
+    if (buffer == RL_NULL)
     {
         *size = 0;
         return RL_NULL;
     }
 
-    while (buffer == RL_NULL)
-    {
-        env_sleep_msec(RL_MS_PER_INTERVAL);
-        env_lock_mutex(rpmsg_lite_dev->lock);
-        buffer = rpmsg_lite_dev->vq_ops->vq_tx_alloc(rpmsg_lite_dev->tvq, size, &idx);
-        env_unlock_mutex(rpmsg_lite_dev->lock);
-        tick_count += (uint32_t)RL_MS_PER_INTERVAL;
-        if ((tick_count >= timeout) && (buffer == RL_NULL))
-        {
-            *size = 0;
-            return RL_NULL;
-        }
-    }
-
     rpmsg_msg = (struct rpmsg_std_msg *)buffer;
 
     /* keep idx and totlen information for nocopy tx function */
@@ -824,6 +1057,7 @@ int32_t rpmsg_lite_send_nocopy(struct rpmsg_lite_instance *rpmsg_lite_dev,
     rpmsg_msg->hdr.src   = src;
     rpmsg_msg->hdr.len   = (uint16_t)size;
     rpmsg_msg->hdr.flags = (uint16_t)RL_NO_FLAGS;
+    RL_CACHE_CLEAN(rpmsg_msg, sizeof(struct rpmsg_std_hdr) + size);
 
     env_lock_mutex(rpmsg_lite_dev->lock);
     /* Enqueue buffer on virtqueue. */
@@ -832,9 +1066,32 @@ int32_t rpmsg_lite_send_nocopy(struct rpmsg_lite_instance *rpmsg_lite_dev,
         (uint32_t)virtqueue_get_buffer_length(rpmsg_lite_dev->tvq, rpmsg_msg->hdr.reserved.idx),
         rpmsg_msg->hdr.reserved.idx);
     /* Let the other side know that there is a job to process. */
-    virtqueue_kick(rpmsg_lite_dev->tvq);
+    rpmsg_lite_kick(rpmsg_lite_dev, rpmsg_lite_dev->tvq, &rpmsg_lite_dev->tx_unkicked);
+    env_unlock_mutex(rpmsg_lite_dev->lock);
+
+    return RL_SUCCESS;
+}
+
+int32_t rpmsg_lite_release_tx_buffer(struct rpmsg_lite_instance *rpmsg_lite_dev, void *txbuf)
+{
+    struct rpmsg_std_msg *rpmsg_msg;
+
+    if ((rpmsg_lite_dev == RL_NULL) || (txbuf == RL_NULL))
+    {
+        return RL_ERR_PARAM;
+    }
+
+    rpmsg_msg = RPMSG_STD_MSG_FROM_BUF(txbuf);
+
+    /* the buffer never reached the other side, keep it for the next allocation */
+    env_lock_mutex(rpmsg_lite_dev->lock);
+    env_memcpy(rpmsg_msg->data, &rpmsg_lite_dev->tx_released, sizeof(void *));
+    rpmsg_lite_dev->tx_released = rpmsg_msg;
     env_unlock_mutex(rpmsg_lite_dev->lock);
 
+    /* wake a sender waiting for a free buffer */
+    env_release_sync_lock(rpmsg_lite_dev->tx_sync_lock);
+
     return RL_SUCCESS;
 }
 
@@ -892,7 +1149,7 @@ int32_t rpmsg_lite_release_rx_buffer(struct rpmsg_lite_instance *rpmsg_lite_dev,
 
 #if defined(RL_ALLOW_CONSUMED_BUFFERS_NOTIFICATION) && (RL_ALLOW_CONSUMED_BUFFERS_NOTIFICATION == 1)
     /* Let the remote device know that a buffer has been freed */
-    virtqueue_kick(rpmsg_lite_dev->rvq);
+    rpmsg_lite_kick(rpmsg_lite_dev, rpmsg_lite_dev->rvq, &rpmsg_lite_dev->rx_unkicked);
 #endif
 
     env_unlock_mutex(rpmsg_lite_dev->lock);
@@ -955,19 +1212,13 @@ struct rpmsg_lite_instance *rpmsg_lite_master_init(void *shmem_addr,
         return RL_NULL;
     }
 
-    /* shmem_config.buffer_count must be power of two (2, 4, ...) */
-    if (0U != (shmem_config.buffer_count & (shmem_config.buffer_count - 1U)))
-    {
-        return RL_NULL;
-    }
-
-    /* buffer size must be power of two (256, 512, ...) */
-    if (0U != ((shmem_config.buffer_payload_size + 16UL) & ((shmem_config.buffer_payload_size + 16UL) - 1U)))
+    if (RL_SUCCESS != rpmsg_lite_check_shmem_config(&shmem_config))
     {
         return RL_NULL;
     }
 
-    if ((2U * (uint32_t)shmem_config.buffer_count) >
+    if ((shmem_length < 2U * shmem_config.vring_size) ||
+        (2U * (uint32_t)shmem_config.buffer_count) >
         ((RL_WORD_ALIGN_DOWN(shmem_length - 2U * shmem_config.vring_size)) /
          (uint32_t)(shmem_config.buffer_payload_size + 16UL)))
     {
@@ -1017,11 +1268,11 @@ struct rpmsg_lite_instance *rpmsg_lite_master_init(void *shmem_addr,
      * shared buffers. Create shared memory pool to handle buffers.
      */
 #if defined(RL_ALLOW_CUSTOM_SHMEM_CONFIG) && (RL_ALLOW_CUSTOM_SHMEM_CONFIG == 1)
-    rpmsg_lite_dev->sh_mem_base = (char *)RL_WORD_ALIGN_UP((uint32_t)(char *)shmem_addr + 2U * shmem_config.vring_size);
+    rpmsg_lite_dev->sh_mem_base = (char *)RL_WORD_ALIGN_UP((uintptr_t)(char *)shmem_addr + 2U * shmem_config.vring_size);
     rpmsg_lite_dev->sh_mem_remaining = (RL_WORD_ALIGN_DOWN(shmem_length - 2U * shmem_config.vring_size)) /
                                        (uint32_t)(shmem_config.buffer_payload_size + 16UL);
 #else
-    rpmsg_lite_dev->sh_mem_base = (char *)RL_WORD_ALIGN_UP((uint32_t)(char *)shmem_addr + (uint32_t)RL_VRING_OVERHEAD);
+    rpmsg_lite_dev->sh_mem_base = (char *)RL_WORD_ALIGN_UP((uintptr_t)(char *)shmem_addr + (uint32_t)RL_VRING_OVERHEAD);
     rpmsg_lite_dev->sh_mem_remaining =
         (RL_WORD_ALIGN_DOWN(shmem_length - (uint32_t)RL_VRING_OVERHEAD)) / (uint32_t)RL_BUFFER_SIZE;
 #endif /* defined(RL_ALLOW_CUSTOM_SHMEM_CONFIG) && (RL_ALLOW_CUSTOM_SHMEM_CONFIG == 1) */
@@ -1039,17 +1290,18 @@ struct rpmsg_lite_instance *rpmsg_lite_master_init(void *shmem_addr,
     {
 #if defined(RL_ALLOW_CUSTOM_SHMEM_CONFIG) && (RL_ALLOW_CUSTOM_SHMEM_CONFIG == 1)
         ring_info.phy_addr =
-            (void *)(char *)((uint32_t)(char *)shmem_addr + (uint32_t)((idx == 0U) ? (0U) : (shmem_config.vring_size)));
+            (void *)(char *)((uintptr_t)(char *)shmem_addr + (uint32_t)((idx == 0U) ? (0U) : (shmem_config.vring_size)));
         ring_info.align     = shmem_config.vring_align;
         ring_info.num_descs = shmem_config.buffer_count;
 #else
         ring_info.phy_addr =
-            (void *)(char *)((uint32_t)(char *)shmem_addr + (uint32_t)((idx == 0U) ? (0U) : (VRING_SIZE)));
+            (void *)(char *)((uintptr_t)(char *)shmem_addr + (uint32_t)((idx == 0U) ? (0U) : (VRING_SIZE)));
         ring_info.align = VRING_ALIGN;
         ring_info.num_descs = RL_BUFFER_COUNT;
 #endif /* defined(RL_ALLOW_CUSTOM_SHMEM_CONFIG) && (RL_ALLOW_CUSTOM_SHMEM_CONFIG == 1) */
 
         env_memset((void *)ring_info.phy_addr, 0x00, (uint32_t)vring_size(ring_info.num_descs, ring_info.align));
+        RL_CACHE_CLEAN(ring_info.phy_addr, vring_size(ring_info.num_descs, ring_info.align));
 
 #if defined(RL_USE_STATIC_API) && (RL_USE_STATIC_API == 1)
         status = virtqueue_create_static((uint16_t)(RL_GET_VQ_ID(link_id, idx)), vq_names[idx], &ring_info,
@@ -1062,6 +1314,11 @@ struct rpmsg_lite_instance *rpmsg_lite_master_init(void *shmem_addr,
 
         if (status == RL_SUCCESS)
         {
+            if ((init_flags & (uint32_t)RL_EVENT_IDX) != 0U)
+            {
+                vqs[idx]->vq_flags |= VIRTQUEUE_FLAG_EVENT_IDX;
+            }
+
             /* Initialize vring control block in virtqueue. */
             vq_ring_init(vqs[idx]);
 
@@ -1098,6 +1355,20 @@ struct rpmsg_lite_instance *rpmsg_lite_master_init(void *shmem_addr,
         return RL_NULL;
     }
 
+#if defined(RL_USE_STATIC_API) && (RL_USE_STATIC_API == 1)
+    status = env_create_sync_lock(&rpmsg_lite_dev->tx_sync_lock, LOCKED, &rpmsg_lite_dev->tx_sync_lock_static_ctxt);
+#else
+    status = env_create_sync_lock(&rpmsg_lite_dev->tx_sync_lock, LOCKED);
+#endif
+    if (status != RL_SUCCESS)
+    {
+        env_delete_mutex(rpmsg_lite_dev->lock);
+#if !(defined(RL_USE_STATIC_API) && (RL_USE_STATIC_API == 1))
+        env_free_memory(rpmsg_lite_dev);
+#endif
+        return RL_NULL;
+    }
+
     // FIXME - a better way to handle this , tx for master is rx for remote and vice versa.
     rpmsg_lite_dev->tvq = vqs[1];
     rpmsg_lite_dev->rvq = vqs[0];
@@ -1122,8 +1393,10 @@ struct rpmsg_lite_instance *rpmsg_lite_master_init(void *shmem_addr,
 
 #if defined(RL_ALLOW_CUSTOM_SHMEM_CONFIG) && (RL_ALLOW_CUSTOM_SHMEM_CONFIG == 1)
             env_memset(buffer, 0x00, (uint32_t)(shmem_config.buffer_payload_size + 16UL));
+            RL_CACHE_CLEAN(buffer, shmem_config.buffer_payload_size + 16UL);
 #else
             env_memset(buffer, 0x00, (uint32_t)RL_BUFFER_SIZE);
+            RL_CACHE_CLEAN(buffer, RL_BUFFER_SIZE);
 #endif /* defined(RL_ALLOW_CUSTOM_SHMEM_CONFIG) && (RL_ALLOW_CUSTOM_SHMEM_CONFIG == 1) */
             if (vqs[j] == rpmsg_lite_dev->rvq)
             {
@@ -1151,6 +1424,7 @@ struct rpmsg_lite_instance *rpmsg_lite_master_init(void *shmem_addr,
             if (status != RL_SUCCESS)
             {
                 /* Clean up! */
+                env_delete_sync_lock(rpmsg_lite_dev->tx_sync_lock);
                 env_delete_mutex(rpmsg_lite_dev->lock);
 #if !(defined(RL_USE_STATIC_API) && (RL_USE_STATIC_API == 1))
                 env_free_memory(rpmsg_lite_dev);
@@ -1179,6 +1453,12 @@ struct rpmsg_lite_instance *rpmsg_lite_master_init(void *shmem_addr,
     env_enable_interrupt(rpmsg_lite_dev->tvq->vq_queue_index);
 #endif
 
+    /* the remote only notifies while callbacks are enabled */
+    env_lock_mutex(rpmsg_lite_dev->lock);
+    (void)virtqueue_enable_cb(rpmsg_lite_dev->rvq);
+    (void)virtqueue_enable_cb(rpmsg_lite_dev->tvq);
+    env_unlock_mutex(rpmsg_lite_dev->lock);
+
     /*
      * Let the remote device know that Master is ready for
      * communication.
@@ -1229,14 +1509,7 @@ struct rpmsg_lite_instance *rpmsg_lite_remote_init(void *shmem_addr, uint32_t li
         return RL_NULL;
     }
 
-    /* shmem_config.buffer_count must be power of two (2, 4, ...) */
-    if (0U != (shmem_config.buffer_count & (shmem_config.buffer_count - 1U)))
-    {
-        return RL_NULL;
-    }
-
-    /* buffer size must be power of two (256, 512, ...) */
-    if (0U != ((shmem_config.buffer_payload_size + 16UL) & ((shmem_config.buffer_payload_size + 16UL) - 1U)))
+    if (RL_SUCCESS != rpmsg_lite_check_shmem_config(&shmem_config))
     {
         return RL_NULL;
     }
@@ -1279,9 +1552,9 @@ struct rpmsg_lite_instance *rpmsg_lite_remote_init(void *shmem_addr, uint32_t li
     callback[1]            = rpmsg_lite_rx_callback;
     rpmsg_lite_dev->vq_ops = &remote_vq_ops;
 #if defined(RL_ALLOW_CUSTOM_SHMEM_CONFIG) && (RL_ALLOW_CUSTOM_SHMEM_CONFIG == 1)
-    rpmsg_lite_dev->sh_mem_base = (char *)RL_WORD_ALIGN_UP((uint32_t)(char *)shmem_addr + 2U * shmem_config.vring_size);
+    rpmsg_lite_dev->sh_mem_base = (char *)RL_WORD_ALIGN_UP((uintptr_t)(char *)shmem_addr + 2U * shmem_config.vring_size);
 #else
-    rpmsg_lite_dev->sh_mem_base = (char *)RL_WORD_ALIGN_UP((uint32_t)(char *)shmem_addr + (uint32_t)RL_VRING_OVERHEAD);
+    rpmsg_lite_dev->sh_mem_base = (char *)RL_WORD_ALIGN_UP((uintptr_t)(char *)shmem_addr + (uint32_t)RL_VRING_OVERHEAD);
 #endif /* defined(RL_ALLOW_CUSTOM_VRING_CONFIG) && (RL_ALLOW_CUSTOM_VRING_CONFIG == 1) */
 
     /* Create virtqueue for each vring. */
@@ -1289,12 +1562,12 @@ struct rpmsg_lite_instance *rpmsg_lite_remote_init(void *shmem_addr, uint32_t li
     {
 #if defined(RL_ALLOW_CUSTOM_SHMEM_CONFIG) && (RL_ALLOW_CUSTOM_SHMEM_CONFIG == 1)
         ring_info.phy_addr =
-            (void *)(char *)((uint32_t)(char *)shmem_addr + (uint32_t)((idx == 0U) ? (0U) : (shmem_config.vring_size)));
+            (void *)(char *)((uintptr_t)(char *)shmem_addr + (uint32_t)((idx == 0U) ? (0U) : (shmem_config.vring_size)));
         ring_info.align     = shmem_config.vring_align;
         ring_info.num_descs = shmem_config.buffer_count;
 #else
         ring_info.phy_addr =
-            (void *)(char *)((uint32_t)(char *)shmem_addr + (uint32_t)((idx == 0U) ? (0U) : (VRING_SIZE)));
+            (void *)(char *)((uintptr_t)(char *)shmem_addr + (uint32_t)((idx == 0U) ? (0U) : (VRING_SIZE)));
         ring_info.align = VRING_ALIGN;
         ring_info.num_descs = RL_BUFFER_COUNT;
 #endif /* defined(RL_ALLOW_CUSTOM_VRING_CONFIG) && (RL_ALLOW_CUSTOM_VRING_CONFIG == 1) */
@@ -1316,6 +1589,13 @@ struct rpmsg_lite_instance *rpmsg_lite_remote_init(void *shmem_addr, uint32_t li
             return RL_NULL;
         }
 
+        /* the remote is the virtio device, it fills the used rings */
+        vqs[idx]->vq_flags |= VIRTQUEUE_FLAG_REMOTE;
+        if ((init_flags & (uint32_t)RL_EVENT_IDX) != 0U)
+        {
+            vqs[idx]->vq_flags |= VIRTQUEUE_FLAG_EVENT_IDX;
+        }
+
         /* virtqueue has reference to the RPMsg Lite instance */
         vqs[idx]->priv = (void *)rpmsg_lite_dev;
 #if defined(RL_USE_ENVIRONMENT_CONTEXT) && (RL_USE_ENVIRONMENT_CONTEXT == 1)
@@ -1336,6 +1616,20 @@ struct rpmsg_lite_instance *rpmsg_lite_remote_init(void *shmem_addr, uint32_t li
         return RL_NULL;
     }
 
+#if defined(RL_USE_STATIC_API) && (RL_USE_STATIC_API == 1)
+    status = env_create_sync_lock(&rpmsg_lite_dev->tx_sync_lock, LOCKED, &rpmsg_lite_dev->tx_sync_lock_static_ctxt);
+#else
+    status = env_create_sync_lock(&rpmsg_lite_dev->tx_sync_lock, LOCKED);
+#endif
+    if (status != RL_SUCCESS)
+    {
+        env_delete_mutex(rpmsg_lite_dev->lock);
+#if !(defined(RL_USE_STATIC_API) && (RL_USE_STATIC_API == 1))
+        env_free_memory(rpmsg_lite_dev);
+#endif
+        return RL_NULL;
+    }
+
     // FIXME - a better way to handle this , tx for master is rx for remote and vice versa.
     rpmsg_lite_dev->tvq = vqs[0];
     rpmsg_lite_dev->rvq = vqs[1];
@@ -1346,7 +1640,8 @@ struct rpmsg_lite_instance *rpmsg_lite_remote_init(void *shmem_addr, uint32_t li
     env_init_interrupt(rpmsg_lite_dev->env, rpmsg_lite_dev->tvq->vq_queue_index, rpmsg_lite_dev->tvq);
     env_disable_interrupt(rpmsg_lite_dev->env, rpmsg_lite_dev->rvq->vq_queue_index);
     env_disable_interrupt(rpmsg_lite_dev->env, rpmsg_lite_dev->tvq->vq_queue_index);
-    rpmsg_lite_dev->link_state = 0;
+    /* link_state is not cleared here: it is 0 since the instance was zeroed, and
+       the kick of the master may already have come in while installing the ISRs */
     env_enable_interrupt(rpmsg_lite_dev->env, rpmsg_lite_dev->rvq->vq_queue_index);
     env_enable_interrupt(rpmsg_lite_dev->env, rpmsg_lite_dev->tvq->vq_queue_index);
 #else
@@ -1354,7 +1649,8 @@ struct rpmsg_lite_instance *rpmsg_lite_remote_init(void *shmem_addr, uint32_t li
     (void)platform_init_interrupt(rpmsg_lite_dev->tvq->vq_queue_index, rpmsg_lite_dev->tvq);
     env_disable_interrupt(rpmsg_lite_dev->rvq->vq_queue_index);
     env_disable_interrupt(rpmsg_lite_dev->tvq->vq_queue_index);
-    rpmsg_lite_dev->link_state = 0;
+    /* link_state is not cleared here: it is 0 since the instance was zeroed, and
+       the kick of the master may already have come in while installing the ISRs */
     env_enable_interrupt(rpmsg_lite_dev->rvq->vq_queue_index);
     env_enable_interrupt(rpmsg_lite_dev->tvq->vq_queue_index);
 #endif
@@ -1414,6 +1710,7 @@ int32_t rpmsg_lite_deinit(struct rpmsg_lite_instance *rpmsg_lite_dev)
     virtqueue_free(rpmsg_lite_dev->tvq);
 #endif /* RL_USE_STATIC_API */
 
+    env_delete_sync_lock(rpmsg_lite_dev->tx_sync_lock);
     env_delete_mutex(rpmsg_lite_dev->lock);
 #if defined(RL_USE_ENVIRONMENT_CONTEXT) && (RL_USE_ENVIRONMENT_CONTEXT == 1)
     (void)env_deinit(rpmsg_lite_dev->env);
@@ -223,6 +223,7 @@ int32_t virtqueue_fill_avail_buffers(struct virtqueue *vq, void *buffer, uint32_
 #endif
         dp->len   = len;
         dp->flags = VRING_DESC_F_WRITE;
+        RL_CACHE_CLEAN(dp, sizeof(struct vring_desc));
 
         vq->vq_desc_head_idx++;
 
@@ -249,7 +250,12 @@ void *virtqueue_get_buffer(struct virtqueue *vq, uint32_t *len, uint16_t *idx)
     uint16_t used_idx, desc_idx;
     env_mb();
     virtqueue_dump(__FUNCTION__, vq);
-    if ((vq == VQ_NULL) || (vq->vq_used_cons_idx == vq->vq_ring.used->idx))
+    if (vq == VQ_NULL)
+    {
+        return (VQ_NULL);
+    }
+    RL_CACHE_INVALIDATE(&vq->vq_ring.used->idx, sizeof(uint16_t));
+    if (vq->vq_used_cons_idx == vq->vq_ring.used->idx)
     {
         return (VQ_NULL);
     }
@@ -257,7 +263,7 @@ void *virtqueue_get_buffer(struct virtqueue *vq, uint32_t *len, uint16_t *idx)
 
     used_idx = (uint16_t)(vq->vq_used_cons_idx & ((uint16_t)(vq->vq_nentries - 1U)));
     uep      = &vq->vq_ring.used->ring[used_idx];
-
+    RL_CACHE_INVALIDATE(uep, sizeof(struct vring_used_elem));
 
     desc_idx = (uint16_t)uep->id;
     if (len != VQ_NULL)
@@ -272,6 +278,14 @@ void *virtqueue_get_buffer(struct virtqueue *vq, uint32_t *len, uint16_t *idx)
 
     vq->vq_used_cons_idx++;
 
+    /* with EVENT_IDX, ask to be notified for the next used buffer, unless disabled */
+    if (((vq->vq_flags & VIRTQUEUE_FLAG_EVENT_IDX) != 0UL) &&
+        ((vq->vq_ring.avail->flags & (uint16_t)VRING_AVAIL_F_NO_INTERRUPT) == 0U))
+    {
+        vring_used_event(&vq->vq_ring) = vq->vq_used_cons_idx;
+        RL_CACHE_CLEAN(&vring_used_event(&vq->vq_ring), sizeof(uint16_t));
+    }
+
     VQUEUE_IDLE(vq, used_read);
 #if defined(RL_USE_ENVIRONMENT_CONTEXT) && (RL_USE_ENVIRONMENT_CONTEXT == 1)
     return env_map_patova(vq->env, ((uint32_t)(vq->vq_ring.desc[desc_idx].addr)));
@@ -290,6 +304,7 @@ void *virtqueue_get_buffer(struct virtqueue *vq, uint32_t *len, uint16_t *idx)
  */
 uint32_t virtqueue_get_buffer_length(struct virtqueue *vq, uint16_t idx)
 {
+    RL_CACHE_INVALIDATE(&vq->vq_ring.desc[idx], sizeof(struct vring_desc));
     return vq->vq_ring.desc[idx].len;
 }
 
@@ -348,6 +363,7 @@ void *virtqueue_get_available_buffer(struct virtqueue *vq, uint16_t *avail_idx,
     
     env_rmb();
 
+    RL_CACHE_INVALIDATE(&vq->vq_ring.avail->idx, sizeof(uint16_t));
     if (vq->vq_available_idx == vq->vq_ring.avail->idx)
     {
         return (VQ_NULL);
@@ -356,10 +372,18 @@ void *virtqueue_get_available_buffer(struct virtqueue *vq, uint16_t *avail_idx,
     VQUEUE_BUSY(vq, avail_read);
 
     head_idx   = (uint16_t)(vq->vq_available_idx++ & ((uint16_t)(vq->vq_nentries - 1U)));
+    RL_CACHE_INVALIDATE(&vq->vq_ring.avail->ring[head_idx], sizeof(uint16_t));
     *avail_idx = vq->vq_ring.avail->ring[head_idx];
 
+    /* with EVENT_IDX, ask to be notified for the next available buffer */
+    if ((vq->vq_flags & VIRTQUEUE_FLAG_EVENT_IDX) != 0UL)
+    {
+        vring_avail_event(&vq->vq_ring) = vq->vq_available_idx;
+        RL_CACHE_CLEAN(&vring_avail_event(&vq->vq_ring), sizeof(uint16_t));
+    }
 
     env_rmb();
+    RL_CACHE_INVALIDATE(&vq->vq_ring.desc[*avail_idx], sizeof(struct vring_desc));
 #if defined(RL_USE_ENVIRONMENT_CONTEXT) && (RL_USE_ENVIRONMENT_CONTEXT == 1)
     buffer = env_map_patova(vq->env, ((uint32_t)(vq->vq_ring.desc[*avail_idx].addr)));
 #else
@@ -451,12 +475,14 @@ void virtqueue_disable_cb(struct virtqueue *vq)
     if ((vq->vq_flags & VIRTQUEUE_FLAG_EVENT_IDX) != 0UL)
     {
         vring_used_event(&vq->vq_ring) = vq->vq_used_cons_idx - vq->vq_nentries - 1U;
-    }
-    else
-    {
-        vq->vq_ring.avail->flags |= (uint16_t)VRING_AVAIL_F_NO_INTERRUPT;
+        RL_CACHE_CLEAN(&vring_used_event(&vq->vq_ring), sizeof(uint16_t));
     }
 
+    /* ignored by the other side with EVENT_IDX, but tells virtqueue_get_buffer()
+       not to move the used event */
+    vq->vq_ring.avail->flags |= (uint16_t)VRING_AVAIL_F_NO_INTERRUPT;
+    RL_CACHE_CLEAN(&vq->vq_ring.avail->flags, sizeof(uint16_t));
+
     VQUEUE_IDLE(vq, avail_write);
 }
 
@@ -475,6 +501,7 @@ void virtqueue_kick(struct virtqueue *vq)
     if (0 != vq_ring_must_notify_host(vq))
     {
         vq_ring_notify_host(vq);
+        vq->vq_notify_cnt++;
     }
     vq->vq_queued_cnt = 0;
     virtqueue_dump(__FUNCTION__, vq);
@@ -516,14 +543,17 @@ uint32_t virtqueue_get_desc_size(struct virtqueue *vq)
     uint16_t avail_idx;
     uint32_t len;
 
+    RL_CACHE_INVALIDATE(&vq->vq_ring.avail->idx, sizeof(uint16_t));
     if (vq->vq_available_idx == vq->vq_ring.avail->idx)
     {
         return 0;
     }
 
-    head_idx  = (uint16_t)(vq->vq_available_idx & ((uint16_t)(vq->vq_nentries - 1U)));
+    head_idx = (uint16_t)(vq->vq_available_idx & ((uint16_t)(vq->vq_nentries - 1U)));
+    RL_CACHE_INVALIDATE(&vq->vq_ring.avail->ring[head_idx], sizeof(uint16_t));
     avail_idx = vq->vq_ring.avail->ring[head_idx];
-    len       = vq->vq_ring.desc[avail_idx].len;
+    RL_CACHE_INVALIDATE(&vq->vq_ring.desc[avail_idx], sizeof(struct vring_desc));
+    len = vq->vq_ring.desc[avail_idx].len;
     virtqueue_dump(__FUNCTION__, vq);
     return (len);
 }
@@ -559,7 +589,7 @@ static uint16_t vq_ring_add_buffer(
 #endif
     dp->len   = length;
     dp->flags = VRING_DESC_F_WRITE;
-
+    RL_CACHE_CLEAN(dp, sizeof(struct vring_desc));
 
     return (head_idx + 1U);
 }
@@ -582,6 +612,7 @@ void vq_ring_init(struct virtqueue *vq)
         vr->desc[i].next = (uint16_t)(i + 1U);
     }
     vr->desc[i].next = (uint16_t)VQ_RING_DESC_CHAIN_END;
+    RL_CACHE_CLEAN(vr->desc, size * sizeof(struct vring_desc));
     virtqueue_dump(__FUNCTION__, vq);
 }
 
@@ -603,10 +634,12 @@ static void vq_ring_update_avail(struct virtqueue *vq, uint16_t desc_idx)
      */
     avail_idx                          = (uint16_t)(vq->vq_ring.avail->idx & ((uint16_t)(vq->vq_nentries - 1U)));
     vq->vq_ring.avail->ring[avail_idx] = desc_idx;
+    RL_CACHE_CLEAN(&vq->vq_ring.avail->ring[avail_idx], sizeof(uint16_t));
 
     env_wmb();
 
     vq->vq_ring.avail->idx++;
+    RL_CACHE_CLEAN(&vq->vq_ring.avail->idx, sizeof(uint16_t));
 
     /* Keep pending count until virtqueue_notify(). */
     vq->vq_queued_cnt++;
@@ -634,10 +667,18 @@ static void vq_ring_update_used(struct virtqueue *vq, uint16_t head_idx, uint32_
     used_desc      = &(vq->vq_ring.used->ring[used_idx]);
     used_desc->id  = head_idx;
     used_desc->len = len;
+    RL_CACHE_CLEAN(used_desc, sizeof(struct vring_used_elem));
 
     env_wmb();
 
     vq->vq_ring.used->idx++;
+    RL_CACHE_CLEAN(&vq->vq_ring.used->idx, sizeof(uint16_t));
+
+    if ((vq->vq_flags & VIRTQUEUE_FLAG_REMOTE) != 0UL)
+    {
+        /* Keep pending count until virtqueue_notify(). */
+        vq->vq_queued_cnt++;
+    }
     virtqueue_dump(__FUNCTION__, vq);
 }
 
@@ -655,11 +696,10 @@ static int32_t vq_ring_enable_interrupt(struct virtqueue *vq, uint16_t ndesc)
     if ((vq->vq_flags & VIRTQUEUE_FLAG_EVENT_IDX) != 0UL)
     {
         vring_used_event(&vq->vq_ring) = vq->vq_used_cons_idx + ndesc;
+        RL_CACHE_CLEAN(&vring_used_event(&vq->vq_ring), sizeof(uint16_t));
     }
-    else
-    {
-        vq->vq_ring.avail->flags &= ~(uint16_t)VRING_AVAIL_F_NO_INTERRUPT;
-    }
+    vq->vq_ring.avail->flags &= ~(uint16_t)VRING_AVAIL_F_NO_INTERRUPT;
+    RL_CACHE_CLEAN(&vq->vq_ring.avail->flags, sizeof(uint16_t));
 
     env_mb();
 
@@ -706,15 +746,34 @@ static int32_t vq_ring_must_notify_host(struct virtqueue *vq)
     uint16_t new_idx, prev_idx;
     uint16_t event_idx;
 
+    if ((vq->vq_flags & VIRTQUEUE_FLAG_REMOTE) != 0UL)
+    {
+        /* the other side consumes the used ring, and asks for notifications
+           in the available ring */
+        if ((vq->vq_flags & VIRTQUEUE_FLAG_EVENT_IDX) != 0UL)
+        {
+            new_idx  = vq->vq_ring.used->idx;
+            prev_idx = new_idx - vq->vq_queued_cnt;
+            RL_CACHE_INVALIDATE(&vring_used_event(&vq->vq_ring), sizeof(uint16_t));
+            event_idx = (uint16_t)vring_used_event(&vq->vq_ring);
+
+            return ((vring_need_event(event_idx, new_idx, prev_idx) != 0) ? 1 : 0);
+        }
+        RL_CACHE_INVALIDATE(&vq->vq_ring.avail->flags, sizeof(uint16_t));
+        return (((vq->vq_ring.avail->flags & ((uint16_t)VRING_AVAIL_F_NO_INTERRUPT)) == 0U) ? 1 : 0);
+    }
+
     if ((vq->vq_flags & VIRTQUEUE_FLAG_EVENT_IDX) != 0UL)
     {
-        new_idx   = vq->vq_ring.avail->idx;
-        prev_idx  = new_idx - vq->vq_queued_cnt;
+        new_idx  = vq->vq_ring.avail->idx;
+        prev_idx = new_idx - vq->vq_queued_cnt;
+        RL_CACHE_INVALIDATE(&vring_avail_event(&vq->vq_ring), sizeof(uint16_t));
         event_idx = (uint16_t)vring_avail_event(&vq->vq_ring);
 
         return ((vring_need_event(event_idx, new_idx, prev_idx) != 0) ? 1 : 0);
     }
     virtqueue_dump(__FUNCTION__, vq);
+    RL_CACHE_INVALIDATE(&vq->vq_ring.used->flags, sizeof(uint16_t));
     return (((vq->vq_ring.used->flags & ((uint16_t)VRING_USED_F_NO_NOTIFY)) == 0U) ? 1 : 0);
 }
 
@@ -740,6 +799,7 @@ static uint16_t virtqueue_nused(struct virtqueue *vq)
 {
     uint16_t used_idx, nused;
 
+    RL_CACHE_INVALIDATE(&vq->vq_ring.used->idx, sizeof(uint16_t));
     used_idx = vq->vq_ring.used->idx;
 
     nused = (uint16_t)(used_idx - vq->vq_used_cons_idx);
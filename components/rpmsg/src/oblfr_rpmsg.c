@@ -1,51 +1,201 @@
 
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include <bflb_l1c.h>
+#include <bflb_mtimer.h>
 #include <sys/queue.h>
 #include <FreeRTOS.h>
 #include <task.h>
-#include <queue.h>
+#include <timers.h>
 
 #include "rpmsg_lite.h"
 #include "rpmsg_ns.h"
-#include "rpmsg_queue.h"
 #include "oblfr_mailbox.h"
 #include "oblfr_rpmsg.h"
 
 #define DBG_TAG "RPMSG"
 #include <log.h>
 
-#define MAX_NUMBER_OF_ENDPOINTS 4
-#define MAX_NUMBER_OF_QUEUED_MESSAGES RL_BUFFER_COUNT
-#define MAX_QUEUESET_SIZE (MAX_NUMBER_OF_ENDPOINTS * MAX_NUMBER_OF_QUEUED_MESSAGES)
+/* at most all rx buffers are held at once, whatever the number of endpoints */
+#define MAX_NUMBER_OF_QUEUED_MESSAGES RL_BUFFER_COUNT(RL_PLATFORM_BL808_M0_LINK_ID)
+#define OBLFR_RPMSG_MTU               RL_BUFFER_PAYLOAD_SIZE(RL_PLATFORM_BL808_M0_LINK_ID)
+/* the virtqueue of the received messages, the second one on the remote side */
+#define OBLFR_RPMSG_RX_VECTOR         RL_GET_VQ_ID(RL_PLATFORM_BL808_M0_LINK_ID, 1U)
+
+/* the layout of the M0 link (buffer count and size, vring size) is in rpmsg_platform.h */
+#ifndef CONFIG_RPMSG_SHMEM_ADDR
+#define CONFIG_RPMSG_SHMEM_ADDR 0x22048000
+#endif
+#ifndef CONFIG_RPMSG_SHMEM_SIZE
+#define CONFIG_RPMSG_SHMEM_SIZE 0x10000
+#endif
+
+#ifndef CONFIG_RPMSG_KICK_BATCH
+#define CONFIG_RPMSG_KICK_BATCH 1
+#endif
+#ifndef CONFIG_RPMSG_KICK_FLUSH_MS
+#define CONFIG_RPMSG_KICK_FLUSH_MS 2
+#endif
+#ifndef CONFIG_RPMSG_EPT_CREDITS
+#define CONFIG_RPMSG_EPT_CREDITS 0
+#endif
+#ifndef CONFIG_RPMSG_WORKERS
+#define CONFIG_RPMSG_WORKERS 2
+#endif
+#ifndef CONFIG_RPMSG_TASK_PRIORITY
+#define CONFIG_RPMSG_TASK_PRIORITY 5
+#endif
+#ifndef CONFIG_RPMSG_TASK_STACK
+#define CONFIG_RPMSG_TASK_STACK 1024
+#endif
+#if CONFIG_RPMSG_TASK_PRIORITY + CONFIG_RPMSG_WORKERS - 1 >= configMAX_PRIORITIES
+#error "the rpmsg task of the last class runs at CONFIG_RPMSG_TASK_PRIORITY + CONFIG_RPMSG_WORKERS - 1, which must stay below configMAX_PRIORITIES"
+#endif
+/* there is no feature negotiation in the shared memory, must match the Linux resource table */
+#ifndef OBLFR_RPMSG_INIT_FLAGS
+#ifdef CONFIG_RPMSG_EVENT_IDX
+#define OBLFR_RPMSG_INIT_FLAGS RL_EVENT_IDX
+#else
+#define OBLFR_RPMSG_INIT_FLAGS RL_NO_FLAGS
+#endif
+#endif
+/* line of the D0 dcache, the larger one of the two sides */
+#define OBLFR_RPMSG_CACHE_LINE 64
 
 static struct rpmsg_lite_instance *ipc_rpmsg;
 static rpmsg_ns_handle ipc_rpmsg_ns;
 
 typedef struct oblfr_queue_entry_s
 {
-    rpmsg_queue_handle queue;
     oblfr_device_cfg_t *cfg;
     struct rpmsg_lite_endpoint *ept;
     uint32_t dst;
     bool valid;
+    /* priority class, the rpmsg task that runs the callback */
+    uint32_t worker;
+    uint32_t pending;
     uint32_t sent;
     uint32_t received;
+    /* credits, see oblfr_device_cfg_t. pending counts the messages until they are
+       processed, held the buffers until they are released */
+    uint32_t held;
+    uint32_t kept;
+    uint32_t credits;
+    uint32_t dropped;
+    uint32_t consumed;
+    uint32_t advertised;
+    bool advertise;
+    uint32_t held_max;
+    uint32_t hold_us_max;
+    uint64_t hold_us_total;
     LIST_ENTRY(oblfr_queue_entry_s)
     list_entry;
 } oblfr_queue_entry_t;
 
+/* a received message, queued by the endpoint callback for the rpmsg task of its class */
+typedef struct oblfr_rpmsg_msg_s
+{
+    oblfr_queue_entry_t *entry;
+    uint32_t src;
+    void *data;
+    uint32_t len;
+    uint32_t rx_us;
+} oblfr_rpmsg_msg_t;
+
 static LIST_HEAD(oblfr_rpmsg_queues, oblfr_queue_entry_s) oblfr_rpmsg_queues = LIST_HEAD_INITIALIZER(oblfr_rpmsg_queues);
 
-static QueueSetHandle_t xQueueSet;
+/* a rpmsg task per priority class, each with the messages of its endpoints */
+typedef struct oblfr_rpmsg_worker_s
+{
+    /* each message with its entry, so no lookup is needed */
+    void *queue;
+    TaskHandle_t task;
+    /* the message of the running callback, for oblfr_rpmsg_hold() */
+    oblfr_rpmsg_msg_t *current;
+    bool current_kept;
+} oblfr_rpmsg_worker_t;
+
+static oblfr_rpmsg_worker_t oblfr_rpmsg_workers[CONFIG_RPMSG_WORKERS];
+static const char *const oblfr_rpmsg_task_names[] = { "rpmsg", "rpmsg1", "rpmsg2", "rpmsg3" };
+
+/* notifies the buffers held back by the kick batch */
+static TimerHandle_t oblfr_rpmsg_flush_timer;
+static uint32_t oblfr_rpmsg_kick_batch = CONFIG_RPMSG_KICK_BATCH;
+
+static uint32_t oblfr_rpmsg_sent;
+static uint32_t oblfr_rpmsg_received;
+static uint32_t oblfr_rpmsg_dropped;
 
-#define XRAM_RINGBUF_ADDR 0x22048000
+/* advertises the credits of the endpoints, see OBLFR_RPMSG_CREDIT_ENDPOINT */
+static void oblfr_rpmsg_credit_rx(void *data, size_t len, void *priv);
+static oblfr_device_cfg_t oblfr_rpmsg_credit_cfg = {
+    .name = OBLFR_RPMSG_CREDIT_ENDPOINT,
+    .cb = oblfr_rpmsg_credit_rx,
+};
+static oblfr_queue_entry_t *oblfr_rpmsg_credit;
+/* an advertisement found no free tx buffer, the rpmsg task retries */
+static bool oblfr_rpmsg_credit_retry;
 
+/* the credits of the endpoints and the kept messages, released from any task */
+static void *oblfr_rpmsg_lock;
+/* messages kept with oblfr_rpmsg_hold(), a slot per rx buffer */
+static oblfr_rpmsg_msg_t *oblfr_rpmsg_kept;
+
+// Default layout, in XRAM:
 // WRAM -   0x22030000 - 160KB (0x28000)  - 0x22058000
 // vring1 - 0x22048000 - 16K (0x4000)     - 0x2204C000
 // vring2 - 0x2204C000 - 16K (0x4000)     - 0x22050000
 // buffer - 0x22050000 - 32K (0x8000)     - 0x22058000
 
 void oblfr_rpmsg_task(void *arg);
+static void oblfr_rpmsg_worker_task(void *arg);
+
+/* called from the rpmsg-lite rx callback, in the mailbox ISR or in the poll of oblfr_rpmsg_task() */
+static int32_t oblfr_rpmsg_rx_cb(void *payload, uint32_t payload_len, uint32_t src, void *priv)
+{
+    oblfr_queue_entry_t *queue_entry = priv;
+    oblfr_rpmsg_msg_t msg = {
+        .entry = queue_entry,
+        .src = src,
+        .data = payload,
+        .len = payload_len,
+        .rx_us = (uint32_t)bflb_mtimer_get_time_us(),
+    };
+
+    if (queue_entry->cfg->direct)
+    {
+        /* no queue and no task switch, rpmsg-lite releases the buffer on return */
+        if (queue_entry->valid)
+        {
+            queue_entry->dst = src;
+            queue_entry->cfg->cb(payload, payload_len, queue_entry->cfg->priv);
+            queue_entry->received++;
+            oblfr_rpmsg_received++;
+        }
+        return RL_RELEASE;
+    }
+
+    if (queue_entry->held >= queue_entry->credits)
+    {
+        /* the peer ignored the credits, keep the buffers for the other endpoints */
+        queue_entry->dropped++;
+        oblfr_rpmsg_dropped++;
+        return RL_RELEASE;
+    }
+    queue_entry->pending++;
+    if (env_put_queue(oblfr_rpmsg_workers[queue_entry->worker].queue, &msg, 0) == 0)
+    {
+        queue_entry->pending--;
+        return RL_RELEASE;
+    }
+    queue_entry->held++;
+    if (queue_entry->held > queue_entry->held_max)
+    {
+        queue_entry->held_max = queue_entry->held;
+    }
+    return RL_HOLD;
+}
 
 /* we shouldn't actually get any NS calls from Linux */
 static void ipc_rpmsg_ns_callback(uint32_t new_ept, const char *new_ept_name, uint32_t flags, void *user_data)
@@ -73,37 +223,145 @@ static void ipc_rpmsg_ns_callback(uint32_t new_ept, const char *new_ept_name, ui
     }
 }
 
+static void oblfr_rpmsg_flush_timer_cb(TimerHandle_t timer)
+{
+    rpmsg_lite_flush(ipc_rpmsg);
+}
+
+/* after a send or release, so a partial batch does not wait for more */
+static void oblfr_rpmsg_kick_later(void)
+{
+    if (oblfr_rpmsg_kick_batch > 1 && xTimerIsTimerActive(oblfr_rpmsg_flush_timer) == pdFALSE)
+    {
+        xTimerStart(oblfr_rpmsg_flush_timer, 0);
+    }
+}
+
+/* the buffers are placed by Linux, but have to fit the region after the vrings */
+static oblfr_err_t oblfr_rpmsg_check_layout(void)
+{
+    rpmsg_platform_shmem_config_t layout;
+    uint32_t buffer_size;
+
+    if (platform_get_custom_shmem_config(RL_PLATFORM_BL808_M0_LINK_ID, &layout) != 0)
+    {
+        return OBLFR_ERR_ERROR;
+    }
+    buffer_size = layout.buffer_payload_size + 16;
+    LOG_I("RPMsg shared memory 0x%08lx, %ld bytes: vrings %ld bytes, %d buffers of %ld bytes per direction\r\n",
+          (uint32_t)CONFIG_RPMSG_SHMEM_ADDR, (uint32_t)CONFIG_RPMSG_SHMEM_SIZE, layout.vring_size, layout.buffer_count, buffer_size);
+    if (2 * layout.vring_size + 2 * layout.buffer_count * buffer_size > CONFIG_RPMSG_SHMEM_SIZE)
+    {
+        LOG_E("RPMsg buffers do not fit the shared memory\r\n");
+        return OBLFR_ERR_INVALID;
+    }
+#ifdef CONFIG_RPMSG_DCACHE
+    /* the cache maintenance of a buffer must not touch its neighbours */
+    if ((CONFIG_RPMSG_SHMEM_ADDR % OBLFR_RPMSG_CACHE_LINE) != 0)
+    {
+        LOG_E("RPMsg shared memory is not aligned to the cache lines\r\n");
+        return OBLFR_ERR_INVALID;
+    }
+#endif
+    return OBLFR_OK;
+}
+
 oblfr_err_t init_rpmsg()
 {
 
     LOG_I("Initilizing RPMsg\r\n");
 
+#ifndef CONFIG_RPMSG_DCACHE
+    /* the shared memory is only coherent with the dcache off */
     bflb_l1c_dcache_disable();
+#endif
 
-    ipc_rpmsg = rpmsg_lite_remote_init((uintptr_t *)XRAM_RINGBUF_ADDR, RL_PLATFORM_BL808_M0_LINK_ID, RL_NO_FLAGS);
-    LOG_I("rpmsg addr %lx, remaining %lx, total: %lx\r\n", ipc_rpmsg->sh_mem_base, ipc_rpmsg->sh_mem_remaining, ipc_rpmsg->sh_mem_total);
+    if (oblfr_rpmsg_check_layout() != OBLFR_OK)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    /* checks the buffer count and size, and that the vrings hold them */
+    ipc_rpmsg = rpmsg_lite_remote_init((uintptr_t *)CONFIG_RPMSG_SHMEM_ADDR, RL_PLATFORM_BL808_M0_LINK_ID, OBLFR_RPMSG_INIT_FLAGS);
     if (ipc_rpmsg == NULL)
     {
         LOG_E("RPMSG init failed\r\n");
         return OBLFR_ERR_ERROR;
     }
-    xQueueSet = xQueueCreateSet(MAX_QUEUESET_SIZE);
-    if (xQueueSet == NULL)
+    /* each queue takes all rx buffers, a class may hold them all */
+    uint32_t queues = 0;
+    for (; queues < CONFIG_RPMSG_WORKERS; queues++)
     {
-        LOG_E("Failed to create QueueSet\r\n");
-        rpmsg_lite_deinit(ipc_rpmsg);
-        ipc_rpmsg = NULL;
-        return OBLFR_ERR_ERROR;
+        if (env_create_queue(&oblfr_rpmsg_workers[queues].queue, MAX_NUMBER_OF_QUEUED_MESSAGES, sizeof(oblfr_rpmsg_msg_t)) != 0)
+        {
+            LOG_E("Failed to create RX Queue\r\n");
+            goto err_queues;
+        }
     }
+    oblfr_rpmsg_flush_timer = xTimerCreate("rpmsg_flush", pdMS_TO_TICKS(CONFIG_RPMSG_KICK_FLUSH_MS), pdFALSE, NULL, oblfr_rpmsg_flush_timer_cb);
+    if (oblfr_rpmsg_flush_timer == NULL)
+    {
+        LOG_E("Failed to create flush timer\r\n");
+        goto err_queues;
+    }
+    rpmsg_lite_set_kick_batch(ipc_rpmsg, oblfr_rpmsg_kick_batch);
 
-    if (xTaskCreate(oblfr_rpmsg_task, "rpmsg", 1024, NULL, 5, NULL) != pdPASS)
+    oblfr_rpmsg_kept = calloc(MAX_NUMBER_OF_QUEUED_MESSAGES, sizeof(oblfr_rpmsg_msg_t));
+    if (oblfr_rpmsg_kept == NULL)
     {
-        LOG_E("Failed to create RPMSG task\r\n");
-        rpmsg_lite_deinit(ipc_rpmsg);
-        ipc_rpmsg = NULL;
-        return OBLFR_ERR_ERROR;
+        LOG_E("Failed to allocate kept messages\r\n");
+        goto err_timer;
+    }
+    if (env_create_mutex(&oblfr_rpmsg_lock, 1) != 0)
+    {
+        LOG_E("Failed to create RPMSG lock\r\n");
+        goto err_kept;
+    }
+    oblfr_rpmsg_credit = oblfr_rpmsg_device_add(&oblfr_rpmsg_credit_cfg);
+    if (oblfr_rpmsg_credit == NULL)
+    {
+        LOG_E("Failed to create credit endpoint\r\n");
+        goto err_lock;
+    }
+
+    /* class n runs n priorities above the first one, the first task also brings the link up */
+    for (uint32_t i = 0; i < CONFIG_RPMSG_WORKERS; i++)
+    {
+        if (xTaskCreate(i == 0 ? oblfr_rpmsg_task : oblfr_rpmsg_worker_task, oblfr_rpmsg_task_names[i], CONFIG_RPMSG_TASK_STACK,
+                        &oblfr_rpmsg_workers[i], CONFIG_RPMSG_TASK_PRIORITY + i, &oblfr_rpmsg_workers[i].task) != pdPASS)
+        {
+            LOG_E("Failed to create RPMSG task\r\n");
+            while (i-- > 0)
+            {
+                vTaskDelete(oblfr_rpmsg_workers[i].task);
+                oblfr_rpmsg_workers[i].task = NULL;
+            }
+            goto err_credit;
+        }
     }
     return OBLFR_OK;
+
+    /* in the reverse order of the creation */
+err_credit:
+    oblfr_rpmsg_device_remove(oblfr_rpmsg_credit);
+    oblfr_rpmsg_credit = NULL;
+err_lock:
+    env_delete_mutex(oblfr_rpmsg_lock);
+    oblfr_rpmsg_lock = NULL;
+err_kept:
+    free(oblfr_rpmsg_kept);
+    oblfr_rpmsg_kept = NULL;
+err_timer:
+    xTimerDelete(oblfr_rpmsg_flush_timer, portMAX_DELAY);
+    oblfr_rpmsg_flush_timer = NULL;
+err_queues:
+    while (queues-- > 0)
+    {
+        env_delete_queue(oblfr_rpmsg_workers[queues].queue);
+        oblfr_rpmsg_workers[queues].queue = NULL;
+    }
+    rpmsg_lite_deinit(ipc_rpmsg);
+    ipc_rpmsg = NULL;
+    return OBLFR_ERR_ERROR;
 }
 
 oblfr_queue_entry_t *oblfr_rpmsg_device_add(oblfr_device_cfg_t *cfg)
@@ -115,33 +373,35 @@ oblfr_queue_entry_t *oblfr_rpmsg_device_add(oblfr_device_cfg_t *cfg)
         return NULL;
     }
     queue_entry->cfg = cfg;
-
-    queue_entry->queue = rpmsg_queue_create(ipc_rpmsg);
-    if (queue_entry->queue == RL_NULL)
+    queue_entry->dst = RL_ADDR_ANY;
+    queue_entry->valid = true;
+    queue_entry->worker = cfg->priority < CONFIG_RPMSG_WORKERS ? cfg->priority : CONFIG_RPMSG_WORKERS - 1;
+    queue_entry->pending = queue_entry->held = queue_entry->kept = 0;
+    queue_entry->sent = queue_entry->received = 0;
+    queue_entry->credits = cfg->credits != 0 ? cfg->credits : CONFIG_RPMSG_EPT_CREDITS;
+    /* 0 is the whole pool, which never drops */
+    if (queue_entry->credits == 0 || queue_entry->credits > MAX_NUMBER_OF_QUEUED_MESSAGES)
     {
-        LOG_W("Failed to create RPMSG queue\r\n");
-        rpmsg_queue_destroy(ipc_rpmsg, queue_entry->queue);
-        return NULL;
+        queue_entry->credits = MAX_NUMBER_OF_QUEUED_MESSAGES;
     }
+    queue_entry->dropped = queue_entry->consumed = queue_entry->advertised = 0;
+    queue_entry->advertise = false;
+    queue_entry->held_max = queue_entry->hold_us_max = 0;
+    queue_entry->hold_us_total = 0;
 
     /* first endpoint addr will be 0x1*/
-    queue_entry->ept = rpmsg_lite_create_ept(ipc_rpmsg, RL_ADDR_ANY, rpmsg_queue_rx_cb, queue_entry->queue);
+    queue_entry->ept = rpmsg_lite_create_ept(ipc_rpmsg, RL_ADDR_ANY, oblfr_rpmsg_rx_cb, queue_entry);
     if (queue_entry->ept == RL_NULL)
     {
         LOG_W("Failed to create RPMSG endpoint\r\n");
-        rpmsg_queue_destroy(ipc_rpmsg, queue_entry->queue);
+        free(queue_entry);
         return NULL;
     }
 
+    /* the rpmsg tasks walk the list for the credits */
+    env_lock_mutex(oblfr_rpmsg_lock);
     LIST_INSERT_HEAD(&oblfr_rpmsg_queues, queue_entry, list_entry);
-    if (xQueueAddToSet(queue_entry->queue, xQueueSet) != pdPASS)
-    {
-        LOG_W("Failed to add queue to set\r\n");
-        rpmsg_lite_destroy_ept(ipc_rpmsg, queue_entry->ept);
-        rpmsg_queue_destroy(ipc_rpmsg, queue_entry->queue);
-        LIST_REMOVE(queue_entry, list_entry);
-        return NULL;
-    }
+    env_unlock_mutex(oblfr_rpmsg_lock);
 
     LOG_D("New RPMsg Driver %s\r\n", queue_entry->cfg->name);
 
@@ -151,15 +411,16 @@ oblfr_queue_entry_t *oblfr_rpmsg_device_add(oblfr_device_cfg_t *cfg)
         if (rpmsg_ns_announce(ipc_rpmsg, queue_entry->ept, queue_entry->cfg->name, RL_NS_CREATE) != RL_SUCCESS)
         {
             LOG_W("Failed to announce RPMSG NS\r\n");
+            env_lock_mutex(oblfr_rpmsg_lock);
+            LIST_REMOVE(queue_entry, list_entry);
+            env_unlock_mutex(oblfr_rpmsg_lock);
             rpmsg_lite_destroy_ept(ipc_rpmsg, queue_entry->ept);
-            rpmsg_queue_destroy(ipc_rpmsg, queue_entry->queue);
+            free(queue_entry);
             return NULL;
         }
+        rpmsg_lite_flush(ipc_rpmsg);
         LOG_D("New Endpoint %s Announced\r\n", queue_entry->cfg->name);
     }
-    queue_entry->dst = RL_ADDR_ANY;
-    queue_entry->valid = true;
-    queue_entry->sent = queue_entry->received = 0;
     return queue_entry;
 }
 
@@ -184,27 +445,28 @@ oblfr_err_t oblfr_rpmsg_device_remove(oblfr_queue_entry_t *device)
             LOG_W("Failed to Destroy RPMSG Nameservice for %s\r\n", device->cfg->name);
             ret = OBLFR_ERR_ERROR;
         }
+        rpmsg_lite_flush(ipc_rpmsg);
     }
+    /* unlinked before it can be freed, under the lock of the walks */
+    env_lock_mutex(oblfr_rpmsg_lock);
     LIST_REMOVE(device, list_entry);
-    if (xQueueRemoveFromSet(device->queue, xQueueSet) != pdPASS)
-    {
-        LOG_W("Failed to remove queue from set\r\n");
-        ret = OBLFR_ERR_ERROR;
-    }
+    env_unlock_mutex(oblfr_rpmsg_lock);
     if (rpmsg_lite_destroy_ept(ipc_rpmsg, device->ept) != RL_SUCCESS)
     {
         LOG_W("Failed to destroy RPMSG endpoint\r\n");
         ret = OBLFR_ERR_ERROR;
     }
+    LOG_D("RPMSG Driver %s removed: %d\r\n", device->cfg->name, ret);
 
-    if (rpmsg_queue_destroy(ipc_rpmsg, device->queue) != RL_SUCCESS)
+    /* messages still queued for the device refer to it, the rpmsg task frees it after them */
+    taskENTER_CRITICAL();
+    device->valid = false;
+    bool pending = device->pending != 0;
+    taskEXIT_CRITICAL();
+    if (!pending)
     {
-        LOG_W("Failed to destroy RPMSG queue\r\n");
-        ret = OBLFR_ERR_ERROR;
+        free(device);
     }
-    LOG_D("RPMSG Driver %s removed: %d\r\n", device->cfg->name, ret);
-    device->valid = false;
-    free(device);
     device = NULL;
     return ret;
 }
@@ -221,7 +483,7 @@ oblfr_err_t oblfr_rpmsg_device_send(oblfr_queue_entry_t *device, void *data, siz
         LOG_W("Invalid Handle\r\n");
         return OBLFR_ERR_INVALID;
     }
-    if (len > RL_BUFFER_PAYLOAD_SIZE)
+    if (len > OBLFR_RPMSG_MTU)
     {
         LOG_W("Message too large\r\n");
         return OBLFR_ERR_INVALID;
@@ -241,7 +503,82 @@ oblfr_err_t oblfr_rpmsg_device_send(oblfr_queue_entry_t *device, void *data, siz
         LOG_W("Failed to send message\r\n");
         return OBLFR_ERR_ERROR;
     }
+    oblfr_rpmsg_kick_later();
+    device->sent++;
+    oblfr_rpmsg_sent++;
+    LOG_D("Sent message to %s\r\n", device->cfg->name);
+    return OBLFR_OK;
+}
+
+oblfr_err_t oblfr_rpmsg_device_sendv(oblfr_queue_entry_t *device, const struct iovec *iov, int iovcnt, OBLFR_Timeout timeout)
+{
+    size_t len = 0;
+    uint32_t size;
+    uint8_t *buffer;
+
+    if (device == NULL)
+    {
+        LOG_W("Invalid Handle\r\n");
+        return OBLFR_ERR_INVALID;
+    }
+    if (device->valid == false)
+    {
+        LOG_W("Invalid Handle\r\n");
+        return OBLFR_ERR_INVALID;
+    }
+    if (iov == NULL || iovcnt < 0)
+    {
+        LOG_W("Invalid IO Vector\r\n");
+        return OBLFR_ERR_INVALID;
+    }
+    /* everything is checked before a buffer is taken */
+    for (int i = 0; i < iovcnt; i++)
+    {
+        if (iov[i].iov_len > OBLFR_RPMSG_MTU - len)
+        {
+            LOG_W("Message too large\r\n");
+            return OBLFR_ERR_INVALID;
+        }
+        if (iov[i].iov_base == NULL && iov[i].iov_len > 0)
+        {
+            LOG_W("Invalid IO Vector\r\n");
+            return OBLFR_ERR_INVALID;
+        }
+        len += iov[i].iov_len;
+    }
+    if (device->ept == NULL || device->dst == RL_ADDR_ANY)
+    {
+        LOG_W("No destination address\r\n");
+        return OBLFR_ERR_INVALID;
+    }
+    if (rpmsg_lite_is_link_up(ipc_rpmsg) == RL_FALSE)
+    {
+        LOG_W("Link is down\r\n");
+        return OBLFR_ERR_ERROR;
+    }
+    buffer = rpmsg_lite_alloc_tx_buffer(ipc_rpmsg, &size, (uint32_t)timeout);
+    if (buffer == NULL)
+    {
+        LOG_W("Failed to allocate buffer\r\n");
+        return OBLFR_ERR_ERROR;
+    }
+    /* the only copy of the message */
+    len = 0;
+    for (int i = 0; i < iovcnt; i++)
+    {
+        memcpy(buffer + len, iov[i].iov_base, iov[i].iov_len);
+        len += iov[i].iov_len;
+    }
+    if (rpmsg_lite_send_nocopy(ipc_rpmsg, device->ept, device->dst, buffer, len) != RL_SUCCESS)
+    {
+        LOG_W("Failed to send message\r\n");
+        /* still ours, hand it back for the next send */
+        rpmsg_lite_release_tx_buffer(ipc_rpmsg, buffer);
+        return OBLFR_ERR_ERROR;
+    }
+    oblfr_rpmsg_kick_later();
     device->sent++;
+    oblfr_rpmsg_sent++;
     LOG_D("Sent message to %s\r\n", device->cfg->name);
     return OBLFR_OK;
 }
@@ -283,7 +620,7 @@ oblfr_err_t oblfr_rpmsg_device_send_buffer(oblfr_queue_entry_t *device, void *bu
         LOG_W("Invalid Handle\r\n");
         return OBLFR_ERR_INVALID;
     }
-    if (len > RL_BUFFER_PAYLOAD_SIZE)
+    if (len > OBLFR_RPMSG_MTU)
     {
         LOG_W("Message too large\r\n");
         return OBLFR_ERR_INVALID;
@@ -303,14 +640,16 @@ oblfr_err_t oblfr_rpmsg_device_send_buffer(oblfr_queue_entry_t *device, void *bu
         LOG_W("Failed to send message\r\n");
         return OBLFR_ERR_ERROR;
     }
+    oblfr_rpmsg_kick_later();
     device->sent++;
+    oblfr_rpmsg_sent++;
     LOG_D("Sent message to %s\r\n", device->cfg->name);
     return OBLFR_OK;
 }
 
 uint32_t oblfr_rpmsg_get_mtu(void)
 {
-    return RL_BUFFER_PAYLOAD_SIZE;
+    return OBLFR_RPMSG_MTU;
 }
 
 bool oblfr_rpmsg_is_ready(void)
@@ -318,6 +657,65 @@ bool oblfr_rpmsg_is_ready(void)
     return rpmsg_lite_is_link_up(ipc_rpmsg);
 }
 
+oblfr_err_t oblfr_rpmsg_set_kick_batch(uint32_t batch)
+{
+    if (ipc_rpmsg == NULL)
+    {
+        return OBLFR_ERR_ERROR;
+    }
+    oblfr_rpmsg_kick_batch = batch;
+    if (rpmsg_lite_set_kick_batch(ipc_rpmsg, batch) != RL_SUCCESS)
+    {
+        return OBLFR_ERR_ERROR;
+    }
+    return OBLFR_OK;
+}
+
+oblfr_err_t oblfr_rpmsg_flush(void)
+{
+    if (ipc_rpmsg == NULL)
+    {
+        return OBLFR_ERR_ERROR;
+    }
+    if (rpmsg_lite_flush(ipc_rpmsg) != RL_SUCCESS)
+    {
+        return OBLFR_ERR_ERROR;
+    }
+    return OBLFR_OK;
+}
+
+oblfr_err_t oblfr_rpmsg_get_stats(oblfr_rpmsg_stats_t *stats)
+{
+    if (ipc_rpmsg == NULL || stats == NULL)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    stats->sent = oblfr_rpmsg_sent;
+    stats->received = oblfr_rpmsg_received;
+    stats->tx_kicks = ipc_rpmsg->tvq->vq_notify_cnt;
+    stats->rx_kicks = ipc_rpmsg->rvq->vq_notify_cnt;
+    stats->dropped = oblfr_rpmsg_dropped;
+    return OBLFR_OK;
+}
+
+oblfr_err_t oblfr_rpmsg_get_device_stats(oblfr_queue_entry_t *device, oblfr_rpmsg_device_stats_t *stats)
+{
+    if (device == NULL || device->valid == false || stats == NULL)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    stats->sent = device->sent;
+    stats->received = device->received;
+    stats->dropped = device->dropped;
+    stats->held = device->held;
+    stats->kept = device->kept;
+    stats->held_max = device->held_max;
+    stats->credits = device->credits;
+    stats->hold_us_avg = device->consumed != 0 ? (uint32_t)(device->hold_us_total / device->consumed) : 0;
+    stats->hold_us_max = device->hold_us_max;
+    return OBLFR_OK;
+}
+
 oblfr_err_t oblfr_rpmsg_dump(void)
 {
     oblfr_queue_entry_t *rpmsgqueue;
@@ -331,31 +729,224 @@ oblfr_err_t oblfr_rpmsg_dump(void)
     LOG_I("State: %s\r\n", rpmsg_lite_is_link_up(ipc_rpmsg) == RL_TRUE ? "UP" : "DOWN");
     LOG_I("Shared Memory Total: %ld Free: %ld\r\n", ipc_rpmsg->sh_mem_total, ipc_rpmsg->sh_mem_remaining);
     LOG_I("RPMSG MTU %ld\r\n", oblfr_rpmsg_get_mtu());
+    LOG_I("Kicks: TX %ld RX %ld, Batch %ld\r\n", ipc_rpmsg->tvq->vq_notify_cnt, ipc_rpmsg->rvq->vq_notify_cnt, oblfr_rpmsg_kick_batch);
+    env_lock_mutex(oblfr_rpmsg_lock);
     LIST_FOREACH(rpmsgqueue, &oblfr_rpmsg_queues, list_entry)
     {
-        LOG_I("Endpoint: %s - Addr: %ld Sent: %ld Recv: %ld\r\n", rpmsgqueue->cfg->name, rpmsgqueue->dst, rpmsgqueue->sent, rpmsgqueue->received);
+        LOG_I("Endpoint: %s - Addr: %ld Sent: %ld Recv: %ld Class: %ld%s\r\n", rpmsgqueue->cfg->name, rpmsgqueue->dst, rpmsgqueue->sent, rpmsgqueue->received, rpmsgqueue->worker, rpmsgqueue->cfg->direct ? " (direct)" : "");
+        LOG_I("    Credits: %ld Held: %ld Kept: %ld Max: %ld Dropped: %ld Hold max: %ld us\r\n", rpmsgqueue->credits, rpmsgqueue->held, rpmsgqueue->kept, rpmsgqueue->held_max, rpmsgqueue->dropped, rpmsgqueue->hold_us_max);
     }
+    env_unlock_mutex(oblfr_rpmsg_lock);
     LOG_I("========================================\r\n");
     return OBLFR_OK;
 }
 
-void oblfr_process_queue(oblfr_queue_entry_t *rpmsgqueue)
+/* with oblfr_rpmsg_lock held */
+static void oblfr_rpmsg_advertise(oblfr_queue_entry_t *entry)
 {
-    char *rx_msg;
-    uint32_t len;
-    if (rpmsg_queue_recv_nocopy(ipc_rpmsg, rpmsgqueue->queue, &rpmsgqueue->dst, &rx_msg, &len, RL_DONT_BLOCK) == RL_SUCCESS)
+    oblfr_rpmsg_credit_t credit;
+
+    if (entry == oblfr_rpmsg_credit || entry->cfg->direct || oblfr_rpmsg_credit->dst == RL_ADDR_ANY)
+    {
+        return;
+    }
+    credit.addr = entry->ept->addr;
+    /* the dropped messages are released too */
+    credit.consumed = entry->consumed + entry->dropped;
+    credit.credits = (uint16_t)entry->credits;
+    credit.reserved = 0;
+    /* never wait for a tx buffer here, the receive path would stall */
+    if (rpmsg_lite_send(ipc_rpmsg, oblfr_rpmsg_credit->ept, oblfr_rpmsg_credit->dst, (char *)&credit, sizeof(credit), RL_DONT_BLOCK) != RL_SUCCESS)
+    {
+        entry->advertise = true;
+        oblfr_rpmsg_credit_retry = true;
+        return;
+    }
+    oblfr_rpmsg_kick_later();
+    entry->advertised = credit.consumed;
+    entry->advertise = false;
+    oblfr_rpmsg_credit->sent++;
+    oblfr_rpmsg_sent++;
+}
+
+/* retry the advertisements that found no tx buffer */
+static void oblfr_rpmsg_advertise_pending(void)
+{
+    oblfr_queue_entry_t *rpmsgqueue;
+
+    env_lock_mutex(oblfr_rpmsg_lock);
+    oblfr_rpmsg_credit_retry = false;
+    LIST_FOREACH(rpmsgqueue, &oblfr_rpmsg_queues, list_entry)
     {
-        rpmsgqueue->cfg->cb(rx_msg, len, rpmsgqueue->cfg->priv);
-        if (rpmsg_queue_nocopy_free(ipc_rpmsg, rx_msg) != RL_SUCCESS)
+        if (rpmsgqueue->advertise)
         {
-            LOG_W("Failed to free rpmsg buffer\r\n");
+            oblfr_rpmsg_advertise(rpmsgqueue);
         }
+    }
+    env_unlock_mutex(oblfr_rpmsg_lock);
+}
+
+/* any message subscribes the peer, which gets all credits */
+static void oblfr_rpmsg_credit_rx(void *data, size_t len, void *priv)
+{
+    oblfr_queue_entry_t *rpmsgqueue;
+
+    LOG_D("Credits subscribed by %ld\r\n", oblfr_rpmsg_credit->dst);
+    env_lock_mutex(oblfr_rpmsg_lock);
+    LIST_FOREACH(rpmsgqueue, &oblfr_rpmsg_queues, list_entry)
+    {
+        oblfr_rpmsg_advertise(rpmsgqueue);
+    }
+    env_unlock_mutex(oblfr_rpmsg_lock);
+}
+
+/* the callback is done with the buffer, in a rpmsg task or oblfr_rpmsg_release() */
+static void oblfr_rpmsg_msg_done(oblfr_rpmsg_msg_t *msg)
+{
+    oblfr_queue_entry_t *rpmsgqueue = msg->entry;
+    uint32_t hold_us = (uint32_t)bflb_mtimer_get_time_us() - msg->rx_us;
+    bool valid;
+
+    env_lock_mutex(oblfr_rpmsg_lock);
+    rpmsgqueue->hold_us_total += hold_us;
+    if (hold_us > rpmsgqueue->hold_us_max)
+    {
+        rpmsgqueue->hold_us_max = hold_us;
+    }
+    rpmsgqueue->consumed++;
+    /* before the release, the peer may send the next message as soon as the buffer is back */
+    taskENTER_CRITICAL();
+    rpmsgqueue->held--;
+    taskEXIT_CRITICAL();
+
+    if (rpmsg_lite_release_rx_buffer(ipc_rpmsg, msg->data) != RL_SUCCESS)
+    {
+        LOG_W("Failed to free rpmsg buffer\r\n");
+    }
+    oblfr_rpmsg_kick_later();
+
+    /* half of the credits released since the last advertisement */
+    if (rpmsgqueue->valid && rpmsgqueue->consumed + rpmsgqueue->dropped - rpmsgqueue->advertised >= (rpmsgqueue->credits + 1) / 2)
+    {
+        oblfr_rpmsg_advertise(rpmsgqueue);
+    }
+    env_unlock_mutex(oblfr_rpmsg_lock);
+
+    taskENTER_CRITICAL();
+    rpmsgqueue->pending--;
+    valid = rpmsgqueue->valid || rpmsgqueue->pending != 0;
+    taskEXIT_CRITICAL();
+    if (!valid)
+    {
+        /* removed while messages were queued for it */
+        free(rpmsgqueue);
+    }
+}
+
+static void oblfr_process_msg(oblfr_rpmsg_worker_t *worker, oblfr_rpmsg_msg_t *msg)
+{
+    oblfr_queue_entry_t *rpmsgqueue = msg->entry;
+
+    if (rpmsgqueue->valid)
+    {
+        rpmsgqueue->dst = msg->src;
+        worker->current = msg;
+        worker->current_kept = false;
+        rpmsgqueue->cfg->cb(msg->data, msg->len, rpmsgqueue->cfg->priv);
+        worker->current = NULL;
+        /* the tasks of two classes may count at once */
+        taskENTER_CRITICAL();
         rpmsgqueue->received++;
+        oblfr_rpmsg_received++;
+        taskEXIT_CRITICAL();
+        if (worker->current_kept)
+        {
+            /* oblfr_rpmsg_release() finishes it */
+            return;
+        }
     }
+    oblfr_rpmsg_msg_done(msg);
 }
 
+oblfr_err_t oblfr_rpmsg_hold(void *data)
+{
+    oblfr_rpmsg_worker_t *worker = NULL;
+    oblfr_rpmsg_msg_t *msg;
+    uint32_t i;
+
+    for (i = 0; i < CONFIG_RPMSG_WORKERS; i++)
+    {
+        if (oblfr_rpmsg_workers[i].task == xTaskGetCurrentTaskHandle())
+        {
+            worker = &oblfr_rpmsg_workers[i];
+            break;
+        }
+    }
+    /* a direct callback may interrupt a rpmsg task, but not with the same data */
+    msg = worker != NULL ? worker->current : NULL;
+    if (msg == NULL || msg->data != data)
+    {
+        LOG_W("Not the message of the callback\r\n");
+        return OBLFR_ERR_INVALID;
+    }
+    if (worker->current_kept)
+    {
+        return OBLFR_OK;
+    }
+    env_lock_mutex(oblfr_rpmsg_lock);
+    /* a slot per rx buffer, one is always free */
+    for (i = 0; i < MAX_NUMBER_OF_QUEUED_MESSAGES; i++)
+    {
+        if (oblfr_rpmsg_kept[i].data == NULL)
+        {
+            oblfr_rpmsg_kept[i] = *msg;
+            msg->entry->kept++;
+            break;
+        }
+    }
+    env_unlock_mutex(oblfr_rpmsg_lock);
+    if (i == MAX_NUMBER_OF_QUEUED_MESSAGES)
+    {
+        LOG_E("No slot for a kept message\r\n");
+        return OBLFR_ERR_ERROR;
+    }
+    worker->current_kept = true;
+    return OBLFR_OK;
+}
+
+oblfr_err_t oblfr_rpmsg_release(void *data)
+{
+    oblfr_rpmsg_msg_t msg = { 0 };
+
+    if (data == NULL || oblfr_rpmsg_kept == NULL)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    env_lock_mutex(oblfr_rpmsg_lock);
+    for (uint32_t i = 0; i < MAX_NUMBER_OF_QUEUED_MESSAGES; i++)
+    {
+        if (oblfr_rpmsg_kept[i].data == data)
+        {
+            msg = oblfr_rpmsg_kept[i];
+            oblfr_rpmsg_kept[i].data = NULL;
+            msg.entry->kept--;
+            break;
+        }
+    }
+    env_unlock_mutex(oblfr_rpmsg_lock);
+    if (msg.data == NULL)
+    {
+        LOG_W("Buffer is not kept\r\n");
+        return OBLFR_ERR_INVALID;
+    }
+    oblfr_rpmsg_msg_done(&msg);
+    return OBLFR_OK;
+}
+
+/* the rpmsg task of class 0, which also brings the link up and retries the advertisements */
 void oblfr_rpmsg_task(void *arg)
 {
+    oblfr_rpmsg_worker_t *worker = arg;
     oblfr_queue_entry_t *rpmsgqueue;
 
     LOG_I("Waiting for RPMSG link up\r\n");
@@ -389,34 +980,53 @@ void oblfr_rpmsg_task(void *arg)
             LOG_D("Device %s announced\r\n", rpmsgqueue->cfg->name);
         }
     }
+    rpmsg_lite_flush(ipc_rpmsg);
 
     while (1)
     {
-        QueueSetMemberHandle_t xActivatedMember = xQueueSelectFromSet(xQueueSet, 1000 / portTICK_PERIOD_MS);
-        if (xActivatedMember != NULL)
+        oblfr_rpmsg_msg_t msg;
+        /* a failed advertisement is retried soon, the peer may wait for it */
+        uint32_t wait_ms = oblfr_rpmsg_credit_retry ? CONFIG_RPMSG_KICK_FLUSH_MS : 1000;
+        if (env_get_queue(worker->queue, &msg, wait_ms) != 0)
         {
-            LOG_D("Selected queue %p\r\n", xActivatedMember);
-            bool handled = false;
-            LIST_FOREACH(rpmsgqueue, &oblfr_rpmsg_queues, list_entry)
-            {
-                LOG_D("Checking queue %s\r\n", rpmsgqueue->cfg->name);
-                if (rpmsgqueue->queue == xActivatedMember)
-                {
-                    LOG_D("Received message on queue %s\r\n", rpmsgqueue->cfg->name);
-                    oblfr_process_queue(rpmsgqueue);
-                    handled = true;
-                    break;
-                }
-            }
-            if (!handled)
+            LOG_D("Received message on queue %s\r\n", msg.entry->cfg->name);
+            oblfr_process_msg(worker, &msg);
+            if (oblfr_rpmsg_credit_retry)
             {
-                LOG_E("Received message on unknown queue\r\n");
+                oblfr_rpmsg_advertise_pending();
             }
+        } else if (oblfr_rpmsg_credit_retry) {
+            oblfr_rpmsg_advertise_pending();
         } else {
-            /* occasionally check our RX Queue in case we miss a interupt */
-            env_isr(1);
+            /* occasionally check our RX Queue in case we miss a interupt, with the
+             * interrupt masked so both do not run at once. This runs the direct
+             * callbacks in this task */
+            env_disable_interrupt(OBLFR_RPMSG_RX_VECTOR);
+            env_isr(OBLFR_RPMSG_RX_VECTOR);
+            env_enable_interrupt(OBLFR_RPMSG_RX_VECTOR);
         }
     }
 
     return;
 }
+
+/* the rpmsg tasks of the higher classes, messages only arrive once the link is up */
+static void oblfr_rpmsg_worker_task(void *arg)
+{
+    oblfr_rpmsg_worker_t *worker = arg;
+    oblfr_rpmsg_msg_t msg;
+
+    while (1)
+    {
+        uint32_t wait_ms = oblfr_rpmsg_credit_retry ? CONFIG_RPMSG_KICK_FLUSH_MS : RL_BLOCK;
+        if (env_get_queue(worker->queue, &msg, wait_ms) != 0)
+        {
+            LOG_D("Received message on queue %s\r\n", msg.entry->cfg->name);
+            oblfr_process_msg(worker, &msg);
+        }
+        if (oblfr_rpmsg_credit_retry)
+        {
+            oblfr_rpmsg_advertise_pending();
+        }
+    }
+}
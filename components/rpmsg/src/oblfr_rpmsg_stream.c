@@ -0,0 +1,339 @@
+#include <stdlib.h>
+#include <string.h>
+#include <bflb_mtimer.h>
+
+#include "rpmsg_lite.h"
+#include "oblfr_rpmsg.h"
+#include "oblfr_rpmsg_stream.h"
+
+#define DBG_TAG "RPMSG"
+#include <log.h>
+
+typedef struct oblfr_rpmsg_stream_s
+{
+    oblfr_rpmsg_stream_cfg_t *cfg;
+    oblfr_device_cfg_t device_cfg;
+    oblfr_queue_entry_t *device;
+
+    /* sender, one message at a time */
+    void *tx_lock;
+    uint16_t tx_seq;
+    uint32_t tx_msgs;
+    uint32_t tx_frags;
+    uint64_t tx_bytes;
+    uint64_t tx_us;
+
+    /* reassembly buffers, taken by the rx callback and released by the application */
+    void *pool_lock;
+    void **bufs;
+    bool *in_use;
+    uint32_t buf_count;
+    bool bufs_allocated;
+
+    /* message being reassembled, only touched by the rx callback */
+    uint8_t *rx_buf;
+    uint16_t rx_seq;
+    uint32_t rx_total;
+    uint32_t rx_len;
+    uint64_t rx_start;
+    uint32_t rx_msgs;
+    uint32_t rx_frags;
+    uint64_t rx_bytes;
+    uint64_t rx_us;
+    uint32_t rx_dropped;
+} oblfr_rpmsg_stream_t;
+
+static void *oblfr_rpmsg_stream_buf_get(oblfr_rpmsg_stream_t *stream)
+{
+    void *buf = NULL;
+
+    env_lock_mutex(stream->pool_lock);
+    for (uint32_t i = 0; i < stream->buf_count; i++)
+    {
+        if (!stream->in_use[i])
+        {
+            stream->in_use[i] = true;
+            buf = stream->bufs[i];
+            break;
+        }
+    }
+    env_unlock_mutex(stream->pool_lock);
+    return buf;
+}
+
+oblfr_err_t oblfr_rpmsg_stream_release(oblfr_rpmsg_stream_t *stream, void *data)
+{
+    oblfr_err_t ret = OBLFR_ERR_INVALID;
+
+    if (stream == NULL || data == NULL)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    env_lock_mutex(stream->pool_lock);
+    for (uint32_t i = 0; i < stream->buf_count; i++)
+    {
+        if (stream->bufs[i] == data && stream->in_use[i])
+        {
+            stream->in_use[i] = false;
+            ret = OBLFR_OK;
+            break;
+        }
+    }
+    env_unlock_mutex(stream->pool_lock);
+    return ret;
+}
+
+/* give up the message being reassembled, its remaining fragments are ignored */
+static void oblfr_rpmsg_stream_rx_drop(oblfr_rpmsg_stream_t *stream)
+{
+    if (stream->rx_buf != NULL)
+    {
+        oblfr_rpmsg_stream_release(stream, stream->rx_buf);
+        stream->rx_buf = NULL;
+    }
+    stream->rx_dropped++;
+}
+
+/* oblfr_device_cfg_t callback, in the rpmsg task */
+static void oblfr_rpmsg_stream_rx(void *data, size_t len, void *priv)
+{
+    oblfr_rpmsg_stream_t *stream = priv;
+    oblfr_rpmsg_frag_t frag;
+    uint8_t *buf;
+    size_t payload_len;
+
+    if (len < sizeof(frag))
+    {
+        LOG_W("Stream %s: short fragment of %lu bytes\r\n", stream->cfg->name, (unsigned long)len);
+        stream->rx_dropped++;
+        return;
+    }
+    /* the payload of a rpmsg message is not aligned */
+    memcpy(&frag, data, sizeof(frag));
+    payload_len = len - sizeof(frag);
+    stream->rx_frags++;
+
+    if (frag.offset == 0)
+    {
+        if (stream->rx_buf != NULL)
+        {
+            LOG_W("Stream %s: message %d incomplete\r\n", stream->cfg->name, stream->rx_seq);
+            oblfr_rpmsg_stream_rx_drop(stream);
+        }
+        if (frag.total > stream->cfg->max_len)
+        {
+            LOG_W("Stream %s: message of %lu bytes too large\r\n", stream->cfg->name, (unsigned long)frag.total);
+            stream->rx_dropped++;
+            return;
+        }
+        stream->rx_buf = oblfr_rpmsg_stream_buf_get(stream);
+        if (stream->rx_buf == NULL)
+        {
+            LOG_W("Stream %s: no free buffer\r\n", stream->cfg->name);
+            stream->rx_dropped++;
+            return;
+        }
+        stream->rx_seq = frag.seq;
+        stream->rx_total = frag.total;
+        stream->rx_len = 0;
+        stream->rx_start = bflb_mtimer_get_time_us();
+    }
+    if (stream->rx_buf == NULL)
+    {
+        /* rest of a dropped message */
+        return;
+    }
+    if (frag.seq != stream->rx_seq || frag.total != stream->rx_total || frag.offset != stream->rx_len ||
+        payload_len > stream->rx_total - stream->rx_len)
+    {
+        LOG_W("Stream %s: fragment lost in message %d\r\n", stream->cfg->name, stream->rx_seq);
+        oblfr_rpmsg_stream_rx_drop(stream);
+        return;
+    }
+    memcpy(stream->rx_buf + stream->rx_len, (uint8_t *)data + sizeof(frag), payload_len);
+    stream->rx_len += payload_len;
+
+    if (stream->rx_len == stream->rx_total)
+    {
+        stream->rx_us += bflb_mtimer_get_time_us() - stream->rx_start;
+        stream->rx_msgs++;
+        stream->rx_bytes += stream->rx_total;
+        buf = stream->rx_buf;
+        stream->rx_buf = NULL;
+        stream->cfg->cb(stream, buf, stream->rx_total, stream->cfg->priv);
+    }
+}
+
+oblfr_rpmsg_stream_t *oblfr_rpmsg_stream_add(oblfr_rpmsg_stream_cfg_t *cfg)
+{
+    if (cfg == NULL || cfg->cb == NULL)
+    {
+        LOG_W("Invalid Stream Configuration\r\n");
+        return NULL;
+    }
+    oblfr_rpmsg_stream_t *stream = calloc(1, sizeof(oblfr_rpmsg_stream_t));
+    if (stream == NULL)
+    {
+        LOG_E("Failed to allocate stream\r\n");
+        return NULL;
+    }
+    stream->cfg = cfg;
+    stream->buf_count = cfg->buf_count != 0 ? cfg->buf_count : 1;
+    stream->in_use = calloc(stream->buf_count, sizeof(bool));
+    if (cfg->bufs != NULL)
+    {
+        stream->bufs = cfg->bufs;
+    }
+    else
+    {
+        stream->bufs = calloc(stream->buf_count, sizeof(void *));
+        stream->bufs_allocated = true;
+        for (uint32_t i = 0; stream->bufs != NULL && i < stream->buf_count; i++)
+        {
+            stream->bufs[i] = malloc(cfg->max_len != 0 ? cfg->max_len : 1);
+            if (stream->bufs[i] == NULL)
+            {
+                LOG_E("Failed to allocate stream buffers\r\n");
+                goto err;
+            }
+        }
+    }
+    if (stream->in_use == NULL || stream->bufs == NULL)
+    {
+        LOG_E("Failed to allocate stream buffers\r\n");
+        goto err;
+    }
+    if (env_create_mutex(&stream->tx_lock, 1) != RL_SUCCESS)
+    {
+        LOG_E("Failed to create stream lock\r\n");
+        goto err;
+    }
+    if (env_create_mutex(&stream->pool_lock, 1) != RL_SUCCESS)
+    {
+        LOG_E("Failed to create stream lock\r\n");
+        goto err;
+    }
+
+    strncpy(stream->device_cfg.name, cfg->name, sizeof(stream->device_cfg.name));
+    stream->device_cfg.cb = oblfr_rpmsg_stream_rx;
+    stream->device_cfg.status_cb = cfg->status_cb;
+    stream->device_cfg.priv = stream;
+    stream->device_cfg.credits = cfg->credits;
+    stream->device_cfg.priority = cfg->priority;
+    stream->device = oblfr_rpmsg_device_add(&stream->device_cfg);
+    if (stream->device == NULL)
+    {
+        goto err;
+    }
+    return stream;
+
+err:
+    if (stream->pool_lock != NULL)
+    {
+        env_delete_mutex(stream->pool_lock);
+    }
+    if (stream->tx_lock != NULL)
+    {
+        env_delete_mutex(stream->tx_lock);
+    }
+    if (stream->bufs_allocated && stream->bufs != NULL)
+    {
+        for (uint32_t i = 0; i < stream->buf_count; i++)
+        {
+            free(stream->bufs[i]);
+        }
+        free(stream->bufs);
+    }
+    free(stream->in_use);
+    free(stream);
+    return NULL;
+}
+
+oblfr_err_t oblfr_rpmsg_stream_remove(oblfr_rpmsg_stream_t *stream)
+{
+    oblfr_err_t ret;
+
+    if (stream == NULL)
+    {
+        LOG_W("Invalid Handle\r\n");
+        return OBLFR_ERR_INVALID;
+    }
+    ret = oblfr_rpmsg_device_remove(stream->device);
+    env_delete_mutex(stream->pool_lock);
+    env_delete_mutex(stream->tx_lock);
+    if (stream->bufs_allocated)
+    {
+        for (uint32_t i = 0; i < stream->buf_count; i++)
+        {
+            free(stream->bufs[i]);
+        }
+        free(stream->bufs);
+    }
+    free(stream->in_use);
+    free(stream);
+    return ret;
+}
+
+oblfr_err_t oblfr_rpmsg_stream_send(oblfr_rpmsg_stream_t *stream, const void *data, size_t len, OBLFR_Timeout timeout)
+{
+    uint32_t frag_max = oblfr_rpmsg_get_mtu() - sizeof(oblfr_rpmsg_frag_t);
+    oblfr_rpmsg_frag_t frag = { .total = len };
+    struct iovec iov[2] = {
+        { .iov_base = &frag, .iov_len = sizeof(frag) },
+    };
+    oblfr_err_t ret = OBLFR_OK;
+    uint64_t start;
+
+    if (stream == NULL || (data == NULL && len != 0))
+    {
+        LOG_W("Invalid Arguments\r\n");
+        return OBLFR_ERR_INVALID;
+    }
+
+    env_lock_mutex(stream->tx_lock);
+    start = bflb_mtimer_get_time_us();
+    frag.seq = stream->tx_seq++;
+    /* a message of 0 bytes is one empty fragment */
+    do
+    {
+        iov[1].iov_base = (uint8_t *)data + frag.offset;
+        iov[1].iov_len = len - frag.offset < frag_max ? len - frag.offset : frag_max;
+        ret = oblfr_rpmsg_device_sendv(stream->device, iov, 2, timeout);
+        if (ret != OBLFR_OK)
+        {
+            LOG_W("Stream %s: failed to send fragment at %lu of %lu\r\n", stream->cfg->name,
+                  (unsigned long)frag.offset, (unsigned long)frag.total);
+            break;
+        }
+        stream->tx_frags++;
+        frag.offset += iov[1].iov_len;
+    } while (frag.offset < len);
+    /* the last fragments may be held back by the kick batch */
+    oblfr_rpmsg_flush();
+    if (ret == OBLFR_OK)
+    {
+        stream->tx_us += bflb_mtimer_get_time_us() - start;
+        stream->tx_msgs++;
+        stream->tx_bytes += len;
+    }
+    env_unlock_mutex(stream->tx_lock);
+    return ret;
+}
+
+oblfr_err_t oblfr_rpmsg_stream_get_stats(oblfr_rpmsg_stream_t *stream, oblfr_rpmsg_stream_stats_t *stats)
+{
+    if (stream == NULL || stats == NULL)
+    {
+        return OBLFR_ERR_INVALID;
+    }
+    stats->tx_msgs = stream->tx_msgs;
+    stats->tx_frags = stream->tx_frags;
+    stats->tx_bytes = stream->tx_bytes;
+    stats->tx_bytes_per_s = stream->tx_us != 0 ? (uint32_t)(stream->tx_bytes * 1000000 / stream->tx_us) : 0;
+    stats->rx_msgs = stream->rx_msgs;
+    stats->rx_frags = stream->rx_frags;
+    stats->rx_bytes = stream->rx_bytes;
+    stats->rx_bytes_per_s = stream->rx_us != 0 ? (uint32_t)(stream->rx_bytes * 1000000 / stream->rx_us) : 0;
+    stats->rx_dropped = stream->rx_dropped;
+    return OBLFR_OK;
+}